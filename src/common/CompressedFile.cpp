@@ -0,0 +1,383 @@
+/*
+ * VERMONT
+ * Streaming compression of output files
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "CompressedFile.h"
+#include "msg.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <deque>
+#include <vector>
+
+#ifdef ZLIB_SUPPORT_ENABLED
+#include <zlib.h>
+#endif
+
+/* gzip header with deflate as compression method */
+static const unsigned char GZIP_MAGIC[] = { 0x1f, 0x8b, 0x08 };
+
+#ifdef ZLIB_SUPPORT_ENABLED
+
+struct compressed_file {
+	int fd;
+	int level;
+	z_stream stream;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond; /**< signals new frames, finished frames and closing */
+	std::vector<uint8_t>* current; /**< frame being filled by the writer */
+	std::deque<std::vector<uint8_t>*> frames; /**< frames waiting for or in compression */
+	std::vector<std::vector<uint8_t>*> spare; /**< compressed frames for reuse */
+	std::vector<uint8_t> output;
+	bool closing;
+	int error; /**< errno of the first failure in the background thread */
+};
+
+static bool writeAll(int fd, const uint8_t* data, size_t length)
+{
+	while (length > 0) {
+		ssize_t n = write(fd, data, length);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		}
+		data += n;
+		length -= n;
+	}
+	return true;
+}
+
+/**
+ * compresses the frames in the order they have been written
+ */
+static void* compressionThread(void* arg)
+{
+	compressed_file* cf = (compressed_file*)arg;
+
+	pthread_mutex_lock(&cf->lock);
+	while (true) {
+		while (cf->frames.empty() && !cf->closing)
+			pthread_cond_wait(&cf->cond, &cf->lock);
+		if (cf->frames.empty())
+			break;
+		std::vector<uint8_t>* frame = cf->frames.front();
+		bool failed = cf->error != 0;
+		pthread_mutex_unlock(&cf->lock);
+
+		int error = 0;
+		if (!failed) {
+			cf->output.resize(deflateBound(&cf->stream, frame->size()));
+			cf->stream.next_in = frame->data();
+			cf->stream.avail_in = frame->size();
+			cf->stream.next_out = cf->output.data();
+			cf->stream.avail_out = cf->output.size();
+			if (deflate(&cf->stream, Z_FINISH) != Z_STREAM_END) {
+				error = EIO;
+			} else if (!writeAll(cf->fd, cf->output.data(), cf->output.size() - cf->stream.avail_out)) {
+				error = errno;
+			}
+			deflateReset(&cf->stream);
+		}
+
+		pthread_mutex_lock(&cf->lock);
+		if (error && !cf->error) {
+			cf->error = error;
+			msg(LOG_ERR, "CompressedFile: could not write compressed data: %s", strerror(error));
+		}
+		cf->frames.pop_front();
+		frame->clear();
+		cf->spare.push_back(frame);
+		pthread_cond_broadcast(&cf->cond);
+	}
+	pthread_mutex_unlock(&cf->lock);
+	return NULL;
+}
+
+/**
+ * hands the current frame to the background thread, waits if it is too far behind
+ */
+static void submitFrame(compressed_file* cf)
+{
+	pthread_mutex_lock(&cf->lock);
+	while (cf->frames.size() >= COMPRESSION_MAX_FRAMES && !cf->error)
+		pthread_cond_wait(&cf->cond, &cf->lock);
+	cf->frames.push_back(cf->current);
+	if (cf->spare.empty()) {
+		cf->current = new std::vector<uint8_t>();
+		cf->current->reserve(COMPRESSION_FRAME_SIZE);
+	} else {
+		cf->current = cf->spare.back();
+		cf->spare.pop_back();
+	}
+	pthread_cond_broadcast(&cf->cond);
+	pthread_mutex_unlock(&cf->lock);
+}
+
+bool compression_supported(void)
+{
+	return true;
+}
+
+compressed_file* compressed_file_open(int fd, int level)
+{
+	compressed_file* cf = new compressed_file;
+	cf->fd = fd;
+	cf->level = level;
+	cf->closing = false;
+	cf->error = 0;
+	cf->current = new std::vector<uint8_t>();
+	cf->current->reserve(COMPRESSION_FRAME_SIZE);
+	memset(&cf->stream, 0, sizeof(cf->stream));
+	// windowBits 15 + 16 produces gzip members
+	if (deflateInit2(&cf->stream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+		msg(LOG_ERR, "CompressedFile: could not initialize zlib with level %d", level);
+		delete cf->current;
+		delete cf;
+		errno = EINVAL;
+		return NULL;
+	}
+	pthread_mutex_init(&cf->lock, NULL);
+	pthread_cond_init(&cf->cond, NULL);
+	if (pthread_create(&cf->thread, NULL, compressionThread, cf) != 0) {
+		msg(LOG_ERR, "CompressedFile: could not create compression thread");
+		deflateEnd(&cf->stream);
+		pthread_cond_destroy(&cf->cond);
+		pthread_mutex_destroy(&cf->lock);
+		delete cf->current;
+		delete cf;
+		errno = EAGAIN;
+		return NULL;
+	}
+	return cf;
+}
+
+ssize_t compressed_file_write(compressed_file* cf, const void* data, size_t length)
+{
+	pthread_mutex_lock(&cf->lock);
+	int error = cf->error;
+	pthread_mutex_unlock(&cf->lock);
+	if (error) {
+		errno = error;
+		return -1;
+	}
+
+	const uint8_t* p = (const uint8_t*)data;
+	size_t remaining = length;
+	while (remaining > 0) {
+		size_t n = COMPRESSION_FRAME_SIZE - cf->current->size();
+		if (n > remaining)
+			n = remaining;
+		cf->current->insert(cf->current->end(), p, p + n);
+		p += n;
+		remaining -= n;
+		if (cf->current->size() == COMPRESSION_FRAME_SIZE)
+			submitFrame(cf);
+	}
+	return length;
+}
+
+ssize_t compressed_file_writev(compressed_file* cf, const struct iovec* iov, int iovcnt)
+{
+	ssize_t total = 0;
+	for (int i = 0; i < iovcnt; i++) {
+		if (compressed_file_write(cf, iov[i].iov_base, iov[i].iov_len) < 0)
+			return -1;
+		total += iov[i].iov_len;
+	}
+	return total;
+}
+
+int compressed_file_close(compressed_file* cf)
+{
+	if (!cf->current->empty())
+		submitFrame(cf);
+
+	pthread_mutex_lock(&cf->lock);
+	cf->closing = true;
+	pthread_cond_broadcast(&cf->cond);
+	pthread_mutex_unlock(&cf->lock);
+	pthread_join(cf->thread, NULL);
+
+	int result = cf->error ? -1 : 0;
+	if (close(cf->fd) != 0)
+		result = -1;
+	deflateEnd(&cf->stream);
+	pthread_cond_destroy(&cf->cond);
+	pthread_mutex_destroy(&cf->lock);
+	delete cf->current;
+	for (size_t i = 0; i < cf->spare.size(); i++)
+		delete cf->spare[i];
+	delete cf;
+	return result;
+}
+
+/* stdio adapters, a FILE* is expected by libpcap and the exporters using stdio */
+
+#ifdef __linux__
+static ssize_t cookieWrite(void* cookie, const char* buf, size_t size)
+{
+	ssize_t n = compressed_file_write((compressed_file*)cookie, buf, size);
+	// fopencookie treats 0 as an error
+	return n < 0 ? 0 : n;
+}
+
+static ssize_t cookieRead(void* cookie, char* buf, size_t size)
+{
+	return gzread((gzFile)cookie, buf, size);
+}
+
+static int cookieSeek(void* cookie, off64_t* offset, int whence)
+{
+	if (whence == SEEK_END)
+		return -1;
+	z_off_t pos = gzseek((gzFile)cookie, *offset, whence);
+	if (pos < 0)
+		return -1;
+	*offset = pos;
+	return 0;
+}
+#else
+static int cookieWrite(void* cookie, const char* buf, int size)
+{
+	return compressed_file_write((compressed_file*)cookie, buf, size);
+}
+
+static int cookieRead(void* cookie, char* buf, int size)
+{
+	return gzread((gzFile)cookie, buf, size);
+}
+
+static fpos_t cookieSeek(void* cookie, fpos_t offset, int whence)
+{
+	if (whence == SEEK_END)
+		return -1;
+	return gzseek((gzFile)cookie, offset, whence);
+}
+#endif
+
+static int cookieCloseWrite(void* cookie)
+{
+	return compressed_file_close((compressed_file*)cookie);
+}
+
+static int cookieCloseRead(void* cookie)
+{
+	return gzclose((gzFile)cookie) == Z_OK ? 0 : -1;
+}
+
+FILE* compressed_file_fopen(const char* path, int level)
+{
+	int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
+	if (fd < 0)
+		return NULL;
+	compressed_file* cf = compressed_file_open(fd, level);
+	if (!cf) {
+		close(fd);
+		return NULL;
+	}
+#ifdef __linux__
+	cookie_io_functions_t functions = { NULL, cookieWrite, NULL, cookieCloseWrite };
+	FILE* f = fopencookie(cf, "w", functions);
+#else
+	FILE* f = funopen(cf, NULL, cookieWrite, NULL, cookieCloseWrite);
+#endif
+	if (!f)
+		compressed_file_close(cf);
+	return f;
+}
+
+FILE* compressed_file_fopen_read(const char* path)
+{
+	gzFile gz = gzopen(path, "rb");
+	if (!gz)
+		return NULL;
+	gzbuffer(gz, COMPRESSION_FRAME_SIZE);
+#ifdef __linux__
+	cookie_io_functions_t functions = { cookieRead, NULL, cookieSeek, cookieCloseRead };
+	FILE* f = fopencookie(gz, "r", functions);
+#else
+	FILE* f = funopen(gz, cookieRead, NULL, cookieSeek, cookieCloseRead);
+#endif
+	if (!f)
+		gzclose(gz);
+	return f;
+}
+
+#else
+
+bool compression_supported(void)
+{
+	return false;
+}
+
+compressed_file* compressed_file_open(int fd, int level)
+{
+	msg(LOG_ERR, "CompressedFile: compression requires zlib support, enable cmake option SUPPORT_ZLIB");
+	errno = ENOTSUP;
+	return NULL;
+}
+
+ssize_t compressed_file_write(compressed_file* cf, const void* data, size_t length)
+{
+	errno = EBADF;
+	return -1;
+}
+
+ssize_t compressed_file_writev(compressed_file* cf, const struct iovec* iov, int iovcnt)
+{
+	errno = EBADF;
+	return -1;
+}
+
+int compressed_file_close(compressed_file* cf)
+{
+	return -1;
+}
+
+FILE* compressed_file_fopen(const char* path, int level)
+{
+	compressed_file_open(-1, level);
+	return NULL;
+}
+
+FILE* compressed_file_fopen_read(const char* path)
+{
+	msg(LOG_ERR, "CompressedFile: %s is compressed, reading it requires zlib support", path);
+	errno = ENOTSUP;
+	return NULL;
+}
+
+#endif
+
+bool compressed_file_detect(const char* path)
+{
+	unsigned char magic[sizeof(GZIP_MAGIC)];
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	bool found = read(fd, magic, sizeof(magic)) == sizeof(magic) &&
+		memcmp(magic, GZIP_MAGIC, sizeof(magic)) == 0;
+	close(fd);
+	return found;
+}
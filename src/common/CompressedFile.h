@@ -0,0 +1,81 @@
+/*
+ * VERMONT
+ * Streaming compression of output files
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef COMPRESSEDFILE_H
+#define COMPRESSEDFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Written data is collected in frames of COMPRESSION_FRAME_SIZE bytes. Each
+ * frame is compressed by a background thread into a gzip member of its own,
+ * so the output is a regular gzip file (readable by zcat) and a file cut off
+ * by a crash can be read up to its last complete frame. At most
+ * COMPRESSION_MAX_FRAMES frames wait for the background thread, further
+ * writes block until it has caught up.
+ */
+#define COMPRESSION_FRAME_SIZE (1024*1024)
+#define COMPRESSION_MAX_FRAMES 4
+#define COMPRESSION_DEFAULT_LEVEL 6
+
+typedef struct compressed_file compressed_file;
+
+/* true if the library has been compiled with zlib */
+bool compression_supported(void);
+
+/*
+ * starts compressing everything written to the file descriptor fd with the
+ * given zlib level (1-9). fd is owned by the compressed_file afterwards.
+ * Returns NULL on failure.
+ */
+compressed_file *compressed_file_open(int fd, int level);
+ssize_t compressed_file_write(compressed_file *cf, const void *data, size_t length);
+ssize_t compressed_file_writev(compressed_file *cf, const struct iovec *iov, int iovcnt);
+/* writes the remaining data and closes the file. Returns 0 on success, -1 if any write failed */
+int compressed_file_close(compressed_file *cf);
+
+/*
+ * opens path for writing through a compressed_file. The returned FILE* can be
+ * used with stdio functions, fclose() finishes the compression.
+ */
+FILE *compressed_file_fopen(const char *path, int level);
+
+/* true if the file at path starts with the gzip magic */
+bool compressed_file_detect(const char *path);
+/*
+ * opens a file written by compressed_file for reading. The returned FILE*
+ * yields the decompressed data and can seek within it (seeking backwards
+ * restarts decompression). Returns NULL on failure.
+ */
+FILE *compressed_file_fopen_read(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
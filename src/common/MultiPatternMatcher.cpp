@@ -0,0 +1,192 @@
+/*
+ * VERMONT
+ * Matching of many byte strings in one pass
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "MultiPatternMatcher.h"
+#include "msg.h"
+
+#include <string.h>
+#include <deque>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MULTIPATTERNMATCHER_SHUFTI
+#include <tmmintrin.h>
+#endif
+
+static const uint32_t NO_STATE = UINT32_MAX;
+
+MultiPatternMatcher::MultiPatternMatcher()
+	: compiled(false)
+{
+	compile();
+}
+
+unsigned MultiPatternMatcher::addPattern(const std::string& pattern)
+{
+	if (pattern.empty())
+		THROWEXCEPTION("MultiPatternMatcher: empty patterns are not allowed");
+	patterns.push_back(pattern);
+	compiled = false;
+	return patterns.size() - 1;
+}
+
+void MultiPatternMatcher::compile()
+{
+	memset(byteClass, 0, sizeof(byteClass));
+	classCount = 1;
+	for (size_t p = 0; p < patterns.size(); p++) {
+		for (size_t i = 0; i < patterns[p].size(); i++) {
+			uint8_t b = patterns[p][i];
+			if (byteClass[b] == 0)
+				byteClass[b] = classCount++;
+		}
+	}
+
+	// trie of all patterns, state 0 is the start state
+	std::vector<uint32_t> trie(classCount, NO_STATE);
+	std::vector<std::vector<uint32_t> > out(1);
+	for (size_t p = 0; p < patterns.size(); p++) {
+		uint32_t state = 0;
+		for (size_t i = 0; i < patterns[p].size(); i++) {
+			uint32_t& next = trie[state * classCount + byteClass[(uint8_t)patterns[p][i]]];
+			if (next == NO_STATE) {
+				next = out.size();
+				out.push_back(std::vector<uint32_t>());
+				trie.resize(trie.size() + classCount, NO_STATE);
+			}
+			state = trie[state * classCount + byteClass[(uint8_t)patterns[p][i]]];
+		}
+		out[state].push_back(p);
+	}
+
+	// turn the trie into a deterministic automaton in breadth-first order,
+	// so the failure state of a state has been completed before the state
+	size_t states = out.size();
+	transitions.swap(trie);
+	std::vector<uint32_t> failure(states, 0);
+	std::deque<uint32_t> queue;
+	for (unsigned c = 0; c < classCount; c++) {
+		uint32_t& next = transitions[c];
+		if (next == NO_STATE) {
+			next = 0;
+		} else {
+			queue.push_back(next);
+		}
+	}
+	while (!queue.empty()) {
+		uint32_t state = queue.front();
+		queue.pop_front();
+		const std::vector<uint32_t>& inherited = out[failure[state]];
+		out[state].insert(out[state].end(), inherited.begin(), inherited.end());
+		for (unsigned c = 0; c < classCount; c++) {
+			uint32_t& next = transitions[state * classCount + c];
+			uint32_t fallback = transitions[failure[state] * classCount + c];
+			if (next == NO_STATE) {
+				next = fallback;
+			} else {
+				failure[next] = fallback;
+				queue.push_back(next);
+			}
+		}
+	}
+
+	outputStart.assign(1, 0);
+	outputs.clear();
+	for (size_t s = 0; s < states; s++) {
+		outputs.insert(outputs.end(), out[s].begin(), out[s].end());
+		outputStart.push_back(outputs.size());
+	}
+
+	memset(isStart, 0, sizeof(isStart));
+	memset(shuftiLow, 0, sizeof(shuftiLow));
+	memset(shuftiHigh, 0, sizeof(shuftiHigh));
+	startCount = 0;
+	firstStart = 0;
+	for (size_t p = 0; p < patterns.size(); p++) {
+		uint8_t b = patterns[p][0];
+		if (isStart[b])
+			continue;
+		isStart[b] = true;
+		startCount++;
+		firstStart = b;
+		// one bucket per high nibble modulo 8, findStart() verifies candidates
+		uint8_t bucket = 1 << ((b >> 4) & 7);
+		shuftiLow[b & 0x0f] |= bucket;
+		shuftiHigh[b >> 4] |= bucket;
+	}
+	useShufti = false;
+#ifdef MULTIPATTERNMATCHER_SHUFTI
+	useShufti = startCount > 1 && __builtin_cpu_supports("ssse3");
+#endif
+	compiled = true;
+}
+
+#ifdef MULTIPATTERNMATCHER_SHUFTI
+/**
+ * returns the position of the first byte from pos on which may begin a
+ * pattern according to the nibble tables, or the start of the last
+ * incomplete block of 16 bytes
+ */
+__attribute__((target("ssse3")))
+static size_t shuftiFind(const uint8_t* data, size_t pos, size_t len, const bool* isStart,
+		const uint8_t* low, const uint8_t* high)
+{
+	const __m128i lowTable = _mm_loadu_si128((const __m128i*)low);
+	const __m128i highTable = _mm_loadu_si128((const __m128i*)high);
+	const __m128i nibble = _mm_set1_epi8(0x0f);
+	const __m128i zero = _mm_setzero_si128();
+
+	for (; pos + 16 <= len; pos += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(data + pos));
+		__m128i l = _mm_shuffle_epi8(lowTable, _mm_and_si128(v, nibble));
+		__m128i h = _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi16(v, 4), nibble));
+		unsigned candidates = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(l, h), zero)) & 0xffff;
+		while (candidates) {
+			size_t p = pos + __builtin_ctz(candidates);
+			if (isStart[data[p]])
+				return p;
+			candidates &= candidates - 1;
+		}
+	}
+	return pos;
+}
+#endif
+
+/**
+ * returns the position of the first byte from pos on which begins a pattern, or len
+ */
+size_t MultiPatternMatcher::findStart(const uint8_t* data, size_t pos, size_t len) const
+{
+	if (startCount == 0)
+		return len;
+	if (startCount == 1) {
+		const uint8_t* p = (const uint8_t*)memchr(data + pos, firstStart, len - pos);
+		return p ? p - data : len;
+	}
+#ifdef MULTIPATTERNMATCHER_SHUFTI
+	if (useShufti) {
+		pos = shuftiFind(data, pos, len, isStart, shuftiLow, shuftiHigh);
+		if (pos + 16 <= len)
+			return pos;
+	}
+#endif
+	while (pos < len && !isStart[data[pos]])
+		pos++;
+	return pos;
+}
@@ -0,0 +1,115 @@
+/*
+ * VERMONT
+ * Matching of many byte strings in one pass
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef MULTIPATTERNMATCHER_H
+#define MULTIPATTERNMATCHER_H
+
+#include "msg.h"
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+/**
+ * Finds all occurrences of a set of byte strings in a single pass over the
+ * data (Aho-Corasick).
+ *
+ * compile() builds a deterministic automaton whose transitions are indexed by
+ * byte classes: every byte occurring in a pattern has a class of its own, all
+ * other bytes share class 0, which always leads back to the start state.
+ * While the automaton is in its start state, bytes which cannot begin a
+ * pattern are skipped by a prefilter, which uses memchr() for a single first
+ * byte and SSSE3 nibble lookups (shufti) for sets of first bytes if the CPU
+ * supports them.
+ */
+class MultiPatternMatcher
+{
+public:
+	MultiPatternMatcher();
+
+	/**
+	 * adds a non-empty pattern and returns its id. Ids are assigned in the
+	 * order of addition, starting at 0. compile() has to be called afterwards.
+	 */
+	unsigned addPattern(const std::string& pattern);
+
+	void compile();
+
+	size_t patternCount() const
+	{
+		return patterns.size();
+	}
+
+	const std::string& pattern(unsigned id) const
+	{
+		return patterns[id];
+	}
+
+	/**
+	 * scans data once and calls onMatch(id, end) for every occurrence of a
+	 * pattern, end is the offset behind the occurrence. Occurrences are
+	 * reported in the order of their end, scanning stops when onMatch returns
+	 * false. Throws if patterns have been added since the last compile().
+	 */
+	template <class F>
+	void scan(const uint8_t* data, size_t len, F& onMatch) const
+	{
+		if (!compiled)
+			THROWEXCEPTION("MultiPatternMatcher: compile() has not been called after adding patterns");
+		uint32_t state = 0;
+		size_t i = 0;
+		while (i < len) {
+			if (state == 0) {
+				i = findStart(data, i, len);
+				if (i == len)
+					return;
+			}
+			state = transitions[state * classCount + byteClass[data[i]]];
+			i++;
+			for (uint32_t o = outputStart[state]; o != outputStart[state + 1]; o++) {
+				if (!onMatch(outputs[o], i))
+					return;
+			}
+		}
+	}
+
+private:
+	std::vector<std::string> patterns;
+	bool compiled;
+
+	uint8_t byteClass[256];
+	unsigned classCount;
+	std::vector<uint32_t> transitions; /**< state * classCount + byte class */
+	std::vector<uint32_t> outputStart; /**< outputs of state s are outputStart[s] .. outputStart[s + 1] */
+	std::vector<uint32_t> outputs;
+
+	/* prefilter */
+	bool isStart[256]; /**< bytes which begin a pattern */
+	unsigned startCount;
+	uint8_t firstStart;
+	bool useShufti;
+	uint8_t shuftiLow[16];
+	uint8_t shuftiHigh[16];
+
+	size_t findStart(const uint8_t* data, size_t pos, size_t len) const;
+};
+
+#endif
@@ -0,0 +1,88 @@
+/*
+ * VERMONT
+ * Set of address prefixes with longest prefix match lookups
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "PrefixSet.h"
+#include "msg.h"
+
+#include <algorithm>
+
+PrefixSet::PrefixSet(unsigned addressLength)
+	: addressLength(addressLength),
+	  prefixCount(0),
+	  root(65536, EMPTY)
+{
+	if (addressLength != 4 && addressLength != 16)
+		THROWEXCEPTION("PrefixSet: unsupported address length %u", addressLength);
+}
+
+void PrefixSet::add(const uint8_t* address, unsigned prefixLength)
+{
+	if (prefixLength > addressLength * 8)
+		THROWEXCEPTION("PrefixSet: prefix length %u is longer than the address", prefixLength);
+	prefixCount++;
+
+	// entries of the current table are table[base + index], the table covers
+	// the address bits from bit on with stride bits
+	std::vector<uint32_t>* table = &root;
+	size_t base = 0;
+	unsigned bit = 0;
+	unsigned stride = 16;
+	uint32_t index = (address[0] << 8) | address[1];
+	while (true) {
+		if (prefixLength <= bit + stride) {
+			// expand the prefix to all entries it covers, nodes below them
+			// are no longer reachable
+			uint32_t span = 1 << (bit + stride - prefixLength);
+			uint32_t first = index & ~(span - 1);
+			for (uint32_t i = first; i < first + span; i++)
+				(*table)[base + i] = MATCH;
+			return;
+		}
+
+		uint32_t entry = (*table)[base + index];
+		if (entry == MATCH)
+			return;
+		if (entry == EMPTY) {
+			entry = CHILD + nodes.size() / 256;
+			(*table)[base + index] = entry;
+			nodes.resize(nodes.size() + 256, EMPTY);
+		}
+		table = &nodes;
+		base = (size_t)(entry - CHILD) << 8;
+		bit += stride;
+		stride = 8;
+		index = address[bit / 8];
+	}
+}
+
+void PrefixSet::clear()
+{
+	root.assign(65536, EMPTY);
+	nodes.clear();
+	prefixCount = 0;
+}
+
+void PrefixSet::swap(PrefixSet& other)
+{
+	std::swap(addressLength, other.addressLength);
+	std::swap(prefixCount, other.prefixCount);
+	root.swap(other.root);
+	nodes.swap(other.nodes);
+}
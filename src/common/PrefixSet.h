@@ -0,0 +1,93 @@
+/*
+ * VERMONT
+ * Set of address prefixes with longest prefix match lookups
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef PREFIXSET_H
+#define PREFIXSET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Set of IPv4 or IPv6 prefixes, which tells whether an address is covered by
+ * any of them.
+ *
+ * The prefixes are stored in a multibit trie like DIR-16-8-8: a table of
+ * 65536 entries for the first 16 bits of an address and nodes of 256 entries
+ * for each further byte. Every entry is empty, matches all addresses below it
+ * or points to a child node. Prefixes are expanded to the entries they cover,
+ * so a lookup reads at most 3 entries for IPv4 and 15 for IPv6, independent
+ * of the number of prefixes. Memory grows only with prefixes longer than
+ * 16 bits, by one node per byte of them which is not shared.
+ */
+class PrefixSet
+{
+public:
+	/**
+	 * @param addressLength length of the addresses in bytes, 4 or 16
+	 */
+	explicit PrefixSet(unsigned addressLength);
+
+	/**
+	 * adds the prefix of the given length of address, which is in network
+	 * byte order. Bits behind the prefix are ignored.
+	 */
+	void add(const uint8_t* address, unsigned prefixLength);
+
+	void clear();
+
+	void swap(PrefixSet& other);
+
+	bool empty() const
+	{
+		return prefixCount == 0;
+	}
+
+	size_t size() const
+	{
+		return prefixCount;
+	}
+
+	unsigned getAddressLength() const
+	{
+		return addressLength;
+	}
+
+	/**
+	 * returns true if a prefix covers the address in network byte order
+	 */
+	bool contains(const uint8_t* address) const
+	{
+		uint32_t entry = root[(address[0] << 8) | address[1]];
+		for (unsigned i = 2; entry >= CHILD; i++)
+			entry = nodes[((size_t)(entry - CHILD) << 8) | address[i]];
+		return entry == MATCH;
+	}
+
+private:
+	enum { EMPTY = 0, MATCH = 1, CHILD = 2 };
+
+	unsigned addressLength;
+	size_t prefixCount;
+	std::vector<uint32_t> root;
+	std::vector<uint32_t> nodes; /**< node n has the entries 256 * n .. 256 * n + 255 */
+};
+
+#endif
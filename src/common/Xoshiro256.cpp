@@ -0,0 +1,45 @@
+/*
+ * VERMONT
+ * Fast pseudo random numbers for samplers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "Xoshiro256.h"
+
+#include <random>
+
+Xoshiro256::Xoshiro256(uint64_t seed)
+{
+	this->seed(seed);
+}
+
+/**
+ * expands the seed with splitmix64, which never yields an all-zero state
+ */
+void Xoshiro256::seed(uint64_t seed)
+{
+	if (seed == 0) {
+		std::random_device rd;
+		seed = ((uint64_t)rd() << 32) | rd();
+	}
+	for (int i = 0; i < 4; i++) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		s[i] = z ^ (z >> 31);
+	}
+}
@@ -0,0 +1,91 @@
+/*
+ * VERMONT
+ * Fast pseudo random numbers for samplers
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef XOSHIRO256_H
+#define XOSHIRO256_H
+
+#include <stdint.h>
+#include <math.h>
+
+/**
+ * xoshiro256** generator by Blackman and Vigna. Every instance has its own
+ * state, so samplers in different threads neither share a lock nor a
+ * sequence. Not suitable for cryptographic purposes.
+ */
+class Xoshiro256
+{
+public:
+	/**
+	 * seed 0 draws a seed from std::random_device, all other seeds produce
+	 * reproducible sequences
+	 */
+	explicit Xoshiro256(uint64_t seed = 0);
+
+	void seed(uint64_t seed);
+
+	uint64_t next()
+	{
+		uint64_t result = rotl(s[1] * 5, 7) * 9;
+		uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	/**
+	 * returns a uniformly distributed number in [0, n)
+	 */
+	uint32_t below(uint32_t n)
+	{
+		return ((next() >> 32) * n) >> 32;
+	}
+
+	/**
+	 * returns a uniformly distributed number in (0, 1]
+	 */
+	double uniform()
+	{
+		return ((next() >> 11) + 1) * (1.0 / 9007199254740992.0);
+	}
+
+	/**
+	 * returns the number of failed trials before the first success, if every
+	 * trial succeeds with probability p. invLogQ is 1 / log(1 - p), 0 for p = 1.
+	 */
+	uint64_t geometric(double invLogQ)
+	{
+		double skip = floor(log(uniform()) * invLogQ);
+		return skip < 1.8e19 ? (uint64_t)skip : UINT64_MAX;
+	}
+
+private:
+	uint64_t s[4];
+
+	static uint64_t rotl(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+};
+
+#endif
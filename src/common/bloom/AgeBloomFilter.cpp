@@ -18,11 +18,15 @@
 
 #include "AgeBloomFilter.h"
 
+/* block of a blocked filter, operations on it use SIMD instructions where available */
+typedef agetime_t AgeBlock __attribute__((vector_size(BLOOMFILTER_BLOCK_SIZE), may_alias));
+
 void AgeArray::resize(size_t size)
 {
 	free(array);
 	array_size = size;
-	array = (agetime_t*)malloc(size*sizeof(agetime_t));
+	if (posix_memalign((void**)&array, BLOOMFILTER_BLOCK_SIZE, size*sizeof(agetime_t)) != 0)
+		THROWEXCEPTION("AgeArray: could not allocate %lu entries", (unsigned long)size);
 	clear();
 }
 
@@ -46,6 +50,33 @@ agetime_t AgeArray::get(size_t index) const
 	return 0;
 }
 
+void AgeArray::setBlock(size_t block, uint64_t h, unsigned k, agetime_t time)
+{
+	AgeBlock probed = {};
+	for (unsigned i = 0; i < k; i++)
+		probed[bloomBlockPosition(h, i, BLOCK_ENTRIES)] = -1;
+
+	AgeBlock* b = (AgeBlock*)(array + block * BLOCK_ENTRIES);
+	*b = (probed & time) | (~probed & *b);
+}
+
+agetime_t AgeArray::getBlock(size_t block, uint64_t h, unsigned k) const
+{
+	AgeBlock probed = {};
+	for (unsigned i = 0; i < k; i++)
+		probed[bloomBlockPosition(h, i, BLOCK_ENTRIES)] = -1;
+
+	// the minimum of the probed entries, as in MinBloomFilter::get()
+	const AgeBlock* b = (const AgeBlock*)(array + block * BLOCK_ENTRIES);
+	AgeBlock values = (*b & probed) | (~probed & INT_MAX);
+	agetime_t ret = INT_MAX;
+	for (unsigned i = 0; i < BLOCK_ENTRIES; i++) {
+		if (values[i] < ret)
+			ret = values[i];
+	}
+	return ret;
+}
+
 std::ostream & operator << (std::ostream & os, const AgeArray & a) 
 {
     for(uint32_t i=0; i<a.array_size; i++)
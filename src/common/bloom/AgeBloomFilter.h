@@ -40,11 +40,14 @@ class AgeArray {
 		}
 
 		typedef agetime_t ValueType;
+		enum { BLOCK_ENTRIES = BLOOMFILTER_BLOCK_SIZE / sizeof(agetime_t) };
 
 		void resize(size_t size);
 		void clear();
 		void set(size_t index, agetime_t time);
 		agetime_t get(size_t index) const;
+		void setBlock(size_t block, uint64_t h, unsigned k, agetime_t time);
+		agetime_t getBlock(size_t block, uint64_t h, unsigned k) const;
     
 	private:
 		agetime_t* array;
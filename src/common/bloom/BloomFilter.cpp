@@ -18,6 +18,8 @@
 
 #include "BloomFilter.h"
 
+#include <common/msg.h>
+
 const uint8_t bitmask[8] =
 {
     0x01, //00000001
@@ -30,12 +32,17 @@ const uint8_t bitmask[8] =
     0x80  //10000000
 };
     
+/* block of a blocked filter, operations on it use SIMD instructions where available */
+typedef uint8_t BitmapBlock __attribute__((vector_size(BLOOMFILTER_BLOCK_SIZE), may_alias));
+typedef uint64_t BitmapBlockWords __attribute__((vector_size(BLOOMFILTER_BLOCK_SIZE), may_alias));
+
 void Bitmap::resize(size_t size)
 {
     free(bitmap);
     len_bits = size;
     len_octets = (size+7)/8;
-    bitmap = (uint8_t*)(malloc(len_octets));
+    if (posix_memalign((void**)&bitmap, BLOOMFILTER_BLOCK_SIZE, len_octets) != 0)
+	THROWEXCEPTION("Bitmap: could not allocate %lu bits", (unsigned long)size);
     memset(bitmap, 0, len_octets);
 }
 
@@ -58,6 +65,34 @@ bool Bitmap::get(size_t index) const
 	return false;
 }
 
+static void blockMask(BitmapBlock* mask, uint64_t h, unsigned k)
+{
+    BitmapBlock m = {};
+    for (unsigned i = 0; i < k; i++) {
+	unsigned index = bloomBlockPosition(h, i, Bitmap::BLOCK_ENTRIES);
+	m[index/8] |= bitmask[index%8];
+    }
+    *mask = m;
+}
+
+void Bitmap::setBlock(size_t block, uint64_t h, unsigned k)
+{
+    BitmapBlock mask;
+    blockMask(&mask, h, k);
+    *(BitmapBlock*)(bitmap + block * BLOOMFILTER_BLOCK_SIZE) |= mask;
+}
+
+bool Bitmap::getBlock(size_t block, uint64_t h, unsigned k) const
+{
+    BitmapBlock mask;
+    blockMask(&mask, h, k);
+    BitmapBlockWords missing = (BitmapBlockWords)(mask & ~*(const BitmapBlock*)(bitmap + block * BLOOMFILTER_BLOCK_SIZE));
+    uint64_t any = 0;
+    for (unsigned i = 0; i < BLOOMFILTER_BLOCK_SIZE / 8; i++)
+	any |= missing[i];
+    return any == 0;
+}
+
 std::ostream & operator<< (std::ostream & os, const Bitmap & b) 
 {
     for(size_t i=0; i<b.len_bits; i++)
@@ -72,25 +107,34 @@ std::ostream & operator<< (std::ostream & os, const Bitmap & b)
 
 void BloomFilter::set(const uint8_t* input, size_t len, bool) 
 {
+    uint64_t h[2];
+    hashKey(input, len, h);
+    if (blocked_) {
+        filter_[0].setBlock(hashBlock(h), h[1], hfList->len);
+        return;
+    }
     for(unsigned i=0; i < hfList->len; i++) {
     	if (CMS_)
-            filter_[0].set(hashU(input, len, filterSize(), hfList->seed[i]));
+            filter_[0].set(hashIndex(h, i));
 	else 
-	    filter_[i].set(hashU(input, len, filterSize(), hfList->seed[i]));
+	    filter_[i].set(hashIndex(h, i));
     }
 }
 
 bool BloomFilter::get(const uint8_t* input, size_t len) const
 {
+    uint64_t h[2];
+    hashKey(input, len, h);
+    if (blocked_)
+        return filter_[0].getBlock(hashBlock(h), h[1], hfList->len);
     for(unsigned i=0; i < hfList->len; i++) {
         if (CMS_) {
-	    if (filter_[0].get(hashU(input, len, filterSize(), hfList->seed[i])) == false)
+	    if (filter_[0].get(hashIndex(h, i)) == false)
 	        return false;
         } else {
-            if (filter_[i].get(hashU(input, len, filterSize(), hfList->seed[i])) == false)
+            if (filter_[i].get(hashIndex(h, i)) == false)
 	        return false;
 	}
     }
     return true;
 }
-
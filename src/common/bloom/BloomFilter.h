@@ -40,11 +40,14 @@ class Bitmap {
 	}
 
 	typedef bool ValueType;
+	enum { BLOCK_ENTRIES = BLOOMFILTER_BLOCK_SIZE * 8 };
 
 	void resize(size_t size);
 	void clear();
 	void set(size_t index);
 	bool get(size_t index) const;
+	void setBlock(size_t block, uint64_t h, unsigned k);
+	bool getBlock(size_t block, uint64_t h, unsigned k) const;
 
     private:
 	uint8_t* bitmap;
@@ -62,7 +65,8 @@ class BloomFilter : public BloomFilterBase<Bitmap>
     friend std::ostream & operator << (std::ostream &, const BloomFilter &);
 
     public:
-	BloomFilter(HashParams* hashParams, size_t size, bool CMS = true) : BloomFilterBase<Bitmap>(hashParams, size, CMS) {}
+	BloomFilter(HashParams* hashParams, size_t size, bool CMS = true, bool blocked = false)
+		: BloomFilterBase<Bitmap>(hashParams, size, CMS, blocked) {}
 
 	virtual ~BloomFilter() {}
 
@@ -19,16 +19,14 @@
 #ifndef _BLOOMFILTER_BASE_H_
 #define _BLOOMFILTER_BASE_H_
 
-#ifdef HAVE_GSL
-#include <gsl/gsl_rng.h>
-#endif
-
 #include <stdint.h>
 #include <cstring>
 #include <ctime>
 
 #include <modules/packet/Packet.h>
 
+#include "BloomHash.h"
+
 /* GenericKey class holding uint8_t* input for BloomFilter hash functions */
 template<unsigned size> class GenericKey
 {
@@ -143,6 +141,24 @@ class QuintupleKey
 		}
 };
 
+/* size of a block of blocked filters, all probes of a key fall into one cache line */
+#define BLOOMFILTER_BLOCK_SIZE 64
+
+/**
+ * returns the position of probe i of a key within its block of a blocked
+ * filter with the given number of entries. The positions of the probes are
+ * independent of each other, so keys sharing a block rarely share all probes.
+ */
+inline unsigned bloomBlockPosition(uint64_t h, unsigned i, unsigned entries)
+{
+	// finalizer of splitmix64
+	uint64_t x = h + (i + 1) * 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return ((x >> 32) * entries) >> 32;
+}
+
 struct HashParams
 {
 	HashParams(size_t l, unsigned startSeed = time(0)) : len(l) {
@@ -172,18 +188,28 @@ struct HashParams
  *	void clear();
  *	myDesiredType get(uint8_t* data, size_t len);
  *	void set(uint8_t* data, size_t len, myDesiredType value);
+ *	enum { BLOCK_ENTRIES = BLOOMFILTER_BLOCK_SIZE / sizeof(entry) };
+ *	myDesiredType getBlock(size_t block, uint64_t h, unsigned k) const;
+ *	void setBlock(size_t block, uint64_t h, unsigned k, myDesiredType value);
  * }
+ *
+ * Blocked filters use a single filter of T. All k probes of a key are placed
+ * into one block of BLOCK_ENTRIES entries, see bloomBlockPosition(), so a
+ * lookup touches one cache line instead of k. T has to allocate its entries
+ * aligned to BLOOMFILTER_BLOCK_SIZE.
  */
 template <class T>
 class BloomFilterBase
 {
 	public:
-		BloomFilterBase(HashParams* hashParams, unsigned filterSize, bool CMS = true) : hfList(hashParams),
-			filterSize_(filterSize), CMS_(CMS)
+		BloomFilterBase(HashParams* hashParams, unsigned filterSize, bool CMS = true, bool blocked = false)
+			: hfList(hashParams), filterSize_(filterSize), CMS_(CMS || blocked), blocked_(blocked)
 		{
-#ifdef HAVE_GSL
-			r = gsl_rng_alloc (gsl_rng_fishman18);
-#endif
+			if (blocked_) {
+				filterSize_ = (filterSize_ + T::BLOCK_ENTRIES - 1) / T::BLOCK_ENTRIES * T::BLOCK_ENTRIES;
+				if (filterSize_ == 0)
+					filterSize_ = T::BLOCK_ENTRIES;
+			}
 			if (CMS_) {
 				filterCount_ = 1;
 			} else {
@@ -200,9 +226,6 @@ class BloomFilterBase
 
 		virtual ~BloomFilterBase()
 		{
-#ifdef HAVE_GSL
-			gsl_rng_free(r);
-#endif
 			delete[] filter_;
 		}
 
@@ -216,23 +239,29 @@ class BloomFilterBase
 
 	protected:
 
-#ifdef HAVE_GSL
-		uint32_t hashU(const uint8_t* input, uint16_t len, uint32_t max, uint32_t seed) const
+		/**
+		 * hashes the key once for all hash functions of the filter.
+		 * Hash function i is derived by double hashing, see hashIndex().
+		 */
+		void hashKey(const uint8_t* input, size_t len, uint64_t h[2]) const
 		{
-			uint32_t result = 0;
-			gsl_rng_set(r, seed);
-			for (unsigned i = 0; i < len; i++) {
-				result += input[i] * gsl_rng_get(r);
-			}
-			return result % max;
+			bloomHash128(input, len, hfList->len ? hfList->seed[0] : 0, h);
+			// a step of 0 would map all hash functions to the same index
+			h[1] |= 1;
 		}
-#else
-		uint32_t hashU(const uint8_t* input, uint16_t len, uint32_t max, uint32_t seed) const
+
+		uint32_t hashIndex(const uint64_t h[2], unsigned i) const
 		{
-			// TODO: create a function that does not need gsl
-			return 0;
+			return (h[0] + i * h[1]) % filterSize_;
+		}
+
+		/**
+		 * block of blocked filters, the probes within the block are derived from h[1]
+		 */
+		size_t hashBlock(const uint64_t h[2]) const
+		{
+			return h[0] % (filterSize_ / T::BLOCK_ENTRIES);
 		}
-#endif
 
 		int32_t ggT(uint32_t m, uint32_t n)
 		{
@@ -252,16 +281,13 @@ class BloomFilterBase
 			}
 		}
 
-#ifdef HAVE_GSL
-		gsl_rng * r;
-#endif
-
 		const HashParams* hfList;
 
 		size_t filterSize_;
 		T* filter_;
 		size_t filterCount_;
 		bool CMS_;
+		bool blocked_;
 };
 
 #endif
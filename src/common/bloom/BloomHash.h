@@ -0,0 +1,29 @@
+/**************************************************************************/
+/*    This library is free software; you can redistribute it and/or       */
+/*    modify it under the terms of the GNU Lesser General Public          */
+/*    License as published by the Free Software Foundation; either        */
+/*    version 2.1 of the License, or (at your option) any later version.  */
+/*                                                                        */
+/*    This library is distributed in the hope that it will be useful,     */
+/*    but WITHOUT ANY WARRANTY; without even the implied warranty of      */
+/*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU   */
+/*    Lesser General Public License for more details.                     */
+/*                                                                        */
+/*    You should have received a copy of the GNU Lesser General Public    */
+/*    License along with this library; if not, write to the Free Software  */
+/*    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA    */
+/**************************************************************************/
+
+#ifndef _BLOOMHASH_H_
+#define _BLOOMHASH_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * 128 bit hash of a key (MurmurHash3 x64_128), returned in h[0] and h[1].
+ * The hash functions of the BloomFilters are derived from both halves.
+ */
+void bloomHash128(const uint8_t* input, size_t len, uint32_t seed, uint64_t h[2]);
+
+#endif
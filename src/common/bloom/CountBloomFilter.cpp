@@ -18,11 +18,15 @@
 
 #include "CountBloomFilter.h"
 
+/* block of a blocked filter, operations on it use SIMD instructions where available */
+typedef CountArray::ValueType CountBlock __attribute__((vector_size(BLOOMFILTER_BLOCK_SIZE), may_alias));
+
 void CountArray::resize(size_t size)
 {
 	free(array);
 	array_size = size;
-	array = (ValueType*)(malloc(size*sizeof(ValueType)));
+	if (posix_memalign((void**)&array, BLOOMFILTER_BLOCK_SIZE, size*sizeof(ValueType)) != 0)
+		THROWEXCEPTION("CountArray: could not allocate %lu entries", (unsigned long)size);
 	clear();
 }
 
@@ -49,6 +53,32 @@ CountArray::ValueType CountArray::get(size_t index) const
 	}
 }
 
+void CountArray::setBlock(size_t block, uint64_t h, unsigned k, ValueType value)
+{
+	CountBlock probed = {};
+	for (unsigned i = 0; i < k; i++)
+		probed[bloomBlockPosition(h, i, BLOCK_ENTRIES)] = -1;
+
+	CountBlock* b = (CountBlock*)(array + block * BLOCK_ENTRIES);
+	*b += probed & value;
+}
+
+CountArray::ValueType CountArray::getBlock(size_t block, uint64_t h, unsigned k) const
+{
+	CountBlock probed = {};
+	for (unsigned i = 0; i < k; i++)
+		probed[bloomBlockPosition(h, i, BLOCK_ENTRIES)] = -1;
+
+	const CountBlock* b = (const CountBlock*)(array + block * BLOCK_ENTRIES);
+	CountBlock values = (*b & probed) | (~probed & INT_MAX);
+	ValueType ret = INT_MAX;
+	for (unsigned i = 0; i < BLOCK_ENTRIES; i++) {
+		if (values[i] < ret)
+			ret = values[i];
+	}
+	return ret;
+}
+
 std::ostream & operator << (std::ostream & os, const CountArray & a) 
 {
     for(size_t i=0; i<a.array_size; i++)
@@ -35,11 +35,14 @@ class CountArray {
 		}
 
 		typedef int ValueType;
+		enum { BLOCK_ENTRIES = BLOOMFILTER_BLOCK_SIZE / sizeof(ValueType) };
 
 		void resize(size_t size);
 		void clear();
 		void set(size_t index, ValueType value);
 		ValueType get(size_t index) const;
+		void setBlock(size_t block, uint64_t h, unsigned k, ValueType value);
+		ValueType getBlock(size_t block, uint64_t h, unsigned k) const;
 
 	private:
 		ValueType* array;
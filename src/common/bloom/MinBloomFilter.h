@@ -32,8 +32,8 @@ template <class T>
 class MinBloomFilter : public BloomFilterBase<T>
 {
 	public:
-		MinBloomFilter(HashParams* hashParams, size_t filterSize, bool CMS = true)
-			: BloomFilterBase<T>(hashParams, filterSize, CMS) {}
+		MinBloomFilter(HashParams* hashParams, size_t filterSize, bool CMS = true, bool blocked = false)
+			: BloomFilterBase<T>(hashParams, filterSize, CMS, blocked) {}
 
 		virtual ~MinBloomFilter() {}
 
@@ -41,15 +41,18 @@ class MinBloomFilter : public BloomFilterBase<T>
 		virtual typename T::ValueType  get(const uint8_t* input, size_t len) const {
 			typename T::ValueType  ret = INT_MAX;
 			typename T::ValueType  current;
+			uint64_t h[2];
+			BloomFilterBase<T>::hashKey(input, len, h);
+			if (BloomFilterBase<T>::blocked_)
+				return BloomFilterBase<T>::filter_[0].getBlock(BloomFilterBase<T>::hashBlock(h), h[1],
+					BloomFilterBase<T>::hfList->len);
 			for(unsigned i=0; i != BloomFilterBase<T>::hfList->len; i++) {   
 				if (BloomFilterBase<T>::CMS_) {
 					current = BloomFilterBase<T>::filter_[0].get(
-						BloomFilterBase<T>::hashU(input, len, 
-							BloomFilterBase<T>::filterSize(), BloomFilterBase<T>::hfList->seed[i]));
+						BloomFilterBase<T>::hashIndex(h, i));
 				} else {
 					current = BloomFilterBase<T>::filter_[i].get(
-						BloomFilterBase<T>::hashU(input, len,
-							BloomFilterBase<T>::filterSize(), BloomFilterBase<T>::hfList->seed[i]));
+						BloomFilterBase<T>::hashIndex(h, i));
 				}
 				if (current < ret)
 					ret = current;
@@ -60,15 +63,18 @@ class MinBloomFilter : public BloomFilterBase<T>
 
 		virtual void set(const uint8_t* input, size_t len, typename T::ValueType v) {
 			//msg(LOG_INFO, "MinBloomFilter.set(): %i", v);
+			uint64_t h[2];
+			BloomFilterBase<T>::hashKey(input, len, h);
+			if (BloomFilterBase<T>::blocked_) {
+				BloomFilterBase<T>::filter_[0].setBlock(BloomFilterBase<T>::hashBlock(h), h[1],
+					BloomFilterBase<T>::hfList->len, v);
+				return;
+			}
 			for(unsigned i=0; i != BloomFilterBase<T>::hfList->len; i++) {
 				if (BloomFilterBase<T>::CMS_) {
-					BloomFilterBase<T>::filter_[0].set(BloomFilterBase<T>::hashU(input, len,
-						BloomFilterBase<T>::filterSize(), 
-						BloomFilterBase<T>::hfList->seed[i]), v);
+					BloomFilterBase<T>::filter_[0].set(BloomFilterBase<T>::hashIndex(h, i), v);
 				} else {
-					BloomFilterBase<T>::filter_[i].set(BloomFilterBase<T>::hashU(input, len,
-						BloomFilterBase<T>::filterSize(), 
-						BloomFilterBase<T>::hfList->seed[i]), v);
+					BloomFilterBase<T>::filter_[i].set(BloomFilterBase<T>::hashIndex(h, i), v);
 				}
 			}
 		}
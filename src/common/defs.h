@@ -66,6 +66,13 @@
  */
 #define IS_DEFAULT_MAXRECORDRATE 0
 
+/**
+ * defines how many IPFIX messages IpfixSender accumulates before they are
+ * transmitted to UDP collectors in one go. 1 means that every message is sent
+ * immediately.
+ */
+#define IS_DEFAULT_SENDBATCHSIZE 1
+
 /**
  * defines amount of milliseconds, how long a SCTP socket tries to retransmit
  * data
@@ -39,6 +39,10 @@
  jan@petranek.de
  */
 
+#if defined(HAVE_SENDMMSG) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE /* sendmmsg() */
+#endif
+
 #include "ipfixlolib.h"
 #include "ipfixlolib_private.h"
 #include "encoding.h"
@@ -69,6 +73,23 @@ extern "C" {
 
 #define bit_set(data, bits) ((data & bits) == bits)
 
+/* space reserved for the message header of each batched message */
+#define BATCH_HEADER_SLOT_SIZE (sizeof(nfv9_header) > sizeof(ipfix_header) ? sizeof(nfv9_header) : sizeof(ipfix_header))
+
+/*
+ * Bodies (i.e. everything but the message header) of IPFIX Messages that
+ * have been passed to ipfix_send() but have not been transmitted to the UDP
+ * collectors yet. The bodies are shared by all collectors, the message
+ * headers are kept per collector as they might differ (NetFlow v9 sequence
+ * numbers).
+ */
+struct ipfix_send_batch {
+	unsigned size; /* maximum number of messages in a batch */
+	unsigned count; /* number of message bodies in .data */
+	size_t used; /* bytes used in .data */
+	char *data; /* .size * IPFIX_MAX_PACKETSIZE bytes */
+};
+
 #if defined(SUPPORT_DTLS_OVER_SCTP) && !defined(OPENSSL_SCTP)
 # error OpenSSL built without SCTP support. Rebuild OpenSSL with SCTP support or turn off SUPPORT_DTLS_OVER_SCTP
 #endif
@@ -80,18 +101,26 @@ static int init_send_udp_socket(struct sockaddr_storage serv_addr, char *vrf_nam
 static int ipfix_find_template(ipfix_exporter *exporter, uint16_t template_id);
 static int ipfix_init_sendbuffer(export_protocol_version export_protocol, ipfix_sendbuffer **sendbufn);
 static int ipfix_reset_sendbuffer(ipfix_sendbuffer *sendbuf);
+static int ipfix_grow_set_header_store(ipfix_sendbuffer *sendbuf);
 static int ipfix_deinit_sendbuffer(ipfix_sendbuffer **sendbuf);
-static int ipfix_init_collector_array(ipfix_receiving_collector **col, int col_capacity);
+static int ipfix_init_collector_array(ipfix_exporter *exporter, int col_capacity);
+static int ipfix_grow_collector_array(ipfix_exporter *exporter, int col_capacity);
 static void remove_collector(ipfix_receiving_collector *collector);
-static int ipfix_deinit_collector_array(ipfix_receiving_collector **col);
+static int ipfix_deinit_collector_array(ipfix_exporter *exporter);
 static int ipfix_init_send_socket(struct sockaddr_storage serv_addr , enum ipfix_transport_protocol protocol, char *vrf_name);
 static int ipfix_init_template_array(ipfix_exporter *exporter, int template_capacity);
+static int ipfix_grow_template_array(ipfix_exporter *exporter, int template_capacity);
+static int ipfix_add_template_change(ipfix_exporter *exporter, int index);
 static int ipfix_deinit_template(ipfix_lo_template* templ);
 static int ipfix_deinit_template_array(ipfix_exporter *exporter);
 static int ipfix_update_template_sendbuffer(ipfix_exporter *exporter);
 static int ipfix_send_templates(ipfix_exporter* exporter);
 static int ipfix_send_data(ipfix_exporter* exporter);
+static void ipfix_flush_collector_batch(ipfix_exporter *exporter, ipfix_receiving_collector *col);
+static void ipfix_deinit_send_batch(ipfix_exporter *exporter);
 static int ipfix_new_file(ipfix_receiving_collector* recvcoll);
+static void ipfix_close_file(ipfix_receiving_collector* recvcoll);
+static void ipfix_close_index(ipfix_receiving_collector* recvcoll);
 static int get_mtu(const int s);
 static int ipfix_enterprise_flag_set(uint16_t id);
 
@@ -284,7 +313,7 @@ static int init_send_sctp_socket(struct sockaddr_storage serv_addr,
  * tolen 	: length of the address
  * ppid, flags, stream_no, timetolive, context : sctp parameters
  */
-static int sctp_sendmsgv(int s, struct iovec *vector, int v_len, struct sockaddr *to,
+int sctp_sendmsgv(int s, struct iovec *vector, int v_len, struct sockaddr *to,
 		socklen_t tolen, uint32_t ppid, uint32_t flags,
 	     	uint16_t stream_no, uint32_t timetolive, uint32_t context){
 
@@ -397,6 +426,8 @@ int ipfix_init_exporter(export_protocol_version export_protocol, uint32_t observ
 	tmp->max_message_size = IPFIX_MTU_CONSERVATIVE_DEFAULT;
 
         tmp->collector_max_num = 0;
+        tmp->send_batch = NULL;
+        tmp->sender_thread = NULL;
 #ifdef SUPPORT_DTLS
 	ipfix_init_dtls_certificate(&tmp->certificate);
 #endif
@@ -421,16 +452,15 @@ int ipfix_init_exporter(export_protocol_version export_protocol, uint32_t observ
         }
 	
         // initialize the collectors to zero
-        ret=ipfix_init_collector_array( &(tmp->collector_arr), IPFIX_MAX_COLLECTORS);
+        ret=ipfix_init_collector_array(tmp, IPFIX_INITIAL_COLLECTOR_CAPACITY);
         if (ret !=0) {
                 msg(LOG_CRIT, "initializing collectors failed");
                 goto out3;
         }
 
-        tmp->collector_max_num = IPFIX_MAX_COLLECTORS;
-
         // initialize an array to hold the templates.
-        if(ipfix_init_template_array(tmp, IPFIX_MAX_TEMPLATES)) {
+        if(ipfix_init_template_array(tmp, IPFIX_INITIAL_TEMPLATE_CAPACITY)) {
+                msg(LOG_CRIT, "initializing templates failed");
                 goto out4;
         }
 	
@@ -448,7 +478,7 @@ int ipfix_init_exporter(export_protocol_version export_protocol, uint32_t observ
 out5:
         ipfix_deinit_sendbuffer(&(tmp->sctp_template_sendbuffer));
 out4:
-        ipfix_deinit_collector_array(&(tmp->collector_arr));
+        ipfix_deinit_collector_array(tmp);
 out3:
         ipfix_deinit_sendbuffer(&(tmp->data_sendbuffer));
 out2:
@@ -477,6 +507,11 @@ int ipfix_deinit_exporter(ipfix_exporter **exporter_p) {
         // close sockets etc.
         // (currently, nothing to do)
 
+        // transmit messages that are still waiting in a batch or queue
+        ipfix_flush(exporter);
+        ipfix_deinit_send_batch(exporter);
+        ipfix_drain_send_queues(exporter);
+
         // free all children
 
         // deinitialize array to hold the templates.
@@ -493,11 +528,14 @@ int ipfix_deinit_exporter(ipfix_exporter **exporter_p) {
         // find the collector in the exporter
         int i=0;
         for(i=0;i<exporter->collector_max_num;i++) {
-	        if (exporter->collector_arr[i].state != C_UNUSED)
-                remove_collector(&exporter->collector_arr[i]);
+	        if (exporter->collector_arr[i]->state != C_UNUSED)
+                remove_collector(exporter->collector_arr[i]);
         }
+        // all send queues are gone, stop the sender thread
+        ipfix_deinit_sender_thread(exporter);
+
         // deinitialize the collectors
-        ipfix_deinit_collector_array(&(exporter->collector_arr));
+        ipfix_deinit_collector_array(exporter);
 
 #ifdef SUPPORT_DTLS
 	ipfix_clear_dtls_certificate(&exporter->certificate);
@@ -516,7 +554,7 @@ void update_exporter_max_message_size(ipfix_exporter *exporter) {
     uint16_t max_message_size;
     max_message_size = exporter->max_message_size;
     for(i=0;i<exporter->collector_max_num;i++) {
-	col = &exporter->collector_arr[i];
+	col = exporter->collector_arr[i];
 	if(col->state != C_UNUSED &&
 		(col->protocol == UDP || col->protocol == DTLS_OVER_UDP)) {
 	    uint16_t maxsize = 0;
@@ -613,14 +651,19 @@ int update_collector_mtu(ipfix_exporter *exporter,
 }
 
 static ipfix_receiving_collector *get_free_collector_slot(ipfix_exporter *exporter) {
-    for(int i=0; i<exporter->collector_max_num; i++) {
-	if(exporter->collector_arr[i].state == C_UNUSED)
-	    return &exporter->collector_arr[i];
+    int i;
+    for(i=0; i<exporter->collector_max_num; i++) {
+	if(exporter->collector_arr[i]->state == C_UNUSED)
+	    return exporter->collector_arr[i];
     }
-    return NULL;
+    // all slots are in use, double the capacity
+    if (ipfix_grow_collector_array(exporter, 2 * exporter->collector_max_num))
+	return NULL;
+    return exporter->collector_arr[i];
 }
 
-static int add_collector_datafile(ipfix_receiving_collector *collector, const char *basename, uint32_t maxfilesize) {
+static int add_collector_datafile(ipfix_receiving_collector *collector, const char *basename, uint32_t maxfilesize,
+	ipfix_aux_config_datafile *aux_config_datafile) {
     collector->ipaddress[0] = '\0';
     collector->port_number = 0;
     collector->data_socket = -1;
@@ -631,6 +674,10 @@ static int add_collector_datafile(ipfix_receiving_collector *collector, const ch
     collector->basename = strdup(basename);
     collector->filenum = -1;
     collector->maxfilesize = maxfilesize;
+    collector->index_fh = NULL;
+    collector->write_index = aux_config_datafile && aux_config_datafile->write_index;
+    collector->compression_level = aux_config_datafile ? aux_config_datafile->compression_level : 0;
+    collector->cfh = NULL;
     ipfix_new_file(collector); 
     collector->state = C_CONNECTED;
     return 0;
@@ -755,7 +802,7 @@ static int valid_transport_protocol(enum ipfix_transport_protocol p) {
 /*!
  * \brief Add a Collector to the given Exporter and trigger connection setup.
  *
- * Up to IPFIX_MAX_COLLECTORS Collectors may be added to a single Exporter.
+ * Any number of Collectors may be added to a single Exporter.
  * Data Records are sent to all Collectors in parallel. All active Templates
  * are transmitted to a given Collector before Data Records are sent to the
  * this Collector.
@@ -775,6 +822,7 @@ static int valid_transport_protocol(enum ipfix_transport_protocol p) {
  * <table><tr><td><em>transport protocol</em></td><td><em>type of *aux_config</em></td></tr>
  * <tr><td>RAWDIR</td><td>NULL</td></tr>
  * <tr><td>SCTP</td><td>NULL</td></tr>
+ * <tr><td>DATAFILE</td><td>ipfix_aux_config_datafile or NULL</td></tr>
  * <tr><td>UDP</td><td>ipfix_aux_config_udp</td></tr>
  * <tr><td>DTLS_OVER_UDP</td><td>ipfix_aux_config_dtls_over_udp</td></tr>
  * <tr><td>DTLS_OVER_SCTP</td><td>ipfix_aux_config_dtls_over_sctp</td></tr>
@@ -807,9 +855,7 @@ int ipfix_add_collector(ipfix_exporter *exporter, const char *coll_ip_addr,
     // get free slot
     ipfix_receiving_collector *collector = get_free_collector_slot(exporter);
     if( ! collector) {
-	msg(LOG_CRIT, "no more free slots for new collectors available, limit %d reached",
-		exporter->collector_max_num
-	   );
+	msg(LOG_CRIT, "could not allocate a slot for a new collector");
 	return -1;
     }
 
@@ -817,7 +863,8 @@ int ipfix_add_collector(ipfix_exporter *exporter, const char *coll_ip_addr,
     /* It is the duty of add_collector_rawdir to set collector->state */
     if (proto==RAWDIR) return add_collector_rawdir(collector,coll_ip_addr);
 #endif
-    if (proto==DATAFILE) return add_collector_datafile(collector, coll_ip_addr, coll_port);
+    if (proto==DATAFILE) return add_collector_datafile(collector, coll_ip_addr, coll_port,
+		(ipfix_aux_config_datafile*)aux_config);
     /*
     FIXME: only a quick fix to make that work
     Must be copied, else pointered data must be around forever
@@ -859,6 +906,8 @@ int ipfix_add_collector(ipfix_exporter *exporter, const char *coll_ip_addr,
 
 static void remove_collector(ipfix_receiving_collector *collector) {
     DPRINTF_INFO("Removing collector.");
+    /* the sender thread must not use the socket any longer */
+    ipfix_deinit_send_queue(collector);
 #ifdef SUPPORT_DTLS
     /* Shutdown DTLS connection */
     if (collector->protocol == DTLS_OVER_UDP || collector->protocol == DTLS_OVER_SCTP) {
@@ -883,8 +932,15 @@ static void remove_collector(ipfix_receiving_collector *collector) {
     }
 #endif
     if (collector->protocol == DATAFILE) {
+	ipfix_close_file(collector);
+	ipfix_close_index(collector);
 	free(collector->basename);
     }
+    free(collector->batch_iov);
+    free(collector->batch_headers);
+    collector->batch_iov = NULL;
+    collector->batch_headers = NULL;
+    collector->batch_count = 0;
     collector->state = C_UNUSED;
 }
 
@@ -906,7 +962,7 @@ static void remove_collector(ipfix_receiving_collector *collector) {
 int ipfix_remove_collector(ipfix_exporter *exporter, const char *coll_ip_addr, uint16_t coll_port) {
     int i;
     for(i=0;i<exporter->collector_max_num;i++) {
-	ipfix_receiving_collector *collector = &exporter->collector_arr[i];
+	ipfix_receiving_collector *collector = exporter->collector_arr[i];
 	if( ( strcmp( collector->ipaddress, coll_ip_addr) == 0 )
 		&& collector->port_number == coll_port) {
 	    remove_collector(collector);
@@ -937,15 +993,15 @@ static int ipfix_find_template(
 
     DPRINTF_DEBUG( "ipfix_find_template with ID: %d",template_id);
 
-    int i=0;
-    for (;i<exporter->ipfix_lo_template_maxsize;i++) {
-	if(exporter->template_arr[i].state != T_UNUSED &&
-		exporter->template_arr[i].template_id == template_id) {
-	    DPRINTF_DEBUG(
-		    "ipfix_find_template with ID: %d, validity %d found at %d",
-		    template_id, exporter->template_arr[i].state, i);
-	    return i;
-	}
+    // the index entry is stale if the slot has been freed or reused since
+    int i = exporter->template_index[template_id];
+    if(i < exporter->ipfix_lo_template_maxsize &&
+	    exporter->template_arr[i].state != T_UNUSED &&
+	    exporter->template_arr[i].template_id == template_id) {
+	DPRINTF_DEBUG(
+		"ipfix_find_template with ID: %d, validity %d found at %d",
+		template_id, exporter->template_arr[i].state, i);
+	return i;
     }
     return -1;
 }
@@ -960,8 +1016,36 @@ static int ipfix_get_free_template_slot(ipfix_exporter *exporter) {
 	    return i;
 	}
     }
-    DPRINTF_INFO("ipfix_get_free_template_slot failed.");
-    return -1;
+    // all slots are in use, double the capacity
+    if (ipfix_grow_template_array(exporter, 2 * exporter->ipfix_lo_template_maxsize)) {
+	DPRINTF_INFO("ipfix_get_free_template_slot failed.");
+	return -1;
+    }
+    DPRINTF_DEBUG( "ipfix_get_free_template_slot found at %d",i);
+    return i;
+}
+
+/*
+ * Helper function: Remembers that the state of a template has changed, so
+ * that the next update of the template sendbuffers processes it.
+ * Parameters:
+ * exporter: Exporter the template belongs to
+ * index: slot of the template in the exporter's template array
+ * Returns: 0 on success, -1 on failure.
+ */
+static int ipfix_add_template_change(ipfix_exporter *exporter, int index) {
+    if (exporter->template_changes_count == exporter->template_changes_capacity) {
+	int capacity = 2 * exporter->template_changes_capacity;
+	int *tmp = (int *)realloc(exporter->template_changes, capacity * sizeof(int));
+	if (!tmp) {
+	    msg(LOG_ERR, "could not enlarge template change list");
+	    return -1;
+	}
+	exporter->template_changes = tmp;
+	exporter->template_changes_capacity = capacity;
+    }
+    exporter->template_changes[exporter->template_changes_count++] = index;
+    return 0;
 }
 
 /*!
@@ -1008,6 +1092,9 @@ int ipfix_remove_template(ipfix_exporter *exporter, uint16_t template_id) {
 	exporter->template_arr[found_index].field_count = 0;
 	exporter->template_arr[found_index].fields_added = 0;
 	exporter->template_arr[found_index].state = T_WITHDRAWN;
+	// the template sendbuffer still points to the overwritten template
+	exporter->template_sendbuffer_invalid = 1;
+	ipfix_add_template_change(exporter, found_index);
 	DPRINTF_DEBUG( "... Withdrawn");
     } else {
 	ipfix_deinit_template(&(exporter->template_arr[found_index]) );
@@ -1100,9 +1187,47 @@ void ipfix_update_header(ipfix_exporter *p_exporter, ipfix_receiving_collector *
 /*create a new filehandle and set recvcoll->fh, recvcoll->byteswritten, recvcoll->filenum 
  * to their new values
  * returns the newly created filehandle*/
+static void ipfix_close_index(ipfix_receiving_collector* recvcoll){
+	if (recvcoll->index_fh) fclose(recvcoll->index_fh);
+	recvcoll->index_fh = NULL;
+}
+
+/* open the sidecar index of a new data file, failures only disable the index */
+static void ipfix_new_index(ipfix_receiving_collector* recvcoll, const char *filename){
+	char *indexname = malloc(strlen(filename) + strlen(IPFIX_DATAFILE_INDEX_SUFFIX) + 1);
+	if (!indexname) {
+		msg(LOG_ERR, "could not malloc index filename");
+		return;
+	}
+	sprintf(indexname, "%s%s", filename, IPFIX_DATAFILE_INDEX_SUFFIX);
+	recvcoll->index_fh = fopen(indexname, "wb");
+	if (!recvcoll->index_fh ||
+			fwrite(IPFIX_DATAFILE_INDEX_MAGIC, strlen(IPFIX_DATAFILE_INDEX_MAGIC), 1, recvcoll->index_fh) != 1) {
+		msg(LOG_ERR, "could not create DATAFILE index %s", indexname);
+		ipfix_close_index(recvcoll);
+	}
+	recvcoll->index_entries = 0;
+	recvcoll->index_data_time = 0;
+	recvcoll->index_template_version = 0;
+	free(indexname);
+}
+
+/* closes the current data file, finishing its compression */
+static void ipfix_close_file(ipfix_receiving_collector* recvcoll){
+	if (recvcoll->cfh) {
+		if (compressed_file_close(recvcoll->cfh) != 0)
+			msg(LOG_ERR, "could not finish compressed DATAFILE file");
+		recvcoll->cfh = NULL;
+	} else if (recvcoll->fh > 0) {
+		close(recvcoll->fh);
+	}
+	recvcoll->fh = -1;
+}
+
 static int ipfix_new_file(ipfix_receiving_collector* recvcoll){
 	int f = -1;
-	if (recvcoll->fh > 0) close(recvcoll->fh);
+	ipfix_close_file(recvcoll);
+	ipfix_close_index(recvcoll);
 	recvcoll->filenum++;
 	recvcoll->bytes_written = 0;
 
@@ -1129,7 +1254,18 @@ static int ipfix_new_file(ipfix_receiving_collector* recvcoll){
 		}
 		break;
 	}
+	if (recvcoll->compression_level > 0) {
+		recvcoll->cfh = compressed_file_open(f, recvcoll->compression_level);
+		if (!recvcoll->cfh) {
+			msg(LOG_ERR, "could not compress DATAFILE file %s", filename);
+			close(f);
+			f = -1;
+			goto out;
+		}
+	}
 	msg(LOG_NOTICE, "Created new file: %s", filename);
+	if (recvcoll->write_index)
+		ipfix_new_index(recvcoll, filename);
 out:
 	free(filename);
 	recvcoll->fh = f;
@@ -1175,7 +1311,11 @@ static int ipfix_init_sendbuffer(export_protocol_version export_protocol, ipfix_
 
         // initialize an ipfix_set_manager
 	(tmp->set_manager).set_counter = 0;
-        memset(&(tmp->set_manager).set_header_store, 0, sizeof((tmp->set_manager).set_header_store));
+        (tmp->set_manager).set_header_capacity = IPFIX_INITIAL_SETS_PER_PACKET;
+        (tmp->set_manager).set_header_store = (ipfix_set_header *)calloc(IPFIX_INITIAL_SETS_PER_PACKET, sizeof(ipfix_set_header));
+        if (!(tmp->set_manager).set_header_store) {
+                goto out1;
+        }
         (tmp->set_manager).data_length = 0;
 
         *sendbuf=tmp;
@@ -1206,18 +1346,54 @@ static int ipfix_reset_sendbuffer(ipfix_sendbuffer *sendbuf)
 
         // also reset the set_manager!
 	(sendbuf->set_manager).set_counter = 0;
-        memset(&(sendbuf->set_manager).set_header_store, 0, sizeof((sendbuf->set_manager).set_header_store));
+        memset((sendbuf->set_manager).set_header_store, 0, (sendbuf->set_manager).set_header_capacity * sizeof(ipfix_set_header));
         (sendbuf->set_manager).data_length = 0;
 
         return 0;
 }
 
 
+/*
+ * Doubles the capacity of the set header store of a sendbuffer.
+ * Entries of the sendbuffer which point to set headers are moved to the
+ * new store.
+ */
+static int ipfix_grow_set_header_store(ipfix_sendbuffer *sendbuf)
+{
+        ipfix_set_manager *manager = &sendbuf->set_manager;
+        ipfix_set_header *old_store = manager->set_header_store;
+        char *old_begin = (char *)old_store;
+        char *old_end = (char *)(old_store + manager->set_header_capacity);
+        unsigned capacity = 2 * manager->set_header_capacity;
+        unsigned i;
+
+        ipfix_set_header *store = (ipfix_set_header *)calloc(capacity, sizeof(ipfix_set_header));
+        if (!store) {
+                msg(LOG_ERR, "could not enlarge set_header_store to %u entries", capacity);
+                return -1;
+        }
+        memcpy(store, old_store, manager->set_header_capacity * sizeof(ipfix_set_header));
+
+        for (i = HEADER_USED_IOVEC_COUNT; i < sendbuf->current; i++) {
+                char *base = (char *)sendbuf->entries[i].iov_base;
+                if (base >= old_begin && base < old_end)
+                        sendbuf->entries[i].iov_base = (char *)store + (base - old_begin);
+        }
+
+        manager->set_header_store = store;
+        manager->set_header_capacity = capacity;
+        free(old_store);
+
+        return 0;
+}
+
+
 /*
  * Deinitialize (free) an ipfix_sendbuffer
  */
 static int ipfix_deinit_sendbuffer(ipfix_sendbuffer **sendbuf)
 {
+        free((*sendbuf)->set_manager.set_header_store);
         // free the sendbuffer itself:
         free(*sendbuf);
         *sendbuf = NULL;
@@ -1230,21 +1406,44 @@ static int ipfix_deinit_sendbuffer(ipfix_sendbuffer **sendbuf)
  * initialize array of collectors
  * Allocates memory for an array of collectors
  * Parameters:
- * col: collector array to initialize
- * col_capacity: maximum amount of collectors to store in this array
+ * exporter: exporter, whose collector array we'll initialize
+ * col_capacity: initial amount of collectors to store in this array
  */
-static int ipfix_init_collector_array(ipfix_receiving_collector **col, int col_capacity)
+static int ipfix_init_collector_array(ipfix_exporter *exporter, int col_capacity)
+{
+        exporter->collector_arr = NULL;
+        exporter->collector_max_num = 0;
+
+        return ipfix_grow_collector_array(exporter, col_capacity);
+}
+
+
+/*
+ * enlarge array of collectors
+ * Allocates unused collectors until the array holds col_capacity collectors.
+ * Collectors that are already in use keep their memory location.
+ * Parameters:
+ * exporter: exporter, whose collector array we'll enlarge
+ * col_capacity: new amount of collectors to store in this array
+ */
+static int ipfix_grow_collector_array(ipfix_exporter *exporter, int col_capacity)
 {
         int i;
-        ipfix_receiving_collector *tmp;
+        ipfix_receiving_collector **tmp;
 
-        tmp=(ipfix_receiving_collector *)malloc((sizeof(ipfix_receiving_collector) * col_capacity));
+        tmp=(ipfix_receiving_collector **)realloc(exporter->collector_arr, sizeof(ipfix_receiving_collector *) * col_capacity);
         if(!tmp) {
+                msg(LOG_ERR, "could not enlarge collector array to %d entries", col_capacity);
                 return -1;
         }
+        exporter->collector_arr = tmp;
 
-        for (i = 0; i< col_capacity; i++) {
-		ipfix_receiving_collector *c = &tmp[i];
+        for (i = exporter->collector_max_num; i < col_capacity; i++) {
+		ipfix_receiving_collector *c = (ipfix_receiving_collector *)malloc(sizeof(ipfix_receiving_collector));
+		if (!c) {
+			msg(LOG_ERR, "could not allocate collector");
+			return -1;
+		}
                 c->state = C_UNUSED;
 		c->ipaddress[0] = '\0';
 		c->port_number = 0;
@@ -1252,6 +1451,10 @@ static int ipfix_init_collector_array(ipfix_receiving_collector **col, int col_c
 		c->data_socket = -1;
 		c->last_reconnect_attempt_time = 0;
 		c->messages_sent = 0;
+		c->batch_count = 0;
+		c->batch_iov = NULL;
+		c->batch_headers = NULL;
+		c->send_queue = NULL;
 #ifdef IPFIXLOLIB_RAWDIR_SUPPORT
 		c->packet_directory_path = NULL;
 #endif
@@ -1262,10 +1465,10 @@ static int ipfix_init_collector_array(ipfix_receiving_collector **col, int col_c
 		    c->dtls_connection.dtls_replacement.last_reconnect_attempt_time = 0;
 		c->dtls_connection.peer_fqdn = NULL;
 #endif
-
+		exporter->collector_arr[i] = c;
+		exporter->collector_max_num = i + 1;
         }
 
-        *col=tmp;
         return 0;
 }
 
@@ -1273,12 +1476,17 @@ static int ipfix_init_collector_array(ipfix_receiving_collector **col, int col_c
 /*
  * deinitialize an array of collectors
  * Parameters:
- * col: collector array to clean up
+ * exporter: exporter, whose collector array will be freed
  */
-static int ipfix_deinit_collector_array(ipfix_receiving_collector **col)
+static int ipfix_deinit_collector_array(ipfix_exporter *exporter)
 {
-        free(*col);
-        *col=NULL;
+        int i;
+
+        for (i = 0; i < exporter->collector_max_num; i++)
+                free(exporter->collector_arr[i]);
+        free(exporter->collector_arr);
+        exporter->collector_arr = NULL;
+        exporter->collector_max_num = 0;
 
         return 0;
 }
@@ -1323,16 +1531,60 @@ static int ipfix_init_send_socket(struct sockaddr_storage serv_addr, enum ipfix_
  * template_capacity: maximum amount of templates to store in this array
  */
 static int ipfix_init_template_array(ipfix_exporter *exporter, int template_capacity)
+{
+        exporter->ipfix_lo_template_maxsize = 0;
+        exporter->template_arr = NULL;
+        exporter->template_changes_count = 0;
+        exporter->template_changes_capacity = template_capacity;
+        exporter->template_sendbuffer_invalid = 0;
+        exporter->template_sendbuffer_version = 1;
+
+        // one entry for every possible template ID
+        exporter->template_index = (uint16_t *) calloc(UINT16_MAX + 1, sizeof(uint16_t));
+        exporter->template_changes = (int *) malloc(template_capacity * sizeof(int));
+        if (!exporter->template_index || !exporter->template_changes ||
+                        ipfix_grow_template_array(exporter, template_capacity)) {
+                free(exporter->template_index);
+                free(exporter->template_changes);
+                free(exporter->template_arr);
+                return -1;
+        }
+
+        return 0;
+}
+
+
+/*
+ * enlarge array of templates
+ * Parameters:
+ * exporter: exporter, whose template array we'll enlarge
+ * template_capacity: new amount of templates to store in this array
+ */
+static int ipfix_grow_template_array(ipfix_exporter *exporter, int template_capacity)
 {
         int i;
+        ipfix_lo_template *tmp;
+
+        // a template ID can only be in use once, so the index into the
+        // array always fits into template_index
+        if (template_capacity > UINT16_MAX + 1)
+                template_capacity = UINT16_MAX + 1;
+        if (template_capacity <= exporter->ipfix_lo_template_maxsize) {
+                msg(LOG_ERR, "template array cannot hold more than %d entries", exporter->ipfix_lo_template_maxsize);
+                return -1;
+        }
 
-        // allocate the memory for template_capacity elements:
-        exporter->ipfix_lo_template_maxsize  = template_capacity;
-        exporter->template_arr =  (ipfix_lo_template*) malloc (template_capacity * sizeof(ipfix_lo_template) );
+        tmp = (ipfix_lo_template*) realloc (exporter->template_arr, template_capacity * sizeof(ipfix_lo_template) );
+        if (!tmp) {
+                msg(LOG_ERR, "could not enlarge template array to %d entries", template_capacity);
+                return -1;
+        }
 
-        for(i = 0; i< template_capacity; i++) {
-                exporter->template_arr[i].state = T_UNUSED;
+        for(i = exporter->ipfix_lo_template_maxsize; i< template_capacity; i++) {
+                tmp[i].state = T_UNUSED;
         }
+        exporter->template_arr = tmp;
+        exporter->ipfix_lo_template_maxsize = template_capacity;
 
         return 0;
 }
@@ -1368,18 +1620,49 @@ static int ipfix_deinit_template_array(ipfix_exporter *exporter)
 	    }
         }
         free(exporter->template_arr);
+        free(exporter->template_index);
+        free(exporter->template_changes);
 
         exporter->template_arr = NULL;
+        exporter->template_index = NULL;
+        exporter->template_changes = NULL;
+        exporter->template_changes_count = 0;
         exporter->ipfix_lo_template_maxsize = 0;
 
         return 0;
 }
 
 
+/*
+ * Appends a template to a template sendbuffer
+ * Returns: 0 on success, -1 if the sendbuffer is full.
+ */
+static int ipfix_put_template_to_sendbuffer(ipfix_sendbuffer *sendbuf, ipfix_lo_template *templ)
+{
+        if (sendbuf->current >= IPFIX_MAX_SENDBUFSIZE-2 ) {
+                msg(LOG_ERR, "template sendbuffer too small to handle more than %i entries", sendbuf->current);
+                return -1;
+        }
+        sendbuf->entries[ sendbuf->current ].iov_base = templ->template_fields;
+        sendbuf->entries[ sendbuf->current ].iov_len =  templ->fields_length;
+        sendbuf->current++;
+        sendbuf->committed_data_length +=  templ->fields_length;
+        sendbuf->record_count++;
+
+        return 0;
+}
+
+
 /*
  * Updates the template sendbuffers
  * will be called, after a template has been added or removed
  *
+ * The UDP template sendbuffer is kept between calls. Only templates whose
+ * state changed since the last call are processed, unless a template that
+ * is contained in the UDP template sendbuffer has been withdrawn. In this
+ * case, the UDP template sendbuffer is rebuilt from all templates in state
+ * T_SENT. The SCTP template sendbuffer only holds the changes.
+ *
  * Watch out: By calling this function you undertake a commitment!
  * The commitment is that you send out sctp_sendbuf to all SCTP collectors!
  * This function alters the state of all templates that are
@@ -1393,79 +1676,68 @@ static int ipfix_deinit_template_array(ipfix_exporter *exporter)
 static int ipfix_update_template_sendbuffer (ipfix_exporter *exporter)
 {
         int i;
+        int c;
+        int count;
 
         ipfix_sendbuffer* t_sendbuf = exporter->template_sendbuffer;
 	ipfix_sendbuffer* sctp_sendbuf = exporter->sctp_template_sendbuffer;
 
-        // clean the template sendbuffers
-        ipfix_reset_sendbuffer(t_sendbuf);
+        // the SCTP template sendbuffer only contains changes
 	ipfix_reset_sendbuffer(sctp_sendbuf);
 
-        // place all valid templates into the template sendbuffer
-        // could be done just like put_data_field:
+        if (exporter->template_sendbuffer_invalid) {
+                ipfix_reset_sendbuffer(t_sendbuf);
+                for (i = 0; i < exporter->ipfix_lo_template_maxsize; i++ ) {
+                        if (exporter->template_arr[i].state == T_SENT &&
+                                        ipfix_put_template_to_sendbuffer(t_sendbuf, &exporter->template_arr[i]))
+                                return -1;
+                }
+                exporter->template_sendbuffer_invalid = 0;
+                exporter->template_sendbuffer_version++;
+        }
 
-        for (i = 0; i < exporter->ipfix_lo_template_maxsize; i++ )  {
+        // withdrawn templates are freed during the next call, so they are
+        // added to the list of changes again
+        count = exporter->template_changes_count;
+        exporter->template_changes_count = 0;
+
+        for (c = 0; c < count; c++ )  {
+                i = exporter->template_changes[c];
                 switch (exporter->template_arr[i].state) {
                 	case (T_TOBEDELETED):
 				// free memory and mark T_UNUSED
 				ipfix_deinit_template(&(exporter->template_arr[i]) );
 				break;
 			case (T_COMMITED): // send to SCTP and UDP collectors and mark as T_SENT
-				if (sctp_sendbuf->current >= IPFIX_MAX_SENDBUFSIZE-2 ) {
-					msg(LOG_ERR, "SCTP template sendbuffer too small to handle more than %i entries", sctp_sendbuf->current);
-					return -1;
-                        	}
-                        	if (t_sendbuf->current >= IPFIX_MAX_SENDBUFSIZE-2 ) {
-					msg(LOG_ERR, "UDP template sendbuffer too small to handle more than %i entries", t_sendbuf->current);
-					return -1;
-                        	}
-				sctp_sendbuf->entries[ sctp_sendbuf->current ].iov_base = exporter->template_arr[i].template_fields;
-                        	sctp_sendbuf->entries[ sctp_sendbuf->current ].iov_len =  exporter->template_arr[i].fields_length;
-                        	sctp_sendbuf->current++;
-                        	sctp_sendbuf->committed_data_length +=  exporter->template_arr[i].fields_length;
-				sctp_sendbuf->record_count++;
-				
-				t_sendbuf->entries[ t_sendbuf->current ].iov_base = exporter->template_arr[i].template_fields;
-				t_sendbuf->entries[ t_sendbuf->current ].iov_len =  exporter->template_arr[i].fields_length;
-				t_sendbuf->current++;
-				t_sendbuf->committed_data_length +=  exporter->template_arr[i].fields_length;
-				t_sendbuf->record_count++;
-                        	
+				if (ipfix_put_template_to_sendbuffer(sctp_sendbuf, &exporter->template_arr[i]) ||
+						ipfix_put_template_to_sendbuffer(t_sendbuf, &exporter->template_arr[i]))
+					goto out;
                         	exporter->template_arr[i].state = T_SENT;
+				exporter->template_sendbuffer_version++;
                         	break;
-                	case (T_SENT): // only to UDP collectors
-                		if (t_sendbuf->current >= IPFIX_MAX_SENDBUFSIZE-2 ) {
-					msg(LOG_ERR, "UDP template sendbuffer too small to handle more than %i entries", t_sendbuf->current);
-					return -1;
-                        	}
-                		t_sendbuf->entries[ t_sendbuf->current ].iov_base = exporter->template_arr[i].template_fields;
-				t_sendbuf->entries[ t_sendbuf->current ].iov_len =  exporter->template_arr[i].fields_length;
-				t_sendbuf->current++;
-				t_sendbuf->committed_data_length +=  exporter->template_arr[i].fields_length;
-				t_sendbuf->record_count++;
-				break;
                 	case (T_WITHDRAWN): // put the SCTP withdrawal message and mark T_TOBEDELETED
-                		if (sctp_sendbuf->current >= IPFIX_MAX_SENDBUFSIZE-2 ) {
-					msg(LOG_ERR, "SCTP template sendbuffer too small to handle more than %i entries", sctp_sendbuf->current);
-					return -1;
-				}
-				sctp_sendbuf->entries[ sctp_sendbuf->current ].iov_base = exporter->template_arr[i].template_fields;
-				sctp_sendbuf->entries[ sctp_sendbuf->current ].iov_len =  exporter->template_arr[i].fields_length;
-				sctp_sendbuf->current++;
-				sctp_sendbuf->committed_data_length +=  exporter->template_arr[i].fields_length;
-				sctp_sendbuf->record_count++;
+				if (ipfix_put_template_to_sendbuffer(sctp_sendbuf, &exporter->template_arr[i]))
+					goto out;
 				
 				/* ASK: Why don't we just delete the template? */
 				exporter->template_arr[i].state = T_TOBEDELETED;
+				exporter->template_changes[exporter->template_changes_count++] = i;
 				DPRINTF_DEBUG( "Withdrawal for template ID: %d added to sctp_sendbuffer", exporter->template_arr[i].template_id);
 				break;
-			default : // Do nothing : T_UNUSED or T_UNCLEAN
+			default : // Do nothing : T_SENT, T_UNUSED or T_UNCLEAN
 				break;
                 }
-        } // end loop over all templates
+        } // end loop over all changed templates
 
         // that's it!
         return 0;
+
+out:
+        // keep the changes that have not been processed for the next call
+        memmove(&exporter->template_changes[exporter->template_changes_count],
+                        &exporter->template_changes[c], (count - c) * sizeof(int));
+        exporter->template_changes_count += count - c;
+        return -1;
 }
 
 #ifdef SUPPORT_SCTP
@@ -1489,6 +1761,8 @@ static int sctp_reconnect(ipfix_receiving_collector *collector){
 	collector->last_reconnect_attempt_time = time_now;
 	// error occurred while being connected?
 	if(collector->state == C_CONNECTED) {
+		// queued messages are lost with the association
+		ipfix_detach_send_queue(collector);
 		// the socket has not yet been closed
 		close(collector->data_socket);
 		collector->data_socket = -1;
@@ -1646,7 +1920,48 @@ static int sctp_reconnect(ipfix_receiving_collector *collector){
 /* Transmission                                                    */
 /*******************************************************************/
 
-static bool ipfix_write_sendbuffer_to_datafile(ipfix_sendbuffer *sendbuffer, ipfix_receiving_collector *col)
+/*
+ * Adds the Message about to be written at col->bytes_written to the sidecar index.
+ * Data Messages are only indexed once per export time second, Template Messages
+ * only if the Templates have changed since the last template entry.
+ */
+static void ipfix_write_datafile_index(ipfix_exporter *exporter, ipfix_sendbuffer *sendbuffer,
+	ipfix_receiving_collector *col, bool templates)
+{
+    ipfix_datafile_index_entry entry;
+    uint32_t export_time;
+
+    if (!col->index_fh)
+	return;
+
+    if (exporter->export_protocol == NFV9_PROTOCOL)
+	export_time = ntohl(sendbuffer->nfv9_message_header.unix_secs);
+    else
+	export_time = ntohl(sendbuffer->ipfix_message_header.export_time);
+
+    if (templates) {
+	if (col->index_template_version == exporter->template_sendbuffer_version)
+	    return;
+	col->index_template_version = exporter->template_sendbuffer_version;
+    } else {
+	if (col->index_entries > 0 && col->index_data_time == export_time)
+	    return;
+	col->index_data_time = export_time;
+	col->index_entries++;
+    }
+
+    memset(&entry, 0, sizeof(entry));
+    entry.export_time = htonl(export_time);
+    entry.flags = templates ? IPFIX_DATAFILE_INDEX_TEMPLATES : 0;
+    entry.offset = htonll(col->bytes_written);
+    if (fwrite(&entry, sizeof(entry), 1, col->index_fh) != 1) {
+	msg(LOG_ERR, "could not write to DATAFILE index, disabling it");
+	ipfix_close_index(col);
+    }
+}
+
+static bool ipfix_write_sendbuffer_to_datafile(ipfix_exporter *exporter, ipfix_sendbuffer *sendbuffer,
+	ipfix_receiving_collector *col, bool templates)
 {
     ssize_t nwritten = 0;
     // @todo For V9 there is no immediate access to message length, need to calculate it.
@@ -1654,6 +1969,9 @@ static bool ipfix_write_sendbuffer_to_datafile(ipfix_sendbuffer *sendbuffer, ipf
 				ntohs(sendbuffer->ipfix_message_header.length)
 				> (uint64_t)(col->maxfilesize) * 1024)) {
 	ipfix_new_file(col);
+	// every file starts with the current Templates, so it can be read on its own
+	if (!templates && col->fh >= 0 && exporter->template_sendbuffer->committed_data_length > 0)
+	    ipfix_write_sendbuffer_to_datafile(exporter, exporter->template_sendbuffer, col, true);
     }
 
     if (col->fh < 0) {
@@ -1664,6 +1982,7 @@ static bool ipfix_write_sendbuffer_to_datafile(ipfix_sendbuffer *sendbuffer, ipf
 	msg(LOG_ERR, "packet size == 0!");
 	return false;
     }
+    ipfix_write_datafile_index(exporter, sendbuffer, col, templates);
     if (col->protocol == UDP) {
 	struct msghdr header;
 
@@ -1675,6 +1994,8 @@ static bool ipfix_write_sendbuffer_to_datafile(ipfix_sendbuffer *sendbuffer, ipf
 	header.msg_controllen = 0;
 
 	nwritten = sendmsg(col->fh, &header, 0);
+    } else if (col->cfh) {
+	nwritten = compressed_file_writev(col->cfh, sendbuffer->entries, sendbuffer->current);
     } else {
 	nwritten = writev(col->fh, sendbuffer->entries, sendbuffer->current);
     }
@@ -1702,6 +2023,32 @@ static void ipfix_write_sendbuffer_to_rawdir(ipfix_sendbuffer *sendbuffer, ipfix
 }
 #endif
 
+/*
+ * Reacts to an error the sender thread ran into while transmitting the
+ * send queue of a collector. Like for messages sent directly, the MTU
+ * estimate of UDP collectors is updated and SCTP collectors reconnect.
+ * The collector might be removed (set to C_UNUSED) afterwards.
+ */
+static void ipfix_handle_send_queue_error(ipfix_exporter *exporter, ipfix_receiving_collector *col)
+{
+    int error = ipfix_take_send_queue_error(col);
+    if (error == 0)
+	return;
+    if (col->protocol == UDP && error == EMSGSIZE) {
+	msg(LOG_ERR, "Updating MTU estimate for collector %s:%d",
+	    col->ipaddress,
+	    col->port_number);
+	update_collector_mtu(exporter, col);
+    }
+#ifdef SUPPORT_SCTP
+    if (col->protocol == SCTP && col->state == C_CONNECTED) {
+	sctp_reconnect(col);
+	// if result is C_DISCONNECTED and sctp_reconnect_timer == 0, collector will
+	// be removed below
+    }
+#endif
+}
+
 /*
  * If necessary, sends all associated templates
  * Parameters:
@@ -1718,6 +2065,10 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
     // Remember: This is a global timer for all collectors associated with a given exporter
     bool expired = ( (time_now - exporter->last_template_transmission_time) >  exporter->template_transmission_timer);
 
+    // batched data messages must not overtake (re)sent templates
+    if (expired && exporter->send_batch)
+	ipfix_flush(exporter);
+
     // update the sendbuffers
     // Watch out: You undertake a commitment by calling this function
     // See the definition of the function for more details.
@@ -1725,12 +2076,18 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 
     // send the sendbuffer to all collectors depending on their protocol
     for (i = 0; i < exporter->collector_max_num; i++) {
-	ipfix_receiving_collector *col = &exporter->collector_arr[i];
+	ipfix_receiving_collector *col = exporter->collector_arr[i];
 	// is the collector a valid target?
 	if (col->state == C_UNUSED) {
 	    continue; // No. Continue to next loop iteration.
 	}
 
+	if (col->send_queue) {
+	    ipfix_handle_send_queue_error(exporter, col);
+	    if (col->state == C_UNUSED)
+		continue;
+	}
+
 	char vrf_log[VRF_LOG_LEN] = "";
 	if (strlen(col->vrf_name) > 0) {
 		snprintf(vrf_log, VRF_LOG_LEN, "[%.*s] ", IFNAMSIZ, col->vrf_name);
@@ -1783,6 +2140,14 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 		ipfix_update_header(exporter, col,
 				    exporter->template_sendbuffer);
 
+		if (col->send_queue) {
+		    // transmitted by the sender thread
+		    ipfix_enqueue_message(col, exporter->template_sendbuffer->entries,
+					  exporter->template_sendbuffer->current, 0, 1);
+		    col->messages_sent++;
+		    break;
+		}
+
 		struct msghdr header;
 		header.msg_name = &col->addr;
 		header.msg_namelen = sizeof(col->addr);
@@ -1835,7 +2200,11 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 		    // update the sendbuffer header, as we must set the export time & sequence number!
 		    ipfix_update_header(exporter, col,
 					exporter->sctp_template_sendbuffer);
-		    if((bytes_sent = sctp_sendmsgv(col->data_socket,
+		    if (col->send_queue && col->state == C_CONNECTED) {
+			// transmitted by the sender thread, templates are reliable
+			ipfix_enqueue_message(col, exporter->sctp_template_sendbuffer->entries,
+					      exporter->sctp_template_sendbuffer->current, 0, 1);
+		    } else if((bytes_sent = sctp_sendmsgv(col->data_socket,
 						   exporter->sctp_template_sendbuffer->entries,
 						   exporter->sctp_template_sendbuffer->current,
 						   (struct sockaddr*)&(col->addr),
@@ -1879,7 +2248,7 @@ static int ipfix_send_templates(ipfix_exporter* exporter)
 	    if (exporter->template_sendbuffer->committed_data_length > 0) {
 		ipfix_update_header(exporter, col,
 				    exporter->template_sendbuffer);
-		ipfix_write_sendbuffer_to_datafile(exporter->template_sendbuffer, col);
+		ipfix_write_sendbuffer_to_datafile(exporter, exporter->template_sendbuffer, col, true);
 		col->messages_sent++;
 	    }
 	    break;
@@ -1911,6 +2280,134 @@ static void ipfix_sendbuffer_debug(ipfix_sendbuffer *sendbuffer)
 }
 #endif
 
+/*
+ * Copies the body of the data sendbuffer (set headers and records) into the
+ * send batch of the exporter.
+ * Returns an iovec pointing to the copy.
+ */
+static struct iovec ipfix_copy_data_to_batch(ipfix_exporter *exporter)
+{
+    struct ipfix_send_batch *batch = exporter->send_batch;
+    ipfix_sendbuffer *sendbuf = exporter->data_sendbuffer;
+    struct iovec body;
+    unsigned i;
+
+    body.iov_base = batch->data + batch->used;
+    for (i = HEADER_USED_IOVEC_COUNT; i < sendbuf->committed; i++) {
+	memcpy(batch->data + batch->used, sendbuf->entries[i].iov_base, sendbuf->entries[i].iov_len);
+	batch->used += sendbuf->entries[i].iov_len;
+    }
+    body.iov_len = (char *)batch->data + batch->used - (char *)body.iov_base;
+    batch->count++;
+    return body;
+}
+
+/*
+ * Appends a message consisting of the current header of the data sendbuffer
+ * and the given body to the batch of a collector.
+ * Returns 0 on success, -1 on failure.
+ */
+static int ipfix_add_to_collector_batch(ipfix_exporter *exporter, ipfix_receiving_collector *col, struct iovec *body)
+{
+    unsigned size = exporter->send_batch->size;
+    if (!col->batch_iov) {
+	col->batch_iov = (struct iovec *)malloc(2 * size * sizeof(struct iovec));
+	col->batch_headers = (char *)malloc(size * BATCH_HEADER_SLOT_SIZE);
+	if (!col->batch_iov || !col->batch_headers) {
+	    msg(LOG_ERR, "could not allocate batch for collector %s:%d", col->ipaddress, col->port_number);
+	    free(col->batch_iov);
+	    free(col->batch_headers);
+	    col->batch_iov = NULL;
+	    col->batch_headers = NULL;
+	    return -1;
+	}
+	col->batch_count = 0;
+    }
+    if (col->batch_count >= size) {
+	ipfix_flush_collector_batch(exporter, col);
+	if (col->state == C_UNUSED)
+	    return -1;
+    }
+
+    char *header = col->batch_headers + col->batch_count * BATCH_HEADER_SLOT_SIZE;
+    memcpy(header, exporter->data_sendbuffer->entries[0].iov_base, exporter->data_sendbuffer->entries[0].iov_len);
+    col->batch_iov[2 * col->batch_count].iov_base = header;
+    col->batch_iov[2 * col->batch_count].iov_len = exporter->data_sendbuffer->entries[0].iov_len;
+    col->batch_iov[2 * col->batch_count + 1] = *body;
+    col->batch_count++;
+    return 0;
+}
+
+/*
+ * Transmits all messages waiting in the batch of a UDP collector.
+ * The collector might have been removed (state C_UNUSED) after calling this
+ * function if the MTU could not be determined anymore.
+ */
+static void ipfix_flush_collector_batch(ipfix_exporter *exporter, ipfix_receiving_collector *col)
+{
+    unsigned count = col->batch_count;
+    unsigned sent = 0;
+    int ret;
+
+    col->batch_count = 0;
+    if (count == 0 || col->state != C_CONNECTED)
+	return;
+
+    char vrf_log[VRF_LOG_LEN] = "";
+    if (strlen(col->vrf_name) > 0) {
+	snprintf(vrf_log, VRF_LOG_LEN, "[%.*s] ", IFNAMSIZ, col->vrf_name);
+    }
+
+#ifdef HAVE_SENDMMSG
+    struct mmsghdr msgs[IPFIX_MAX_SEND_BATCH_SIZE];
+    memset(msgs, 0, count * sizeof(struct mmsghdr));
+    for (unsigned i = 0; i < count; i++) {
+	msgs[i].msg_hdr.msg_name = &col->addr;
+	msgs[i].msg_hdr.msg_namelen = sizeof(col->addr);
+	msgs[i].msg_hdr.msg_iov = &col->batch_iov[2 * i];
+	msgs[i].msg_hdr.msg_iovlen = 2;
+    }
+#endif
+
+    while (sent < count) {
+#ifdef HAVE_SENDMMSG
+	/* sendmmsg() only fails if the first message could not be sent.
+	   Otherwise, it returns the number of messages sent. */
+	ret = sendmmsg(col->data_socket, &msgs[sent], count - sent, 0);
+#else
+	struct msghdr header;
+	header.msg_name = &col->addr;
+	header.msg_namelen = sizeof(col->addr);
+	header.msg_iov = &col->batch_iov[2 * sent];
+	header.msg_iovlen = 2;
+	header.msg_control = 0;
+	header.msg_controllen = 0;
+	header.msg_flags = 0;
+	ret = (sendmsg(col->data_socket, &header, 0) == -1) ? -1 : 1;
+#endif
+	if (ret == -1) {
+	    msg(LOG_ERR, "%scould not send data to %s:%d errno: %s  (UDP)", vrf_log, col->ipaddress, col->port_number, strerror(errno));
+	    if (errno == EMSGSIZE) {
+		msg(LOG_ERR, "%sUpdating MTU estimate for collector %s:%d",
+		    vrf_log,
+		    col->ipaddress,
+		    col->port_number);
+		/* If update_collector_mtu fails, it calls
+		   remove_collector() which also frees the batch. */
+		update_collector_mtu(exporter, col);
+		if (col->state == C_UNUSED)
+		    return;
+	    }
+	    /* drop the message that could not be sent */
+	    sent++;
+	} else {
+	    sent += ret;
+	}
+    }
+    msg(LOG_DEBUG, "%s%u batched messages sent to UDP collector %s:%d",
+	vrf_log, count, col->ipaddress, col->port_number);
+}
+
 /*
  Send data to collectors
  Sends all data committed via ipfix_put_data_field to this exporter.
@@ -1926,10 +2423,12 @@ static int ipfix_send_data(ipfix_exporter* exporter)
     int bytes_sent;
     // send the current data_sendbuffer if there is data
     if (exporter->data_sendbuffer->committed_data_length > 0 ) {
+	// body of the message in the send batch, copied on first use
+	struct iovec batch_body = { NULL, 0 };
 	// send the sendbuffer to all collectors
 	for (int i = 0; i < exporter->collector_max_num; i++) {
 	    struct msghdr header;
-	    ipfix_receiving_collector *col = &exporter->collector_arr[i];
+	    ipfix_receiving_collector *col = exporter->collector_arr[i];
 	    // update the header in the sendbuffer
 	    ipfix_update_header(exporter, col, exporter->data_sendbuffer);
 	    // is the collector a valid target?
@@ -1947,6 +2446,19 @@ static int ipfix_send_data(ipfix_exporter* exporter)
 #endif
 	    switch(col->protocol){
 	    case UDP:
+		if (col->send_queue) {
+		    // transmitted by the sender thread
+		    ipfix_enqueue_message(col, exporter->data_sendbuffer->entries,
+					  exporter->data_sendbuffer->current, 0, 0);
+		    break;
+		}
+		if (exporter->send_batch) {
+		    // defer transmission until the batch is full or ipfix_flush() is called
+		    if (batch_body.iov_base == NULL)
+			batch_body = ipfix_copy_data_to_batch(exporter);
+		    ipfix_add_to_collector_batch(exporter, col, &batch_body);
+		    break;
+		}
 		header.msg_name = &col->addr;
 		header.msg_namelen = sizeof(col->addr);
 		header.msg_iov = exporter->data_sendbuffer->entries;
@@ -1990,6 +2502,13 @@ static int ipfix_send_data(ipfix_exporter* exporter)
 
 #ifdef SUPPORT_SCTP
 	    case SCTP:
+		if (col->send_queue) {
+		    // transmitted by the sender thread
+		    ipfix_enqueue_message(col, exporter->data_sendbuffer->entries,
+					  exporter->data_sendbuffer->committed,
+					  exporter->sctp_lifetime, 0);
+		    break;
+		}
 		if((bytes_sent = sctp_sendmsgv(col->data_socket,
 					       exporter->data_sendbuffer->entries,
 					       exporter->data_sendbuffer->committed,
@@ -2031,7 +2550,7 @@ static int ipfix_send_data(ipfix_exporter* exporter)
 		break;
 #endif
 	    case DATAFILE:
-		ipfix_write_sendbuffer_to_datafile(exporter->data_sendbuffer, col);
+		ipfix_write_sendbuffer_to_datafile(exporter, exporter->data_sendbuffer, col, false);
 		break;
 
 	    default:
@@ -2044,6 +2563,9 @@ static int ipfix_send_data(ipfix_exporter* exporter)
 	// increment sequence number
 	exporter->sequence_number += exporter->sn_increment;
 	exporter->sn_increment = 0;
+
+	if (exporter->send_batch && exporter->send_batch->count >= exporter->send_batch->size)
+	    ipfix_flush(exporter);
     }  // end if
 
     // reset the sendbuffer
@@ -2135,10 +2657,7 @@ int ipfix_start_data_set(ipfix_exporter *exporter, uint16_t template_id)
         }
 
 	// check if we do have space for another set header
-        if((current + 1) >= IPFIX_MAX_SETS_PER_PACKET ) {
-                msg(LOG_ERR, "start_data_set set_header_store too small to handle more than %i entries",
-                    current + 1
-                   );
+        if(current >= manager->set_header_capacity && ipfix_grow_set_header_store(exporter->data_sendbuffer)) {
                 return -1;
         }
 
@@ -2275,7 +2794,7 @@ int ipfix_end_data_set(ipfix_exporter *exporter, uint16_t number_of_records)
                 msg(LOG_ERR, "ipfix_end_data_set called but there is no started set to end.");
                 return -1;
         }
-	if((current + 1) >= IPFIX_MAX_SETS_PER_PACKET ) {
+	if(current >= manager->set_header_capacity ) {
 		msg(LOG_ERR, "ipfix_end_data_set set_header_store too small to handle more than %i entries", current + 1);
 		return -1;
 	}
@@ -2328,7 +2847,7 @@ int ipfix_cancel_data_set(ipfix_exporter *exporter)
                 msg(LOG_ERR, "cancel_data_set called but there is no set to cancel.");
                 return -1;
         }
-	if((current + 1) >= IPFIX_MAX_SETS_PER_PACKET ) {
+	if(current >= manager->set_header_capacity ) {
 		msg(LOG_ERR, "ipfix_cancel_data_set set_header_store too small to handle more than %i entries", current + 1);
 		return -1;
 	}
@@ -2423,7 +2942,7 @@ out:
  *        It is considered an error if more or fewer fields are added.
  * \return 0 success
  * \return -1 failure. Reasons might be that <tt>template_id</tt> is not great than 255
- *   or that the maximum number of defined templates has been exceeded.
+ *   or that no memory could be allocated for the template.
  * \sa ipfix_end_template(), ipfix_put_template_field(), ipfix_send()
 **/
 int ipfix_start_template (ipfix_exporter *exporter, uint16_t template_id,  uint16_t field_count) {
@@ -2481,6 +3000,7 @@ int ipfix_start_template (ipfix_exporter *exporter, uint16_t template_id,  uint1
     // initialize the rest:
     exporter->template_arr[found_index].state = T_UNCLEAN;
     exporter->template_arr[found_index].template_id = template_id;
+    exporter->template_index[template_id] = found_index;
     exporter->template_arr[found_index].field_count = field_count;
     exporter->template_arr[found_index].fields_added = 0;
 
@@ -2671,6 +3191,10 @@ int ipfix_end_template(ipfix_exporter *exporter, uint16_t template_id)
     write_unsigned16 (&p_pos, p_end, templ->fields_length);
     // call the template valid
     templ->state = T_COMMITED;
+    if (ipfix_add_template_change(exporter, found_index)) {
+	ipfix_deinit_template(templ);
+	return -1;
+    }
     // force resending templates to UDP collectors by resetting transmission time
     exporter->last_template_transmission_time = 0;
 
@@ -2745,6 +3269,100 @@ int ipfix_set_sctp_reconnect_timer(ipfix_exporter *exporter, uint32_t timer) {
     return 0;
 }
 
+/*!
+ * \brief Set the number of IPFIX Messages that are accumulated before they are
+ * transmitted to UDP Collectors.
+ *
+ * If <tt>batch_size</tt> is greater than one, ipfix_send() copies each IPFIX
+ * Message containing Data Sets into a batch instead of transmitting it
+ * immediately to UDP Collectors. As soon as the batch contains
+ * <tt>batch_size</tt> Messages, all of them are transmitted to each UDP
+ * Collector with a single call to sendmmsg() (where available). As the data is
+ * copied, it does not have to stay at its memory location after ipfix_send()
+ * returned. Call ipfix_flush() to transmit an incomplete batch. Collectors
+ * using other transport protocols are not affected.
+ *
+ * Messages waiting in the current batch are transmitted before the batch size
+ * is changed.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \param batch_size maximum number of Messages per batch (at most
+ * IPFIX_MAX_SEND_BATCH_SIZE), 0 or 1 disables batching
+ * \return 0 success
+ * \return -1 failure. Reasons include:<ul><li>batch size too big</li><li>memory allocation failed</li></ul>
+ * \sa ipfix_flush()
+ */
+int ipfix_set_send_batch_size(ipfix_exporter *exporter, uint16_t batch_size) {
+    if (batch_size > IPFIX_MAX_SEND_BATCH_SIZE) {
+	msg(LOG_ERR, "send batch size %u exceeds maximum of %u", batch_size, IPFIX_MAX_SEND_BATCH_SIZE);
+	return -1;
+    }
+    ipfix_flush(exporter);
+    ipfix_deinit_send_batch(exporter);
+    if (batch_size <= 1)
+	return 0;
+
+    struct ipfix_send_batch *batch = (struct ipfix_send_batch *)malloc(sizeof(struct ipfix_send_batch));
+    if (!batch) {
+	msg(LOG_ERR, "could not allocate send batch");
+	return -1;
+    }
+    batch->data = (char *)malloc((size_t)batch_size * IPFIX_MAX_PACKETSIZE);
+    if (!batch->data) {
+	msg(LOG_ERR, "could not allocate send batch");
+	free(batch);
+	return -1;
+    }
+    batch->size = batch_size;
+    batch->count = 0;
+    batch->used = 0;
+    exporter->send_batch = batch;
+    return 0;
+}
+
+/*!
+ * \brief Transmit all IPFIX Messages waiting in the send batch.
+ *
+ * This function has no effect if batching has not been enabled with
+ * ipfix_set_send_batch_size().
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \return 0 This value is always returned.
+ * \sa ipfix_set_send_batch_size()
+ */
+int ipfix_flush(ipfix_exporter *exporter) {
+    if (!exporter->send_batch)
+	return 0;
+    for (int i = 0; i < exporter->collector_max_num; i++) {
+	ipfix_receiving_collector *col = exporter->collector_arr[i];
+	if (col->state != C_UNUSED && col->protocol == UDP)
+	    ipfix_flush_collector_batch(exporter, col);
+    }
+    exporter->send_batch->count = 0;
+    exporter->send_batch->used = 0;
+    return 0;
+}
+
+/*
+ * Frees the send batch of an exporter and the batches of its collectors.
+ * Pending messages are discarded.
+ */
+static void ipfix_deinit_send_batch(ipfix_exporter *exporter) {
+    for (int i = 0; i < exporter->collector_max_num; i++) {
+	ipfix_receiving_collector *col = exporter->collector_arr[i];
+	free(col->batch_iov);
+	free(col->batch_headers);
+	col->batch_iov = NULL;
+	col->batch_headers = NULL;
+	col->batch_count = 0;
+    }
+    if (exporter->send_batch) {
+	free(exporter->send_batch->data);
+	free(exporter->send_batch);
+	exporter->send_batch = NULL;
+    }
+}
+
 /* check if the enterprise bit in an ID is set */
 static int ipfix_enterprise_flag_set(uint16_t id)
 {
@@ -95,6 +95,14 @@ See ipfixlolib.h for details on how to use this library.
     Collectors on a regular basis as required by RFC 5101. In addition, all
     Data Sets waiting in the send buffer are transmitted. The length of this
     buffer is reset to zero afterwards.
+    - ipfix_set_send_batch_size() allows to accumulate several IPFIX Messages
+    for UDP Collectors which are then transmitted with a single system call.
+    ipfix_flush() transmits all Messages that are waiting in such a batch.
+    - ipfix_set_collector_send_queue() decouples a UDP or SCTP Collector from
+    the calling thread. Messages for this Collector are put into a bounded
+    queue and transmitted by a sender thread, so that a slow Collector does
+    not delay the others. ipfix_get_send_queue_stats() reports the queue
+    length and the number of dropped Messages.
     - ipfix_remove_collector() can be used at any time to remove a Collector
     that has been previously added with ipfix_add_collector(). This includes
     closing the transport connection.
@@ -113,6 +121,7 @@ See ipfixlolib.h for details on how to use this library.
 #include <time.h>
 #include <unistd.h>
 #include <errno.h>
+#include "common/CompressedFile.h"
 #include <string.h>
 #ifdef SUPPORT_SCTP 
 #include <netinet/sctp.h>
@@ -152,16 +161,16 @@ typedef enum export_protocol_version {
 #define HEADER_USED_IOVEC_COUNT 1
 
 /*
- * maximum number of collectors at a time.
- * can be specified by user
+ * initial number of collector slots;
+ * more slots are allocated when needed
  */
-#define IPFIX_MAX_COLLECTORS 16
+#define IPFIX_INITIAL_COLLECTOR_CAPACITY 16
 
 /*
- * maximum number of templates at a time;
- * can be specified by user
+ * initial number of template slots;
+ * more slots are allocated when needed
  */
-#define IPFIX_MAX_TEMPLATES 16
+#define IPFIX_INITIAL_TEMPLATE_CAPACITY 16
 
 /*
  * Default time, until templates are re-sent again:
@@ -184,10 +193,10 @@ typedef enum export_protocol_version {
 #define IPFIX_DEFAULT_SCTP_DATA_LIFETIME 0
 
 /*
- * maximum number of sets per IPFIX packet
- * TODO: This value is deliberately chosen, adapt it if you need it or make it dynamic.
+ * initial number of set headers stored per IPFIX packet;
+ * the store is enlarged when more sets are added
  */
-#define IPFIX_MAX_SETS_PER_PACKET 128
+#define IPFIX_INITIAL_SETS_PER_PACKET 128
 
 /*
  * maximum size of a sendbuffer
@@ -195,6 +204,19 @@ typedef enum export_protocol_version {
  */
 #define IPFIX_MAX_SENDBUFSIZE (32 * 1024)
 
+/*
+ * maximum number of IPFIX Messages that can be accumulated per UDP collector
+ * before they are transmitted with a single call to sendmmsg()
+ * (see ipfix_set_send_batch_size())
+ */
+#define IPFIX_MAX_SEND_BATCH_SIZE 64
+
+/*
+ * time in milliseconds ipfix_deinit_exporter() waits for the send queues
+ * of the collectors to become empty
+ */
+#define IPFIX_SEND_QUEUE_DRAIN_TIMEOUT 2000
+
 /*
  * maximum size of an IPFIX packet
  */
@@ -386,6 +408,26 @@ typedef struct {
 } nfv9_header;
 
 
+/*
+ * Sidecar index of a DATAFILE file. The index file starts with
+ * IPFIX_DATAFILE_INDEX_MAGIC followed by entries in file order.
+ * A data entry is written for the first Message of each export time second,
+ * a template entry whenever the Templates have changed since the last one
+ * (and for the first Template Message of a file). A reader seeking to a time
+ * replays the last template entry before the data entry it starts at.
+ */
+#define IPFIX_DATAFILE_INDEX_SUFFIX ".idx"
+#define IPFIX_DATAFILE_INDEX_MAGIC "IPFIXID1"
+#define IPFIX_DATAFILE_INDEX_TEMPLATES 0x01
+
+typedef struct {
+	uint32_t export_time; /* export time of the Message, network byte order */
+	uint8_t flags; /* IPFIX_DATAFILE_INDEX_TEMPLATES for Template Messages */
+	uint8_t reserved[3];
+	uint64_t offset; /* offset of the Message in the data file, network byte order */
+} ipfix_datafile_index_entry;
+
+
 /*! \brief The transport protocol used to transmit IPFIX data
  */
 enum ipfix_transport_protocol {
@@ -438,6 +480,26 @@ enum template_state {T_UNUSED, T_UNCLEAN, T_COMMITED, T_SENT, T_WITHDRAWN, T_TOB
  */
 enum collector_state {C_UNUSED, C_NEW, C_DISCONNECTED, C_CONNECTED};
 
+/*
+ * What to do with a new Message if the send queue of a collector is full
+ * (see ipfix_set_collector_send_queue())
+ */
+enum ipfix_queue_overflow_policy {
+	IPFIX_QUEUE_DROP_OLDEST, /* discard the oldest queued Data Message */
+	IPFIX_QUEUE_DROP_NEWEST, /* discard the new Message */
+	IPFIX_QUEUE_BLOCK /* wait until the sender thread made room */
+};
+
+/*
+ * Statistics of the send queue of a collector
+ */
+typedef struct {
+	uint32_t length; /* number of Messages currently queued */
+	uint32_t capacity; /* maximum number of queued Data Messages */
+	uint64_t sent; /* number of Messages transmitted */
+	uint64_t dropped; /* number of Messages discarded */
+} ipfix_send_queue_stats;
+
 
 /*
  * Manages a record set
@@ -450,12 +512,13 @@ typedef struct{
 	/* index of the current set.
 	 * If no set is open, then .set_counter specifies the next free entry
 	 * in .set_header_store */
-	/* The maximum is IPFIX_MAX_SETS_PER_PACKET.
+	/* The maximum is set_header_capacity.
 	 * set_counter serves as an index into set_header_store. */
 	unsigned set_counter;
 
-	/* buffer to store set headers */
-	ipfix_set_header set_header_store[IPFIX_MAX_SETS_PER_PACKET];
+	/* buffer to store set headers, grows if more sets are added */
+	ipfix_set_header *set_header_store;
+	unsigned set_header_capacity;
 
 	/* set length = sum of field length */
 	/* This refers to the current data set only */
@@ -528,6 +591,13 @@ typedef struct {
 	int filenum; /**< for protocol==DATAFILE, this variable contains the current filenumber: 'filename = basename + filenum'*/
 	uint64_t bytes_written; /**< for protocol==DATAFILE, this variable contains the current filesize */
 	uint32_t maxfilesize; /**< for protocol==DATAFILE, this variable contains the maximum filesize given in KiB*/
+	int compression_level; /**< for protocol==DATAFILE, zlib level of the data files, 0 for uncompressed files */
+	compressed_file *cfh; /**< for protocol==DATAFILE, the compression stream writing to fh, NULL if uncompressed */
+	FILE *index_fh; /**< for protocol==DATAFILE, the sidecar index of the current file, NULL if disabled */
+	int write_index; /**< for protocol==DATAFILE, write a sidecar index for every file */
+	int index_entries; /**< for protocol==DATAFILE, number of data entries in the current index */
+	uint32_t index_data_time; /**< for protocol==DATAFILE, export time of the last data entry */
+	uint32_t index_template_version; /**< for protocol==DATAFILE, template_sendbuffer_version of the last template entry, 0 if none */
 	int mtu_mode; /* Either IPFIX_MTU_FIXED or IPFIX_MTU_DISCOVER */
 	uint16_t mtu; /* Maximum transmission unit.
 			 Applies to UDP and DTLS over UDP only. */
@@ -538,6 +608,14 @@ typedef struct {
 	ipfix_collector_dtls_connection dtls_connection;
 #endif
 	char vrf_name[IFNAMSIZ];
+	/* Messages waiting for transmission if batching is enabled.
+	   Applies to UDP only. */
+	unsigned batch_count; /* number of messages in .batch_iov */
+	struct iovec *batch_iov; /* two entries (header and body) per message */
+	char *batch_headers; /* per-message copy of the message header */
+	/* Messages waiting for the sender thread, NULL if messages are
+	   transmitted by the calling thread. Applies to UDP and SCTP only. */
+	struct ipfix_send_queue *send_queue;
 } ipfix_receiving_collector;
 
 /*
@@ -589,7 +667,9 @@ typedef struct {
 	ipfix_sendbuffer *sctp_template_sendbuffer;
 	ipfix_sendbuffer *data_sendbuffer;
 	int collector_max_num; // maximum available collector
-	ipfix_receiving_collector *collector_arr; // array of (collector_max_num) collectors
+	// array of (collector_max_num) pointers to collectors, grows if all are in use.
+	// Collectors do not move as pointers to them are handed to OpenSSL.
+	ipfix_receiving_collector **collector_arr;
 
 	// we also need some timer / counter to indicate,
 	// if we should send the templates too.
@@ -609,7 +689,24 @@ typedef struct {
 	// (0 ==> no reconnection -> destroy collector)
 	uint32_t sctp_reconnect_timer;
 	int ipfix_lo_template_maxsize;
-	ipfix_lo_template *template_arr;
+	ipfix_lo_template *template_arr; // grows if all slots are in use
+	// slot in template_arr for each template ID, only valid if the slot
+	// is in use and holds a template with this ID
+	uint16_t *template_index;
+	// slots of templates whose state has to be processed by the next
+	// update of the template sendbuffers
+	int *template_changes;
+	int template_changes_count;
+	int template_changes_capacity;
+	// set if a template contained in template_sendbuffer has been withdrawn
+	int template_sendbuffer_invalid;
+	// incremented whenever the content of template_sendbuffer changes
+	uint32_t template_sendbuffer_version;
+	// storage for the bodies of batched messages, NULL if batching is disabled
+	struct ipfix_send_batch *send_batch;
+	// thread transmitting the send queues of the collectors, NULL until
+	// the first send queue is set up
+	struct ipfix_sender_thread *sender_thread;
 #ifdef SUPPORT_DTLS
 	ipfix_exporter_certificate certificate;
 #endif
@@ -639,6 +736,10 @@ int ipfix_send(ipfix_exporter *exporter);
 int ipfix_set_template_transmission_timer(ipfix_exporter *exporter, uint32_t timer); 	 
 int ipfix_set_sctp_lifetime(ipfix_exporter *exporter, uint32_t lifetime);
 int ipfix_set_sctp_reconnect_timer(ipfix_exporter *exporter, uint32_t timer);
+int ipfix_set_send_batch_size(ipfix_exporter *exporter, uint16_t batch_size);
+int ipfix_flush(ipfix_exporter *exporter);
+int ipfix_set_collector_send_queue(ipfix_exporter *exporter, const char *coll_ip_addr, uint16_t coll_port, uint32_t queue_length, enum ipfix_queue_overflow_policy policy);
+int ipfix_get_send_queue_stats(ipfix_exporter *exporter, int index, ipfix_send_queue_stats *stats);
 
 #ifdef __cplusplus
 }
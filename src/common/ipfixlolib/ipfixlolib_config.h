@@ -10,4 +10,14 @@ typedef struct {
 		     Applies to UDP and DTLS over UDP only. */
 } ipfix_aux_config_udp;
 
+typedef struct {
+    int write_index; /*!< If non-zero, a sidecar index "<file>.idx" is written
+		       for every data file. See ipfix_datafile_index_entry.
+		       Applies to DATAFILE only. */
+    int compression_level; /*!< If non-zero, data files are compressed with this
+		       zlib level (1-9), see common/CompressedFile.h. Offsets
+		       in the index refer to the uncompressed data.
+		       Applies to DATAFILE only. */
+} ipfix_aux_config_datafile;
+
 #endif
@@ -761,7 +761,7 @@ int ipfix_set_ca_locations(ipfix_exporter_certificate *certificate, const char *
 int ipfix_dtls_advance_connections(ipfix_exporter *exporter) {
     int ret = 0;
     for (int i = 0; i < exporter->collector_max_num; i++) {
-	ipfix_receiving_collector *col = &exporter->collector_arr[i];
+	ipfix_receiving_collector *col = exporter->collector_arr[i];
 	// is the collector a valid target?
 	if (col->state != C_UNUSED) {
 	    if (col->protocol == DTLS_OVER_UDP ||
@@ -9,5 +9,18 @@ int update_collector_mtu(ipfix_exporter *exporter, ipfix_receiving_collector *co
 void ipfix_update_header(ipfix_exporter *p_exporter, ipfix_receiving_collector *collector, ipfix_sendbuffer *sendbuf);
 void set_mtu_config(ipfix_receiving_collector *col, ipfix_aux_config_udp *aux_config_udp);
 void update_exporter_max_message_size(ipfix_exporter *exporter);
+#ifdef SUPPORT_SCTP
+int sctp_sendmsgv(int s, struct iovec *vector, int v_len, struct sockaddr *to,
+		socklen_t tolen, uint32_t ppid, uint32_t flags,
+		uint16_t stream_no, uint32_t timetolive, uint32_t context);
+#endif
+
+/* send queues, see ipfixlolib_queue.c */
+int ipfix_enqueue_message(ipfix_receiving_collector *col, struct iovec *iov, int iovcnt, uint32_t sctp_lifetime, int is_template);
+int ipfix_take_send_queue_error(ipfix_receiving_collector *col);
+void ipfix_detach_send_queue(ipfix_receiving_collector *col);
+void ipfix_deinit_send_queue(ipfix_receiving_collector *col);
+void ipfix_drain_send_queues(ipfix_exporter *exporter);
+void ipfix_deinit_sender_thread(ipfix_exporter *exporter);
 
 #endif
@@ -0,0 +1,611 @@
+/*
+ This file is part of the ipfixlolib.
+ Release under LGPL.
+
+ Send queues which decouple the transmission of IPFIX Messages to UDP and
+ SCTP Collectors from the thread calling ipfix_send().
+
+ Every Collector with a send queue gets its Messages copied into a bounded
+ queue. A single sender thread per exporter waits with epoll() until the
+ sockets of Collectors with queued Messages become writable and transmits
+ the Messages without blocking. A slow Collector therefore only fills its
+ own queue instead of delaying the other Collectors.
+
+ Errors are not handled by the sender thread. It stores the error number
+ and the exporter thread reacts to it (MTU update or SCTP reconnect) the
+ next time ipfix_send() is called.
+ */
+
+#include "ipfixlolib.h"
+#include "ipfixlolib_private.h"
+#include "common/msg.h"
+
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/time.h>
+
+#define SENDER_THREAD_MAX_EVENTS 64
+
+/*
+ * An IPFIX Message (header and body) waiting in a send queue
+ */
+struct ipfix_queued_message {
+	struct ipfix_queued_message *next;
+	uint32_t sctp_lifetime; /* packet lifetime in ms, SCTP only */
+	int is_template; /* Template Messages are never discarded */
+	size_t length;
+	char data[];
+};
+
+struct ipfix_send_queue {
+	struct ipfix_sender_thread *sender;
+	ipfix_receiving_collector *col;
+	pthread_mutex_t lock;
+	pthread_cond_t changed; /* signalled when Messages leave the queue */
+	struct ipfix_queued_message *head;
+	struct ipfix_queued_message *tail;
+	uint32_t length;
+	uint32_t capacity;
+	enum ipfix_queue_overflow_policy policy;
+	int socket; /* socket registered with the sender thread, -1 if detached */
+	int armed; /* socket is watched for EPOLLOUT */
+	int failed; /* transmission stopped because of an error */
+	int error; /* errno to be handled by the exporter thread, 0 if none */
+	uint64_t sent;
+	uint64_t dropped;
+};
+
+struct ipfix_sender_thread {
+	pthread_t thread;
+	int epoll_fd;
+	int wakeup_fd; /* eventfd to interrupt epoll_wait() */
+	pthread_mutex_t lock;
+	pthread_cond_t iteration_done;
+	uint32_t sync_requested;
+	uint32_t sync_completed;
+	int exit;
+};
+
+static void ipfix_wakeup_sender_thread(struct ipfix_sender_thread *sender)
+{
+	uint64_t one = 1;
+	if (write(sender->wakeup_fd, &one, sizeof(one)) != sizeof(one))
+		msg(LOG_ERR, "could not wake up sender thread: %s", strerror(errno));
+}
+
+/*
+ * Waits until the sender thread completed an iteration of its main loop
+ * which started after this function has been called. Afterwards, the sender
+ * thread does not hold any events for sockets removed from its epoll set
+ * before.
+ * Must not be called with the lock of a send queue held.
+ */
+static void ipfix_sync_sender_thread(struct ipfix_sender_thread *sender)
+{
+	pthread_mutex_lock(&sender->lock);
+	uint32_t ticket = ++sender->sync_requested;
+	pthread_mutex_unlock(&sender->lock);
+
+	ipfix_wakeup_sender_thread(sender);
+
+	pthread_mutex_lock(&sender->lock);
+	while ((int32_t)(sender->sync_completed - ticket) < 0)
+		pthread_cond_wait(&sender->iteration_done, &sender->lock);
+	pthread_mutex_unlock(&sender->lock);
+}
+
+/*
+ * Starts or stops watching the socket of a queue for writability.
+ * Must be called with the lock of the queue held.
+ */
+static void ipfix_arm_send_queue(struct ipfix_send_queue *q, int arm)
+{
+	if (q->armed == arm || q->socket < 0)
+		return;
+	if (arm) {
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLOUT;
+		ev.data.ptr = q;
+		if (epoll_ctl(q->sender->epoll_fd, EPOLL_CTL_ADD, q->socket, &ev) == -1) {
+			msg(LOG_ERR, "could not watch socket of collector %s:%d: %s",
+					q->col->ipaddress, q->col->port_number, strerror(errno));
+			return;
+		}
+	} else {
+		epoll_ctl(q->sender->epoll_fd, EPOLL_CTL_DEL, q->socket, NULL);
+	}
+	q->armed = arm;
+}
+
+/*
+ * Removes the first Message from a queue.
+ * Must be called with the lock of the queue held.
+ */
+static void ipfix_pop_message(struct ipfix_send_queue *q)
+{
+	struct ipfix_queued_message *m = q->head;
+	q->head = m->next;
+	if (!q->head)
+		q->tail = NULL;
+	q->length--;
+	free(m);
+}
+
+/*
+ * Transmits a single Message without blocking.
+ * Returns the result of sendmsg().
+ */
+static ssize_t ipfix_transmit_message(struct ipfix_send_queue *q, struct ipfix_queued_message *m)
+{
+	ipfix_receiving_collector *col = q->col;
+	struct iovec iov;
+	iov.iov_base = m->data;
+	iov.iov_len = m->length;
+
+#ifdef SUPPORT_SCTP
+	if (col->protocol == SCTP) {
+		/* SCTP sockets are non-blocking */
+		return sctp_sendmsgv(q->socket, &iov, 1,
+				(struct sockaddr*)&(col->addr), sizeof(col->addr),
+				0, 0, // payload protocol identifier, flags
+				0, // Stream Number
+				m->sctp_lifetime,
+				0 // context
+				);
+	}
+#endif
+	struct msghdr header;
+	memset(&header, 0, sizeof(header));
+	header.msg_name = &col->addr;
+	header.msg_namelen = sizeof(col->addr);
+	header.msg_iov = &iov;
+	header.msg_iovlen = 1;
+	return sendmsg(q->socket, &header, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/*
+ * Transmits queued Messages until the queue is empty or the socket would
+ * block. Called by the sender thread.
+ */
+static void ipfix_drain_send_queue(struct ipfix_send_queue *q)
+{
+	pthread_mutex_lock(&q->lock);
+	/* the queue might have been detached after epoll_wait() returned */
+	if (q->socket < 0 || q->failed) {
+		pthread_mutex_unlock(&q->lock);
+		return;
+	}
+	while (q->head) {
+		if (ipfix_transmit_message(q, q->head) == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+				break;
+			msg(LOG_ERR, "could not send to %s:%d errno: %s  (queued)",
+					q->col->ipaddress, q->col->port_number, strerror(errno));
+			q->error = errno;
+			if (q->col->protocol != UDP) {
+				/* the exporter thread reconnects */
+				q->failed = 1;
+				break;
+			}
+			/* drop the message that could not be sent */
+			q->dropped++;
+		} else {
+			q->sent++;
+		}
+		ipfix_pop_message(q);
+	}
+	if (!q->head || q->failed)
+		ipfix_arm_send_queue(q, 0);
+	pthread_cond_broadcast(&q->changed);
+	pthread_mutex_unlock(&q->lock);
+}
+
+static void *ipfix_sender_thread_main(void *arg)
+{
+	struct ipfix_sender_thread *sender = (struct ipfix_sender_thread *)arg;
+	struct epoll_event events[SENDER_THREAD_MAX_EVENTS];
+
+	while (1) {
+		pthread_mutex_lock(&sender->lock);
+		int exit = sender->exit;
+		pthread_mutex_unlock(&sender->lock);
+		if (exit)
+			break;
+
+		int n = epoll_wait(sender->epoll_fd, events, SENDER_THREAD_MAX_EVENTS, -1);
+		if (n == -1 && errno != EINTR) {
+			msg(LOG_ERR, "epoll_wait() failed in sender thread: %s", strerror(errno));
+			break;
+		}
+		for (int i = 0; i < n; i++) {
+			if (events[i].data.ptr == NULL) {
+				uint64_t value;
+				if (read(sender->wakeup_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+					msg(LOG_ERR, "could not read from wakeup eventfd: %s", strerror(errno));
+			} else {
+				ipfix_drain_send_queue((struct ipfix_send_queue *)events[i].data.ptr);
+			}
+		}
+
+		/* All events of this iteration have been processed. Events of the
+		   next iteration are collected after all sync requests issued so
+		   far. */
+		pthread_mutex_lock(&sender->lock);
+		sender->sync_completed = sender->sync_requested;
+		pthread_cond_broadcast(&sender->iteration_done);
+		pthread_mutex_unlock(&sender->lock);
+	}
+
+	/* wake up everyone who is waiting for an iteration */
+	pthread_mutex_lock(&sender->lock);
+	sender->sync_completed = sender->sync_requested;
+	pthread_cond_broadcast(&sender->iteration_done);
+	pthread_mutex_unlock(&sender->lock);
+	return NULL;
+}
+
+static int ipfix_init_sender_thread(ipfix_exporter *exporter)
+{
+	struct ipfix_sender_thread *sender;
+	struct epoll_event ev;
+
+	if (exporter->sender_thread)
+		return 0;
+
+	sender = (struct ipfix_sender_thread *)malloc(sizeof(struct ipfix_sender_thread));
+	if (!sender) {
+		msg(LOG_ERR, "could not allocate sender thread");
+		return -1;
+	}
+	sender->sync_requested = 0;
+	sender->sync_completed = 0;
+	sender->exit = 0;
+	sender->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	sender->wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (sender->epoll_fd == -1 || sender->wakeup_fd == -1) {
+		msg(LOG_ERR, "could not create epoll instance for sender thread: %s", strerror(errno));
+		goto out;
+	}
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl(sender->epoll_fd, EPOLL_CTL_ADD, sender->wakeup_fd, &ev) == -1) {
+		msg(LOG_ERR, "could not watch wakeup eventfd: %s", strerror(errno));
+		goto out;
+	}
+	pthread_mutex_init(&sender->lock, NULL);
+	pthread_cond_init(&sender->iteration_done, NULL);
+	if (pthread_create(&sender->thread, NULL, ipfix_sender_thread_main, sender) != 0) {
+		msg(LOG_ERR, "could not create sender thread");
+		pthread_cond_destroy(&sender->iteration_done);
+		pthread_mutex_destroy(&sender->lock);
+		goto out;
+	}
+	exporter->sender_thread = sender;
+	return 0;
+
+out:
+	if (sender->epoll_fd != -1)
+		close(sender->epoll_fd);
+	if (sender->wakeup_fd != -1)
+		close(sender->wakeup_fd);
+	free(sender);
+	return -1;
+}
+
+/*
+ * Stops the sender thread. All send queues must have been deinitialized before.
+ */
+void ipfix_deinit_sender_thread(ipfix_exporter *exporter)
+{
+	struct ipfix_sender_thread *sender = exporter->sender_thread;
+	if (!sender)
+		return;
+
+	pthread_mutex_lock(&sender->lock);
+	sender->exit = 1;
+	pthread_mutex_unlock(&sender->lock);
+	ipfix_wakeup_sender_thread(sender);
+	pthread_join(sender->thread, NULL);
+
+	close(sender->epoll_fd);
+	close(sender->wakeup_fd);
+	pthread_cond_destroy(&sender->iteration_done);
+	pthread_mutex_destroy(&sender->lock);
+	free(sender);
+	exporter->sender_thread = NULL;
+}
+
+/*
+ * Appends a copy of an IPFIX Message to the send queue of a collector.
+ * The collector must be in state C_CONNECTED. If the queue is full, the
+ * overflow policy of the queue is applied. Template Messages are always
+ * added, regardless of the length of the queue.
+ * Returns 0 if the Message has been queued, -1 if it has been dropped.
+ */
+int ipfix_enqueue_message(ipfix_receiving_collector *col, struct iovec *iov, int iovcnt, uint32_t sctp_lifetime, int is_template)
+{
+	struct ipfix_send_queue *q = col->send_queue;
+	struct ipfix_queued_message *m;
+	size_t length = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		length += iov[i].iov_len;
+
+	pthread_mutex_lock(&q->lock);
+	if (!is_template) {
+		if (q->policy == IPFIX_QUEUE_BLOCK) {
+			while (q->length >= q->capacity && q->socket >= 0 && !q->failed)
+				pthread_cond_wait(&q->changed, &q->lock);
+		}
+		if (q->length >= q->capacity) {
+			struct ipfix_queued_message *prev = NULL;
+			if (q->policy == IPFIX_QUEUE_DROP_OLDEST) {
+				/* find the oldest Data Message */
+				for (m = q->head; m && m->is_template; m = m->next)
+					prev = m;
+			} else {
+				m = NULL;
+			}
+			if (!m) {
+				q->dropped++;
+				pthread_mutex_unlock(&q->lock);
+				return -1;
+			}
+			if (prev) {
+				prev->next = m->next;
+				if (q->tail == m)
+					q->tail = prev;
+				q->length--;
+				free(m);
+			} else {
+				ipfix_pop_message(q);
+			}
+			q->dropped++;
+		}
+	}
+	pthread_mutex_unlock(&q->lock);
+
+	/* copy the message without holding the lock */
+	m = (struct ipfix_queued_message *)malloc(sizeof(struct ipfix_queued_message) + length);
+	if (!m) {
+		msg(LOG_ERR, "could not allocate message for send queue");
+		pthread_mutex_lock(&q->lock);
+		q->dropped++;
+		pthread_mutex_unlock(&q->lock);
+		return -1;
+	}
+	m->next = NULL;
+	m->sctp_lifetime = sctp_lifetime;
+	m->is_template = is_template;
+	m->length = length;
+	length = 0;
+	for (i = 0; i < iovcnt; i++) {
+		memcpy(m->data + length, iov[i].iov_base, iov[i].iov_len);
+		length += iov[i].iov_len;
+	}
+
+	pthread_mutex_lock(&q->lock);
+	if (q->tail)
+		q->tail->next = m;
+	else
+		q->head = m;
+	q->tail = m;
+	q->length++;
+	if (q->socket < 0) {
+		/* (re)connected since the queue has been detached */
+		q->socket = col->data_socket;
+		q->failed = 0;
+	}
+	if (!q->failed)
+		ipfix_arm_send_queue(q, 1);
+	pthread_mutex_unlock(&q->lock);
+	return 0;
+}
+
+/*
+ * Returns the error which stopped or disturbed the transmission of the
+ * send queue of a collector and resets it. Returns 0 if there was none.
+ */
+int ipfix_take_send_queue_error(ipfix_receiving_collector *col)
+{
+	struct ipfix_send_queue *q = col->send_queue;
+	int error;
+
+	pthread_mutex_lock(&q->lock);
+	error = q->error;
+	q->error = 0;
+	pthread_mutex_unlock(&q->lock);
+	return error;
+}
+
+/*
+ * Unregisters the socket of a collector from the sender thread and discards
+ * all queued Messages. Must be called before the socket is closed.
+ * The queue is attached to the current socket of the collector again when
+ * the next Message is queued.
+ */
+void ipfix_detach_send_queue(ipfix_receiving_collector *col)
+{
+	struct ipfix_send_queue *q = col->send_queue;
+	if (!q)
+		return;
+
+	pthread_mutex_lock(&q->lock);
+	if (q->socket < 0) {
+		pthread_mutex_unlock(&q->lock);
+		return;
+	}
+	ipfix_arm_send_queue(q, 0);
+	q->socket = -1;
+	while (q->head) {
+		ipfix_pop_message(q);
+		q->dropped++;
+	}
+	pthread_cond_broadcast(&q->changed);
+	pthread_mutex_unlock(&q->lock);
+
+	/* the sender thread might still process an event for the old socket */
+	ipfix_sync_sender_thread(q->sender);
+}
+
+/*
+ * Detaches and frees the send queue of a collector.
+ */
+void ipfix_deinit_send_queue(ipfix_receiving_collector *col)
+{
+	struct ipfix_send_queue *q = col->send_queue;
+	if (!q)
+		return;
+
+	ipfix_detach_send_queue(col);
+	col->send_queue = NULL;
+	pthread_cond_destroy(&q->changed);
+	pthread_mutex_destroy(&q->lock);
+	free(q);
+}
+
+/*
+ * Waits up to IPFIX_SEND_QUEUE_DRAIN_TIMEOUT milliseconds until the sender
+ * thread transmitted the Messages waiting in the send queues.
+ */
+void ipfix_drain_send_queues(ipfix_exporter *exporter)
+{
+	struct timeval now;
+	struct timespec deadline;
+
+	if (!exporter->sender_thread)
+		return;
+
+	gettimeofday(&now, NULL);
+	deadline.tv_sec = now.tv_sec + IPFIX_SEND_QUEUE_DRAIN_TIMEOUT / 1000;
+	deadline.tv_nsec = now.tv_usec * 1000 + (IPFIX_SEND_QUEUE_DRAIN_TIMEOUT % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	for (int i = 0; i < exporter->collector_max_num; i++) {
+		struct ipfix_send_queue *q = exporter->collector_arr[i]->send_queue;
+		if (exporter->collector_arr[i]->state == C_UNUSED || !q)
+			continue;
+		pthread_mutex_lock(&q->lock);
+		while (q->head && q->socket >= 0 && !q->failed) {
+			if (pthread_cond_timedwait(&q->changed, &q->lock, &deadline) == ETIMEDOUT) {
+				msg(LOG_ERR, "discarding %u queued messages for collector %s:%d",
+						q->length, q->col->ipaddress, q->col->port_number);
+				break;
+			}
+		}
+		pthread_mutex_unlock(&q->lock);
+	}
+}
+
+/*!
+ * \brief Transmit the Messages for a Collector from a separate thread.
+ *
+ * IPFIX Messages for the given Collector are copied into a queue which can
+ * hold up to <tt>queue_length</tt> Data Messages. A sender thread, which is
+ * shared by all Collectors of the exporter, transmits the queued Messages as
+ * soon as the socket is writable. Hence, ipfix_send() does not wait for a
+ * slow Collector. Template Messages are always queued.
+ *
+ * Send queues are available for UDP and SCTP Collectors. Messages that are
+ * still queued when ipfix_deinit_exporter() is called are transmitted
+ * for up to IPFIX_SEND_QUEUE_DRAIN_TIMEOUT milliseconds.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \param coll_ip_addr IP address of the Collector as passed to ipfix_add_collector()
+ * \param coll_port port number of the Collector
+ * \param queue_length maximum number of queued Data Messages, 0 transmits
+ * Messages from the calling thread again
+ * \param policy what to do with a Data Message if the queue is full
+ * \return 0 success
+ * \return -1 failure. Reasons include:<ul><li>Collector not found</li><li>transport protocol not supported</li><li>sender thread could not be started</li></ul>
+ * \sa ipfix_get_send_queue_stats()
+ */
+int ipfix_set_collector_send_queue(ipfix_exporter *exporter, const char *coll_ip_addr,
+	uint16_t coll_port, uint32_t queue_length, enum ipfix_queue_overflow_policy policy)
+{
+	ipfix_receiving_collector *col = NULL;
+
+	for (int i = 0; i < exporter->collector_max_num; i++) {
+		ipfix_receiving_collector *c = exporter->collector_arr[i];
+		if (c->state != C_UNUSED && strcmp(c->ipaddress, coll_ip_addr) == 0 &&
+				c->port_number == coll_port) {
+			col = c;
+			break;
+		}
+	}
+	if (!col) {
+		msg(LOG_ERR, "set_collector_send_queue: collector %s:%d not found", coll_ip_addr, coll_port);
+		return -1;
+	}
+	if (col->protocol != UDP && col->protocol != SCTP) {
+		msg(LOG_ERR, "send queues are only supported for UDP and SCTP collectors");
+		return -1;
+	}
+
+	ipfix_deinit_send_queue(col);
+	if (queue_length == 0)
+		return 0;
+
+	if (ipfix_init_sender_thread(exporter))
+		return -1;
+
+	struct ipfix_send_queue *q = (struct ipfix_send_queue *)malloc(sizeof(struct ipfix_send_queue));
+	if (!q) {
+		msg(LOG_ERR, "could not allocate send queue");
+		return -1;
+	}
+	q->sender = exporter->sender_thread;
+	q->col = col;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->changed, NULL);
+	q->head = q->tail = NULL;
+	q->length = 0;
+	q->capacity = queue_length;
+	q->policy = policy;
+	q->socket = -1;
+	q->armed = 0;
+	q->failed = 0;
+	q->error = 0;
+	q->sent = 0;
+	q->dropped = 0;
+	col->send_queue = q;
+	return 0;
+}
+
+/*!
+ * \brief Query the statistics of the send queue of a Collector.
+ *
+ * The caller has to serialise this with all other calls on the exporter,
+ * which may reallocate the Collector array or free the send queue.
+ *
+ * \param exporter pointer to previously initialized exporter struct
+ * \param index index of the Collector, 0 <= index < exporter->collector_max_num
+ * \param stats filled with the statistics of the send queue
+ * \return 0 success
+ * \return -1 the Collector is not in use or has no send queue
+ * \sa ipfix_set_collector_send_queue()
+ */
+int ipfix_get_send_queue_stats(ipfix_exporter *exporter, int index, ipfix_send_queue_stats *stats)
+{
+	if (index < 0 || index >= exporter->collector_max_num)
+		return -1;
+	ipfix_receiving_collector *col = exporter->collector_arr[index];
+	struct ipfix_send_queue *q = col->send_queue;
+	if (col->state == C_UNUSED || !q)
+		return -1;
+
+	pthread_mutex_lock(&q->lock);
+	stats->length = q->length;
+	stats->capacity = q->capacity;
+	stats->sent = q->sent;
+	stats->dropped = q->dropped;
+	pthread_mutex_unlock(&q->lock);
+	return 0;
+}
@@ -358,8 +358,9 @@ public:
 		//Gerhard: postReconfiguration() is now called in Module::start()
 		//this->postReconfiguration();
 
-		// check if we need a splitter
-		if (this->getNext().size() > 1) {
+		// check if we need a splitter, modules which are splitters distribute elements themselves
+		if (this->getNext().size() > 1 &&
+				!dynamic_cast<ConnectionSplitter<typename InstanceType::src_value_type>*>(instance)) {
 			if (!splitter) {
 				splitter = new ConnectionSplitter<typename InstanceType::src_value_type>();
 				instance->connectTo(splitter);
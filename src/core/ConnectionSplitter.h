@@ -72,7 +72,7 @@ public:
 		}
 	}
 
-private:
+protected:
 	inline void process(T packet)
 	{
 		if (!Source<T>::sleepUntilConnected()) {
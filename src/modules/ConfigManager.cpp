@@ -29,6 +29,8 @@
 #include "modules/packet/ObserverCfg.h"
 #include "modules/packet/PSAMPExporterCfg.h"
 #include "modules/packet/PCAPExporterFileCfg.h"
+#include "modules/packet/PacketRingCfg.h"
+#include "modules/packet/PacketHashSplitterCfg.h"
 #include "modules/packet/PCAPExporterPipeCfg.h"
 #include "modules/packet/filter/PacketFilterCfg.h"
 #include "modules/ipfix/FpaPcapExporterCfg.h"
@@ -42,6 +44,7 @@
 #include "modules/ipfix/IpfixPayloadWriterCfg.h"
 #include "modules/ipfix/IpfixSamplerCfg.h"
 #include "modules/ipfix/IpfixCsExporterCfg.hpp"
+#include "modules/ipfix/IpfixColumnWriterCfg.hpp"
 #include "modules/ipfix/NetflowV9ConverterCfg.hpp"
 #include "modules/ipfix/aggregator/IpfixAggregatorCfg.h"
 #include "modules/ipfix/aggregator/PacketAggregatorCfg.h"
@@ -61,6 +64,7 @@
 #include "modules/analysis/HostStatisticsCfg.h"
 
 #include <cassert>
+#include <map>
 
 // we create a static array of all root config entrys so that we don't
 // need to hardcode the config entry name in here. Instead, we just ask the
@@ -70,6 +74,8 @@ Cfg* ConfigManager::configModules[] = {
 	new PacketFilterCfg(NULL),
 	new PacketQueueCfg(NULL),
 	new PCAPExporterFileCfg(NULL),
+	new PacketRingCfg(NULL),
+	new PacketHashSplitterCfg(NULL),
 	new PCAPExporterPipeCfg(NULL),
 	new PSAMPExporterCfg(NULL),
 	new FpaPcapExporterCfg(NULL),
@@ -96,6 +102,7 @@ Cfg* ConfigManager::configModules[] = {
 	new P2PDetectorCfg(NULL),
 	new HostStatisticsCfg(NULL),
 	new IpfixCsExporterCfg(NULL),
+	new IpfixColumnWriterCfg(NULL),
 #if defined(DB_SUPPORT_ENABLED) || defined(PG_SUPPORT_ENABLED) || defined(ORACLE_SUPPORT_ENABLED)
 	new IpfixDbWriterCfg(NULL),
 	new IpfixDbReaderCfg(NULL),
@@ -194,6 +201,8 @@ void ConfigManager::parseConfig(std::string fileName)
 		}
 	}
 
+	deriveCaptureFilters(graph);
+
 	if (!oldGraph) { // this is the first config we have read
 		Connector connector;
 		graph->accept(&connector);
@@ -221,6 +230,56 @@ void ConfigManager::parseConfig(std::string fileName)
 
 }
 
+/**
+ * lets every observer whose packets all go to a packet filter, optionally
+ * through packet queues, evaluate the leading header filters of that filter
+ * in its pcap filter. Observers in two-stage capture mode take these filters
+ * over if no other module sends packets into the path, so they are evaluated
+ * before the payload of a packet is copied.
+ */
+void ConfigManager::deriveCaptureFilters(Graph* g)
+{
+	const std::vector<CfgNode*>& nodes = g->getNodes();
+	std::map<unsigned int, Cfg*> id2cfg;
+	std::map<unsigned int, unsigned int> sources; // the graph is not connected yet
+	for (size_t i = 0; i < nodes.size(); i++) {
+		id2cfg[nodes[i]->getCfg()->getID()] = nodes[i]->getCfg();
+		std::vector<unsigned int> nexts = nodes[i]->getCfg()->getNext();
+		for (size_t k = 0; k < nexts.size(); k++)
+			sources[nexts[k]]++;
+	}
+
+	for (size_t i = 0; i < nodes.size(); i++) {
+		ObserverCfg* observer = dynamic_cast<ObserverCfg*>(nodes[i]->getCfg());
+		if (!observer)
+			continue;
+
+		Cfg* next = observer;
+		bool exclusive = true;
+		for (size_t hops = 0; next && hops < nodes.size(); hops++) {
+			std::vector<unsigned int> nexts = next->getNext();
+			next = (nexts.size() == 1 && id2cfg.count(nexts[0])) ? id2cfg[nexts[0]] : NULL;
+			if (!next)
+				break;
+			exclusive = exclusive && sources[next->getID()] == 1;
+			if (!dynamic_cast<PacketQueueCfg*>(next))
+				break;
+		}
+
+		PacketFilterCfg* filter = dynamic_cast<PacketFilterCfg*>(next);
+		if (!filter)
+			continue;
+		observer->setDerivedFilter(filter->getCaptureFilter());
+		if (observer->isTwoStageCapture()) {
+			if (exclusive) {
+				observer->setHeaderStage(filter->takeHeaderStage());
+			} else {
+				msg(LOG_ERR, "Observer: two-stage capture is disabled, filter %u also receives packets of other modules", filter->getID());
+			}
+		}
+	}
+}
+
 void ConfigManager::shutdown()
 {
 	lockGraph();
@@ -65,6 +65,7 @@ private:
 	SensorManager* sensorManager;
 	
 	void readGlobalConfig(XMLElement* e);
+	void deriveCaptureFilters(Graph* g);
 	std::list<deleter_list_item> deleter_list;
 };
 
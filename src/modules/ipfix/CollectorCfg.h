@@ -50,7 +50,9 @@ public:
 	CollectorCfg(XMLElement* elem, unsigned int moduleId)
 		: vrfName(""),
 		  protocol(UDP), port(0), mtu(0), buffer(0), moduleId(moduleId),
-		  zmqHighWaterMark(0), zmqPollTimeout(ZMQ_POLL_TIMEOUT_DEFAULT)
+		  zmqHighWaterMark(0), zmqPollTimeout(ZMQ_POLL_TIMEOUT_DEFAULT),
+		  sendQueueLength(0), sendQueuePolicy(IPFIX_QUEUE_DROP_OLDEST),
+		  workerThreads(1)
 	{
 		uint16_t defaultPort = 4739;
 		if (!elem)
@@ -116,6 +118,22 @@ public:
 				zmqHighWaterMark = atoi(e->getContent().c_str());
 			} else if (e->matches("zmqPollTimeout")) {
 				zmqPollTimeout = atoi(e->getContent().c_str());
+			} else if (e->matches("sendQueueLength")) {
+				sendQueueLength = (uint32_t)atoi(e->getContent().c_str());
+			} else if (e->matches("sendQueuePolicy")) {
+				std::string policy = e->getContent();
+				if (policy == "dropOldest")
+					sendQueuePolicy = IPFIX_QUEUE_DROP_OLDEST;
+				else if (policy == "dropNewest")
+					sendQueuePolicy = IPFIX_QUEUE_DROP_NEWEST;
+				else if (policy == "block")
+					sendQueuePolicy = IPFIX_QUEUE_BLOCK;
+				else
+					THROWEXCEPTION("Invalid configuration parameter for sendQueuePolicy (%s)", policy.c_str());
+			} else if (e->matches("workerThreads")) {
+				workerThreads = (unsigned int)atoi(e->getContent().c_str());
+				if (workerThreads == 0)
+					THROWEXCEPTION("Invalid configuration parameter for workerThreads (%u)", workerThreads);
 			} else {
 				msg(LOG_CRIT, "Unknown collector config statement %s", e->getName().c_str());
 				continue;
@@ -139,7 +157,7 @@ public:
 			const std::string &caPath) {
 		IpfixReceiver* ipfixReceiver = NULL;
 		if (protocol == SCTP)
-			ipfixReceiver = new IpfixReceiverSctpIpV4(port, ipAddress, buffer);
+			ipfixReceiver = new IpfixReceiverSctpIpV4(port, ipAddress, buffer, workerThreads);
 		else if (protocol == DTLS_OVER_UDP)
 			ipfixReceiver = new IpfixReceiverDtlsUdpIpV4(port,
 				ipAddress, certificateChainFile,
@@ -149,7 +167,7 @@ public:
 				ipAddress, certificateChainFile,
 				privateKeyFile, caFile, caPath, peerFqdns, buffer);
 		else if (protocol == TCP)
-			ipfixReceiver = new IpfixReceiverTcpIpV4(port, ipAddress, buffer);
+			ipfixReceiver = new IpfixReceiverTcpIpV4(port, ipAddress, buffer, moduleId, workerThreads);
 		else if (protocol == UDP)
 			ipfixReceiver = new IpfixReceiverUdpIpV4(port, ipAddress, buffer);
 #ifdef ZMQ_SUPPORT_ENABLED
@@ -184,7 +202,10 @@ public:
 			(zmqHighWaterMark == other->zmqHighWaterMark) &&
 			(zmqPollTimeout == other->zmqPollTimeout) &&
 			(zmqEndpoints == other->zmqEndpoints) &&
-			(zmqPubSubChannels == other->zmqPubSubChannels)) {
+			(zmqPubSubChannels == other->zmqPubSubChannels) &&
+			(sendQueueLength == other->sendQueueLength) &&
+			(sendQueuePolicy == other->sendQueuePolicy) &&
+			(workerThreads == other->workerThreads)) {
 			return true;
 		}
 
@@ -198,6 +219,9 @@ public:
 	uint16_t getPort() { return port; }
 	uint16_t getMtu() { return mtu; }
 	unsigned int getModuleId() {return moduleId; }
+	uint32_t getSendQueueLength() { return sendQueueLength; }
+	ipfix_queue_overflow_policy getSendQueuePolicy() { return sendQueuePolicy; }
+	unsigned int getWorkerThreads() { return workerThreads; }
 
 private:
 	std::string ipAddress;
@@ -213,6 +237,9 @@ private:
 	unsigned int moduleId;
 	int zmqHighWaterMark;
 	int zmqPollTimeout;
+	uint32_t sendQueueLength;
+	ipfix_queue_overflow_policy sendQueuePolicy;
+	unsigned int workerThreads;
 };
 
 #endif /*COLLECTORCFG_H_*/
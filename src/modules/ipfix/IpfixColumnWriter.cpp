@@ -0,0 +1,518 @@
+/*
+ * IPFIX Columnar Archive Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "IpfixColumnWriter.hpp"
+#include "common/ipfixlolib/ipfix_names.h"
+#include "common/Time.h"
+#include "core/Timer.h"
+#include <sys/stat.h>
+#include <string.h>
+#include <sstream>
+#ifdef ZLIB_SUPPORT_ENABLED
+#include <zlib.h>
+#endif
+
+/* interval of the timer which flushes old row groups, in milliseconds */
+#define COLUMN_TIMEOUT_INTERVAL 1000
+#define COLUMN_FILE_BUFFER_SIZE (1024*1024)
+
+static const char COLUMN_FILE_MAGIC[8] = { 'V', 'E', 'R', 'M', 'C', 'O', 'L', '1' };
+static const char COLUMN_ROWGROUP_MAGIC[4] = { 'V', 'C', 'R', 'G' };
+static const char COLUMN_FOOTER_MAGIC[4] = { 'V', 'C', 'F', 'T' };
+
+static void appendUint8(std::vector<uint8_t>& buf, uint8_t v)
+{
+	buf.push_back(v);
+}
+
+static void appendUint16(std::vector<uint8_t>& buf, uint16_t v)
+{
+	v = htons(v);
+	buf.insert(buf.end(), (uint8_t*)&v, (uint8_t*)&v + sizeof(v));
+}
+
+static void appendUint32(std::vector<uint8_t>& buf, uint32_t v)
+{
+	v = htonl(v);
+	buf.insert(buf.end(), (uint8_t*)&v, (uint8_t*)&v + sizeof(v));
+}
+
+static void appendUint64(std::vector<uint8_t>& buf, uint64_t v)
+{
+	v = htonll(v);
+	buf.insert(buf.end(), (uint8_t*)&v, (uint8_t*)&v + sizeof(v));
+}
+
+/**
+ * returns true if the network byte order encoding of the data type sorts like its values
+ */
+static bool hasOrderedEncoding(const InformationElement::IeInfo& type)
+{
+	const struct ipfix_identifier* ident = ipfix_id_lookup(type.id, type.enterprise);
+	if (ident == NULL)
+		return false;
+
+	switch (ident->type) {
+		case IPFIX_TYPE_unsigned8:
+		case IPFIX_TYPE_unsigned16:
+		case IPFIX_TYPE_unsigned32:
+		case IPFIX_TYPE_unsigned64:
+		case IPFIX_TYPE_boolean:
+		case IPFIX_TYPE_macAddress:
+		case IPFIX_TYPE_dateTimeSeconds:
+		case IPFIX_TYPE_dateTimeMilliseconds:
+		case IPFIX_TYPE_dateTimeMicroseconds:
+		case IPFIX_TYPE_dateTimeNanoseconds:
+		case IPFIX_TYPE_ipv4Address:
+		case IPFIX_TYPE_ipv6Address:
+			return true;
+		default:
+			return false;
+	}
+}
+
+IpfixColumnWriter::IpfixColumnWriter(const std::string& destinationPath, const std::string& filenamePrefix,
+		uint32_t partitionInterval, uint32_t maxRowGroupRecords, uint32_t maxBufferTime,
+		Codec codec, int compressionLevel)
+	: destinationPath(destinationPath),
+	  filenamePrefix(filenamePrefix),
+	  partitionInterval((uint64_t)partitionInterval*1000),
+	  maxRowGroupRecords(maxRowGroupRecords),
+	  maxBufferTime(maxBufferTime),
+	  codec(codec),
+	  compressionLevel(compressionLevel),
+	  timeoutRegistered(false),
+	  statRecords(0),
+	  statRowGroups(0),
+	  statRawBytes(0),
+	  statStoredBytes(0),
+	  statFiles(0)
+{
+	if (!this->destinationPath.empty() && this->destinationPath[this->destinationPath.size()-1] != '/')
+		this->destinationPath += "/";
+
+	msg(LOG_NOTICE, "IpfixColumnWriter initialized with the following parameters");
+	msg(LOG_NOTICE, "  - destinationPath = %s", this->destinationPath.c_str());
+	msg(LOG_NOTICE, "  - filenamePrefix = %s", filenamePrefix.c_str());
+	msg(LOG_NOTICE, "  - partitionInterval = %u seconds", partitionInterval);
+	msg(LOG_NOTICE, "  - maxRowGroupRecords = %u", maxRowGroupRecords);
+	msg(LOG_NOTICE, "  - maxBufferTime = %u seconds", maxBufferTime);
+	msg(LOG_NOTICE, "  - compression = %s", codec == CodecZlib ? "zlib" : "none");
+}
+
+IpfixColumnWriter::~IpfixColumnWriter()
+{
+	for (std::map<uint64_t, Partition*>::iterator it = partitions.begin(); it != partitions.end(); it++) {
+		Partition* p = it->second;
+		for (std::map<uint16_t, RowGroup*>::iterator rit = p->rowGroups.begin(); rit != p->rowGroups.end(); rit++)
+			delete rit->second;
+		if (p->file)
+			fclose(p->file);
+		delete p;
+	}
+}
+
+/**
+ * returns the flow start time of a record in milliseconds, or the current time if the
+ * Template does not contain one
+ */
+uint64_t IpfixColumnWriter::getRecordTime(IpfixDataRecord* record)
+{
+	uint64_t time;
+	TemplateInfo::FieldInfo* fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_flowStartMilliseconds, 0);
+	if (fi != 0 && fi->type.length == 8)
+		return ntohll(*(uint64_t*)(record->data + fi->offset));
+
+	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_flowStartSeconds, 0);
+	if (fi != 0 && fi->type.length == 4)
+		return (uint64_t)ntohl(*(uint32_t*)(record->data + fi->offset))*1000;
+
+	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_flowStartNanoseconds, 0);
+	if (fi != 0 && fi->type.length == 8) {
+		convertNtp64(*(uint64_t*)(record->data + fi->offset), time);
+		return time;
+	}
+
+	struct timeval now;
+	gettimeofday(&now, 0);
+	return (uint64_t)now.tv_sec*1000 + now.tv_usec/1000;
+}
+
+/**
+ * returns the partition for the given flow time and opens it if necessary.
+ * Records older than all open partitions are added to the oldest one, so
+ * files are never reopened. Opening a new partition closes those which are
+ * more than one interval older.
+ */
+IpfixColumnWriter::Partition* IpfixColumnWriter::getPartition(uint64_t time)
+{
+	uint64_t start = time - time % partitionInterval;
+
+	std::map<uint64_t, Partition*>::iterator it = partitions.find(start);
+	if (it != partitions.end())
+		return it->second;
+	if (!partitions.empty() && start < partitions.begin()->first)
+		return partitions.begin()->second;
+
+	Partition* p = new Partition();
+	p->start = start;
+	p->file = NULL;
+	p->offset = 0;
+	p->lastRecord = ::time(0);
+	openPartition(p);
+	partitions[start] = p;
+
+	while (partitions.begin()->first + partitionInterval < start) {
+		closePartition(partitions.begin()->second);
+		partitions.erase(partitions.begin());
+	}
+	return p;
+}
+
+/**
+ * creates the file of a partition under a temporary name and writes the file header
+ */
+void IpfixColumnWriter::openPartition(Partition* p)
+{
+	time_t start = p->start/1000;
+	struct tm st;
+	gmtime_r(&start, &st);
+
+	char name[512];
+	snprintf(name, ARRAY_SIZE(name), "%s%04d%02d%02d-%02d%02d%02d",
+			filenamePrefix.c_str(), st.tm_year+1900, st.tm_mon+1, st.tm_mday,
+			st.tm_hour, st.tm_min, st.tm_sec);
+
+	// a partition may be written again after a restart, do not overwrite older files
+	struct stat sta;
+	std::string filename = destinationPath + name + ".vcol";
+	std::string tmpname = destinationPath + "._" + name + ".vcol.part";
+	for (uint32_t i = 1; stat(filename.c_str(), &sta) == 0 || stat(tmpname.c_str(), &sta) == 0; i++) {
+		char suffix[16];
+		snprintf(suffix, ARRAY_SIZE(suffix), "_%03u", i);
+		filename = destinationPath + name + suffix + ".vcol";
+		tmpname = destinationPath + "._" + name + suffix + ".vcol.part";
+	}
+
+	p->filename = filename;
+	p->tmpname = tmpname;
+	p->file = fopen(p->tmpname.c_str(), "wb");
+	if (p->file == NULL) {
+		THROWEXCEPTION("IpfixColumnWriter: could not open file '%s' for writing: %s", p->tmpname.c_str(), strerror(errno));
+	}
+	setvbuf(p->file, NULL, _IOFBF, COLUMN_FILE_BUFFER_SIZE);
+
+	write(p, COLUMN_FILE_MAGIC, sizeof(COLUMN_FILE_MAGIC));
+	statFiles++;
+	msg(LOG_INFO, "IpfixColumnWriter: opened partition file %s", p->tmpname.c_str());
+}
+
+/**
+ * writes all buffered row groups and the footer, and renames the file to its final name
+ */
+void IpfixColumnWriter::closePartition(Partition* p)
+{
+	flushRowGroups(p, true);
+
+	std::vector<uint8_t> footer;
+	uint64_t footerOffset = p->offset;
+	footer.insert(footer.end(), COLUMN_FOOTER_MAGIC, COLUMN_FOOTER_MAGIC + sizeof(COLUMN_FOOTER_MAGIC));
+	appendUint32(footer, p->index.size());
+	for (std::vector<RowGroupIndex>::iterator it = p->index.begin(); it != p->index.end(); it++) {
+		appendUint64(footer, it->offset);
+		appendUint32(footer, it->rows);
+		appendUint16(footer, it->templateId);
+		appendUint64(footer, it->minTime);
+		appendUint64(footer, it->maxTime);
+	}
+	appendUint64(footer, footerOffset);
+	footer.insert(footer.end(), COLUMN_FILE_MAGIC, COLUMN_FILE_MAGIC + sizeof(COLUMN_FILE_MAGIC));
+	write(p, &footer[0], footer.size());
+
+	if (fclose(p->file) != 0) {
+		THROWEXCEPTION("IpfixColumnWriter: failed to close file '%s': %s", p->tmpname.c_str(), strerror(errno));
+	}
+	p->file = NULL;
+	if (rename(p->tmpname.c_str(), p->filename.c_str()) != 0) {
+		THROWEXCEPTION("IpfixColumnWriter: failed to rename file '%s' to '%s'", p->tmpname.c_str(), p->filename.c_str());
+	}
+	msg(LOG_INFO, "IpfixColumnWriter: closed partition file %s with %u row groups", p->filename.c_str(), (uint32_t)p->index.size());
+	delete p;
+}
+
+IpfixColumnWriter::RowGroup* IpfixColumnWriter::createRowGroup(TemplateInfo* templateInfo)
+{
+	RowGroup* rg = new RowGroup();
+	rg->templateId = templateInfo->templateId;
+	rg->rows = 0;
+	rg->minTime = 0;
+	rg->maxTime = 0;
+	rg->created = time(0);
+	rg->columns.resize(templateInfo->fieldCount);
+	for (uint16_t i = 0; i < templateInfo->fieldCount; i++) {
+		Column& c = rg->columns[i];
+		c.type = templateInfo->fieldInfo[i].type;
+		c.variableLength = templateInfo->fieldInfo[i].isVariableLength;
+		c.keepStats = !c.variableLength && c.type.length <= COLUMN_MAX_STATS_LENGTH && hasOrderedEncoding(c.type);
+	}
+	return rg;
+}
+
+void IpfixColumnWriter::appendRecord(RowGroup* rg, IpfixDataRecord* record, uint64_t time)
+{
+	TemplateInfo* ti = record->templateInfo.get();
+	for (uint16_t i = 0; i < ti->fieldCount; i++) {
+		Column& c = rg->columns[i];
+		TemplateInfo::FieldInfo& fi = ti->fieldInfo[i];
+		const uint8_t* value = record->data + fi.offset;
+
+		if (c.variableLength) {
+			appendUint16(c.data, fi.type.length);
+		} else if (c.keepStats) {
+			if (rg->rows == 0 || memcmp(value, c.min, c.type.length) < 0)
+				memcpy(c.min, value, c.type.length);
+			if (rg->rows == 0 || memcmp(value, c.max, c.type.length) > 0)
+				memcpy(c.max, value, c.type.length);
+		}
+		c.data.insert(c.data.end(), value, value + fi.type.length);
+	}
+
+	if (rg->rows == 0 || time < rg->minTime)
+		rg->minTime = time;
+	if (rg->rows == 0 || time > rg->maxTime)
+		rg->maxTime = time;
+	rg->rows++;
+}
+
+/**
+ * compresses all column chunks of a row group and appends them to the partition file
+ */
+void IpfixColumnWriter::writeRowGroup(Partition* p, RowGroup* rg)
+{
+	std::vector<uint8_t> header;
+	header.insert(header.end(), COLUMN_ROWGROUP_MAGIC, COLUMN_ROWGROUP_MAGIC + sizeof(COLUMN_ROWGROUP_MAGIC));
+	appendUint16(header, rg->templateId);
+	appendUint16(header, rg->columns.size());
+	appendUint32(header, rg->rows);
+	appendUint64(header, rg->minTime);
+	appendUint64(header, rg->maxTime);
+
+	// chunks are compressed first because the descriptors contain their sizes
+	std::vector<uint8_t> chunks;
+	for (std::vector<Column>::iterator it = rg->columns.begin(); it != rg->columns.end(); it++) {
+		Codec chunkCodec = CodecNone;
+		const uint8_t* chunk = it->data.empty() ? NULL : &it->data[0];
+		size_t storedSize = it->data.size();
+
+#ifdef ZLIB_SUPPORT_ENABLED
+		if (codec == CodecZlib && storedSize > 0) {
+			uLongf destLen = compressBound(storedSize);
+			if (compressBuffer.size() < destLen)
+				compressBuffer.resize(destLen);
+			if (compress2(&compressBuffer[0], &destLen, chunk, storedSize, compressionLevel) == Z_OK
+					&& destLen < storedSize) {
+				chunkCodec = CodecZlib;
+				chunk = &compressBuffer[0];
+				storedSize = destLen;
+			}
+		}
+#endif
+
+		appendUint16(header, it->type.id);
+		appendUint32(header, it->type.enterprise);
+		appendUint16(header, it->variableLength ? COLUMN_VARIABLE_LENGTH : it->type.length);
+		appendUint8(header, chunkCodec);
+		appendUint8(header, it->keepStats ? ColumnHasStats : 0);
+		appendUint32(header, storedSize);
+		appendUint32(header, it->data.size());
+		if (it->keepStats) {
+			header.insert(header.end(), it->min, it->min + it->type.length);
+			header.insert(header.end(), it->max, it->max + it->type.length);
+		}
+		if (storedSize > 0)
+			chunks.insert(chunks.end(), chunk, chunk + storedSize);
+
+		statRawBytes += it->data.size();
+		statStoredBytes += storedSize;
+	}
+
+	RowGroupIndex idx;
+	idx.offset = p->offset;
+	idx.rows = rg->rows;
+	idx.templateId = rg->templateId;
+	idx.minTime = rg->minTime;
+	idx.maxTime = rg->maxTime;
+	p->index.push_back(idx);
+
+	write(p, &header[0], header.size());
+	if (!chunks.empty())
+		write(p, &chunks[0], chunks.size());
+	statRowGroups++;
+}
+
+/**
+ * writes the row groups of a partition which are full or older than maxBufferTime,
+ * or all of them if @c all is set
+ */
+void IpfixColumnWriter::flushRowGroups(Partition* p, bool all)
+{
+	time_t now = time(0);
+	std::map<uint16_t, RowGroup*>::iterator it = p->rowGroups.begin();
+	while (it != p->rowGroups.end()) {
+		RowGroup* rg = it->second;
+		if (all || rg->rows >= maxRowGroupRecords || rg->created + (time_t)maxBufferTime <= now) {
+			writeRowGroup(p, rg);
+			delete rg;
+			p->rowGroups.erase(it++);
+		} else {
+			it++;
+		}
+	}
+}
+
+void IpfixColumnWriter::write(Partition* p, const void* data, size_t length)
+{
+	if (fwrite(data, length, 1, p->file) != 1) {
+		THROWEXCEPTION("IpfixColumnWriter: could not write to file '%s'. Check disk space.", p->tmpname.c_str());
+	}
+	p->offset += length;
+}
+
+/**
+ * buffers the fields of a record in the row group of its Template and partition
+ */
+void IpfixColumnWriter::onDataRecord(IpfixDataRecord* record)
+{
+	// Options Templates and their scope fields are not archived
+	if ((record->templateInfo->setId != TemplateInfo::NetflowTemplate)
+			&& (record->templateInfo->setId != TemplateInfo::IpfixTemplate)) {
+		record->removeReference();
+		return;
+	}
+
+	uint64_t time = getRecordTime(record);
+	Partition* p = getPartition(time);
+	p->lastRecord = ::time(0);
+
+	uint16_t uniqueId = record->templateInfo->getUniqueId();
+	std::map<uint16_t, RowGroup*>::iterator it = p->rowGroups.find(uniqueId);
+	if (it != p->rowGroups.end() && it->second->columns.size() != record->templateInfo->fieldCount) {
+		// should not happen, but a row group must not mix different layouts
+		writeRowGroup(p, it->second);
+		delete it->second;
+		p->rowGroups.erase(it);
+		it = p->rowGroups.end();
+	}
+	if (it == p->rowGroups.end())
+		it = p->rowGroups.insert(std::make_pair(uniqueId, createRowGroup(record->templateInfo.get()))).first;
+
+	RowGroup* rg = it->second;
+	appendRecord(rg, record, time);
+	statRecords++;
+
+	if (rg->rows >= maxRowGroupRecords) {
+		writeRowGroup(p, rg);
+		delete rg;
+		p->rowGroups.erase(it);
+	}
+
+	record->removeReference();
+}
+
+/**
+ * writes the buffered records of a destroyed Template, its uniqueId may be reused
+ */
+void IpfixColumnWriter::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
+{
+	uint16_t uniqueId = record->templateInfo->getUniqueId();
+	for (std::map<uint64_t, Partition*>::iterator it = partitions.begin(); it != partitions.end(); it++) {
+		Partition* p = it->second;
+		std::map<uint16_t, RowGroup*>::iterator rit = p->rowGroups.find(uniqueId);
+		if (rit != p->rowGroups.end()) {
+			writeRowGroup(p, rit->second);
+			delete rit->second;
+			p->rowGroups.erase(rit);
+		}
+	}
+	record->removeReference();
+}
+
+/**
+ * flushes old row groups and closes partitions which did not receive
+ * records for a whole partition interval
+ */
+void IpfixColumnWriter::onTimeout(void* dataPtr)
+{
+	timeoutRegistered = false;
+	time_t now = time(0);
+
+	std::map<uint64_t, Partition*>::iterator it = partitions.begin();
+	while (it != partitions.end()) {
+		Partition* p = it->second;
+		if (p->lastRecord + (time_t)(partitionInterval/1000) <= now) {
+			closePartition(p);
+			partitions.erase(it++);
+		} else {
+			flushRowGroups(p, false);
+			it++;
+		}
+	}
+
+	registerTimeout();
+}
+
+void IpfixColumnWriter::registerTimeout()
+{
+	// when this module is not connected, no timer is available
+	if (!timer) return;
+
+	if (timeoutRegistered) return;
+	struct timespec next;
+	addToCurTime(&next, COLUMN_TIMEOUT_INTERVAL);
+	timer->addTimeout(this, next, NULL);
+	timeoutRegistered = true;
+}
+
+void IpfixColumnWriter::performStart()
+{
+	registerTimeout();
+}
+
+void IpfixColumnWriter::performShutdown()
+{
+	while (!partitions.empty()) {
+		closePartition(partitions.begin()->second);
+		partitions.erase(partitions.begin());
+	}
+
+	if (timer) timer->removeTimeout(NULL);
+	timeoutRegistered = false;
+}
+
+std::string IpfixColumnWriter::getStatisticsXML(double interval)
+{
+	ostringstream oss;
+	oss << "<records>" << statRecords << "</records>";
+	oss << "<rowGroups>" << statRowGroups << "</rowGroups>";
+	oss << "<rawBytes>" << statRawBytes << "</rawBytes>";
+	oss << "<storedBytes>" << statStoredBytes << "</storedBytes>";
+	oss << "<files>" << statFiles << "</files>";
+	oss << "<openPartitions>" << partitions.size() << "</openPartitions>";
+	return oss.str();
+}
@@ -0,0 +1,171 @@
+/*
+ * IPFIX Columnar Archive Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef IPFIXCOLUMNWRITER_H
+#define IPFIXCOLUMNWRITER_H
+
+#include "IpfixRecord.hpp"
+#include "core/Source.h"
+#include "core/Notifiable.h"
+#include "modules/ipfix/IpfixRecordDestination.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/* length of a column descriptor which stands for variable-length values */
+#define COLUMN_VARIABLE_LENGTH 0xFFFF
+/* fields longer than this have no min/max statistics */
+#define COLUMN_MAX_STATS_LENGTH 16
+
+/**
+ * Archives Data Records in a columnar file format for analytical scans.
+ *
+ * Records are buffered per Template. Each field of a Template becomes a
+ * column chunk, all chunks of a Template form a row group. Row groups are
+ * written to one file per time partition, which is derived from the flow
+ * start time. Every column chunk carries its compression codec and min/max
+ * statistics, and the footer of a file lists all row groups with their time
+ * range. A reader can therefore skip files, row groups and columns it does
+ * not need.
+ *
+ * File layout (all integers in network byte order):
+ *   magic "VERMCOL1"
+ *   row groups:
+ *     "VCRG", uint16 templateId, uint16 columnCount, uint32 rowCount,
+ *     uint64 minTime, uint64 maxTime (milliseconds since epoch)
+ *     columnCount descriptors:
+ *       uint16 ieId, uint32 enterprise, uint16 length (0xFFFF = variable),
+ *       uint8 codec, uint8 flags, uint32 storedSize, uint32 rawSize,
+ *       [min, max] (length bytes each, if flags & ColumnHasStats)
+ *     columnCount chunks of storedSize bytes
+ *   footer:
+ *     "VCFT", uint32 rowGroupCount,
+ *     rowGroupCount entries: uint64 offset, uint32 rowCount, uint16 templateId,
+ *     uint64 minTime, uint64 maxTime
+ *   uint64 offset of the footer, magic "VERMCOL1"
+ *
+ * Fixed-length values are stored as they appear in the record. Variable-length
+ * values are prefixed by a uint16 length. Statistics compare the values in
+ * network byte order and are only kept for unsigned, address and time types.
+ */
+class IpfixColumnWriter : public Module, public Source<NullEmitable*>, public IpfixRecordDestination, public Notifiable
+{
+	public:
+		enum Codec {
+			CodecNone = 0,
+			CodecZlib = 1
+		};
+
+		enum ColumnFlags {
+			ColumnHasStats = 1
+		};
+
+		IpfixColumnWriter(const std::string& destinationPath, const std::string& filenamePrefix,
+				uint32_t partitionInterval, uint32_t maxRowGroupRecords, uint32_t maxBufferTime,
+				Codec codec, int compressionLevel);
+		virtual ~IpfixColumnWriter();
+
+		virtual void onDataRecord(IpfixDataRecord* record);
+		virtual void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
+		virtual void onTimeout(void* dataPtr);
+
+		virtual std::string getStatisticsXML(double interval);
+
+	protected:
+		virtual void performStart();
+		virtual void performShutdown();
+
+	private:
+		struct Column {
+			InformationElement::IeInfo type;
+			bool variableLength;
+			bool keepStats;
+			std::vector<uint8_t> data;
+			uint8_t min[COLUMN_MAX_STATS_LENGTH];
+			uint8_t max[COLUMN_MAX_STATS_LENGTH];
+		};
+
+		/**
+		 * buffered records of one Template in one partition
+		 */
+		struct RowGroup {
+			TemplateInfo::TemplateId templateId;
+			std::vector<Column> columns;
+			uint32_t rows;
+			uint64_t minTime;
+			uint64_t maxTime;
+			time_t created; /**< wall-clock time of the first buffered record */
+		};
+
+		struct RowGroupIndex {
+			uint64_t offset;
+			uint32_t rows;
+			TemplateInfo::TemplateId templateId;
+			uint64_t minTime;
+			uint64_t maxTime;
+		};
+
+		/**
+		 * an open output file covering partitionInterval seconds of flow time
+		 */
+		struct Partition {
+			uint64_t start; /**< start of the partition in milliseconds */
+			FILE* file;
+			std::string filename;
+			std::string tmpname;
+			uint64_t offset; /**< current write position */
+			std::map<uint16_t, RowGroup*> rowGroups; /**< buffered records by uniqueId of the Template */
+			std::vector<RowGroupIndex> index;
+			time_t lastRecord; /**< wall-clock time of the last record */
+		};
+
+		std::string destinationPath;
+		std::string filenamePrefix;
+		uint64_t partitionInterval; /**< in milliseconds */
+		uint32_t maxRowGroupRecords;
+		uint32_t maxBufferTime; /**< in seconds */
+		Codec codec;
+		int compressionLevel;
+		std::map<uint64_t, Partition*> partitions; /**< open partitions by start time */
+		bool timeoutRegistered;
+
+		std::vector<uint8_t> compressBuffer;
+
+		uint64_t statRecords;
+		uint64_t statRowGroups;
+		uint64_t statRawBytes;
+		uint64_t statStoredBytes;
+		uint32_t statFiles;
+
+		uint64_t getRecordTime(IpfixDataRecord* record);
+		Partition* getPartition(uint64_t time);
+		void openPartition(Partition* p);
+		void closePartition(Partition* p);
+		RowGroup* createRowGroup(TemplateInfo* templateInfo);
+		void appendRecord(RowGroup* rg, IpfixDataRecord* record, uint64_t time);
+		void writeRowGroup(Partition* p, RowGroup* rg);
+		void flushRowGroups(Partition* p, bool all);
+		void write(Partition* p, const void* data, size_t length);
+		void registerTimeout();
+};
+
+#endif
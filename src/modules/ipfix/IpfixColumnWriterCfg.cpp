@@ -0,0 +1,119 @@
+/*
+ * IPFIX Columnar Archive Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "common/msg.h"
+#include "core/XMLElement.h"
+
+#include "IpfixColumnWriterCfg.hpp"
+
+#include <cassert>
+
+IpfixColumnWriterCfg* IpfixColumnWriterCfg::create(XMLElement* e)
+{
+	assert(e);
+	assert(e->getName() == getName());
+	return new IpfixColumnWriterCfg(e);
+}
+
+IpfixColumnWriterCfg::IpfixColumnWriterCfg(XMLElement* elem)
+	: CfgHelper<IpfixColumnWriter, IpfixColumnWriterCfg>(elem, "ipfixColumnWriter"),
+	destinationPath("./"),
+	filenamePrefix("flows_"),
+	partitionInterval(3600),
+	maxRowGroupRecords(65536),
+	maxBufferTime(60),
+#ifdef ZLIB_SUPPORT_ENABLED
+	codec(IpfixColumnWriter::CodecZlib),
+#else
+	codec(IpfixColumnWriter::CodecNone),
+#endif
+	compressionLevel(6)
+{
+	if (!elem) return;  // needed because of table inside ConfigManager
+
+	XMLNode::XMLSet<XMLElement*> set = _elem->getElementChildren();
+	for (XMLNode::XMLSet<XMLElement*>::iterator it = set.begin();
+	     it != set.end();
+	     it++) {
+		XMLElement* e = *it;
+
+		if (e->matches("destinationPath")) {
+			destinationPath = e->getFirstText();
+		} else if (e->matches("filenamePrefix")) {
+			filenamePrefix = e->getFirstText();
+		} else if (e->matches("partitionInterval")) {
+			partitionInterval = getInt("partitionInterval");
+			if (partitionInterval == 0)
+				THROWEXCEPTION("ipfixColumnWriter: partitionInterval must be greater than 0");
+		} else if (e->matches("maxRowGroupRecords")) {
+			maxRowGroupRecords = getInt("maxRowGroupRecords");
+			if (maxRowGroupRecords == 0)
+				THROWEXCEPTION("ipfixColumnWriter: maxRowGroupRecords must be greater than 0");
+		} else if (e->matches("maxBufferTime")) {
+			maxBufferTime = getInt("maxBufferTime");
+		} else if (e->matches("compression")) {
+			std::string c = e->getFirstText();
+			if (c == "none") {
+				codec = IpfixColumnWriter::CodecNone;
+			} else if (c == "zlib") {
+#ifdef ZLIB_SUPPORT_ENABLED
+				codec = IpfixColumnWriter::CodecZlib;
+#else
+				THROWEXCEPTION("ipfixColumnWriter: zlib compression requested, but Vermont was compiled without zlib support");
+#endif
+			} else {
+				THROWEXCEPTION("ipfixColumnWriter: unknown compression '%s', use 'none' or 'zlib'", c.c_str());
+			}
+		} else if (e->matches("compressionLevel")) {
+			compressionLevel = getInt("compressionLevel");
+			if (compressionLevel < 1 || compressionLevel > 9)
+				THROWEXCEPTION("ipfixColumnWriter: compressionLevel must be between 1 and 9");
+		} else if (e->matches("next")) { // ignore next
+		} else {
+			msg(LOG_CRIT, "Unknown ipfixColumnWriter config statement %s\n",
+				 e->getName().c_str());
+			continue;
+		}
+	}
+}
+
+IpfixColumnWriterCfg::~IpfixColumnWriterCfg()
+{
+}
+
+IpfixColumnWriter* IpfixColumnWriterCfg::createInstance()
+{
+	instance = new IpfixColumnWriter(destinationPath, filenamePrefix, partitionInterval,
+					maxRowGroupRecords, maxBufferTime, codec, compressionLevel);
+	return instance;
+}
+
+bool IpfixColumnWriterCfg::deriveFrom(IpfixColumnWriterCfg* old)
+{
+	if (destinationPath != old->destinationPath ||
+	    filenamePrefix != old->filenamePrefix ||
+	    partitionInterval != old->partitionInterval ||
+	    maxRowGroupRecords != old->maxRowGroupRecords ||
+	    maxBufferTime != old->maxBufferTime ||
+	    codec != old->codec ||
+	    compressionLevel != old->compressionLevel)
+		return false;
+
+	return true;
+}
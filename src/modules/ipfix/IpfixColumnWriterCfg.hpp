@@ -0,0 +1,58 @@
+/*
+ * IPFIX Columnar Archive Writer
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef IPFIXCOLUMNWRITERCFG_H_
+#define IPFIXCOLUMNWRITERCFG_H_
+
+#include <core/XMLElement.h>
+#include <core/Cfg.h>
+
+#include "IpfixColumnWriter.hpp"
+
+#include <string>
+
+
+class IpfixColumnWriterCfg
+	: public CfgHelper<IpfixColumnWriter, IpfixColumnWriterCfg>
+{
+public:
+	friend class ConfigManager;
+
+	virtual IpfixColumnWriterCfg* create(XMLElement* e);
+
+	virtual ~IpfixColumnWriterCfg();
+
+	virtual IpfixColumnWriter* createInstance();
+
+	virtual bool deriveFrom(IpfixColumnWriterCfg* old);
+
+protected:
+	IpfixColumnWriterCfg(XMLElement*);
+
+private:
+	std::string destinationPath; /**< directory of the output files */
+	std::string filenamePrefix; /**< prefix of each file */
+	uint32_t partitionInterval; /**< flow time covered by one file in seconds */
+	uint32_t maxRowGroupRecords; /**< maximum number of records in one row group */
+	uint32_t maxBufferTime; /**< maximum time in seconds records are buffered */
+	IpfixColumnWriter::Codec codec;
+	int compressionLevel;
+};
+
+#endif /*IPFIXCOLUMNWRITERCFG_H_*/
@@ -21,14 +21,18 @@
 
 #include "IpfixCsExporter.hpp"
 #include "core/Timer.h"
+#include <fcntl.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 
 /**
  * Creates a new IPFIXCsExporter.
  */
 IpfixCsExporter::IpfixCsExporter(std::string filenamePrefix,
 		std::string destinationPath, uint32_t maximumFilesize, uint32_t maxChunkBufferTime,
-		uint32_t maxChunkBufferRecords, uint32_t maxFileCreationInterval, uint8_t exportMode)
+		uint32_t maxChunkBufferRecords, uint32_t maxFileCreationInterval, uint8_t exportMode,
+		int compressionLevel)
 {
 	//fill configuration variables
 	this->filenamePrefix = filenamePrefix;
@@ -38,8 +42,10 @@ IpfixCsExporter::IpfixCsExporter(std::string filenamePrefix,
 	this->maxChunkBufferRecords = maxChunkBufferRecords;
 	this->maxFileCreationInterval = maxFileCreationInterval;
 	this->exportMode = exportMode;
-	this->chunkListSize = 0;
-	currentFile = NULL;
+	this->compressionLevel = compressionLevel;
+	chunkBuffer.reserve(maxChunkBufferRecords);
+	currentFile = -1;
+	currentCompressedFile = NULL;
 	currentFileSize = 0;
 
 	//Register first timeouts
@@ -60,6 +66,8 @@ IpfixCsExporter::IpfixCsExporter(std::string filenamePrefix,
 	msg(LOG_NOTICE, "  - maxChunkBufferRecords = %d seconds" , maxChunkBufferRecords);
 	msg(LOG_NOTICE, "  - maxFileCreationInterval = %d seconds" , maxFileCreationInterval);
 	msg(LOG_NOTICE, "  - exportMode = %d" , exportMode);
+	if (compressionLevel > 0)
+		msg(LOG_NOTICE, "  - compression = gzip, level %d", compressionLevel);
 	msg(LOG_NOTICE, "  - export struct sizes = %lu(Ipfix_basic_flow_sequence_chunk_header), %lu(Ipfix_basic_flow)", sizeof(Ipfix_basic_flow_sequence_chunk_header), sizeof(Ipfix_basic_flow));
 	msg(LOG_NOTICE, "IpfixCsExporter: running");
 }
@@ -68,32 +76,158 @@ IpfixCsExporter::~IpfixCsExporter()
 {
 }
 
-uint64_t IpfixCsExporter::retrieveTime(IpfixDataRecord* record, InformationElement::IeId id1, InformationElement::IeId id2,
-		InformationElement::IeId id3, InformationElement::IeEnterpriseNumber pen)
+/**
+ * looks up the first of the given timestamp fields contained in the Template
+ */
+IpfixCsExporter::TimeField IpfixCsExporter::timeField(TemplateInfo* templateInfo, InformationElement::IeId id1,
+		InformationElement::IeId id2, InformationElement::IeId id3, InformationElement::IeEnterpriseNumber pen)
+{
+	TimeField field;
+	TemplateInfo::FieldInfo* fi = templateInfo->getFieldInfo(id1, pen);
+	field.resolution = TimeField::NANOSECONDS;
+	if (fi == 0) {
+		fi = templateInfo->getFieldInfo(id2, pen);
+		field.resolution = TimeField::MILLISECONDS;
+	}
+	if (fi == 0) {
+		fi = templateInfo->getFieldInfo(id3, pen);
+		field.resolution = TimeField::SECONDS;
+	}
+	field.offset = fi ? fi->offset : -1;
+	return field;
+}
+
+uint64_t IpfixCsExporter::retrieveTime(IpfixRecord::Data* data, const TimeField& field)
 {
 	uint64_t rettime;
-	TemplateInfo::FieldInfo* fi = record->templateInfo->getFieldInfo(id1, pen);
-	if (fi != 0) {
-		convertNtp64(*(uint64_t*)(record->data + fi->offset), rettime);
-	} else {
-		fi = record->templateInfo->getFieldInfo(id2, pen);
-		if (fi != 0) {
-			rettime = ntohll(*(uint64_t*)(record->data + fi->offset));
-		} else {
-			fi = record->templateInfo->getFieldInfo(id3, pen);
-			if (fi != 0) {
-				rettime = ntohl(*(uint32_t*)(record->data + fi->offset));
-				rettime *= 1000;
-			} else {
-				rettime = 0;
-			}
-		}
+	if (field.offset < 0)
+		return 0;
+	switch (field.resolution) {
+		case TimeField::NANOSECONDS:
+			convertNtp64(*(uint64_t*)(data + field.offset), rettime);
+			break;
+		case TimeField::MILLISECONDS:
+			rettime = ntohll(*(uint64_t*)(data + field.offset));
+			break;
+		default:
+			rettime = ntohl(*(uint32_t*)(data + field.offset));
+			rettime *= 1000;
+			break;
 	}
 	return rettime;
 }
 
 /**
- * adds information to cs-record structure and pushing into chained list
+ * returns the offset of an anonymisationType IE directly after the field with index idx, or -1
+ */
+int32_t IpfixCsExporter::anonymisationTypeOffset(TemplateInfo* templateInfo, int idx)
+{
+	if (idx < 0 || idx >= templateInfo->fieldCount-1)
+		return -1;
+	TemplateInfo::FieldInfo* fi = &templateInfo->fieldInfo[idx+1];
+	if (fi->type == InformationElement::IeInfo(IPFIX_ETYPEID_anonymisationType, IPFIX_PEN_vermont))
+		return fi->offset;
+	return -1;
+}
+
+/**
+ * returns the field offsets of a Template, looking them up on first use
+ */
+const IpfixCsExporter::FieldOffsets& IpfixCsExporter::getFieldOffsets(TemplateInfo* templateInfo)
+{
+	std::map<uint16_t, FieldOffsets>::iterator it = fieldOffsets.find(templateInfo->getUniqueId());
+	if (it != fieldOffsets.end())
+		return it->second;
+
+	FieldOffsets o;
+	TemplateInfo::FieldInfo* fi;
+	int idx;
+
+	idx = templateInfo->getFieldIndex(IPFIX_TYPEID_sourceIPv4Address, 0);
+	o.sourceIPv4Address = idx >= 0 ? templateInfo->fieldInfo[idx].offset : -1;
+	o.sourceAnonymisationType = anonymisationTypeOffset(templateInfo, idx);
+	idx = templateInfo->getFieldIndex(IPFIX_TYPEID_destinationIPv4Address, 0);
+	o.destinationIPv4Address = idx >= 0 ? templateInfo->fieldInfo[idx].offset : -1;
+	o.destinationAnonymisationType = anonymisationTypeOffset(templateInfo, idx);
+
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_protocolIdentifier, 0);
+	o.protocolIdentifier = fi ? fi->offset : -1;
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_sourceTransportPort, 0);
+	o.sourceTransportPort = fi ? fi->offset : -1;
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_destinationTransportPort, 0);
+	o.destinationTransportPort = fi ? fi->offset : -1;
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_icmpTypeCodeIPv4, 0);
+	o.icmpTypeCodeIPv4 = fi ? fi->offset : -1;
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_tcpControlBits, 0);
+	o.tcpControlBits = fi ? fi->offset : -1;
+	o.tcpControlBitsLength = fi ? fi->type.length : 0;
+
+	o.flowStart = timeField(templateInfo, IPFIX_TYPEID_flowStartNanoseconds, IPFIX_TYPEID_flowStartMilliseconds,
+			IPFIX_TYPEID_flowStartSeconds, 0);
+	o.revFlowStart = timeField(templateInfo, IPFIX_TYPEID_flowStartNanoseconds, IPFIX_TYPEID_flowStartMilliseconds,
+			IPFIX_TYPEID_flowStartSeconds, IPFIX_PEN_reverse);
+	o.flowEnd = timeField(templateInfo, IPFIX_TYPEID_flowEndNanoseconds, IPFIX_TYPEID_flowEndMilliseconds,
+			IPFIX_TYPEID_flowEndSeconds, 0);
+	o.revFlowEnd = timeField(templateInfo, IPFIX_TYPEID_flowEndNanoseconds, IPFIX_TYPEID_flowEndMilliseconds,
+			IPFIX_TYPEID_flowEndSeconds, IPFIX_PEN_reverse);
+
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_octetDeltaCount, 0);
+	o.octetDeltaCount = fi ? fi->offset : -1;
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_packetDeltaCount, 0);
+	o.packetDeltaCount = fi ? fi->offset : -1;
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_octetDeltaCount, IPFIX_PEN_reverse);
+	o.revOctetDeltaCount = fi ? fi->offset : -1;
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_packetDeltaCount, IPFIX_PEN_reverse);
+	o.revPacketDeltaCount = fi ? fi->offset : -1;
+	fi = templateInfo->getFieldInfo(IPFIX_TYPEID_tcpControlBits, IPFIX_PEN_reverse);
+	o.revTcpControlBits = fi ? fi->offset : -1;
+	o.revTcpControlBitsLength = fi ? fi->type.length : 0;
+
+	// the offsets of Templates with variable length fields change from record to record
+	for (int i = 0; i < templateInfo->fieldCount; i++) {
+		if (templateInfo->fieldInfo[i].isVariableLength) {
+			variableLengthOffsets = o;
+			return variableLengthOffsets;
+		}
+	}
+	return fieldOffsets[templateInfo->getUniqueId()] = o;
+}
+
+/**
+ * RFC rfc7011 and rfc7012 changed the tcpControlBits size
+ * from 1 byte to 2 bytes. Support both as the RFC mandates.
+ */
+static inline uint16_t tcpControlBits(IpfixRecord::Data* data, int32_t offset, uint16_t length)
+{
+	if (offset < 0)
+		return 0;
+	if (length == 2)
+		return *(uint16_t*)(data + offset) & Connection::MASK;
+	if (length == 1)
+		return htons((uint16_t)*(uint8_t*)(data + offset));
+	return 0;
+}
+
+void IpfixCsExporter::onTemplate(IpfixTemplateRecord* record)
+{
+	TemplateInfo* templateInfo = record->templateInfo.get();
+	if ((templateInfo->setId == TemplateInfo::NetflowTemplate)
+			|| (templateInfo->setId == TemplateInfo::IpfixTemplate)) {
+		// uniqueIds are reused after the destruction of a Template
+		fieldOffsets.erase(templateInfo->getUniqueId());
+		getFieldOffsets(templateInfo);
+	}
+	record->removeReference();
+}
+
+void IpfixCsExporter::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
+{
+	fieldOffsets.erase(record->templateInfo->getUniqueId());
+	record->removeReference();
+}
+
+/**
+ * adds information to cs-record structure and appends it to the chunk buffer
  */
 void IpfixCsExporter::onDataRecord(IpfixDataRecord* record)
 {
@@ -103,161 +237,93 @@ void IpfixCsExporter::onDataRecord(IpfixDataRecord* record)
 		return;
 	}
 
-	//create a new Ipfix_basic_flow and fill it with data
-	Ipfix_basic_flow* csRecord = new Ipfix_basic_flow();
-	TemplateInfo::FieldInfo* fi;
+	const FieldOffsets& o = getFieldOffsets(record->templateInfo.get());
+	IpfixRecord::Data* data = record->data;
+
+	//fill the next Ipfix_basic_flow of the chunk buffer with data
+	chunkBuffer.resize(chunkBuffer.size() + 1);
+	Ipfix_basic_flow* csRecord = &chunkBuffer.back();
 
 	csRecord->record_length			= htons(sizeof(Ipfix_basic_flow)-2);		/* total length of this record in bytes minus this element*/
 	csRecord->src_export_mode		= CS_E_PLAIN;
 	csRecord->dst_export_mode		= CS_E_PLAIN;
 	csRecord->ipversion				= 4;						/* expected 4 (for now) */
 
-	int idx;
-	idx = record->templateInfo->getFieldIndex(IPFIX_TYPEID_sourceIPv4Address, 0);
-	if (idx >= 0) {
-		fi = &record->templateInfo->fieldInfo[idx];
-		csRecord->source_ipv4_address		= *(uint32_t*)(record->data + fi->offset);
+	if (o.sourceIPv4Address >= 0) {
+		csRecord->source_ipv4_address		= *(uint32_t*)(data + o.sourceIPv4Address);
 		// set export mode if anonymisationType IE is directly after this field
-		if (idx<record->templateInfo->fieldCount-1) {
-			fi = &record->templateInfo->fieldInfo[idx+1];
-			if (fi->type==InformationElement::IeInfo(IPFIX_ETYPEID_anonymisationType, IPFIX_PEN_vermont)
-					&& *(uint8_t*)(record->data + fi->offset)==1) {
-				csRecord->src_export_mode = exportMode;
-			}
-		}
+		if (o.sourceAnonymisationType >= 0 && *(uint8_t*)(data + o.sourceAnonymisationType)==1)
+			csRecord->src_export_mode = exportMode;
 	} else {
 		msg(LOG_INFO, "failed to determine source ip for record, assuming 0.0.0.0");
 		csRecord->source_ipv4_address		= 0;
 	}
 
-	idx = record->templateInfo->getFieldIndex(IPFIX_TYPEID_destinationIPv4Address, 0);
-	if (idx >= 0) {
-		fi = &record->templateInfo->fieldInfo[idx];
-		csRecord->destination_ipv4_address	= *(uint32_t*)(record->data + fi->offset);
+	if (o.destinationIPv4Address >= 0) {
+		csRecord->destination_ipv4_address	= *(uint32_t*)(data + o.destinationIPv4Address);
 		// set export mode if anonymisationType IE is directly after this field
-		if (idx<record->templateInfo->fieldCount-1) {
-			fi = &record->templateInfo->fieldInfo[idx+1];
-			if (fi->type==InformationElement::IeInfo(IPFIX_ETYPEID_anonymisationType, IPFIX_PEN_vermont)
-					&& *(uint8_t*)(record->data + fi->offset)==1) {
-				csRecord->dst_export_mode = exportMode;
-			}
-		}
+		if (o.destinationAnonymisationType >= 0 && *(uint8_t*)(data + o.destinationAnonymisationType)==1)
+			csRecord->dst_export_mode = exportMode;
 	} else {
 		msg(LOG_INFO, "failed to determine destination ip for record, assuming 0.0.0.0");
 		csRecord->destination_ipv4_address	= 0;
 	}
 
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_protocolIdentifier, 0);
-	if (fi != 0) {
-		csRecord->protocol_identifier 		= *(uint8_t*)(record->data + fi->offset);
+	if (o.protocolIdentifier >= 0) {
+		csRecord->protocol_identifier 		= *(uint8_t*)(data + o.protocolIdentifier);
 	} else {
 		msg(LOG_INFO, "failed to determine protocol for record, using 0");
 		csRecord->protocol_identifier		= 0;
 	}
 
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_sourceTransportPort, 0);
-        if (fi != 0) {
-		csRecord->source_transport_port		= *(uint16_t*)(record->data + fi->offset);/* encode udp/tcp ports here */
+	if (o.sourceTransportPort >= 0) {
+		csRecord->source_transport_port		= *(uint16_t*)(data + o.sourceTransportPort);/* encode udp/tcp ports here */
 	} else {
 		msg(LOG_INFO, "failed to determine source port for record, assuming 0");
 		csRecord->source_transport_port		= 0;
 	}
 
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_destinationTransportPort, 0);
-	if (fi != 0) {
-		csRecord->destination_transport_port	= *(uint16_t*)(record->data + fi->offset);/* encode udp/tcp ports here */
+	if (o.destinationTransportPort >= 0) {
+		csRecord->destination_transport_port	= *(uint16_t*)(data + o.destinationTransportPort);/* encode udp/tcp ports here */
 	} else {
 		msg(LOG_INFO, "failed to determine destination port for record, assuming 0");
 		csRecord->destination_transport_port	= 0;
 	}
 
 	// IPFIX_TYPEID_icmpTypeCodeIPv4   (ICMP type * 256) + ICMP code (network-byte order!)
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_icmpTypeCodeIPv4, 0);
-	if (fi != 0) {
-		csRecord->icmp_type_ipv4 		= *(uint8_t*)(record->data + fi->offset);
-		csRecord->icmp_code_ipv4		= *(uint8_t*)(record->data + fi->offset + 1);
+	if (o.icmpTypeCodeIPv4 >= 0) {
+		csRecord->icmp_type_ipv4 		= *(uint8_t*)(data + o.icmpTypeCodeIPv4);
+		csRecord->icmp_code_ipv4		= *(uint8_t*)(data + o.icmpTypeCodeIPv4 + 1);
 	} else {
 		csRecord->icmp_type_ipv4                = 0;
 		csRecord->icmp_code_ipv4                = 0;
 	}
 
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_tcpControlBits, 0);
-	if (fi != 0) {
-		/*
-		 * RFC rfc7011 and rfc7012 changed the tcpControlBits size
-		 * from 1 byte to 2 bytes. Support both as the RFC mandates.
-		 */
-		if (fi->type.length == 2) {
-			csRecord->tcp_control_bits = *(uint16_t*)(record->data + fi->offset) & Connection::MASK;
-		} else if (fi->type.length == 1) {
-			csRecord->tcp_control_bits = htons((uint16_t)*(uint8_t*)(record->data + fi->offset));
-		} else {
-			csRecord->tcp_control_bits = 0;
-		}
-	}
+	csRecord->tcp_control_bits = tcpControlBits(data, o.tcpControlBits, o.tcpControlBitsLength);
 
-	uint64_t timestart = retrieveTime(record, IPFIX_TYPEID_flowStartNanoseconds, IPFIX_TYPEID_flowStartMilliseconds,
-			IPFIX_TYPEID_flowStartSeconds, 0);
-	uint64_t revtimestart = retrieveTime(record, IPFIX_TYPEID_flowStartNanoseconds, IPFIX_TYPEID_flowStartMilliseconds,
-			IPFIX_TYPEID_flowStartSeconds, IPFIX_PEN_reverse);
+	uint64_t timestart = retrieveTime(data, o.flowStart);
+	uint64_t revtimestart = retrieveTime(data, o.revFlowStart);
 	if (revtimestart>0 && revtimestart<timestart)
 		csRecord->flow_start_milliseconds = htonll(revtimestart);
 	else
 		csRecord->flow_start_milliseconds = htonll(timestart);
 
-	uint64_t timeend = retrieveTime(record, IPFIX_TYPEID_flowEndNanoseconds, IPFIX_TYPEID_flowEndMilliseconds,
-			IPFIX_TYPEID_flowEndSeconds, 0);
-	uint64_t revtimeend = retrieveTime(record, IPFIX_TYPEID_flowEndNanoseconds, IPFIX_TYPEID_flowEndMilliseconds,
-			IPFIX_TYPEID_flowEndSeconds, IPFIX_PEN_reverse);
+	uint64_t timeend = retrieveTime(data, o.flowEnd);
+	uint64_t revtimeend = retrieveTime(data, o.revFlowEnd);
 	if (revtimeend>0 && revtimeend>timeend)
 		csRecord->flow_end_milliseconds = htonll(revtimeend);
 	else
 		csRecord->flow_end_milliseconds = htonll(timeend);
 
-
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_octetDeltaCount, 0);
-        if (fi != 0) {
-		csRecord->octet_total_count = *(uint64_t*)(record->data + fi->offset);
-	}
-
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_packetDeltaCount, 0);
-	if (fi != 0) {
-		csRecord->packet_total_count = *(uint64_t*)(record->data + fi->offset);
-	}
-
+	csRecord->octet_total_count = o.octetDeltaCount >= 0 ? *(uint64_t*)(data + o.octetDeltaCount) : 0;
+	csRecord->packet_total_count = o.packetDeltaCount >= 0 ? *(uint64_t*)(data + o.packetDeltaCount) : 0;
 	csRecord->biflow_direction = 0;
-
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_octetDeltaCount, IPFIX_PEN_reverse);
-	if (fi != 0) {
-		csRecord->rev_octet_total_count = *(uint64_t*)(record->data + fi->offset);
-	}
-
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_packetDeltaCount, IPFIX_PEN_reverse);
-	if (fi != 0) {
-		csRecord->rev_packet_total_count = *(uint64_t*)(record->data + fi->offset);
-	}
-
-	fi = record->templateInfo->getFieldInfo(IPFIX_TYPEID_tcpControlBits, IPFIX_PEN_reverse);
-	if (fi != 0) {
-		/*
-		 * RFC rfc7011 and rfc7012 changed the tcpControlBits size
-		 * from 1 byte to 2 bytes. Support both as the RFC mandates.
-		 */
-		if (fi->type.length == 2) {
-			csRecord->rev_tcp_control_bits = *(uint16_t*)(record->data + fi->offset) & Connection::MASK;
-		} else if (fi->type.length == 1) {
-			csRecord->rev_tcp_control_bits = htons((uint16_t)*(uint8_t*)(record->data + fi->offset));
-		} else {
-			csRecord->rev_tcp_control_bits = 0;
-		}
-	}
-
-	//add data to linked list
-	chunkList.push_back(csRecord);
-	chunkListSize++;
+	csRecord->rev_octet_total_count = o.revOctetDeltaCount >= 0 ? *(uint64_t*)(data + o.revOctetDeltaCount) : 0;
+	csRecord->rev_packet_total_count = o.revPacketDeltaCount >= 0 ? *(uint64_t*)(data + o.revPacketDeltaCount) : 0;
+	csRecord->rev_tcp_control_bits = tcpControlBits(data, o.revTcpControlBits, o.revTcpControlBitsLength);
 
 	//check if maxChunkBufferRecords is reached
-	if(chunkListSize == maxChunkBufferRecords)
+	if(chunkBuffer.size() == maxChunkBufferRecords)
 		writeChunkList();
 
 	//check if maxFileSize is reached
@@ -293,14 +359,49 @@ void IpfixCsExporter::onTimeout(void* dataPtr)
 
 void IpfixCsExporter::closeFile()
 {
-	if (currentFile == NULL) return;
+	if (currentFile < 0) return;
 
-	fclose(currentFile);
+	int result = currentCompressedFile ? compressed_file_close(currentCompressedFile) : close(currentFile);
+	if (result != 0) {
+		msg(LOG_ERR, "IpfixCsExporter: could not finish file '%s'", currentTmpname);
+	}
 	if (rename(currentTmpname, currentFilename) != 0) {
 		THROWEXCEPTION("IpfixCsExporter: failed to rename file '%s' to '%s'", currentTmpname, currentFilename);
 	}
 
-	currentFile = NULL;
+	currentFile = -1;
+	currentCompressedFile = NULL;
+}
+
+/**
+ * writes all data of iov to the current file, iov is modified
+ */
+void IpfixCsExporter::writeData(struct iovec* iov, int iovcnt)
+{
+	if (currentCompressedFile) {
+		if (compressed_file_writev(currentCompressedFile, iov, iovcnt) < 0)
+			THROWEXCEPTION("IpfixCsExporter: could not write to file '%s': %s", currentTmpname, strerror(errno));
+		return;
+	}
+
+	while (iovcnt > 0) {
+		ssize_t n = writev(currentFile, iov, iovcnt);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			THROWEXCEPTION("IpfixCsExporter: could not write to file '%s': %s", currentTmpname, strerror(errno));
+		}
+		// skip what has been written, writev may write less than requested
+		while (iovcnt > 0 && (size_t)n >= iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (char*)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
 }
 
 /**
@@ -322,7 +423,8 @@ void IpfixCsExporter::writeFileHeader()
 			destinationPath.c_str(), filenamePrefix.c_str(), st->tm_year+1900,st->tm_mon+1,st->tm_mday,st->tm_hour,st->tm_min);
 	uint32_t i = 1;
 	while (i<0xFFFFFFFE) {
-		snprintf(currentFilename, ARRAY_SIZE(currentFilename), "%s_%03d", prefix, i);
+		snprintf(currentFilename, ARRAY_SIZE(currentFilename), "%s_%03d%s", prefix, i,
+				compressionLevel > 0 ? ".gz" : "");
 		errno = 0;
 		if (stat(currentFilename,&sta) != 0) {
 			if (errno != 2) {
@@ -345,47 +447,51 @@ void IpfixCsExporter::writeFileHeader()
 	}
 
 	// fix: cs_export is too stupid to read incomplete file. Let's create a temporary file ....
-	currentFile = fopen(currentTmpname, "wb");
-	if (currentFile == NULL) {
+	currentFile = open(currentTmpname, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
+	if (currentFile < 0) {
 		THROWEXCEPTION("Could not open file for writing. Check permissions.");
 	}
-
-	if (fwrite(CS_IPFIX_MAGIC, sizeof(CS_IPFIX_MAGIC), 1, currentFile)==0){
-		THROWEXCEPTION("Could not write file header. Check disk space.");
+	if (compressionLevel > 0) {
+		currentCompressedFile = compressed_file_open(currentFile, compressionLevel);
+		if (currentCompressedFile == NULL) {
+			close(currentFile);
+			currentFile = -1;
+			THROWEXCEPTION("Could not open file for writing. Check permissions.");
+		}
 	}
 
+	struct iovec iov;
+	iov.iov_base = CS_IPFIX_MAGIC;
+	iov.iov_len = sizeof(CS_IPFIX_MAGIC);
+	writeData(&iov, 1);
+
 	//new Timeouts:
 	addToCurTime(&nextChunkTimeout, maxChunkBufferTime*1000);
 	addToCurTime(&nextFileTimeout, maxFileCreationInterval*1000);
 }
 
 /**
- * Writes the content of chunkList to the output file
+ * Writes the chunk header and the content of chunkBuffer to the output file
  */
 void IpfixCsExporter::writeChunkList()
 {
 	Ipfix_basic_flow_sequence_chunk_header csChunkHeader;
+	uint32_t flowCount = chunkBuffer.size();
 
 	csChunkHeader.ipfix_type = htons(0x0008);
-	csChunkHeader.chunk_length = htonl(chunkListSize*sizeof(Ipfix_basic_flow)+4);
-	csChunkHeader.flow_count = htonl(chunkListSize);
+	csChunkHeader.chunk_length = htonl(flowCount*sizeof(Ipfix_basic_flow)+4);
+	csChunkHeader.flow_count = htonl(flowCount);
 
-	if (fwrite(&csChunkHeader, sizeof(csChunkHeader), 1, currentFile)==0){
-		THROWEXCEPTION("Could not chunk header. Check disk space.");
-	}
+	msg(LOG_INFO, "IpfixCsExporter: writing %u records to disk", flowCount);
 
-	msg(LOG_INFO, "IpfixCsExporter: writing %u records to disk", chunkListSize);
+	struct iovec iov[2];
+	iov[0].iov_base = &csChunkHeader;
+	iov[0].iov_len = sizeof(csChunkHeader);
+	iov[1].iov_base = chunkBuffer.data();
+	iov[1].iov_len = flowCount*sizeof(Ipfix_basic_flow);
+	writeData(iov, flowCount > 0 ? 2 : 1);
 
-	while (!chunkList.empty()){
-		Ipfix_basic_flow* flow = chunkList.front();
-		if (fwrite(flow, sizeof(Ipfix_basic_flow), 1, currentFile)==0){
-			THROWEXCEPTION("Could not write basic flow data. Check disk space.");
-		}
-
-		chunkList.pop_front();
-		chunkListSize--;
-		delete flow;
-	}
+	chunkBuffer.clear();
 	addToCurTime(&nextChunkTimeout, maxChunkBufferTime*1000);
 }
 
@@ -427,7 +533,7 @@ void IpfixCsExporter::performStart()
 
 void IpfixCsExporter::performShutdown()
 {
-	if (currentFile != NULL) {
+	if (currentFile >= 0) {
 		writeChunkList();
 		closeFile();
 	}
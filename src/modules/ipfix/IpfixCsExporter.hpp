@@ -28,6 +28,7 @@
 #include "IpfixRecord.hpp"
 #include "common/ipfixlolib/ipfix.h"
 #include "common/ipfixlolib/ipfixlolib.h"
+#include "common/CompressedFile.h"
 #include "core/Source.h"
 #include "core/Notifiable.h"
 #include "modules/ipfix/Connection.h"
@@ -36,7 +37,8 @@
 #include <time.h>
 #include <iostream>
 #include <fstream>
-#include <list>
+#include <map>
+#include <vector>
 
 #define EXPORTERID 0
 #define DEFAULTFILESIZE 2097152
@@ -47,7 +49,8 @@ class IpfixCsExporter : public Module, public Source<NullEmitable*>, public Ipfi
 		IpfixCsExporter(std::string filenamePrefix,
 		std::string destinationPath, uint32_t maxFileSize,
 		uint32_t maxChunkBufferTime, uint32_t maxChunkBufferRecords,
-		uint32_t maxFileCreationInterval, uint8_t exportMode);
+		uint32_t maxFileCreationInterval, uint8_t exportMode,
+		int compressionLevel);
 
 		virtual ~IpfixCsExporter();
 
@@ -55,6 +58,8 @@ class IpfixCsExporter : public Module, public Source<NullEmitable*>, public Ipfi
 	        virtual void onTimeout(void* dataPtr);
 
 	protected:
+		virtual void onTemplate(IpfixTemplateRecord* record);
+		virtual void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
 		virtual void performStart();
 		virtual void performShutdown();
 
@@ -65,7 +70,8 @@ class IpfixCsExporter : public Module, public Source<NullEmitable*>, public Ipfi
 
 		std::string filenamePrefix; /**< prefix to each file */
 		std::string destinationPath; /**< storage path of output files */
-		FILE *currentFile;
+		int currentFile; /**< file descriptor of the current file, -1 if none is open */
+		compressed_file* currentCompressedFile; /**< wraps currentFile if compression is enabled */
 		char currentFilename[512];
 		char currentTmpname[512];
 		uint32_t maxFileSize; /**< maximum filesize in  KiB, i.e. maximumFilesize * 1024 == maximum filesize in bytes */
@@ -73,17 +79,60 @@ class IpfixCsExporter : public Module, public Source<NullEmitable*>, public Ipfi
 		uint32_t maxChunkBufferRecords; /**< maximum Chunk Buffer Records (in records) */
 		uint32_t maxFileCreationInterval; /**< time in seconds between creation of a new output file */
 		uint8_t exportMode; /**< export Mode */
+		int compressionLevel; /**< zlib level of the gzip-compressed files, 0 for uncompressed files */
 		uint32_t currentFileSize;
 		bool timeoutRegistered;
 		timespec nextChunkTimeout;
 		timespec nextFileTimeout;
 
+		/**
+		 * timestamp field of a Template, in one of the supported resolutions
+		 */
+		struct TimeField {
+			int32_t offset; /**< -1 if the Template contains none of the fields */
+			enum { NANOSECONDS, MILLISECONDS, SECONDS } resolution;
+		};
+
+		/**
+		 * offsets of the exported fields in the Data Records of a Template,
+		 * -1 for fields not contained in the Template
+		 */
+		struct FieldOffsets {
+			int32_t sourceIPv4Address;
+			int32_t sourceAnonymisationType; /**< anonymisationType directly after sourceIPv4Address */
+			int32_t destinationIPv4Address;
+			int32_t destinationAnonymisationType;
+			int32_t protocolIdentifier;
+			int32_t sourceTransportPort;
+			int32_t destinationTransportPort;
+			int32_t icmpTypeCodeIPv4;
+			int32_t tcpControlBits;
+			uint16_t tcpControlBitsLength;
+			TimeField flowStart;
+			TimeField revFlowStart;
+			TimeField flowEnd;
+			TimeField revFlowEnd;
+			int32_t octetDeltaCount;
+			int32_t packetDeltaCount;
+			int32_t revOctetDeltaCount;
+			int32_t revPacketDeltaCount;
+			int32_t revTcpControlBits;
+			uint16_t revTcpControlBitsLength;
+		};
+
+		std::map<uint16_t, FieldOffsets> fieldOffsets; /**< by uniqueId of the Template */
+		FieldOffsets variableLengthOffsets; /**< offsets of the current record, not cached */
+
 		//to calculate criteria after given timeouts
 		void registerTimeout();
-		uint64_t retrieveTime(IpfixDataRecord* record, InformationElement::IeId id1, InformationElement::IeId id2,
+		const FieldOffsets& getFieldOffsets(TemplateInfo* templateInfo);
+		static int32_t anonymisationTypeOffset(TemplateInfo* templateInfo, int idx);
+		static TimeField timeField(TemplateInfo* templateInfo, InformationElement::IeId id1, InformationElement::IeId id2,
 				InformationElement::IeId id3, InformationElement::IeEnterpriseNumber pen);
+		static uint64_t retrieveTime(IpfixRecord::Data* data, const TimeField& field);
 
 		//file write operations
+		void writeData(struct iovec* iov, int iovcnt);
 		void writeFileHeader();
 		void writeChunkList();
 		void closeFile();
@@ -130,8 +179,7 @@ class IpfixCsExporter : public Module, public Source<NullEmitable*>, public Ipfi
 			uint16_t  rev_tcp_control_bits;
 		} DISABLE_ALIGNMENT
 
-		list<Ipfix_basic_flow*> chunkList;
-		uint32_t chunkListSize;
+		std::vector<Ipfix_basic_flow> chunkBuffer; /**< records of the next chunk, keeps its capacity */
 };
 
 
@@ -19,6 +19,7 @@
  */
 
 #include "common/msg.h"
+#include "common/CompressedFile.h"
 #include "core/XMLElement.h"
 
 #include "IpfixCsExporterCfg.hpp"
@@ -43,7 +44,9 @@ IpfixCsExporterCfg::IpfixCsExporterCfg(XMLElement* elem)
 	maxChunkBufferTime(300),
 	maxChunkBufferRecords(50000),
 	maxFileCreationInterval(1500),
-	exportMode(0)
+	exportMode(0),
+	compression(false),
+	compressionLevel(COMPRESSION_DEFAULT_LEVEL)
 {
 	if (!elem) return;  // needed because of table inside ConfigManager
 
@@ -71,6 +74,21 @@ IpfixCsExporterCfg::IpfixCsExporterCfg(XMLElement* elem)
 				msg(LOG_CRIT, "Unknown ipfixCsExporter-exportMode config value %i\n",exportMode);
 	                        continue;
 			}
+		} else if (e->matches("compression")) {
+			std::string c = e->getFirstText();
+			if (c == "none") {
+				compression = false;
+			} else if (c == "gzip") {
+				if (!compression_supported())
+					THROWEXCEPTION("ipfixCsExporter: gzip compression requested, but Vermont was compiled without zlib support");
+				compression = true;
+			} else {
+				THROWEXCEPTION("ipfixCsExporter: unknown compression '%s', use 'none' or 'gzip'", c.c_str());
+			}
+		} else if (e->matches("compressionLevel")) {
+			compressionLevel = getInt("compressionLevel");
+			if (compressionLevel < 1 || compressionLevel > 9)
+				THROWEXCEPTION("ipfixCsExporter: compressionLevel must be between 1 and 9");
 		} else {
 			msg(LOG_CRIT, "Unknown ipfixCsExporter config statement %s\n",
 				 e->getName().c_str());
@@ -88,7 +106,8 @@ IpfixCsExporter* IpfixCsExporterCfg::createInstance()
 {
 	instance = new IpfixCsExporter(filenamePrefix, destinationPath, maxFileSize,
 					maxChunkBufferTime, maxChunkBufferRecords,
-					maxFileCreationInterval, exportMode);
+					maxFileCreationInterval, exportMode,
+					compression ? compressionLevel : 0);
 	return instance;
 }
 
@@ -100,7 +119,9 @@ bool IpfixCsExporterCfg::deriveFrom(IpfixCsExporterCfg* old)
 	    maxChunkBufferTime != old-> maxChunkBufferTime ||
             maxChunkBufferRecords != old-> maxChunkBufferRecords ||
             maxFileCreationInterval != old-> maxFileCreationInterval ||
-            exportMode != old->exportMode
+            exportMode != old->exportMode ||
+	    compression != old->compression ||
+	    compressionLevel != old->compressionLevel
       	    ) return false;
 		
 	return true;
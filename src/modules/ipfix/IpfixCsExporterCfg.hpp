@@ -62,6 +62,9 @@ private:
         //time in seconds between creation of a new output file
         uint32_t maxFileCreationInterval;
 	uint8_t exportMode;
+	//gzip-compress the output files with zlib level compressionLevel
+	bool compression;
+	int compressionLevel;
 };
 
 #endif /*IPFIXCSEXPORTERCFG_H_*/
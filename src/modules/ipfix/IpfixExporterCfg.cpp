@@ -28,7 +28,7 @@ IpfixExporterCfg::IpfixExporterCfg(XMLElement* elem)
 	: CfgHelper<IpfixSender, IpfixExporterCfg>(elem, "ipfixExporter"),
 	templateRefreshTime(IS_DEFAULT_TEMPLATE_TIMEINTERVAL), /* templateRefreshRate(0), */
 	sctpDataLifetime(0), sctpReconnectInterval(0), export_protocol(IPFIX_PROTOCOL),
-	recordRateLimit(0), observationDomainId(0),
+	recordRateLimit(0), observationDomainId(0), sendBatchSize(IS_DEFAULT_SENDBATCHSIZE),
 	dtlsMaxConnectionLifetime(0)
 {
 
@@ -39,6 +39,10 @@ IpfixExporterCfg::IpfixExporterCfg(XMLElement* elem)
 	recordRateLimit = getInt("maxRecordRate", IS_DEFAULT_MAXRECORDRATE);
 	msg(LOG_NOTICE, "Exporter: using maximum rate of %d records/second", recordRateLimit);
 	observationDomainId = getInt("observationDomainId", 0);
+	int batchSize = getInt("sendBatchSize", IS_DEFAULT_SENDBATCHSIZE);
+	if (batchSize < 0 || batchSize > IPFIX_MAX_SEND_BATCH_SIZE)
+		THROWEXCEPTION("Invalid configuration parameter for sendBatchSize (%d), maximum is %d", batchSize, IPFIX_MAX_SEND_BATCH_SIZE);
+	sendBatchSize = batchSize;
 	sctpDataLifetime = getTimeInUnit("sctpDataLifetime", mSEC, IS_DEFAULT_SCTP_DATALIFETIME);
 	sctpReconnectInterval = getTimeInUnit("sctpReconnectInterval", SEC, IS_DEFAULT_SCTP_RECONNECTINTERVAL);
 	/* templateRefreshRate = getInt("templateRefreshRate", IS_DEFAULT_TEMPLATE_RECORDINTERVAL); */
@@ -70,6 +74,7 @@ IpfixExporterCfg::IpfixExporterCfg(XMLElement* elem)
 				/* e->matches("templateRefreshRate") || */
 				e->matches("templateRefreshInterval") ||
 				e->matches("observationDomainId") ||
+				e->matches("sendBatchSize") ||
 				e->matches("cert") ||
 				e->matches("key") ||
 				e->matches("CAfile") ||
@@ -103,7 +108,8 @@ IpfixSender* IpfixExporterCfg::createInstance()
 {
 	instance = new IpfixSender(observationDomainId, recordRateLimit, sctpDataLifetime, 
 			sctpReconnectInterval, templateRefreshTime,
-			certificateChainFile, privateKeyFile, caFile, caPath, export_protocol);
+			certificateChainFile, privateKeyFile, caFile, caPath, export_protocol,
+			sendBatchSize);
 
 	std::vector<CollectorCfg*>::const_iterator it;
 	for (it = collectors.begin(); it != collectors.end(); it++) {
@@ -171,7 +177,9 @@ IpfixSender* IpfixExporterCfg::createInstance()
 			p->getIpAddress().c_str(),
 			p->getPort(), p->getProtocol(),
 			aux_config,
-			p->getVrfName().c_str());
+			p->getVrfName().c_str(),
+			p->getSendQueueLength(),
+			p->getSendQueuePolicy());
 	}
 
 	return instance;
@@ -195,6 +203,7 @@ bool IpfixExporterCfg::equalTo(IpfixExporterCfg* other)
 	if (sctpReconnectInterval != other->sctpReconnectInterval) return false;
 	if (recordRateLimit != other->recordRateLimit) return false;
 	if (observationDomainId != other->observationDomainId) return false;
+	if (sendBatchSize != other->sendBatchSize) return false;
 	if (certificateChainFile != other->certificateChainFile) return false;
 	if (privateKeyFile != other->privateKeyFile) return false;
 	if (caFile != other->caFile) return false;
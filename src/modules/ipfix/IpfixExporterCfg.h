@@ -58,6 +58,7 @@ private:
 	export_protocol_version export_protocol;
 	uint32_t recordRateLimit;
 	uint32_t observationDomainId;
+	uint16_t sendBatchSize;
 	
 	/** DTLS parameters */
 	std::string certificateChainFile;
@@ -23,6 +23,7 @@
 
 #include "common/ipfixlolib/ipfixlolib.h"
 #include "common/ipfixlolib/ipfix.h"
+#include "common/ipfixlolib/ipfixlolib_config.h"
 #include "common/msg.h"
 
 #include <stdexcept>
@@ -41,7 +42,8 @@
  * Creates a new IPFIXFileWriter. Do not forget to call @c startIpfixFileWriter() to begin sending
  */
 IpfixFileWriter::IpfixFileWriter(uint16_t observationDomainId, std::string filenamePrefix, 
-	std::string destinationPath, uint32_t maximumFilesize)
+	std::string destinationPath, uint32_t maximumFilesize, bool writeIndex,
+	int compressionLevel)
 			: IpfixSender(observationDomainId, MAX_RECORD_RATE)
 {
 	// check if directory base exists
@@ -50,7 +52,8 @@ IpfixFileWriter::IpfixFileWriter(uint16_t observationDomainId, std::string filen
 	}
 
 	if (filenamePrefix != "") {
-		if(addCollector(observationDomainId, filenamePrefix, destinationPath, maximumFilesize) != 0) {
+		if(addCollector(observationDomainId, filenamePrefix, destinationPath, maximumFilesize, writeIndex,
+					compressionLevel) != 0) {
 			THROWEXCEPTION("IpfixFileWriter's Collector addition failed");
 			return;
 		}
@@ -67,11 +70,19 @@ IpfixFileWriter::~IpfixFileWriter() {
 /**
  * Add another IPFIX collector to export the stream to
  * the lowlevel stuff in handled by underlying ipfixlolib
+ * If @c writeIndex is set, every file gets a sidecar index which IpfixReceiverFile
+ * uses to start a replay at a given export time.
+ * A @c compressionLevel greater than 0 gzip-compresses the files while they are
+ * written, @c maximumFilesize then refers to the uncompressed size.
  */
 int IpfixFileWriter::addCollector(uint16_t observationDomainId, std::string filenamePrefix, 
-			std::string destinationPath, uint32_t maximumFilesize) 
+			std::string destinationPath, uint32_t maximumFilesize, bool writeIndex,
+			int compressionLevel)
 {
 	ipfix_exporter *ex = (ipfix_exporter *)ipfixExporter;
+	ipfix_aux_config_datafile acd;
+	acd.write_index = writeIndex;
+	acd.compression_level = compressionLevel;
 	
 	if(destinationPath.at(destinationPath.length()-1) != '/') 
 		destinationPath += "/";
@@ -81,7 +92,7 @@ int IpfixFileWriter::addCollector(uint16_t observationDomainId, std::string file
 		 msg(LOG_ERR, 
 		   "maximum filsize < maximum message length - this could lead to serious problems");
 
-	if(ipfix_add_collector(ex, my_filename.c_str(), maximumFilesize, DATAFILE, NULL, "") != 0) {
+	if(ipfix_add_collector(ex, my_filename.c_str(), maximumFilesize, DATAFILE, &acd, "") != 0) {
 		msg(LOG_CRIT, "IpfixFileWriter: ipfix_add_collector of %s failed", my_filename.c_str());
 		return -1;
 	}
@@ -90,6 +101,9 @@ int IpfixFileWriter::addCollector(uint16_t observationDomainId, std::string file
 	msg(LOG_NOTICE, "IpfixFileWriter initialized with the following parameters");
 	msg(LOG_NOTICE, "  - Basename = %s", my_filename.c_str());
 	msg(LOG_NOTICE, "  - maximumFilesize = %d KiB" , maximumFilesize);
+	msg(LOG_NOTICE, "  - writeIndex = %s", writeIndex ? "true" : "false");
+	if (compressionLevel > 0)
+		msg(LOG_NOTICE, "  - compression = gzip, level %d", compressionLevel);
 
 	return 0;
 }
@@ -41,11 +41,13 @@ class IpfixFileWriter :  public IpfixSender
 {
 	public:
 		IpfixFileWriter(uint16_t observationDomainId, std::string filenamePrefix, 
-			std::string destinationPath, uint32_t maximumFilesize);
+			std::string destinationPath, uint32_t maximumFilesize, bool writeIndex,
+			int compressionLevel);
 
 		~IpfixFileWriter();
 		int addCollector(uint16_t observationDomainId, std::string filenamePrefix, 
-					std::string destinationPath, uint32_t maximumFilesize);
+					std::string destinationPath, uint32_t maximumFilesize, bool writeIndex,
+					int compressionLevel);
 
 	private:
 		std::string filenamePrefix;
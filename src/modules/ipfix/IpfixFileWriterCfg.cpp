@@ -19,6 +19,7 @@
  */
 
 #include "common/msg.h"
+#include "common/CompressedFile.h"
 #include "core/XMLElement.h"
 
 #include "IpfixFileWriterCfg.hpp"
@@ -39,7 +40,10 @@ IpfixFileWriterCfg::IpfixFileWriterCfg(XMLElement* elem)
 	destinationPath("./"),
 	filenamePrefix("ipfix.dump"),
 	maximumFilesize(DEFAULTFILESIZE),
-	observationDomainId(0)
+	observationDomainId(0),
+	writeIndex(true),
+	compression(false),
+	compressionLevel(COMPRESSION_DEFAULT_LEVEL)
 {
 	if (!elem) return;  // needed because of table inside ConfigManager
 
@@ -57,6 +61,23 @@ IpfixFileWriterCfg::IpfixFileWriterCfg(XMLElement* elem)
 			filenamePrefix = e->getFirstText();
 		} else if (e->matches("observationDomainId")) {
 			observationDomainId = getInt("observationDomainId");
+		} else if (e->matches("writeIndex")) {
+			writeIndex = getBool("writeIndex", writeIndex);
+		} else if (e->matches("compression")) {
+			std::string c = e->getFirstText();
+			if (c == "none") {
+				compression = false;
+			} else if (c == "gzip") {
+				if (!compression_supported())
+					THROWEXCEPTION("ipfixFileWriter: gzip compression requested, but Vermont was compiled without zlib support");
+				compression = true;
+			} else {
+				THROWEXCEPTION("ipfixFileWriter: unknown compression '%s', use 'none' or 'gzip'", c.c_str());
+			}
+		} else if (e->matches("compressionLevel")) {
+			compressionLevel = getInt("compressionLevel");
+			if (compressionLevel < 1 || compressionLevel > 9)
+				THROWEXCEPTION("ipfixFileWriter: compressionLevel must be between 1 and 9");
 		}
 		 else {
 			msg(LOG_CRIT, "Unknown ipfixFileWriter config statement %s\n",
@@ -74,7 +95,8 @@ IpfixFileWriterCfg::~IpfixFileWriterCfg()
 IpfixFileWriter* IpfixFileWriterCfg::createInstance()
 {
 	instance = new IpfixFileWriter(observationDomainId, 
-			filenamePrefix, destinationPath, maximumFilesize);
+			filenamePrefix, destinationPath, maximumFilesize, writeIndex,
+			compression ? compressionLevel : 0);
 	return instance;
 }
 
@@ -82,7 +104,10 @@ bool IpfixFileWriterCfg::deriveFrom(IpfixFileWriterCfg* old)
 {
 	if (maximumFilesize != old->maximumFilesize ||
 	    destinationPath != old->destinationPath ||
-	    filenamePrefix != old->filenamePrefix
+	    filenamePrefix != old->filenamePrefix ||
+	    writeIndex != old->writeIndex ||
+	    compression != old->compression ||
+	    compressionLevel != old->compressionLevel
 	    ) return false;
 		
 	return true;
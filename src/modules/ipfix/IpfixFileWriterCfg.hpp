@@ -54,6 +54,9 @@ private:
 	std::string filenamePrefix;
 	uint32_t maximumFilesize;
 	uint16_t observationDomainId;
+	bool writeIndex;
+	bool compression;
+	int compressionLevel;
 };
 
 #endif /*IPFIXFILEWRITERCFG_H_*/
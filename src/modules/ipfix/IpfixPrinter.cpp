@@ -21,6 +21,7 @@
 
 #include "IpfixPrinter.hpp"
 #include "common/Misc.h"
+#include "core/Timer.h"
 #include "Connection.h"
 
 #include <stdlib.h>
@@ -28,6 +29,7 @@
 #include <stdio.h>
 #include <arpa/inet.h>
 #include <inttypes.h>
+#include <ctype.h>
 
 /**
  * print functions which have formerly been in IpfixParser.cpp
@@ -359,12 +361,91 @@ ntp64 PrintHelpers::u64_to_ntp64(const uint64_t &number)
 	return ntp64_number;
 }
 
+
+/**
+ * formatters of the json output type, each returns the position behind the written text
+ */
+
+static char* appendUint(char* p, uint64_t v)
+{
+	char tmp[20];
+	int n = 0;
+	do {
+		tmp[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n)
+		*p++ = tmp[--n];
+	return p;
+}
+
+static char* appendInt(char* p, int64_t v)
+{
+	if (v < 0) {
+		*p++ = '-';
+		return appendUint(p, -(uint64_t)v);
+	}
+	return appendUint(p, v);
+}
+
+static char* appendText(char* p, const char* text)
+{
+	while (*text)
+		*p++ = *text++;
+	return p;
+}
+
+/**
+ * reads an unsigned integer of up to 8 bytes in network byte order
+ */
+static uint64_t readUint(const IpfixRecord::Data* data, uint16_t length)
+{
+	uint64_t v = 0;
+	for (uint16_t i = 0; i < length; i++)
+		v = (v << 8) | data[i];
+	return v;
+}
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static char* appendHex(char* p, const IpfixRecord::Data* data, uint16_t length)
+{
+	*p++ = '"';
+	for (uint16_t i = 0; i < length; i++) {
+		*p++ = hexDigits[data[i] >> 4];
+		*p++ = hexDigits[data[i] & 0xF];
+	}
+	*p++ = '"';
+	return p;
+}
+
+static char* appendString(char* p, const IpfixRecord::Data* data, uint16_t length)
+{
+	*p++ = '"';
+	for (uint16_t i = 0; i < length; i++) {
+		uint8_t c = data[i];
+		if (c == '"' || c == '\\') {
+			*p++ = '\\';
+			*p++ = c;
+		} else if (c >= 0x20 && c < 0x7F) {
+			*p++ = c;
+		} else {
+			p = appendText(p, "\\u00");
+			*p++ = hexDigits[c >> 4];
+			*p++ = hexDigits[c & 0xF];
+		}
+	}
+	*p++ = '"';
+	return p;
+}
+
+
 /**
  * Creates a new IpfixPrinter. Do not forget to call @c startIpfixPrinter() to begin printing
  * @return handle to use when calling @c destroyIpfixPrinter()
  */
 IpfixPrinter::IpfixPrinter(OutputType outputtype, string filename)
-	: linesPrinted(0), outputType(outputtype), filename(filename)
+	: linesPrinted(0), outputType(outputtype), filename(filename), jsonLength(0), timeoutRegistered(false)
 {
 	lastTemplate = 0;
 
@@ -375,6 +456,7 @@ IpfixPrinter::IpfixPrinter(OutputType outputtype, string filename)
 		case LINE: type = "line"; break;
 		case TABLE: type = "table"; break;
 		case NONE: type = "no output"; break;
+		case JSON: type = "json"; break;
 	}
 	msg(LOG_NOTICE, "  - outputType=%s", type.c_str());
 	string file = "standard output";
@@ -388,6 +470,9 @@ IpfixPrinter::IpfixPrinter(OutputType outputtype, string filename)
 			THROWEXCEPTION("IpfixPrinter: error opening file '%s': %s (%u)", filename.c_str(), strerror(errno), errno);
 	}
 
+	if (outputtype==JSON)
+		jsonBuffer.resize(IPFIX_PRINTER_BUFFER_SIZE);
+
 	if (outputtype==TABLE)
 		fprintf(fh, "srcip\tdstip\tsrcport\tdstport\tprot\tsrcpkts\tdstpkts\tsrcoct\tdstoct\tsrcstart\tsrcend\tdststart\tdstend\tsrcplen\tdstplen\tforcedexp\trevstart\tflowcnt\ttranoct\trevtranoct\n");
 }
@@ -397,6 +482,7 @@ IpfixPrinter::IpfixPrinter(OutputType outputtype, string filename)
  */
 IpfixPrinter::~IpfixPrinter()
 {
+	flushJson();
 	if (filename != "") {
 		int ret = fclose(fh);
 		if (ret)
@@ -458,6 +544,12 @@ void IpfixPrinter::onTemplate(IpfixTemplateRecord* record)
 			fprintf(fh, " `---\n\n");
 			break;
 
+		case JSON:
+			// uniqueIds are reused after the destruction of a Template
+			jsonColumns.erase(record->templateInfo->getUniqueId());
+			getJsonColumns(record->templateInfo.get());
+			break;
+
 		case TABLE:
 		case NONE:
 			break;
@@ -473,6 +565,12 @@ void IpfixPrinter::onTemplate(IpfixTemplateRecord* record)
 void IpfixPrinter::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
 {
 	boost::shared_ptr<TemplateInfo> templateInfo = record->templateInfo;
+	if (outputType == JSON) {
+		// only Data Records are printed as json
+		jsonColumns.erase(templateInfo->getUniqueId());
+		record->removeReference();
+		return;
+	}
 	switch(templateInfo->setId) {
 		case TemplateInfo::NetflowTemplate:
 			fprintf(fh, "\n-+--- Destroyed Netflow Template (id=%u, uniqueId=%u) from ", templateInfo->templateId, templateInfo->getUniqueId());
@@ -764,6 +862,9 @@ void IpfixPrinter::onDataRecord(IpfixDataRecord* record)
 		case TABLE:
 			printTableRecord(record);
 			break;
+		case JSON:
+			printJsonRecord(record);
+			break;
 		case NONE:
 			break;
 	}
@@ -771,4 +872,300 @@ void IpfixPrinter::onDataRecord(IpfixDataRecord* record)
 	record->removeReference();
 }
 
+/**
+ * chooses the formatter for a field type of the json output type
+ */
+IpfixPrinter::JsonColumn::Format IpfixPrinter::getJsonFormat(const InformationElement::IeInfo& type)
+{
+	if (type == InformationElement::IeInfo(IPFIX_ETYPEID_frontPayload, IPFIX_PEN_vermont) ||
+		type == InformationElement::IeInfo(IPFIX_ETYPEID_frontPayload, IPFIX_PEN_vermont|IPFIX_PEN_reverse))
+		return JsonColumn::STRING;
+
+	const ipfix_identifier* ident = ipfix_id_lookup(type.id, type.enterprise);
+	if (!ident && type.enterprise == IPFIX_PEN_reverse)
+		ident = ipfix_id_lookup(type.id, 0);
+	if (ident) {
+		switch (ident->type) {
+			case IPFIX_TYPE_unsigned8:
+			case IPFIX_TYPE_unsigned16:
+			case IPFIX_TYPE_unsigned32:
+			case IPFIX_TYPE_unsigned64:
+				return JsonColumn::UINT;
+			case IPFIX_TYPE_signed8:
+			case IPFIX_TYPE_signed16:
+			case IPFIX_TYPE_signed32:
+			case IPFIX_TYPE_signed64:
+				return JsonColumn::INT;
+			case IPFIX_TYPE_float32:
+			case IPFIX_TYPE_float64:
+				return JsonColumn::FLOAT;
+			case IPFIX_TYPE_boolean:
+				return JsonColumn::BOOLEAN;
+			case IPFIX_TYPE_macAddress:
+				return JsonColumn::MAC;
+			case IPFIX_TYPE_string:
+				return JsonColumn::STRING;
+			case IPFIX_TYPE_dateTimeSeconds:
+				return JsonColumn::SECONDS;
+			case IPFIX_TYPE_dateTimeMilliseconds:
+				return JsonColumn::MILLISECONDS;
+			case IPFIX_TYPE_dateTimeMicroseconds:
+				return JsonColumn::MICROSECONDS;
+			case IPFIX_TYPE_dateTimeNanoseconds:
+				return JsonColumn::NANOSECONDS;
+			case IPFIX_TYPE_ipv4Address:
+				return JsonColumn::IPV4;
+			case IPFIX_TYPE_ipv6Address:
+				return JsonColumn::IPV6;
+			case IPFIX_TYPE_basicList:
+				return JsonColumn::LIST;
+		}
+	}
+	// like the other output types, print fields of integer size as numbers
+	if (type.length == 1 || type.length == 2 || type.length == 4 || type.length == 8)
+		return JsonColumn::UINT;
+	return JsonColumn::HEX;
+}
+
+/**
+ * returns the formatters of the fields of a Template, chooses them on first use
+ */
+const std::vector<IpfixPrinter::JsonColumn>& IpfixPrinter::getJsonColumns(TemplateInfo* templateInfo)
+{
+	std::map<uint16_t, std::vector<JsonColumn> >::iterator it = jsonColumns.find(templateInfo->getUniqueId());
+	if (it != jsonColumns.end())
+		return it->second;
+
+	std::vector<JsonColumn>& columns = jsonColumns[templateInfo->getUniqueId()];
+	int count = templateInfo->scopeCount + templateInfo->fieldCount;
+	for (int i = 0; i < count; i++) {
+		bool scope = i < templateInfo->scopeCount;
+		TemplateInfo::FieldInfo* fi = scope ? &templateInfo->scopeInfo[i] : &templateInfo->fieldInfo[i - templateInfo->scopeCount];
+		JsonColumn c;
+		c.scope = scope;
+		c.index = scope ? i : i - templateInfo->scopeCount;
+		c.format = getJsonFormat(fi->type);
+		c.elementFormat = JsonColumn::HEX;
+		if (c.format == JsonColumn::LIST)
+			c.elementFormat = getJsonFormat(*fi->basicListData.fieldIe);
+
+		const ipfix_identifier* ident = ipfix_id_lookup(fi->type.id, fi->type.enterprise);
+		c.key = "\"";
+		if (ident) {
+			c.key += ident->name;
+		} else if (fi->type.enterprise == IPFIX_PEN_reverse && (ident = ipfix_id_lookup(fi->type.id, 0)) != NULL) {
+			// same naming as the reverse Vermont IEs, e.g. revFrontPayload
+			c.key += "rev";
+			c.key += toupper(ident->name[0]);
+			c.key += ident->name + 1;
+		} else {
+			char name[32];
+			snprintf(name, ARRAY_SIZE(name), "%u_%hu", fi->type.enterprise, fi->type.id);
+			c.key += name;
+		}
+		c.key += "\":";
+		columns.push_back(c);
+	}
+	return columns;
+}
+
+/**
+ * formats a value for the json output type, returns the position behind it.
+ * At most 6 * length + IPFIX_PRINTER_MAX_JSON_VALUE characters are written.
+ */
+char* IpfixPrinter::appendJsonValue(char* p, JsonColumn::Format format, const IpfixRecord::Data* data, uint16_t length)
+{
+	uint64_t v;
+	double d;
+	float f;
+
+	switch (format) {
+		case JsonColumn::UINT:
+			if (length > 8)
+				return appendHex(p, data, length);
+			return appendUint(p, readUint(data, length));
+		case JsonColumn::INT:
+			if (length == 0 || length > 8)
+				return appendHex(p, data, length);
+			v = readUint(data, length);
+			// sign extension of reduced size encodings
+			if (length < 8 && (v & ((uint64_t)1 << (length*8 - 1))))
+				v |= ~(uint64_t)0 << (length*8);
+			return appendInt(p, (int64_t)v);
+		case JsonColumn::BOOLEAN:
+			// IPFIX encodes true as 1 and false as 2
+			return appendText(p, length == 1 && data[0] == 1 ? "true" : "false");
+		case JsonColumn::FLOAT:
+			if (length == 8) {
+				v = ntohll(*(uint64_t*)data);
+				memcpy(&d, &v, sizeof(d));
+			} else if (length == 4) {
+				uint32_t u = ntohl(*(uint32_t*)data);
+				memcpy(&f, &u, sizeof(f));
+				d = f;
+			} else {
+				return appendHex(p, data, length);
+			}
+			if (d != d || d - d != 0)
+				return appendText(p, "null");
+			return p + snprintf(p, IPFIX_PRINTER_MAX_JSON_VALUE, "%.17g", d);
+		case JsonColumn::IPV4:
+			if (length != 4 && length != 5)
+				return appendHex(p, data, length);
+			*p++ = '"';
+			for (int i = 0; i < 4; i++) {
+				if (i > 0)
+					*p++ = '.';
+				p = appendUint(p, data[i]);
+			}
+			// Vermont appends the inverse prefix length as fifth byte
+			if (length == 5) {
+				*p++ = '/';
+				p = appendUint(p, 32 - data[4]);
+			}
+			*p++ = '"';
+			return p;
+		case JsonColumn::IPV6:
+			if (length != 16 || !inet_ntop(AF_INET6, data, p + 1, INET6_ADDRSTRLEN))
+				return appendHex(p, data, length);
+			*p = '"';
+			p += strlen(p);
+			*p++ = '"';
+			return p;
+		case JsonColumn::MAC:
+			*p++ = '"';
+			for (uint16_t i = 0; i < length; i++) {
+				if (i > 0)
+					*p++ = ':';
+				*p++ = hexDigits[data[i] >> 4];
+				*p++ = hexDigits[data[i] & 0xF];
+			}
+			*p++ = '"';
+			return p;
+		case JsonColumn::SECONDS:
+		case JsonColumn::MILLISECONDS:
+			if (length > 8)
+				return appendHex(p, data, length);
+			return appendUint(p, readUint(data, length));
+		case JsonColumn::MICROSECONDS:
+		case JsonColumn::NANOSECONDS:
+			// NTP timestamps, printed as microseconds or nanoseconds since 1970
+			if (length != 8)
+				return appendHex(p, data, length);
+			v = readUint(data, 8);
+			if (v == 0)
+				return appendUint(p, 0);
+			if (format == JsonColumn::MICROSECONDS)
+				return appendUint(p, ((v >> 32) - GETTIMEOFDAY_TO_NTP_OFFSET) * 1000000 + (((v & 0xFFFFFFFF) * 1000000) >> 32));
+			return appendUint(p, ((v >> 32) - GETTIMEOFDAY_TO_NTP_OFFSET) * 1000000000 + (((v & 0xFFFFFFFF) * 1000000000) >> 32));
+		case JsonColumn::STRING:
+			return appendString(p, data, length);
+		case JsonColumn::HEX:
+		case JsonColumn::LIST:
+			break;
+	}
+	return appendHex(p, data, length);
+}
+
+/**
+ * returns space for length bytes in the output buffer, writes the buffer if necessary
+ */
+char* IpfixPrinter::reserveJson(size_t length)
+{
+	if (jsonLength + length > jsonBuffer.size()) {
+		flushJson();
+		if (length > jsonBuffer.size())
+			jsonBuffer.resize(length);
+	}
+	return &jsonBuffer[jsonLength];
+}
 
+void IpfixPrinter::flushJson()
+{
+	if (jsonLength == 0)
+		return;
+	if (fwrite(&jsonBuffer[0], jsonLength, 1, fh) != 1 || fflush(fh) != 0)
+		msg(LOG_ERR, "IpfixPrinter: error writing output: %s (%u)", strerror(errno), errno);
+	jsonLength = 0;
+}
+
+/**
+ * prints a Data Record as one line of json
+ */
+void IpfixPrinter::printJsonRecord(IpfixDataRecord* record)
+{
+	TemplateInfo* templateInfo = record->templateInfo.get();
+	const std::vector<JsonColumn>& columns = getJsonColumns(templateInfo);
+
+	char* p = reserveJson(1);
+	*p++ = '{';
+	jsonLength++;
+	for (size_t i = 0; i < columns.size(); i++) {
+		const JsonColumn& c = columns[i];
+		TemplateInfo::FieldInfo* fi = c.scope ? &templateInfo->scopeInfo[c.index] : &templateInfo->fieldInfo[c.index];
+		IpfixRecord::Data* data = record->data + fi->offset;
+
+		if (c.format == JsonColumn::LIST) {
+			const vector<void*>* list = *(vector<void*>**)data;
+			uint16_t length = fi->basicListData.fieldIe->length;
+			p = reserveJson(c.key.length() + 3);
+			memcpy(p, c.key.data(), c.key.length());
+			p += c.key.length();
+			*p++ = '[';
+			jsonLength = p - &jsonBuffer[0];
+			for (size_t j = 0; j < list->size(); j++) {
+				p = reserveJson(6 * (size_t)length + IPFIX_PRINTER_MAX_JSON_VALUE + 1);
+				if (j > 0)
+					*p++ = ',';
+				p = appendJsonValue(p, c.elementFormat, (IpfixRecord::Data*)(*list)[j], length);
+				jsonLength = p - &jsonBuffer[0];
+			}
+			p = reserveJson(2);
+			*p++ = ']';
+		} else {
+			p = reserveJson(c.key.length() + 6 * (size_t)fi->type.length + IPFIX_PRINTER_MAX_JSON_VALUE + 1);
+			memcpy(p, c.key.data(), c.key.length());
+			p += c.key.length();
+			p = appendJsonValue(p, c.format, data, fi->type.length);
+		}
+		if (i + 1 < columns.size())
+			*p++ = ',';
+		jsonLength = p - &jsonBuffer[0];
+	}
+	p = reserveJson(2);
+	*p++ = '}';
+	*p++ = '\n';
+	jsonLength += 2;
+}
+
+void IpfixPrinter::registerTimeout()
+{
+	// when this module is not connected, no timer is available
+	if (!timer || timeoutRegistered)
+		return;
+	struct timespec timeout;
+	addToCurTime(&timeout, IPFIX_PRINTER_FLUSH_INTERVAL);
+	timer->addTimeout(this, timeout, NULL);
+	timeoutRegistered = true;
+}
+
+void IpfixPrinter::onTimeout(void* dataPtr)
+{
+	timeoutRegistered = false;
+	flushJson();
+	registerTimeout();
+}
+
+void IpfixPrinter::performStart()
+{
+	if (outputType == JSON)
+		registerTimeout();
+}
+
+void IpfixPrinter::performShutdown()
+{
+	flushJson();
+	if (timeoutRegistered)
+		timer->removeTimeout(NULL);
+	timeoutRegistered = false;
+}
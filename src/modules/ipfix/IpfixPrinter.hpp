@@ -23,9 +23,20 @@
 
 
 #include "core/Module.h"
+#include "core/Notifiable.h"
 #include "common/Time.h"
 #include "IpfixRecordDestination.h"
 
+#include <map>
+#include <vector>
+
+/* size of the output buffer of the json output type */
+#define IPFIX_PRINTER_BUFFER_SIZE (1024*1024)
+/* maximum time in ms records stay in the output buffer of the json output type */
+#define IPFIX_PRINTER_FLUSH_INTERVAL 1000
+/* maximum length of a json value besides the escaped characters of strings */
+#define IPFIX_PRINTER_MAX_JSON_VALUE 48
+
 class PrintHelpers
 {
 	public:
@@ -54,11 +65,17 @@ class PrintHelpers
  * IPFIX Printer module.
  *
  * Prints received flows to stdout or file
+ *
+ * The json output type prints one JSON object per Data Record and line
+ * (NDJSON) for log shippers. It does not use stdio for formatting: the
+ * formatter of each field is chosen once per Template and the records are
+ * collected in a large buffer, which is written when it is full or at the
+ * latest after IPFIX_PRINTER_FLUSH_INTERVAL.
  */
-class IpfixPrinter : public Module, public IpfixRecordDestination, public Source<NullEmitable*>, private PrintHelpers
+class IpfixPrinter : public Module, public IpfixRecordDestination, public Source<NullEmitable*>, public Notifiable, private PrintHelpers
 {
 	public:
-		enum OutputType { TREE = 0, LINE, TABLE, NONE };
+		enum OutputType { TREE = 0, LINE, TABLE, NONE, JSON };
 
 		IpfixPrinter(OutputType outputtype = TREE, string filename = "");
 		~IpfixPrinter();
@@ -66,18 +83,49 @@ class IpfixPrinter : public Module, public IpfixRecordDestination, public Source
 		virtual void onDataRecord(IpfixDataRecord* record);
 		virtual void onTemplate(IpfixTemplateRecord* record);
 		virtual void onTemplateDestruction(IpfixTemplateDestructionRecord* record);
+		virtual void onTimeout(void* dataPtr);
 
 	protected:
 		void* lastTemplate;
 		uint32_t linesPrinted;
 
+		virtual void performStart();
+		virtual void performShutdown();
+
 	private:
+		/**
+		 * formatting of a field by the json output type
+		 */
+		struct JsonColumn {
+			enum Format { UINT, INT, BOOLEAN, FLOAT, IPV4, IPV6, MAC, SECONDS, MILLISECONDS,
+				MICROSECONDS, NANOSECONDS, STRING, HEX, LIST };
+
+			Format format;
+			Format elementFormat; /**< format of the elements of a basicList */
+			bool scope; /**< field is a scope field */
+			int index; /**< index in scopeInfo or fieldInfo, offsets of variable length fields change per record */
+			std::string key; /**< "<name>": */
+		};
+
 		OutputType outputType;
 		string filename;
 
+		std::map<uint16_t, std::vector<JsonColumn> > jsonColumns; /**< by uniqueId of the Template */
+		std::vector<char> jsonBuffer;
+		size_t jsonLength; /**< bytes used in jsonBuffer */
+		bool timeoutRegistered;
+
 		void printOneLineRecord(IpfixDataRecord* record);
 		void printTreeRecord(IpfixDataRecord* record);
 		void printTableRecord(IpfixDataRecord* record);
+		void printJsonRecord(IpfixDataRecord* record);
+
+		const std::vector<JsonColumn>& getJsonColumns(TemplateInfo* templateInfo);
+		static JsonColumn::Format getJsonFormat(const InformationElement::IeInfo& type);
+		static char* appendJsonValue(char* p, JsonColumn::Format format, const IpfixRecord::Data* data, uint16_t length);
+		char* reserveJson(size_t length);
+		void flushJson();
+		void registerTimeout();
 };
 
 #endif
@@ -42,6 +42,8 @@ IpfixPrinterCfg::IpfixPrinterCfg(XMLElement* elem)
 				outputType = IpfixPrinter::TABLE;
 			} else if (type=="none") {
 				outputType = IpfixPrinter::NONE;
+			} else if (type=="json") {
+				outputType = IpfixPrinter::JSON;
 			} else {
 				THROWEXCEPTION("Unknown IpfixPrinter output type %s", type.c_str());
 			}
@@ -54,7 +54,7 @@
 // full, the client may receive an error with an indication of ECONNREFUSED
 // or, if the underlying protocol supports retransmission, the request may
 // be ignored so that a later reattempt at connection succeeds."
-#define SCTP_MAX_BACKLOG 5
+#define SCTP_MAX_BACKLOG SOMAXCONN
 
 
 class IpfixReceiverDtlsSctpIpV4 : public IpfixReceiver, Sensor {
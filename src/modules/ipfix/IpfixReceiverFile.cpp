@@ -22,7 +22,9 @@
 
 #include "IpfixPacketProcessor.hpp"
 #include "common/ipfixlolib/ipfix.h"
+#include "common/ipfixlolib/ipfixlolib.h"
 #include "common/msg.h"
+#include "common/CompressedFile.h"
 
 #include <stdexcept>
 #include <stdlib.h>
@@ -32,6 +34,11 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <vector>
 #define MAXMISSINGFILES 10
 
 
@@ -46,11 +53,13 @@ bool IpfixReceiverFile::checkint(const char *my_string){
 
 IpfixReceiverFile::IpfixReceiverFile(std::string packetFileBasename, 
 	std::string packetFileDirectory, int c_from, int c_to, bool ignore,
-	 float offlinespeed)	: 
+	 float offlinespeed, uint32_t startTime, uint32_t endTime)	: 
 		packet_file_directory(packetFileDirectory),
 		packet_file_basename(packetFileBasename),
 		from(c_from), to(c_to), ignore_timestamps(ignore),
-		stretchTime(offlinespeed), stretchTimeInt(1)
+		stretchTime(offlinespeed), stretchTimeInt(1),
+		startTime(startTime), endTime(endTime), pastEnd(false),
+		first(true)
 {
 	if (packet_file_directory.at(packet_file_directory.length()-1) != '/')
 				packet_file_directory += "/";
@@ -132,37 +141,227 @@ IpfixReceiverFile::IpfixReceiverFile(std::string packetFileBasename,
 	msg(LOG_NOTICE, "  - End (to) = %d" , to);
 	msg(LOG_NOTICE, "  - ignoreTimestamps = %s" , (ignore_timestamps) ? "true" : "false");
 	if(! ignore_timestamps) msg(LOG_NOTICE, "  - stretchTime = %f", stretchTime);
+	if (startTime) msg(LOG_NOTICE, "  - startTime = %u", startTime);
+	if (endTime) msg(LOG_NOTICE, "  - endTime = %u", endTime);
 }
 
 
 IpfixReceiverFile::~IpfixReceiverFile()
 {
-	if (packetFile.is_open()) packetFile.close();
+}
+
+
+/**
+ * determines the part of a file which contains the Data Messages between startTime
+ * and endTime, and the offset of the last Template Message before it (-1 if none),
+ * from the sidecar index of the file.
+ * Returns false if there is no usable index.
+ */
+bool IpfixReceiverFile::seekIndex(const std::string& path, uint64_t& begin, uint64_t& end, int64_t& checkpoint)
+{
+	std::ifstream indexFile((path + IPFIX_DATAFILE_INDEX_SUFFIX).c_str(), std::ios::in | std::ios::binary);
+	if (indexFile.fail())
+		return false;
+
+	char magic[sizeof(IPFIX_DATAFILE_INDEX_MAGIC) - 1];
+	indexFile.read(magic, sizeof(magic));
+	if (indexFile.gcount() != sizeof(magic) || memcmp(magic, IPFIX_DATAFILE_INDEX_MAGIC, sizeof(magic)) != 0) {
+		msg(LOG_ERR, "IpfixReceiverFile: ignoring invalid index of file %s", path.c_str());
+		return false;
+	}
+
+	std::vector<ipfix_datafile_index_entry> index;
+	ipfix_datafile_index_entry entry;
+	while (indexFile.read(reinterpret_cast<char*>(&entry), sizeof(entry)))
+		index.push_back(entry);
+
+	bool found = false;
+	bool firstData = true;
+	checkpoint = -1;
+	for (std::vector<ipfix_datafile_index_entry>::iterator it = index.begin(); it != index.end(); it++) {
+		uint64_t offset = ntohll(it->offset);
+		uint32_t exporttime = ntohl(it->export_time);
+		if (offset >= end)
+			break;
+		if (it->flags & IPFIX_DATAFILE_INDEX_TEMPLATES) {
+			if (!found)
+				checkpoint = offset;
+			continue;
+		}
+		if (endTime && exporttime > endTime) {
+			// files are written in chronological order
+			if (firstData)
+				pastEnd = true;
+			end = offset;
+			break;
+		}
+		firstData = false;
+		if (!found && (startTime == 0 || exporttime >= startTime)) {
+			begin = offset;
+			found = true;
+		}
+	}
+	if (!found)
+		begin = end;
+	return true;
+}
+
+
+/**
+ * returns true if the Message contains at least one Data Set
+ */
+bool IpfixReceiverFile::containsDataSets(const uint8_t* message, uint16_t length)
+{
+	uint32_t pos = sizeof(ipfix_header);
+	while (pos + sizeof(ipfix_set_header) <= length) {
+		const ipfix_set_header* set = reinterpret_cast<const ipfix_set_header*>(message + pos);
+		if (ntohs(set->set_id) >= IPFIX_SetId_Data_Start)
+			return true;
+		if (ntohs(set->length) < sizeof(ipfix_set_header))
+			break;
+		pos += ntohs(set->length);
+	}
+	return false;
+}
+
+
+/**
+ * sleeps until the Message with the given export time is due, relative to the
+ * first replayed Message and scaled by offlineSpeed
+ */
+void IpfixReceiverFile::waitForExportTime(uint32_t exporttime)
+{
+	struct timeval msg_now, real_now, msg_delta, real_delta, sleep_time, tmp_delta;
+	struct timespec wait_spec;
+
+	if(gettimeofday(&real_now, NULL) != 0){
+		msg(LOG_CRIT, "Error gettimeofday: %s", strerror(errno));
+		msg(LOG_CRIT, "Ignoring timestamps!");
+		ignore_timestamps = true;
+		return;
+	}
+	if (first){
+		first = false;
+		msg_first.tv_sec = (time_t)exporttime;
+		msg_first.tv_usec = 0;
+		real_start.tv_sec = real_now.tv_sec;
+		real_start.tv_usec = real_now.tv_usec;
+		return;
+	}
+
+	settimezero(&msg_now);
+	msg_now.tv_sec = (time_t)exporttime;
+	msg(LOG_INFO, "Exporttime: %u", exporttime);
+	timersub(&msg_now, &msg_first, &msg_delta);
+	timersub(&real_now, &real_start, &real_delta);
+
+	if(stretchTimeInt != 1){
+		if(stretchTimeInt == 0)
+			timermulfloat(&msg_delta, &tmp_delta, stretchTime);
+		else
+			timermul(&msg_delta, &tmp_delta, stretchTimeInt);
+	}
+	else{
+		tmp_delta.tv_sec = msg_delta.tv_sec;
+		tmp_delta.tv_usec = msg_delta.tv_usec;
+	}
+
+	if(timercmp(&real_delta, &tmp_delta, <)){
+		timersub(&tmp_delta, &real_delta, &sleep_time);
+
+		msg(LOG_INFO, "msg_delta: %06us %06uus | tmp_delta: %06us %06uus | "
+		"real_delta: %06us %06uus | sleep_time: %06us %06uus",
+			(uint32_t) msg_delta.tv_sec, (uint32_t) msg_delta.tv_usec,
+			(uint32_t) tmp_delta.tv_sec, (uint32_t) tmp_delta.tv_usec,
+			(uint32_t) real_delta.tv_sec, (uint32_t) real_delta.tv_usec,
+			(uint32_t) sleep_time.tv_sec,(uint32_t) sleep_time.tv_usec);
+
+		wait_spec.tv_sec = sleep_time.tv_sec;
+		wait_spec.tv_nsec = sleep_time.tv_usec*1000;
+		msg(LOG_INFO, "sleeping for: %06us %06uus",
+			 (uint32_t)sleep_time.tv_sec, (uint32_t)sleep_time.tv_usec);
+		if(nanosleep(&wait_spec, NULL)){
+			msg(LOG_ERR, "nanosleep returned non-zero value: %s", strerror(errno));
+		}
+	}
+	else{
+		msg(LOG_INFO, "Not sleeping");
+	}
+}
+
+
+/**
+ * returns the Message at offset idx of the mapped file or, for compressed files,
+ * reads it from the stream. Returns NULL at the end of the file.
+ */
+const uint8_t* IpfixReceiverFile::readMessage(const uint8_t* file, uint64_t size, FILE* stream,
+		uint64_t idx, uint16_t& length, const std::string& path)
+{
+	const uint8_t* message;
+	if (stream) {
+		// the stream is only repositioned to skip to the replay interval
+		if ((uint64_t)ftello(stream) != idx && fseeko(stream, idx, SEEK_SET) != 0)
+			return NULL;
+		if (fread(streamBuffer, sizeof(ipfix_header), 1, stream) != 1)
+			return NULL;
+		message = streamBuffer;
+	} else {
+		if (idx + sizeof(ipfix_header) > size)
+			return NULL;
+		message = file + idx;
+	}
+
+	length = ntohs(((const ipfix_header*)message)->length);
+	bool valid = length >= sizeof(ipfix_header);
+	if (valid && stream)
+		valid = length == sizeof(ipfix_header) ||
+			fread(streamBuffer + sizeof(ipfix_header), length - sizeof(ipfix_header), 1, stream) == 1;
+	else if (valid)
+		valid = idx + length <= size;
+	if (!valid) {
+		msg(LOG_ERR, "IpfixReceiverFile: invalid message length %u at offset %lu in file \"%s\"",
+			length, (unsigned long)idx, path.c_str());
+		return NULL;
+	}
+	return message;
+}
+
+
+void IpfixReceiverFile::processMessage(const uint8_t* message, uint16_t length,
+		boost::shared_ptr<IpfixRecord::SourceID>& sourceID)
+{
+	// the packet processors keep the data, so it is copied out of the mapped file
+	boost::shared_array<uint8_t> data(new uint8_t[length]);
+	memcpy(data.get(), message, length);
+
+	for (std::list<IpfixPacketProcessor*>::iterator i = packetProcessors.begin(); 
+			i != packetProcessors.end(); ++i) {
+		DPRINTF_INFO("Data block starts with: %x %x %x %x", data[0], data[1], data[2], data[3]);
+		(*i)->processPacket(data, length, sourceID);
+	}
 }
 
 
 /**
  * specific listener function. This function is called by @c listenerThread()
+ * Uncompressed files are mapped into memory, Messages are copied from there.
+ * Compressed files are decompressed into a buffer Message by Message.
  */
 void IpfixReceiverFile::run()
 {
-	boost::shared_array<uint8_t> data;
 	boost::shared_ptr<IpfixRecord::SourceID> sourceID(new IpfixRecord::SourceID);
-	struct timeval msg_first, real_start, msg_now, real_now, 
-		   msg_delta, real_delta, sleep_time, tmp_delta;
-	struct timespec wait_spec;
-	bool first = true;
 	int missing = 0; 
 
 	settimezero(&msg_first);
-	settimezero(&real_delta);
 	settimezero(&real_start);
-	settimezero(&msg_delta);
-	settimezero(&msg_now);
-	settimezero(&tmp_delta);
-	settimezero(&real_now);
+	first = true;
 
-	for(int filecount=from; filecount<=to && !exitFlag; filecount++){
+	// FIXME: The received ip address will be 1.0.0.127
+	uint32_t ip = 0x7F000001; // 127.0.0.1
+	memcpy(sourceID->exporterAddress.ip, &ip, 4);
+	sourceID->exporterAddress.len = 4;
+
+	for(int filecount=from; filecount<=to && !exitFlag && !pastEnd; filecount++){
 		ostringstream numberformat (ostringstream::out);
 		numberformat.width(10);
 		numberformat.fill('0');
@@ -173,8 +372,8 @@ void IpfixReceiverFile::run()
 		msg(LOG_INFO, "IpfixReceiverFile: Trying to read message from file \"%s\"", 
 			packet_file_path.c_str());
 
-		packetFile.open(packet_file_path.c_str(), std::ios::in | std::ios::binary);
-		if (packetFile.fail()){
+		int fd = open(packet_file_path.c_str(), O_RDONLY);
+		if (fd < 0){
 			msg(LOG_CRIT, "Couldn't open inputfile %s", packet_file_path.c_str());
 			if (++missing > MAXMISSINGFILES){
 				msg(LOG_CRIT, "Couldn't open %d files in a row...terminating", MAXMISSINGFILES);
@@ -184,120 +383,73 @@ void IpfixReceiverFile::run()
 		}
 		missing = 0;
 
-		packetFile.seekg(0, std::ios::end);
-		uint64_t end = packetFile.tellg();
-		packetFile.seekg(0, std::ios::beg);
+		struct stat st;
+		if (fstat(fd, &st) != 0 || st.st_size == 0) {
+			close(fd);
+			continue;
+		}
 
+		// offsets in the index of a compressed file refer to the uncompressed data
+		bool compressed = compressed_file_detect(packet_file_path.c_str());
+		uint64_t size = compressed ? UINT64_MAX : st.st_size;
 		uint64_t idx = 0;
-		while (idx<end && !exitFlag) {
-			uint16_t n;
-			packetFile.seekg(sizeof(uint16_t), std::ios::cur); /*version number offset*/
-			packetFile.read(reinterpret_cast<char*>(&n), sizeof(uint16_t));
-			n = ntohs(n);
-			/*reset the filepointer to the begin of the message*/
-			packetFile.seekg(-(int)(sizeof(uint32_t)), std::ios::cur); 
-
-			/** @todo uint_16 can never be > 65536
-			if (n > MAX_MSG_LEN) {
-				msg(LOG_ERR, "IpfixReceiverFile: packet at idx=%u too big with n=%u in file \"%s\"", 
-						idx, n, packet_file_path.c_str());
-				continue;
-			}
-*/
-
-			data.reset(new uint8_t[MAX_MSG_LEN]);
-			packetFile.read(reinterpret_cast<char*>(data.get()), n);
-			idx += n;
+		uint64_t end = size;
+		int64_t checkpoint = -1;
+		if ((startTime || endTime) && seekIndex(packet_file_path, idx, end, checkpoint) && idx >= end) {
+			msg(LOG_INFO, "IpfixReceiverFile: skipping file %s, it is outside of the replay interval",
+				packet_file_path.c_str());
+			close(fd);
+			continue;
+		}
 
-			if (packetFile.bad())  {
-				msg(LOG_ERR, "IpfixReceiverFile: bad packet_file: %s", packet_file_path.c_str());
+		uint8_t* file = NULL;
+		FILE* stream = NULL;
+		if (compressed) {
+			close(fd);
+			stream = compressed_file_fopen_read(packet_file_path.c_str());
+			if (!stream) {
+				msg(LOG_ERR, "IpfixReceiverFile: could not open compressed file %s", packet_file_path.c_str());
 				continue;
 			}
-
-			// FIXME: The received ip address will be 1.0.0.127
-			uint32_t ip = 0x7F000001; // 127.0.0.1
-			memcpy(sourceID->exporterAddress.ip, &ip, 4);
-			sourceID->exporterAddress.len = 4;
-
-			if (! ignore_timestamps){
-				uint32_t exporttime = (uint32_t) 
-						((uint32_t)(0xff & data[4])<<24 | (uint32_t)(0xff & data[5])<<16 | 
-						(uint32_t)(0xff & data[6])<<8 | (uint32_t)(0xff & data[7]));
-
-				if(gettimeofday(&real_now, NULL) != 0){
-					msg(LOG_CRIT, "Error gettimeofday: %s", strerror(errno));
-					msg(LOG_CRIT, "Ignoring timestamps!");
-					ignore_timestamps = true;
-					first = true; 
-				}
-				if (first){
-					first = false;
-					msg_first.tv_sec = (time_t)exporttime;
-					real_start.tv_sec = real_now.tv_sec;
-					real_start.tv_usec = real_now.tv_usec;
-				}
-				else{
-					msg_now.tv_sec = (time_t)exporttime;
-					msg(LOG_INFO, "Exporttime: %u", exporttime);
-					//msg_delta.tv_sec = msg_now.tv_sec - msg_first.tv_sec;
-					timersub(&msg_now, &msg_first, &msg_delta);
-					//real_delta.tv_sec = real_now.tv_sec - real_start.tv_sec;
-					timersub(&real_now, &real_start, &real_delta);
-					
-					if(stretchTimeInt != 1){
-						if(stretchTimeInt == 0)
-							timermulfloat(&msg_delta, &tmp_delta, stretchTime);
-						else
-							timermul(&msg_delta, &tmp_delta, stretchTimeInt);
-					}
-					else{
-						tmp_delta.tv_sec = msg_delta.tv_sec;
-						tmp_delta.tv_usec = msg_delta.tv_usec;
-					}
-
-					//if(real_delta.tv_sec < msg_delta.tv_sec) sleep(sleep_time.tv_sec);
-					if(timercmp(&real_delta, &tmp_delta, <)){
-						//sleep_time.tv_sec = msg_delta.tv_sec - real_delta.tv_sec;
-						timersub(&tmp_delta, &real_delta, &sleep_time);
-
-						msg(LOG_INFO, "msg_delta: %06us %06uus | tmp_delta: %06us %06uus | "
-						"real_delta: %06us %06uus | sleep_time: %06us %06uus",
-						  	(uint32_t) msg_delta.tv_sec, (uint32_t) msg_delta.tv_usec,
-						  	(uint32_t) tmp_delta.tv_sec, (uint32_t) tmp_delta.tv_usec,
-							(uint32_t) real_delta.tv_sec, (uint32_t) real_delta.tv_usec, 
-							(uint32_t) sleep_time.tv_sec,(uint32_t) sleep_time.tv_usec);
-
-						wait_spec.tv_sec = sleep_time.tv_sec;
-						wait_spec.tv_nsec = sleep_time.tv_usec*1000;
-						msg(LOG_INFO, "sleeping for: %06us %06uus",
-							 (uint32_t)sleep_time.tv_sec, (uint32_t)sleep_time.tv_usec);
-						if(nanosleep(&wait_spec, NULL)){
-							msg(LOG_ERR, "nanosleep returned non-zero value: %s", strerror(errno));
-						}
-					}
-					else{
-						msg(LOG_INFO, "Not sleeping");
-					}
-				}
+		} else {
+			file = (uint8_t*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			close(fd);
+			if (file == MAP_FAILED) {
+				msg(LOG_ERR, "IpfixReceiverFile: could not map file %s: %s", packet_file_path.c_str(), strerror(errno));
+				continue;
 			}
+			madvise(file, st.st_size, MADV_SEQUENTIAL);
+		}
 
-			for (std::list<IpfixPacketProcessor*>::iterator i = packetProcessors.begin(); 
-					i != packetProcessors.end(); ++i) {
-				DPRINTF_INFO("Data block starts with: %x %x %x %x", data[0], data[1], data[2], data[3]);
-				(*i)->processPacket(data, n, sourceID);
+		const uint8_t* message;
+		uint16_t n;
+		// the Templates which are valid at the start of the replay interval
+		if (checkpoint >= 0 && (message = readMessage(file, size, stream, checkpoint, n, packet_file_path)))
+			processMessage(message, n, sourceID);
+
+		while (idx < end && !exitFlag && (message = readMessage(file, size, stream, idx, n, packet_file_path))) {
+			uint32_t exporttime = ntohl(((const ipfix_header*)message)->export_time);
+			bool inInterval = (startTime == 0 || exporttime >= startTime) && (endTime == 0 || exporttime <= endTime);
+			// Templates outside of the interval may be needed for the Data Records inside
+			if (inInterval || !containsDataSets(message, n)) {
+				if (inInterval && !ignore_timestamps)
+					waitForExportTime(exporttime);
+				processMessage(message, n, sourceID);
 			}
+			idx += n;
 		}
-		packetFile.close();
+		if (stream)
+			fclose(stream);
+		else
+			munmap(file, st.st_size);
 
 		msg(LOG_NOTICE, "IpfixReceiverFile: File %s ended after %lu bytes.", 
-			packet_file_path.c_str(), idx);
+			packet_file_path.c_str(), (unsigned long)idx);
 	}
-	msg(LOG_INFO, "real_start: %lu  msg_start: %lu  real_now: %lu  msg_now: %lu", 
-		real_start.tv_sec, msg_first.tv_sec, real_now.tv_sec, msg_now.tv_sec);
+	msg(LOG_INFO, "real_start: %lu  msg_start: %lu", real_start.tv_sec, msg_first.tv_sec);
 	if (vmodule) {
 		vmodule->shutdownVermont();
 	} else {
 		msg(LOG_ERR, "IpfixReceiverFile: failed to shut down Vermont, internal error!");
 	}
 }
-
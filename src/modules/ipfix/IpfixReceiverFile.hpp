@@ -23,6 +23,7 @@
 
 #include <pthread.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <sys/types.h>
 #include <list>
 #include "boost/filesystem/operations.hpp"
@@ -31,7 +32,6 @@
 
 #include "IpfixReceiver.hpp"
 #include "IpfixPacketProcessor.hpp"
-#include <fstream>
 /* Code adopted from Observer.cpp: */
 /* subtract uvp from tvp and store in vvp */
 #ifndef timersub
@@ -62,15 +62,12 @@
             (uvp)->tv_usec -= 1000000;          \
         }                                       \
     } while(0)
-/* multiply tvp by x and store in uvp (with cast) */
+/* multiply tvp by x and store in uvp (with cast), keeping the fraction of the seconds */
 #define timermulfloat(tvp, uvp, x)              \
     do {                                        \
-        (uvp)->tv_sec = (time_t)((tvp)->tv_sec * x);      \
-        (uvp)->tv_usec = (suseconds_t)((tvp)->tv_usec * x);    \
-        while((uvp)->tv_usec > 1000000) {       \
-            (uvp)->tv_sec++;                    \
-            (uvp)->tv_usec -= 1000000;          \
-        }                                       \
+        double usec = ((tvp)->tv_sec * 1000000.0 + (tvp)->tv_usec) * x; \
+        (uvp)->tv_sec = (time_t)(usec / 1000000);      \
+        (uvp)->tv_usec = (suseconds_t)(usec - (uvp)->tv_sec * 1000000.0);    \
     } while(0)
 #define settimezero(x)							\
 	do {										\
@@ -80,16 +77,29 @@
 	while(0)
 
 /**
- * reads raw packets from a directory containing one file per packet
+ * reads IPFIX Messages from the files written by IpfixFileWriter
+ *
+ * If startTime or endTime are set, only Data Messages exported within this
+ * interval are replayed. The sidecar index written by IpfixFileWriter is used
+ * to jump to the first Message of the interval, after replaying the Templates
+ * which were valid at this point. Files without index are scanned.
+ * Files compressed by IpfixFileWriter are decompressed while they are read.
  */
 class IpfixReceiverFile : public IpfixReceiver {
 public:
-	IpfixReceiverFile(std::string, std::string, int, int, bool, float);
+	IpfixReceiverFile(std::string, std::string, int, int, bool, float, uint32_t, uint32_t);
 	virtual ~IpfixReceiverFile();
 
 	virtual void run();
 private:
 	bool checkint(const char*);
+	bool seekIndex(const std::string& path, uint64_t& begin, uint64_t& end, int64_t& checkpoint);
+	bool containsDataSets(const uint8_t* message, uint16_t length);
+	void waitForExportTime(uint32_t exporttime);
+	const uint8_t* readMessage(const uint8_t* file, uint64_t size, FILE* stream, uint64_t idx,
+			uint16_t& length, const std::string& path);
+	void processMessage(const uint8_t* message, uint16_t length,
+			boost::shared_ptr<IpfixRecord::SourceID>& sourceID);
 	std::string packet_file_directory;
 	std::string packet_file_basename;
 	int from;
@@ -97,7 +107,15 @@ private:
 	bool ignore_timestamps;
 	float stretchTime;
 	uint16_t stretchTimeInt;
-	std::ifstream packetFile;
+	uint32_t startTime; /**< export time of the first replayed Data Message, 0 for no limit */
+	uint32_t endTime; /**< export time of the last replayed Data Message, 0 for no limit */
+	bool pastEnd; /**< set if the index shows that the following files are after endTime */
+
+	/* replay timing */
+	bool first;
+	struct timeval msg_first, real_start;
+
+	uint8_t streamBuffer[UINT16_MAX]; /**< current Message of a compressed file */
 };
 
 #endif
@@ -29,7 +29,9 @@ IpfixReceiverFileCfg::IpfixReceiverFileCfg(XMLElement* elem)
 		c_from(0),
 		c_to(-1),
 		ignore(true),
-		offlinespeed(1.0)
+		offlinespeed(1.0),
+		startTime(0),
+		endTime(0)
 {
 
 	if (!elem)
@@ -59,6 +61,12 @@ IpfixReceiverFileCfg::IpfixReceiverFileCfg(XMLElement* elem)
 		else if (e->matches("offlineSpeed")){
 			offlinespeed = getDouble("offlineSpeed");
 		}
+		else if (e->matches("startTime")) {
+			startTime = getInt64("startTime");
+		}
+		else if (e->matches("endTime")) {
+			endTime = getInt64("endTime");
+		}
 		else if (e->matches("next")) {
 			//ignore <next>
 		}	
@@ -86,7 +94,7 @@ IpfixCollector* IpfixReceiverFileCfg::createInstance()
 {
 	IpfixReceiverFile* ipfixReceiver;
 	ipfixReceiver = new IpfixReceiverFile(packetFileBasename, packetFileDirectory, 
-		c_from, c_to, ignore, offlinespeed);
+		c_from, c_to, ignore, offlinespeed, startTime, endTime);
 
 	if (!ipfixReceiver) {
 		THROWEXCEPTION("Could not create IpfixReceiver");
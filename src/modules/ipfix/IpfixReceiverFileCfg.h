@@ -45,6 +45,8 @@ private:
 		int c_to;
 		bool ignore;
 		float offlinespeed;
+		uint32_t startTime;
+		uint32_t endTime;
 };
 
 #endif /*IPFIXRECEIVERFILECFG_H_*/
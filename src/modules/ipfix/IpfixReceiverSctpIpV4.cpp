@@ -40,12 +40,12 @@
 /** 
  * Does SCTP/IPv4 specific initialization.
  * @param port Port to listen on
+ * @param workerThreads number of threads receiving from the associations
  */
-IpfixReceiverSctpIpV4::IpfixReceiverSctpIpV4(int port, std::string ipAddr, uint32_t buffer)
-	: statReceivedPackets(0)
+IpfixReceiverSctpIpV4::IpfixReceiverSctpIpV4(int port, std::string ipAddr, uint32_t buffer,
+		unsigned int workerThreads)
+	: IpfixReceiverStream(port, IPFIX_protocolIdentifier_SCTP, "IpfixReceiverSctpIpV4", workerThreads)
 {
-	receiverPort = port;
-	
 	struct sockaddr_in serverAddress;
 	
 	listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_SCTP);
@@ -74,6 +74,8 @@ IpfixReceiverSctpIpV4::IpfixReceiverSctpIpV4(int port, std::string ipAddr, uint3
 		msg(LOG_ERR ,"Could not listen on SCTP socket %i", listen_socket);
 		THROWEXCEPTION("Cannot create IpfixReceiverSctpIpV4");
 	}
+	framing = EndOfRecord;
+
 	msg(LOG_NOTICE, "SCTP Receiver listening on %s:%d, FD=%d", (ipAddr == "")?std::string("ALL").c_str() : ipAddr.c_str(), 
 								port, 
 								listen_socket);
@@ -89,102 +91,6 @@ IpfixReceiverSctpIpV4::~IpfixReceiverSctpIpV4() {
 }
 
 
-/**
- * SCTP specific listener function. This function is called by @c listenerThread()
- */
-void IpfixReceiverSctpIpV4::run() {
-
-	struct sockaddr_in clientAddress;
-	socklen_t clientAddressLen;
-	clientAddressLen = sizeof(struct sockaddr_in);
-	
-	fd_set fd_array; //all active filedescriptors
-	fd_set readfds;  //parameter for for pselect
-	int maxfd;
-	
-	int ret;
-	int rfd;
-	struct timespec timeOut;
-	
-	FD_ZERO(&fd_array);
-	FD_SET(listen_socket, &fd_array); // add listensocket
-	maxfd = listen_socket;
-	
-	/* set a 400ms time-out on the pselect */
-	timeOut.tv_sec = 0L;
-	timeOut.tv_nsec = 400000000L;
-	
-	while(!exitFlag) {
-		readfds = fd_array; // because select() changes readfds
-		ret = pselect(maxfd + 1, &readfds, NULL, NULL, &timeOut, NULL); // check only for something to read
-		if (ret == 0) {
-			/* Timeout */
-			continue;
-    		}
-		if ((ret == -1) && (errno == EINTR)) {
-			/* There was a signal... ignore */
-			continue;
-    		}
-    		if (ret < 0) {
-    			msg(LOG_ERR ,"select() returned with an error");
-			THROWEXCEPTION("IpfixReceiverSctpIpV4: terminating listener thread");
-			break;
-		}
-		// looking for a new client to connect at listen_socket
-		if (FD_ISSET(listen_socket, &readfds)){
-			rfd = accept(listen_socket, (struct sockaddr*)&clientAddress, &clientAddressLen);
-			
-			if (rfd >= 0){
-				if (isHostAuthorized(&clientAddress.sin_addr, sizeof(clientAddress.sin_addr))) {
-					FD_SET(rfd, &fd_array); // add new client to fd_array
-					msg(LOG_INFO, "IpfixReceiverSctpIpV4: Client connected from %s:%d, FD=%d", inet_ntoa(clientAddress.sin_addr), ntohs(clientAddress.sin_port), rfd);
-					if (rfd > maxfd){
-						maxfd = rfd;
-					}
-				} else {
-					msg(LOG_INFO, "IpfixReceiverSctpIpV4: Connection from unwanted client %s:%d, FD=%d rejected.", inet_ntoa(clientAddress.sin_addr), ntohs(clientAddress.sin_port), rfd);
-					close(rfd);
-				}
-			}else{
-				msg(LOG_ERR ,"accept() in ipfixReceiver failed");
-				THROWEXCEPTION("IpfixReceiverSctpIpV4: unable to accept new connection");
-			}
-		}
-		// check all connected sockets for new available data
-		for (rfd = listen_socket + 1; rfd <= maxfd; ++rfd) {
-      			if (FD_ISSET(rfd, &readfds)) {
-				boost::shared_array<uint8_t> data(new uint8_t[MAX_MSG_LEN]);
-      				ret = recvfrom(rfd, data.get(), MAX_MSG_LEN, 0, (struct sockaddr*)&clientAddress, &clientAddressLen);
-				if (ret < 0) { // error
-					msg(LOG_ERR, "IpfixReceiverSctpIpV4: Client error (%s), close connection.", inet_ntoa(clientAddress.sin_addr));
-					close(rfd);
-					// we treat an error like a shut down, so overwrite return value to zero
-					ret = 0;
-				}
-				// create sourceId
-				boost::shared_ptr<IpfixRecord::SourceID> sourceID(new IpfixRecord::SourceID);
-				memcpy(sourceID->exporterAddress.ip, &clientAddress.sin_addr.s_addr, 4);
-				sourceID->exporterAddress.len = 4;
-				sourceID->exporterPort = ntohs(clientAddress.sin_port);
-				sourceID->protocol = IPFIX_protocolIdentifier_SCTP;
-				sourceID->receiverPort = receiverPort;
-				sourceID->fileDescriptor = rfd;
-				// send packet to all packet processors
-				mutex.lock();
-				for (std::list<IpfixPacketProcessor*>::iterator i = packetProcessors.begin(); i != packetProcessors.end(); ++i) { 
-					(*i)->processPacket(data, ret, sourceID);
-				}
-				mutex.unlock();
-				if (ret == 0) { // this was a shut down (or error)
-					FD_CLR(rfd, &fd_array); // delete dead client
-					msg(LOG_INFO, "IpfixReceiverSctpIpV4: Client %s disconnected", inet_ntoa(clientAddress.sin_addr));
-				}
-      			}
-      		}
-	}
-	msg(LOG_INFO, "IpfixReceiverSctpIpV4: Exiting");
-}
-
 /**
  * statistics function called by StatisticsManager
  */
@@ -192,7 +98,8 @@ std::string IpfixReceiverSctpIpV4::getStatisticsXML(double interval)
 {
 	ostringstream oss;
 	
-	oss << "<receivedPackets>" << statReceivedPackets << "</receivedPackets>" << endl;	
+	oss << "<receivedPackets>" << statReceivedMessages << "</receivedPackets>" << endl;	
+	oss << "<connections>" << statConnections << "</connections>" << endl;
 
 	return oss.str();
 }
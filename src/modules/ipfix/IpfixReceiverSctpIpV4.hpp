@@ -27,7 +27,7 @@
 #include <arpa/inet.h>
 #include <list>
 
-#include "IpfixReceiver.hpp"
+#include "IpfixReceiverStream.hpp"
 #include "IpfixPacketProcessor.hpp"
 
 // Quote from man page: "maximum length to which the queue of pending connections
@@ -35,24 +35,22 @@
 // full, the client may receive an error with an indication of ECONNREFUSED
 // or, if the underlying protocol supports retransmission, the request may
 // be ignored so that a later reattempt at connection succeeds."
-#define SCTP_MAX_BACKLOG 5
+#define SCTP_MAX_BACKLOG SOMAXCONN
 
 
-class IpfixReceiverSctpIpV4 : public IpfixReceiver, Sensor {
+class IpfixReceiverSctpIpV4 : public IpfixReceiverStream, Sensor {
 #ifdef SUPPORT_SCTP
 	public:
-		IpfixReceiverSctpIpV4(int port, std::string ipAddr = "", uint32_t buffer = 0);
+		IpfixReceiverSctpIpV4(int port, std::string ipAddr = "", uint32_t buffer = 0,
+				unsigned int workerThreads = 1);
 		virtual ~IpfixReceiverSctpIpV4();
 
-		virtual void run();
 		std::string getStatisticsXML(double interval);
-
-	private:
-		int listen_socket;
-		uint32_t statReceivedPackets;  /**< number of received packets */ 
 #else
 	public:
-		IpfixReceiverSctpIpV4(int port, std::string ipAddr, uint32_t buffer = 0) {
+		IpfixReceiverSctpIpV4(int port, std::string ipAddr, uint32_t buffer = 0,
+				unsigned int workerThreads = 1)
+			: IpfixReceiverStream(port, 0, "IpfixReceiverSctpIpV4", workerThreads) {
 			THROWEXCEPTION("SCTP not supported!");
 		}
 		
@@ -0,0 +1,373 @@
+/*
+ * IPFIX Concentrator Module Library - Stream Receiver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "IpfixReceiverStream.hpp"
+
+#include "IpfixPacketProcessor.hpp"
+#include "IpfixParser.hpp"
+#include "common/ipfixlolib/ipfix.h"
+#include "common/msg.h"
+
+#include <stdexcept>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <arpa/inet.h>
+
+IpfixReceiverStream::Worker::Worker(IpfixReceiverStream* receiver)
+	: receiver(receiver),
+	  epollFd(-1),
+	  thread(IpfixReceiverStream::workerWrapper, "IpfixRecvWorker")
+{
+}
+
+/**
+ * @param port Port to listen on
+ * @param protocolIdentifier protocol stored in the SourceID of received Messages
+ * @param name name of the receiver used in log messages
+ * @param workerThreads number of threads receiving from the connections
+ */
+IpfixReceiverStream::IpfixReceiverStream(int port, uint8_t protocolIdentifier,
+		const std::string &name, unsigned int workerThreads)
+	: IpfixReceiver(port),
+	  listen_socket(-1),
+	  framing(LengthField),
+	  statReceivedMessages(0),
+	  statConnections(0),
+	  name(name),
+	  protocolIdentifier(protocolIdentifier),
+	  workerThreads(workerThreads > 0 ? workerThreads : 1),
+	  nextWorker(0)
+{
+}
+
+IpfixReceiverStream::~IpfixReceiverStream()
+{
+}
+
+void* IpfixReceiverStream::workerWrapper(void* worker)
+{
+	Worker* w = (Worker*)worker;
+	w->receiver->processEvents(w);
+	return NULL;
+}
+
+/**
+ * Listener function. This function is called by @c listenerThread().
+ * It starts the additional worker threads and serves as the first worker.
+ */
+void IpfixReceiverStream::run()
+{
+	fcntl(listen_socket, F_SETFL, fcntl(listen_socket, F_GETFL) | O_NONBLOCK);
+
+	for (unsigned int i = 0; i < workerThreads; i++) {
+		Worker* w = new Worker(this);
+		w->epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (w->epollFd < 0) {
+			delete w;
+			THROWEXCEPTION("%s: epoll_create1() failed: %s", name.c_str(), strerror(errno));
+		}
+		workers.push_back(w);
+	}
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL; // the listen socket
+	if (epoll_ctl(workers[0]->epollFd, EPOLL_CTL_ADD, listen_socket, &ev) < 0) {
+		THROWEXCEPTION("%s: unable to watch listen socket: %s", name.c_str(), strerror(errno));
+	}
+
+	for (unsigned int i = 1; i < workers.size(); i++)
+		workers[i]->thread.run(workers[i]);
+
+	processEvents(workers[0]);
+
+	for (unsigned int i = 1; i < workers.size(); i++)
+		workers[i]->thread.join();
+
+	// all workers have stopped, so nobody else touches the connections
+	while (!connections.empty())
+		closeConnection(*connections.begin());
+
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		close(workers[i]->epollFd);
+		delete workers[i];
+	}
+	workers.clear();
+
+	msg(LOG_INFO, "%s: Exiting", name.c_str());
+}
+
+/**
+ * Main loop of a worker. Receives from all connections which have been
+ * assigned to the worker until the receiver is shut down.
+ */
+void IpfixReceiverStream::processEvents(Worker* worker)
+{
+	struct epoll_event events[STREAM_MAX_EVENTS];
+
+	while (!exitFlag) {
+		int n = epoll_wait(worker->epollFd, events, STREAM_MAX_EVENTS, STREAM_EPOLL_TIMEOUT);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			msg(LOG_ERR, "%s: epoll_wait() returned with an error: %s", name.c_str(), strerror(errno));
+			THROWEXCEPTION("%s: terminating listener thread", name.c_str());
+		}
+		for (int i = 0; i < n; i++) {
+			if (events[i].data.ptr == NULL) {
+				acceptConnections();
+				continue;
+			}
+			Connection* c = (Connection*)events[i].data.ptr;
+			if (!receive(c))
+				closeConnection(c);
+		}
+	}
+}
+
+/**
+ * Accepts all pending connections and assigns them to the workers in turn.
+ */
+void IpfixReceiverStream::acceptConnections()
+{
+	while (true) {
+		struct sockaddr_in clientAddress;
+		socklen_t clientAddressLen = sizeof(clientAddress);
+		int rfd = accept4(listen_socket, (struct sockaddr*)&clientAddress, &clientAddressLen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (rfd < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				msg(LOG_ERR, "%s: accept() failed: %s", name.c_str(), strerror(errno));
+			return;
+		}
+
+		if (!isHostAuthorized(&clientAddress.sin_addr, sizeof(clientAddress.sin_addr))) {
+			msg(LOG_INFO, "%s: Connection from unwanted client %s:%d, FD=%d rejected.", name.c_str(), inet_ntoa(clientAddress.sin_addr), ntohs(clientAddress.sin_port), rfd);
+			close(rfd);
+			continue;
+		}
+
+		Connection* c = new Connection;
+		c->fd = rfd;
+		snprintf(c->address, sizeof(c->address), "%s:%d", inet_ntoa(clientAddress.sin_addr), ntohs(clientAddress.sin_port));
+		memcpy(c->sourceID.exporterAddress.ip, &clientAddress.sin_addr.s_addr, 4);
+		c->sourceID.exporterAddress.len = 4;
+		c->sourceID.exporterPort = ntohs(clientAddress.sin_port);
+		c->sourceID.protocol = protocolIdentifier;
+		c->sourceID.receiverPort = receiverPort;
+		c->sourceID.fileDescriptor = rfd;
+		c->buffer = NULL;
+		c->capacity = 0;
+		c->head = 0;
+		c->tail = 0;
+
+		connectionsLock.lock();
+		connections.insert(c);
+		statConnections++;
+		connectionsLock.unlock();
+
+		Worker* w = workers[nextWorker++ % workers.size()];
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = c;
+		if (epoll_ctl(w->epollFd, EPOLL_CTL_ADD, rfd, &ev) < 0) {
+			msg(LOG_ERR, "%s: unable to watch connection: %s", name.c_str(), strerror(errno));
+			closeConnection(c);
+			continue;
+		}
+		msg(LOG_INFO, "%s: Client connected from %s, FD=%d", name.c_str(), c->address, rfd);
+	}
+}
+
+/**
+ * Reads available data of a connection into its ring buffer and passes
+ * all complete Messages to the packet processors.
+ * @return false if the connection has to be closed
+ */
+bool IpfixReceiverStream::receive(Connection* c)
+{
+	if (c->capacity == 0)
+		resizeBuffer(c, STREAM_BUFFER_INITIAL_SIZE);
+
+	uint32_t used = c->tail - c->head;
+	if (used == c->capacity) {
+		if (c->capacity >= MAX_MSG_LEN) {
+			msg(LOG_ERR, "%s: Message from client %s exceeds %u bytes, close connection.", name.c_str(), c->address, MAX_MSG_LEN);
+			return false;
+		}
+		resizeBuffer(c, c->capacity * 2);
+	}
+
+	// free space of the ring buffer, possibly wrapping around
+	uint32_t pos = c->tail & (c->capacity - 1);
+	uint32_t space = c->capacity - used;
+	struct iovec iov[2];
+	iov[0].iov_base = c->buffer + pos;
+	iov[0].iov_len = (space < c->capacity - pos) ? space : c->capacity - pos;
+	iov[1].iov_base = c->buffer;
+	iov[1].iov_len = space - iov[0].iov_len;
+
+	struct msghdr mh;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = (iov[1].iov_len > 0) ? 2 : 1;
+
+	ssize_t ret = recvmsg(c->fd, &mh, 0);
+	if (ret < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+			return true;
+		msg(LOG_ERR, "%s: Client error (%s), close connection.", name.c_str(), c->address);
+		return false;
+	}
+	if (ret == 0) {
+		msg(LOG_INFO, "%s: Client %s disconnected", name.c_str(), c->address);
+		return false;
+	}
+	c->tail += ret;
+
+	return extractMessages(c, (mh.msg_flags & MSG_EOR) != 0);
+}
+
+/**
+ * Passes all complete Messages in the ring buffer to the packet processors.
+ * @param endOfRecord true if the last read completed a Message (EndOfRecord framing only)
+ * @return false if the connection has to be closed
+ */
+bool IpfixReceiverStream::extractMessages(Connection* c, bool endOfRecord)
+{
+	if (framing == EndOfRecord) {
+		uint32_t used = c->tail - c->head;
+		if (endOfRecord) {
+			if (used > UINT16_MAX) {
+				msg(LOG_ERR, "%s: Discarding Message of %u bytes from client %s", name.c_str(), used, c->address);
+				c->head = c->tail;
+			} else {
+				deliverMessage(c, used);
+			}
+		}
+	} else {
+		while (c->tail - c->head >= sizeof(IpfixParser::IpfixHeader)) {
+			uint32_t mask = c->capacity - 1;
+			uint16_t version = (c->buffer[c->head & mask] << 8) | c->buffer[(c->head + 1) & mask];
+			uint16_t length = (c->buffer[(c->head + 2) & mask] << 8) | c->buffer[(c->head + 3) & mask];
+			if (version != 0x000a) {
+				msg(LOG_ERR, "%s: We do not support anything but IPFIX, close connection to %s.", name.c_str(), c->address);
+				return false;
+			}
+			if (length < sizeof(IpfixParser::IpfixHeader)) {
+				msg(LOG_ERR, "%s: Invalid Message length %u from client %s", name.c_str(), length, c->address);
+				return false;
+			}
+			if (c->tail - c->head < length) {
+				// wait for the rest of the Message, make room for it
+				if (length > c->capacity) {
+					uint32_t capacity = c->capacity;
+					while (capacity < length)
+						capacity *= 2;
+					resizeBuffer(c, capacity);
+				}
+				break;
+			}
+			deliverMessage(c, length);
+		}
+	}
+
+	// do not keep large buffers for idle connections
+	if (c->head == c->tail && c->capacity > STREAM_BUFFER_INITIAL_SIZE)
+		resizeBuffer(c, STREAM_BUFFER_INITIAL_SIZE);
+	return true;
+}
+
+/**
+ * Copies the Message at the head of the ring buffer and passes it to the
+ * packet processors.
+ */
+void IpfixReceiverStream::deliverMessage(Connection* c, uint32_t length)
+{
+	boost::shared_array<uint8_t> data(new uint8_t[length]);
+	uint32_t pos = c->head & (c->capacity - 1);
+	uint32_t first = (length < c->capacity - pos) ? length : c->capacity - pos;
+	memcpy(data.get(), c->buffer + pos, first);
+	memcpy(data.get() + first, c->buffer, length - first);
+	c->head += length;
+
+	// the parser updates the SourceID, so each Message gets its own copy
+	boost::shared_ptr<IpfixRecord::SourceID> sourceID(new IpfixRecord::SourceID(c->sourceID));
+
+	mutex.lock();
+	statReceivedMessages++;
+	for (std::list<IpfixPacketProcessor*>::iterator i = packetProcessors.begin(); i != packetProcessors.end(); ++i) {
+		(*i)->processPacket(data, length, sourceID);
+	}
+	mutex.unlock();
+}
+
+/**
+ * Moves the content of the ring buffer into a new buffer of the given size.
+ * @param capacity power of two not smaller than the number of buffered bytes
+ */
+void IpfixReceiverStream::resizeBuffer(Connection* c, uint32_t capacity)
+{
+	uint32_t used = c->tail - c->head;
+	uint8_t* buffer = new uint8_t[capacity];
+	if (used > 0) {
+		uint32_t pos = c->head & (c->capacity - 1);
+		uint32_t first = (used < c->capacity - pos) ? used : c->capacity - pos;
+		memcpy(buffer, c->buffer + pos, first);
+		memcpy(buffer + first, c->buffer, used - first);
+	}
+	delete[] c->buffer;
+	c->buffer = buffer;
+	c->capacity = capacity;
+	c->head = 0;
+	c->tail = used;
+}
+
+/**
+ * Closes a connection and informs the packet processors that the Templates
+ * of this connection are no longer valid.
+ */
+void IpfixReceiverStream::closeConnection(Connection* c)
+{
+	// closing the socket also removes it from the epoll set
+	close(c->fd);
+
+	boost::shared_ptr<IpfixRecord::SourceID> sourceID(new IpfixRecord::SourceID(c->sourceID));
+	mutex.lock();
+	for (std::list<IpfixPacketProcessor*>::iterator i = packetProcessors.begin(); i != packetProcessors.end(); ++i) {
+		(*i)->processPacket(boost::shared_array<uint8_t>(), 0, sourceID);
+	}
+	mutex.unlock();
+
+	connectionsLock.lock();
+	connections.erase(c);
+	statConnections--;
+	connectionsLock.unlock();
+
+	delete[] c->buffer;
+	delete c;
+}
@@ -0,0 +1,106 @@
+/*
+ * IPFIX Concentrator Module Library - Stream Receiver
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+#ifndef _IPFIX_RECEIVER_STREAM_H_
+#define _IPFIX_RECEIVER_STREAM_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "IpfixReceiver.hpp"
+#include "IpfixRecord.hpp"
+#include "common/Thread.h"
+
+/* initial size of the reassembly buffer of a connection */
+#define STREAM_BUFFER_INITIAL_SIZE 16384
+/* maximum time in ms until a worker notices a shutdown */
+#define STREAM_EPOLL_TIMEOUT 400
+#define STREAM_MAX_EVENTS 64
+
+/**
+ * Base class of receivers for connection-oriented transports (TCP and SCTP).
+ *
+ * All connections are watched with epoll, so a receiver scales to thousands
+ * of Exporters. Each connection has a ring buffer which reassembles IPFIX
+ * Messages spread over several reads. Connections can be distributed over
+ * several worker threads, the thread calling @c run() being the first one.
+ *
+ * Derived classes create @c listen_socket and choose how Messages are
+ * delimited.
+ */
+class IpfixReceiverStream : public IpfixReceiver {
+	public:
+		IpfixReceiverStream(int port, uint8_t protocolIdentifier,
+				const std::string &name, unsigned int workerThreads);
+		virtual ~IpfixReceiverStream();
+
+		virtual void run();
+
+	protected:
+		enum Framing {
+			LengthField, /**< Messages are delimited by the length field of the IPFIX header */
+			EndOfRecord  /**< the transport preserves Message boundaries (MSG_EOR) */
+		};
+
+		int listen_socket;
+		Framing framing;
+		uint32_t statReceivedMessages; /**< number of received messages */
+		uint32_t statConnections; /**< number of open connections */
+
+	private:
+		struct Connection {
+			int fd;
+			char address[INET_ADDRSTRLEN + 6]; /**< "ip:port" of the Exporter for log messages */
+			IpfixRecord::SourceID sourceID; /**< copied for every Message */
+			uint8_t* buffer;
+			uint32_t capacity; /**< size of @c buffer, a power of two */
+			uint32_t head; /**< position of the first unprocessed byte (not wrapped) */
+			uint32_t tail; /**< position behind the last received byte (not wrapped) */
+		};
+
+		struct Worker {
+			IpfixReceiverStream* receiver;
+			int epollFd;
+			Thread thread;
+
+			Worker(IpfixReceiverStream* receiver);
+		};
+
+		std::string name;
+		uint8_t protocolIdentifier;
+		unsigned int workerThreads;
+		std::vector<Worker*> workers;
+		unsigned int nextWorker; /**< Worker of the next accepted connection */
+		Mutex connectionsLock;
+		std::set<Connection*> connections; /**< all open connections, for cleanup */
+
+		static void* workerWrapper(void* worker);
+		void processEvents(Worker* worker);
+		void acceptConnections();
+		bool receive(Connection* c);
+		bool extractMessages(Connection* c, bool endOfRecord);
+		void deliverMessage(Connection* c, uint32_t length);
+		void resizeBuffer(Connection* c, uint32_t capacity);
+		void closeConnection(Connection* c);
+};
+
+#endif
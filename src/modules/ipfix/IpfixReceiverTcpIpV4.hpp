@@ -27,22 +27,19 @@
 #include <arpa/inet.h>
 #include <list>
 
-#include "IpfixReceiver.hpp"
+#include "IpfixReceiverStream.hpp"
 #include "IpfixPacketProcessor.hpp"
 
-#define TCP_MAX_BACKLOG 5
+#define TCP_MAX_BACKLOG SOMAXCONN
 
-class IpfixReceiverTcpIpV4 : public IpfixReceiver, Sensor {
+class IpfixReceiverTcpIpV4 : public IpfixReceiverStream, Sensor {
 	public:
 		IpfixReceiverTcpIpV4(int port, std::string ipAddr = "",
-				const uint32_t buffer = 0, unsigned int moduleId = 0);
+				const uint32_t buffer = 0, unsigned int moduleId = 0,
+				unsigned int workerThreads = 1);
 		virtual ~IpfixReceiverTcpIpV4();
 
-		virtual void run();
 		virtual std::string getStatisticsXML(double interval);
-	private:
-		int listen_socket;
-		uint32_t statReceivedMessages;  /**< number of received messages */
 };
 
 #endif
@@ -23,17 +23,26 @@
 #include <math.h>
 
 
-IpfixSampler::IpfixSampler(double flowrate)
+IpfixSampler::IpfixSampler(double flowrate, bool randomly, uint64_t seed)
 	: flowRate(flowrate),
 	  counter(0),
+	  randomSampling(randomly),
+	  invLogQ(0),
+	  random(seed),
 	  statDropped(0),
 	  statTotalDropped(0)
 {
 	modulo = (uint64_t)round(1.0/flowRate);
+	if (flowRate < 1)
+		invLogQ = 1.0 / log1p(-flowRate);
+	skip = randomSampling ? random.geometric(invLogQ) : modulo - 1;
 
 	msg(LOG_NOTICE, "IpfixSampler started with following parameters:");
 	msg(LOG_NOTICE, "  - flowRate=%f", flowRate);
-	msg(LOG_NOTICE, "  - resulting modulo: %lu", modulo);
+	if (randomSampling)
+		msg(LOG_NOTICE, "  - random sampling");
+	else
+		msg(LOG_NOTICE, "  - resulting modulo: %lu", modulo);
 }
 
 IpfixSampler::~IpfixSampler()
@@ -47,9 +56,11 @@ void IpfixSampler::onDataRecord(IpfixDataRecord* record)
 		send(record);
 	} else {
 		counter++;
-		if ((counter%modulo)==0) {
+		if (skip == 0) {
+			skip = randomSampling ? random.geometric(invLogQ) : modulo - 1;
 			send(record);
 		} else {
+			skip--;
 			statDropped++;
 			statTotalDropped++;
 			record->removeReference();
@@ -23,6 +23,7 @@
 #include "IpfixRecordDestination.h"
 #include "Connection.h"
 #include "core/Source.h"
+#include "common/Xoshiro256.h"
 
 #include <list>
 #include <string>
@@ -35,7 +36,13 @@ class IpfixSampler
 	  public Source<IpfixRecord*>
 {
 	public:
-		IpfixSampler(double flowrate);
+		/**
+		 * passes every (1/flowrate)-th data record or, if randomly is set,
+		 * every data record with probability flowrate. Random sampling draws
+		 * the number of records to skip once per passed record, seed 0
+		 * chooses a random seed.
+		 */
+		IpfixSampler(double flowrate, bool randomly = false, uint64_t seed = 0);
 		virtual ~IpfixSampler();
 
 		virtual void onDataRecord(IpfixDataRecord* record);
@@ -44,6 +51,10 @@ class IpfixSampler
 		double flowRate;
 		uint64_t counter;
 		uint64_t modulo;
+		bool randomSampling;
+		double invLogQ;
+		uint64_t skip; /**< data records to drop before the next one is passed */
+		Xoshiro256 random;
 		uint64_t statDropped;
 		uint64_t statTotalDropped;
 
@@ -30,7 +30,9 @@ IpfixSamplerCfg* IpfixSamplerCfg::create(XMLElement* e)
 
 IpfixSamplerCfg::IpfixSamplerCfg(XMLElement* elem)
     : CfgHelper<IpfixSampler, IpfixSamplerCfg>(elem, "ipfixSampler"),
-    flowRate(1)
+    flowRate(1),
+    random(false),
+    seed(0)
 {
     if (!elem) return;
 
@@ -45,6 +47,10 @@ IpfixSamplerCfg::IpfixSamplerCfg(XMLElement* elem)
 			if (flowRate <= 0 || flowRate > 1){
 				THROWEXCEPTION("Illegal value for flowRate. Must be greater 0 and smaller or equal to 1, received %lf", flowRate);
 			}
+		} else if (e->matches("random")) {
+			random = getBool("random");
+		} else if (e->matches("seed")) {
+			seed = getInt64("seed");
 		} else if (e->matches("next")) { // ignore next
 		} else {
 			msg(LOG_CRIT, "Unknown IpfixSampler config statement %s\n", e->getName().c_str());
@@ -59,7 +65,7 @@ IpfixSamplerCfg::~IpfixSamplerCfg()
 
 IpfixSampler* IpfixSamplerCfg::createInstance()
 {
-    instance = new IpfixSampler(flowRate);
+    instance = new IpfixSampler(flowRate, random, seed);
     return instance;
 }
 
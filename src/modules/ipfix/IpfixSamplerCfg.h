@@ -46,6 +46,8 @@ public:
 protected:
 
 	double flowRate;
+	bool random;
+	uint64_t seed;
 
 	IpfixSamplerCfg(XMLElement*);
 };
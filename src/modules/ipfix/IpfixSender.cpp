@@ -57,7 +57,8 @@ IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate,
 		const std::string &privateKeyFile,
 		const std::string &caFile,
 		const std::string &caPath,
-		export_protocol_version export_protocol)
+		export_protocol_version export_protocol,
+		uint16_t sendBatchSize)
 
 	: statSentDataRecords(0),
 	  statSentPackets(0),	  
@@ -67,8 +68,11 @@ IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate,
 	  recordCacheTimeout(IS_DEFAULT_RECORDCACHETIMEOUT),
 	  timeoutRegistered(false),
 	  currentTemplateId(0),
+	  stagingUsed(0),
+	  stagingPut(0),
 	  maxRecordRate(maxRecordRate),
-	  export_protocol(export_protocol)
+	  export_protocol(export_protocol),
+	  cachedExportTemplate(NULL)
 {
 #ifdef SUPPORT_DTLS
 	const char *certificate_chain_file = NULL;
@@ -92,6 +96,10 @@ IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate,
 	ipfix_set_sctp_lifetime(ipfixExporter, sctpDataLifetime);
 	ipfix_set_sctp_reconnect_timer(ipfixExporter, sctpReconnectInterval);
 	ipfix_set_template_transmission_timer(ipfixExporter, templateRefreshInterval);
+	if (ipfix_set_send_batch_size(ipfixExporter, sendBatchSize) != 0) {
+		msg(LOG_CRIT, "IpfixSender: ipfix_set_send_batch_size failed");
+		goto out;
+	}
 
  
 #ifdef SUPPORT_DTLS
@@ -127,8 +135,11 @@ IpfixSender::IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate)
 	  recordCacheTimeout(IS_DEFAULT_RECORDCACHETIMEOUT),
 	  timeoutRegistered(false),
 	  currentTemplateId(0),
+	  stagingUsed(0),
+	  stagingPut(0),
 	  maxRecordRate(maxRecordRate),
-	  export_protocol(IPFIX_PROTOCOL)
+	  export_protocol(IPFIX_PROTOCOL),
+	  cachedExportTemplate(NULL)
 {
 	ipfix_exporter** exporterP = &this->ipfixExporter;
 
@@ -159,7 +170,10 @@ out:
 IpfixSender::~IpfixSender()
 {
 	this->shutdown(false);
+	ipfixMessageLock.lock();
 	ipfix_deinit_exporter(&ipfixExporter);
+	ipfixExporter = NULL;
+	ipfixMessageLock.unlock();
 }
 
 /**
@@ -172,11 +186,15 @@ IpfixSender::~IpfixSender()
  * 	DTLS_OVER_UDP and DTLS_OVER_SCTP. See ipfixlolib documentation for more
  * 	information.
  * @param vrf_name local VRF name to use for outgoing packets
+ * @param sendQueueLength number of Data Messages queued for transmission
+ * 	by the sender thread of ipfixlolib, 0 sends from the calling thread
+ * @param sendQueuePolicy what to do with Data Messages if the queue is full
  * FIXME: support for other than UDP
  */
 void IpfixSender::addCollector(const char *ip, uint16_t port,
 		ipfix_transport_protocol proto, void *aux_config,
-		const char *vrf_name)
+		const char *vrf_name, uint32_t sendQueueLength,
+		ipfix_queue_overflow_policy sendQueuePolicy)
 {
 	ipfix_exporter *ex = (ipfix_exporter *)ipfixExporter;
 
@@ -230,6 +248,12 @@ void IpfixSender::addCollector(const char *ip, uint16_t port,
 				vrf_log, ip, port);
 		return;
 	}
+
+	if (sendQueueLength > 0 && ipfix_set_collector_send_queue(ex, ip, port,
+			sendQueueLength, sendQueuePolicy) != 0) {
+		THROWEXCEPTION("%sIpfixSender: failed to set up send queue for %s:%d",
+				vrf_log, ip, port);
+	}
 }
 
 /**
@@ -307,6 +331,7 @@ void IpfixSender::onTemplate(IpfixTemplateRecord* record)
 	// Update maps
 	templateIdToUniqueId[my_template_id] = dataTemplateInfo->getUniqueId(); 
 	uniqueIdToTemplateId[dataTemplateInfo->getUniqueId()] = my_template_id;
+	initExportTemplate(&exportTemplates[dataTemplateInfo->getUniqueId()], dataTemplateInfo.get(), my_template_id);
 
 	//for(map<TemplateInfo::TemplateId, uint16_t>::iterator iter = templateIdToUniqueId.begin(); iter != templateIdToUniqueId.end(); iter++) msg(LOG_CRIT, "template id %u -> unique id %u", iter->first, iter->second);
 	//for(map<uint16_t, TemplateInfo::TemplateId>::iterator iter = uniqueIdToTemplateId.begin(); iter != uniqueIdToTemplateId.end(); iter++) msg(LOG_CRIT, "unique id %u -> template id %u", iter->first, iter->second);
@@ -416,6 +441,8 @@ void IpfixSender::onTemplateDestruction(IpfixTemplateDestructionRecord* record)
 	// remove from maps
 	uniqueIdToTemplateId.erase(iter);
 	templateIdToUniqueId.erase(my_template_id);
+	exportTemplates.erase(dataTemplateInfo->getUniqueId());
+	clearExportTemplateCache();
 
 	/* Remove template from ipfixlolib */
 	if (0 != ipfix_remove_template(ipfixExporter, my_template_id)) {
@@ -479,6 +506,7 @@ void IpfixSender::setTemplateId(TemplateInfo::TemplateId templateId, uint16_t da
  */
 void IpfixSender::endDataSet()
 {
+	putStagedData();
 	if (ipfix_end_data_set(ipfixExporter, noRecordsInCurrentSet) != 0) {
 		THROWEXCEPTION("ipfix_end_data_set failed");
 	}
@@ -509,6 +537,9 @@ void IpfixSender::send() {
 	if (ipfix_send(ipfixExporter) != 0) {
 		THROWEXCEPTION("sndIpfix: ipfix_send failed");
 	}
+	// ipfixlolib does not reference the staged Data Records any longer
+	stagingUsed = 0;
+	stagingPut = 0;
 
 	removeRecordReferences();
 }
@@ -549,8 +580,8 @@ void IpfixSender::onDataRecord(IpfixDataRecord* record)
 	ipfixMessageLock.lock();
 
 	// check if we know the Template
-	map<uint16_t, TemplateInfo::TemplateId>::iterator iter = uniqueIdToTemplateId.find(dataTemplateInfo->getUniqueId());
-	if(iter == uniqueIdToTemplateId.end()) {
+	ExportTemplate* exportTemplate = lookupExportTemplate(dataTemplateInfo);
+	if (!exportTemplate) {
 		msg(LOG_ERR, "IpfixSender: Discard Data Record because Template (id=%u) does not exist (this may happen during reconfiguration).", dataTemplateInfo->templateId);
 		record->removeReference();
 		ipfixMessageLock.unlock();
@@ -558,7 +589,6 @@ void IpfixSender::onDataRecord(IpfixDataRecord* record)
 	}
 
 	IpfixRecord::Data* data = record->data;
-	TemplateInfo::TemplateId my_template_id = iter->second;
 
 	// return if exitFlag has ben set in the meanwhile
 	if (exitFlag) {
@@ -567,15 +597,23 @@ void IpfixSender::onDataRecord(IpfixDataRecord* record)
 		return;
 	}
 
-	setTemplateId(my_template_id, record->dataLength);
+	setTemplateId(exportTemplate->templateId, record->dataLength);
 
-	// Set variable length data based on template estimation to avoid realloc
-	initVarLenData(record, data);
+	if (exportTemplate->fixedLength &&
+			stagingUsed + exportTemplate->wireLength <= sizeof(stagingBuffer)) {
+		stageDataRecord(exportTemplate, data);
+	} else {
+		// keep the order of Data Records in the current Data Set
+		putStagedData();
 
-	int i;
-	for (i = 0; i < dataTemplateInfo->fieldCount; i++) {
-		TemplateInfo::FieldInfo* fi = &(dataTemplateInfo->fieldInfo[i]);
-		addDataRecordValue(fi, data, record);
+		// Set variable length data based on template estimation to avoid realloc
+		initVarLenData(record, data);
+
+		int i;
+		for (i = 0; i < dataTemplateInfo->fieldCount; i++) {
+			TemplateInfo::FieldInfo* fi = &(dataTemplateInfo->fieldInfo[i]);
+			addDataRecordValue(fi, data, record);
+		}
 	}
 	remainingSpace -= record->dataLength;
 	statSentDataRecords++;
@@ -591,6 +629,144 @@ void IpfixSender::onDataRecord(IpfixDataRecord* record)
 	ipfixMessageLock.unlock();
 }
 
+/**
+ * Determines how Data Records of a Template are serialised.
+ * Templates without basicList fields have Data Records of fixed length which
+ * are copied into @c stagingBuffer as a whole. Adjacent fields are merged
+ * into a single @c CopyRun, so a Data Record whose fields are stored
+ * back-to-back needs a single memcpy().
+ * @param et export information to initialize
+ * @param templateInfo announced Template
+ * @param templateId Template ID used by this exporter
+ */
+void IpfixSender::initExportTemplate(ExportTemplate* et, TemplateInfo* templateInfo, TemplateInfo::TemplateId templateId)
+{
+	uint32_t wireLength = 0;
+
+	et->templateId = templateId;
+	et->fixedLength = true;
+	et->packetDeltaCountOffset = -1;
+	et->packetDeltaCountLength = 0;
+	et->runs.clear();
+
+	for (int i = 0; i < templateInfo->fieldCount; i++) {
+		TemplateInfo::FieldInfo* fi = &templateInfo->fieldInfo[i];
+		CopyRun run;
+		run.type = CopyRun::Copy;
+		run.offset = fi->offset;
+		run.length = fi->type.length;
+
+		if (fi->type.id == IPFIX_TYPEID_basicList) {
+			et->fixedLength = false;
+			break;
+		}
+		if (((fi->type.id == IPFIX_TYPEID_sourceIPv4Address) ||
+				(fi->type.id == IPFIX_TYPEID_destinationIPv4Address)) &&
+				(fi->type.length == 5)) {
+			/* Split IPv4 fields with length 5, i.e. fields with network mask attached */
+			run.length = 4;
+			et->runs.push_back(run);
+			run.type = CopyRun::PrefixLength;
+			run.offset = fi->offset + 4;
+			run.length = 1;
+		} else if ((export_protocol == NFV9_PROTOCOL) &&
+				(fi->type.id == IPFIX_TYPEID_tcpControlBits) &&
+				(fi->type.length != 1)) {
+			// data is in network order, we want just the second byte as per RFC
+			run.offset = fi->offset + 1;
+			run.length = 1;
+		} else if (fi->type.id == IPFIX_TYPEID_packetDeltaCount && fi->type.length <= 8) {
+			et->packetDeltaCountOffset = fi->offset;
+			et->packetDeltaCountLength = fi->type.length;
+		}
+
+		// merge with the previous run if the fields are stored back-to-back
+		if (run.type == CopyRun::Copy && !et->runs.empty() &&
+				et->runs.back().type == CopyRun::Copy &&
+				et->runs.back().offset + et->runs.back().length == run.offset) {
+			et->runs.back().length += run.length;
+		} else {
+			et->runs.push_back(run);
+		}
+	}
+	for (size_t i = 0; i < et->runs.size(); i++)
+		wireLength += et->runs[i].length;
+
+	if (wireLength > UINT16_MAX)
+		et->fixedLength = false;
+	if (!et->fixedLength) {
+		et->runs.clear();
+		wireLength = 0;
+	}
+	et->wireLength = wireLength;
+}
+
+/**
+ * Returns the export information of a Template, NULL if the Template has
+ * not been announced. Consecutive Data Records usually share their Template,
+ * so the result of the previous lookup is reused.
+ */
+IpfixSender::ExportTemplate* IpfixSender::lookupExportTemplate(const boost::shared_ptr<TemplateInfo>& templateInfo)
+{
+	if (templateInfo == cachedTemplateInfo)
+		return cachedExportTemplate;
+
+	map<uint16_t, ExportTemplate>::iterator iter = exportTemplates.find(templateInfo->getUniqueId());
+	if (iter == exportTemplates.end())
+		return NULL;
+
+	cachedTemplateInfo = templateInfo;
+	cachedExportTemplate = &iter->second;
+	return cachedExportTemplate;
+}
+
+/**
+ * Forgets the result of the previous Template lookup.
+ * Must be called whenever export information is removed.
+ */
+void IpfixSender::clearExportTemplateCache()
+{
+	cachedTemplateInfo.reset();
+	cachedExportTemplate = NULL;
+}
+
+/**
+ * Serialises a fixed-length Data Record into @c stagingBuffer.
+ * The staged Data Records are passed to ipfixlolib by @c putStagedData().
+ */
+void IpfixSender::stageDataRecord(ExportTemplate* et, IpfixRecord::Data* data)
+{
+	uint8_t* dst = stagingBuffer + stagingUsed;
+
+	for (vector<CopyRun>::const_iterator run = et->runs.begin(); run != et->runs.end(); run++) {
+		if (run->type == CopyRun::Copy) {
+			memcpy(dst, data + run->offset, run->length);
+			dst += run->length;
+		} else {
+			*dst++ = 32 - *(uint8_t*)(data + run->offset);
+		}
+	}
+	stagingUsed += et->wireLength;
+
+	if (et->packetDeltaCountOffset >= 0) {
+		uint64_t p = 0;
+		memcpy(&p, data + et->packetDeltaCountOffset, et->packetDeltaCountLength);
+		statPacketsInFlows += ntohll(p);
+	}
+}
+
+/**
+ * Passes the Data Records staged since the last call to ipfixlolib as a
+ * single field.
+ */
+void IpfixSender::putStagedData()
+{
+	if (stagingUsed == stagingPut)
+		return;
+	ipfix_put_data_field(ipfixExporter, stagingBuffer + stagingPut, stagingUsed - stagingPut);
+	stagingPut = stagingUsed;
+}
+
 void IpfixSender::addDataRecordValue(TemplateInfo::FieldInfo* fi, IpfixRecord::Data* data)
 {
 	addDataRecordValue(fi, data, NULL);
@@ -736,6 +912,8 @@ void IpfixSender::onReconfiguration2()
 	// clear maps
 	uniqueIdToTemplateId.clear();
 	templateIdToUniqueId.clear();
+	exportTemplates.clear();
+	clearExportTemplateCache();
 
 	// release message lock
 	ipfixMessageLock.unlock();
@@ -769,6 +947,8 @@ void IpfixSender::sendRecords(SendPolicy policy)
 	if (currentTemplateId) endDataSet();
 	send();
 	statSentPackets++;
+	// do not delay messages waiting in a send batch any longer
+	ipfix_flush(ipfixExporter);
 
 	// get the message lock
 	ipfixMessageLock.unlock();
@@ -849,9 +1029,27 @@ void IpfixSender::clearStatistics()
 
 string IpfixSender::getStatisticsXML(double interval)
 {
-	char buf[200];
-	snprintf(buf, ARRAY_SIZE(buf), "<totalSentDataRecords>%u</totalSentDataRecords><totalSentUDPDataRecordPackets>%u</totalSentUDPDataRecordPackets><totalPacketsInFlows>%u</totalPacketsInFlows>",
-			statSentDataRecords, statSentPackets, statPacketsInFlows);
-	return buf;
+	ostringstream oss;
+	oss << "<totalSentDataRecords>" << statSentDataRecords << "</totalSentDataRecords>";
+	oss << "<totalSentUDPDataRecordPackets>" << statSentPackets << "</totalSentUDPDataRecordPackets>";
+	oss << "<totalPacketsInFlows>" << statPacketsInFlows << "</totalPacketsInFlows>";
+
+	// the exporter may grow its collector array or free send queues while sending
+	ipfixMessageLock.lock();
+	ipfix_exporter *ex = (ipfix_exporter *)ipfixExporter;
+	if (ex) {
+		for (int i = 0; i < ex->collector_max_num; i++) {
+			ipfix_send_queue_stats stats;
+			if (ipfix_get_send_queue_stats(ex, i, &stats) != 0)
+				continue;
+			oss << "<collector address=\"" << ex->collector_arr[i]->ipaddress << ":"
+				<< ex->collector_arr[i]->port_number << "\">";
+			oss << "<sendQueueLength>" << stats.length << "</sendQueueLength>";
+			oss << "<sendQueueDrops>" << stats.dropped << "</sendQueueDrops>";
+			oss << "</collector>";
+		}
+	}
+	ipfixMessageLock.unlock();
+	return oss.str();
 }
 
@@ -29,6 +29,7 @@
 #include "core/Notifiable.h"
 #include <queue>
 #include <map>
+#include <vector>
 
 
 
@@ -50,13 +51,15 @@ public:
 			const std::string &privateKeyFile,
 			const std::string &caFile,
 		        const std::string &caPath,
-		        export_protocol_version export_protocol = IPFIX_PROTOCOL);
+		        export_protocol_version export_protocol = IPFIX_PROTOCOL,
+			uint16_t sendBatchSize = IS_DEFAULT_SENDBATCHSIZE);
 	IpfixSender(uint32_t observationDomainId, uint32_t maxRecordRate = IS_DEFAULT_MAXRECORDRATE);
 	virtual ~IpfixSender();
 
 	void addCollector(const char *ip, uint16_t port,
 			ipfix_transport_protocol proto, void *aux_config,
-			const char *vrf_name);
+			const char *vrf_name, uint32_t sendQueueLength = 0,
+			ipfix_queue_overflow_policy sendQueuePolicy = IPFIX_QUEUE_DROP_OLDEST);
 	void flushPacket();
 
 	virtual void notifyQueueRunning();
@@ -83,6 +86,32 @@ private:
 		IfNotEmpty,
 		Always
 	};
+
+	/**
+	 * Part of a Data Record which is copied into @c stagingBuffer
+	 */
+	struct CopyRun {
+		enum Type {
+			Copy, /**< copy @c length bytes starting at @c offset */
+			PrefixLength /**< convert the network mask at @c offset into a prefix length */
+		};
+		Type type;
+		uint16_t offset;
+		uint16_t length;
+	};
+
+	/**
+	 * Export information about an announced Template
+	 */
+	struct ExportTemplate {
+		TemplateInfo::TemplateId templateId; /**< Template ID used by this exporter */
+		bool fixedLength; /**< true if Data Records are serialised with @c runs */
+		uint16_t wireLength; /**< length of a serialised Data Record */
+		int packetDeltaCountOffset; /**< offset of packetDeltaCount for statistics, -1 if none */
+		uint16_t packetDeltaCountLength;
+		std::vector<CopyRun> runs;
+	};
+
 	void performShutdown(); 
 	static void* threadWrapper(void* instance);
 	void processLoop();
@@ -100,6 +129,11 @@ private:
 	void addDataRecordValue(TemplateInfo::FieldInfo*, IpfixRecord::Data*, IpfixDataRecord*);
 	void sendDataFromVarLenDataBuff(IpfixDataRecord*, void*, size_t);
 	void initVarLenData(IpfixDataRecord*, IpfixRecord::Data*);
+	void initExportTemplate(ExportTemplate*, TemplateInfo*, TemplateInfo::TemplateId);
+	ExportTemplate* lookupExportTemplate(const boost::shared_ptr<TemplateInfo>&);
+	void stageDataRecord(ExportTemplate*, IpfixRecord::Data*);
+	void putStagedData();
+	void clearExportTemplateCache();
 
 	TemplateInfo::TemplateId getUnusedTemplateId();
 
@@ -132,6 +166,10 @@ private:
 	uint16_t ringbufferPos; /**< Pointer to next free slot in @c conversionRingbuffer. */
 	uint8_t conversionRingbuffer[65536]; /**< Ringbuffer used to store converted imasks between @c ipfix_put_data_field() and @c ipfix_send() */
 
+	uint8_t stagingBuffer[IPFIX_MAX_PACKETSIZE]; /**< Serialised fixed-length Data Records of the current message */
+	uint32_t stagingUsed; /**< Number of bytes used in @c stagingBuffer */
+	uint32_t stagingPut; /**< Number of bytes of @c stagingBuffer already passed to @c ipfix_put_data_field() */
+
 	// rate limiting paramemters 
 	struct timeval curTimeStep; /**< current time used for determining packet rate */
 	uint32_t recordsSentStep; /**< number of records sent in timestep (usually 100ms)*/
@@ -143,7 +181,10 @@ private:
 	// mapping of uniqueId to templateId and vice versa
 	std::map<TemplateInfo::TemplateId, uint16_t> templateIdToUniqueId; /**< stores uniqueId for a give Template ID */
 	std::map<uint16_t, TemplateInfo::TemplateId> uniqueIdToTemplateId; /**< stores Template ID for a give unique ID */
+	std::map<uint16_t, ExportTemplate> exportTemplates; /**< stores export information for a given unique ID */
 	export_protocol_version export_protocol; // Version of Flow record, V9 or IPFIX
+	boost::shared_ptr<TemplateInfo> cachedTemplateInfo; /**< Template of the previous Data Record */
+	ExportTemplate* cachedExportTemplate; /**< export information of @c cachedTemplateInfo */
 
 };
 
@@ -36,7 +36,8 @@ IpfixDbWriterCfg* IpfixDbWriterCfg::create(XMLElement* e)
 
 IpfixDbWriterCfg::IpfixDbWriterCfg(XMLElement* elem)
     : CfgHelper<IpfixDbWriterSQL, IpfixDbWriterCfg>(elem, "ipfixDbWriter"),
-      port(0), bufferRecords(30), observationDomainId(0), tablePrefix("f"), useLegacyNames(false)
+      port(0), bufferRecords(30), observationDomainId(0), tablePrefix("f"), useLegacyNames(false),
+      useCopy(false), writerBatches(0), journalMaxSize(100*1024*1024)
 {
     if (!elem) return;
 
@@ -50,6 +51,14 @@ IpfixDbWriterCfg::IpfixDbWriterCfg(XMLElement* elem)
 			databaseType = e->getFirstText();
 		} else if (e->matches("useLegacyNames")) {
 			useLegacyNames = getBool("useLegacyNames");
+		} else if (e->matches("useCopy")) {
+			useCopy = getBool("useCopy");
+		} else if (e->matches("writerBatches")) {
+			writerBatches = getInt("writerBatches");
+		} else if (e->matches("journal")) {
+			journal = e->getFirstText();
+		} else if (e->matches("journalMaxSize")) {
+			journalMaxSize = getInt64("journalMaxSize");
 		} else if (e->matches("host")) {
 			hostname = e->getFirstText();
 		} else if (e->matches("port")) {
@@ -75,10 +84,12 @@ IpfixDbWriterCfg::IpfixDbWriterCfg(XMLElement* elem)
 		}
 	}
 	if (databaseType != "mysql" && databaseType != "postgres" && databaseType != "oracle") THROWEXCEPTION("IpfixDbWriterCfg: Incorrect value for dbType: \"%s\"", databaseType.c_str());
+	if (useCopy && databaseType != "postgres") THROWEXCEPTION("IpfixDbWriterCfg: useCopy is only supported for dbType postgres");
 	if (hostname=="") THROWEXCEPTION("IpfixDbWriterCfg: host not set in configuration!");
 	if (port==0) THROWEXCEPTION("IpfixDbWriterCfg: port not set in configuration!");
 	if (dbname=="") THROWEXCEPTION("IpfixDbWriterCfg: dbname not set in configuration!");
 	if (user=="") THROWEXCEPTION("IpfixDbWriterCfg: username not set in configuration!");
+	if (journal!="" && writerBatches==0) THROWEXCEPTION("IpfixDbWriterCfg: journal requires writerBatches to be set!");
 }
 
 void IpfixDbWriterCfg::readColumns(XMLElement* elem) {
@@ -116,7 +127,7 @@ IpfixDbWriterSQL* IpfixDbWriterCfg::createInstance()
 	} else if  (databaseType == "postgres") {
 
 #if defined(PG_SUPPORT_ENABLED)
-		instance = new IpfixDbWriterPg(databaseType.c_str(), hostname.c_str(), dbname.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferRecords, colNames, useLegacyNames, tablePrefix.c_str());
+		instance = new IpfixDbWriterPg(databaseType.c_str(), hostname.c_str(), dbname.c_str(), user.c_str(), password.c_str(), port, observationDomainId, bufferRecords, colNames, useLegacyNames, tablePrefix.c_str(), useCopy);
 #else
 		goto except;
 #endif
@@ -129,6 +140,7 @@ IpfixDbWriterSQL* IpfixDbWriterCfg::createInstance()
 	} else {
 		goto except;
 	}
+	instance->setWriterThread(writerBatches, journal, journalMaxSize);
 	return instance;
 except:
 	THROWEXCEPTION("IpfixDbWriterCfg: Database type \"%s\" not yet implemented or support in vermont is not compiled in ...", databaseType.c_str());
@@ -57,6 +57,10 @@ protected:
 	string tablePrefix; /**< prefix for database table names */
 	vector<string> colNames; /**< column names */
 	bool useLegacyNames;
+	bool useCopy; /**< use COPY instead of INSERT statements (postgres only) */
+	uint32_t writerBatches; /**< batches queued for the writer thread, 0 writes on the record thread */
+	string journal; /**< file for batches which could not be written to the database */
+	uint64_t journalMaxSize; /**< maximum size of the journal in bytes */
 
 	void readColumns(XMLElement* elem);
 	IpfixDbWriterCfg(XMLElement*);
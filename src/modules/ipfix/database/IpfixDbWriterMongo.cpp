@@ -26,6 +26,7 @@
 #include <iomanip>
 #include <stdlib.h>
 #include <vector>
+#include <boost/lexical_cast.hpp>
 #include "IpfixDbWriterMongo.hpp"
 #include "common/msg.h"
 
@@ -119,7 +120,6 @@ void IpfixDbWriterMongo::processDataDataRecord(const IpfixRecord::SourceID& sour
 		TemplateInfo& dataTemplateInfo, uint16_t length,
 		IpfixRecord::Data* data)
 {
-  mongo::BSONObj obj;
 	msg(LOG_INFO, "IpfixDbWriter: Processing data record");
 
 	if (dbError) {
@@ -128,32 +128,19 @@ void IpfixDbWriterMongo::processDataDataRecord(const IpfixRecord::SourceID& sour
 		if (dbError) return;
 	}
 
-	/* get new insert */
+	/* append new object to the batch */
 	if(srcId.observationDomainId != 0) {
 		// use default source id
-		obj = getInsertObj(srcId, dataTemplateInfo, length, data);
+		bufferedObjects.push_back(getInsertObj(srcId, dataTemplateInfo, length, data));
 	} else {
-		obj = getInsertObj(sourceID, dataTemplateInfo, length, data);
-	}
-
-
-	// start new insert statement if necessary
-	if (numberOfInserts == 0) {
-		// start insert statement
-		bufferedObjects.clear();
-    bufferedObjects.push_back(obj);
-		numberOfInserts = 1;
-	} else {
-		// append object
-    bufferedObjects.push_back(obj);
-		numberOfInserts++;
+		bufferedObjects.push_back(getInsertObj(sourceID, dataTemplateInfo, length, data));
 	}
+	numberOfInserts++;
 
 	// write to db if maxInserts is reached
 	if(numberOfInserts == maxInserts) {
 		msg(LOG_INFO, "IpfixDbWriter: Writing buffered records to database");
 		writeToDb();
-		numberOfInserts = 0;
 	}
 }
 
@@ -176,7 +163,8 @@ mongo::BSONObj IpfixDbWriterMongo::getInsertObj(const IpfixRecord::SourceID& sou
 	/** loop over a subset of elements (selected properties) and loop over the IPFIX_TYPEID of the record
 	 *  to get the corresponding data to store and make insert statement
 	 */
-		for(vector<Property>::iterator prop = documentProperties.begin(); prop != documentProperties.end(); prop++) {
+		for(size_t p = 0; p < documentProperties.size(); p++) {
+			const Property* prop = &documentProperties[p];
 			if (prop->ipfixId == EXPORTERID) {
 				// if this is the same source ID as last time, we get the exporter id from currentExporter
 				if ((currentExporter != NULL) && equalExporter(sourceID, currentExporter->sourceID)) {
@@ -203,16 +191,6 @@ mongo::BSONObj IpfixDbWriterMongo::getInsertObj(const IpfixRecord::SourceID& sou
 						}
 					}
 				}
-				if( dataTemplateInfo.dataCount > 0 && notfound) {
-					// look in static data fields of template for data
-					for(k=0; k < dataTemplateInfo.dataCount; k++) {
-						if(dataTemplateInfo.fieldInfo[k].type.enterprise == prop->enterprise && dataTemplateInfo.dataInfo[k].type.id == prop->ipfixId) {
-							notfound = false;
-							intdata = getData(dataTemplateInfo.dataInfo[k].type,(dataTemplateInfo.data+dataTemplateInfo.dataInfo[k].offset));
-							break;
-						}
-					}
-				}
 				if(notfound) {
 					notfound2 = true;
 					// for some Ids, we have an alternative
@@ -331,10 +309,7 @@ mongo::BSONObj IpfixDbWriterMongo::getInsertObj(const IpfixRecord::SourceID& sou
 			}
 		msg(LOG_INFO, "saw ipfix id %s (element ID %d) in packet with intdata %llX", prop->propertyName,
 							prop->ipfixId, static_cast<int64_t>(intdata));
-					if (beautyProp)
-						obj << prop->propertyName << static_cast<long long int>(intdata);
-					else
-						obj << boost::lexical_cast<std::string>(prop->ipfixId).c_str() << static_cast<long long int>(intdata);
+					obj << propertyKeys[p].c_str() << static_cast<long long int>(intdata);
 						
 					if (flowstartsec == 0) {
 						msg(LOG_ERR, "IpfixDbWriterMongo: Failed to get timing data from record. Will be saved in default table.");
@@ -349,15 +324,7 @@ mongo::BSONObj IpfixDbWriterMongo::getInsertObj(const IpfixRecord::SourceID& sou
 						DPRINTF_INFO("IpfixDbWriterMongo::getData: dumping from packet intdata %llX, type %d, length %d and offset %X",
 						  intdata, dataTemplateInfo.fieldInfo[k].type.id, dataTemplateInfo.fieldInfo[k].type.length,
 						  dataTemplateInfo.fieldInfo[k].offset);
-						obj << boost::lexical_cast<std::string>(dataTemplateInfo.fieldInfo[k].type.id).c_str() << static_cast<long long int>(intdata);
-					}
-				}
-			
-			if( dataTemplateInfo.dataCount > 0) {
-				// look in static data fields of template for data
-				for(int k=0; k < dataTemplateInfo.dataCount; k++) {
-						intdata = getData(dataTemplateInfo.dataInfo[k].type,(dataTemplateInfo.data+dataTemplateInfo.dataInfo[k].offset));
-						obj << boost::lexical_cast<std::string>(dataTemplateInfo.fieldInfo[k].type.id).c_str() << static_cast<long long int>(intdata);
+						obj << getFieldKey(dataTemplateInfo.fieldInfo[k].type.id).c_str() << static_cast<long long int>(intdata);
 					}
 				}
 		}
@@ -365,17 +332,39 @@ mongo::BSONObj IpfixDbWriterMongo::getInsertObj(const IpfixRecord::SourceID& sou
 }
 
 
+/**
+ *	Returns the field name of an IPFIX_TYPEID, converted to a string only once
+ */
+const string& IpfixDbWriterMongo::getFieldKey(InformationElement::IeId id)
+{
+	map<InformationElement::IeId, string>::iterator iter = fieldKeys.find(id);
+	if (iter == fieldKeys.end())
+		iter = fieldKeys.insert(make_pair(id, boost::lexical_cast<std::string>(id))).first;
+	return iter->second;
+}
+
 /*
  * Write Objects to database
+ * All buffered objects are sent in one bulk insert. The insert continues after
+ * a failed document, so one bad document does not discard the rest of the batch.
  */
 int IpfixDbWriterMongo::writeToDb()
 {
-  con.insert(dbCollectionFlows, bufferedObjects);
-  if(con.getLastError() != ""){
+	if (bufferedObjects.empty())
+		return 0;
+
+#ifdef MONGO_VERSION_2
+	con.insert(dbCollectionFlows, bufferedObjects, mongo::InsertOption_ContinueOnError);
+#else
+	con.insert(dbCollectionFlows, bufferedObjects);
+#endif
+	bufferedObjects.clear();
+	numberOfInserts = 0;
+	if(con.getLastError() != ""){
 		msg(LOG_CRIT, "IpfixDbWriterMongo: Failed to write to DB.");
-    return 1;
-  }
-	return 0; 
+		return 1;
+	}
+	return 0;
 }
 
 /**
@@ -480,8 +469,7 @@ void IpfixDbWriterMongo::onDataRecord(IpfixDataRecord* record)
 {
 	// only treat non-Options Data Records (although we cannot be sure that there is a Flow inside)
 	if((record->templateInfo->setId != TemplateInfo::NetflowTemplate)
-		&& (record->templateInfo->setId != TemplateInfo::IpfixTemplate)
-		&& (record->templateInfo->setId != TemplateInfo::IpfixDataTemplate)) {
+		&& (record->templateInfo->setId != TemplateInfo::IpfixTemplate)) {
 		record->removeReference();
 		return;
 	}
@@ -532,6 +520,15 @@ IpfixDbWriterMongo::IpfixDbWriterMongo(const string& hostname, const string& dat
 		}
 	}
 	
+	// field names are the same for every object
+	for(vector<Property>::const_iterator prop = documentProperties.begin(); prop != documentProperties.end(); prop++) {
+		if (beautyProp)
+			propertyKeys.push_back(prop->propertyName);
+		else
+			propertyKeys.push_back(boost::lexical_cast<std::string>(prop->ipfixId));
+	}
+	bufferedObjects.reserve(maxInserts);
+
   if(propertyNames.empty() && ! allProp)
 		THROWEXCEPTION("IpfixDbWriterMongo: cannot initiate with no properties");
 
@@ -38,6 +38,7 @@ Mongo  *
 #include <time.h>
 #include <sstream>
 #include <vector>
+#include <map>
 
 #undef msg
 #include "client/dbclient.h"
@@ -100,6 +101,8 @@ class IpfixDbWriterMongo
 		int maxInserts;						// maximum number of inserts per statement
 
 		vector<Property> documentProperties;			// Properties of inserted objects 
+		vector<string> propertyKeys;				// field names of documentProperties, built once
+		map<InformationElement::IeId, string> fieldKeys;	// field names used with allProperties
 
 		// database data
 		string dbHost, dbName, dbUser, dbPassword, dbCollectionFlows, dbCollectionExporters, dbCollectionCounters;
@@ -117,6 +120,7 @@ class IpfixDbWriterMongo
 				IpfixRecord::Data* data);
 
 		uint64_t getData(InformationElement::IeInfo type, IpfixRecord::Data* data);
+		const string& getFieldKey(InformationElement::IeId id);
 		bool equalExporter(const IpfixRecord::SourceID& a, const IpfixRecord::SourceID& b);
 
 		const static Property identify[];
@@ -164,21 +164,15 @@ bool IpfixDbWriterMySQL::createDBTable(const char* partitionname, uint64_t start
 /*
  * Write insertStatement to database
  */
-bool IpfixDbWriterMySQL::writeToDb()
+bool IpfixDbWriterMySQL::writeBatch(Batch* batch)
 {
-	if (insertBuffer.curRows == 0) return true;
+	DPRINTF_INFO("SQL Query: %s", batch->data.c_str());
 
-	DPRINTF_INFO("SQL Query: %s", insertBuffer.sql);
-
-	if(mysql_query(conn, insertBuffer.sql) != 0) {
+	if(mysql_query(conn, batch->data.c_str()) != 0) {
 		msg(LOG_ERR,"IpfixDbWriterMySQL: Insert of records failed. Error: %s", mysql_error(conn));
 		goto dbwriteerror;
 	}
 
-	insertBuffer.curRows = 0;
-	insertBuffer.appendPtr = insertBuffer.bodyPtr;
-	*insertBuffer.appendPtr = 0;
-
 	msg(LOG_INFO,"IpfixDbWriterMySQL: Write to database is complete");
 	return true;
 
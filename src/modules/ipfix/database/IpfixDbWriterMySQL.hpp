@@ -54,7 +54,7 @@ class IpfixDbWriterMySQL
 		~IpfixDbWriterMySQL();
 
 		virtual void connectToDB();
-		virtual bool writeToDb();
+		virtual bool writeBatch(Batch* batch);
 		virtual int createExporterTable();
 		virtual int getExporterID(IpfixRecord::SourceID* sourceID);
 		virtual bool createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime);
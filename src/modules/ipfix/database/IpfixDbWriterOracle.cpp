@@ -230,14 +230,8 @@ int IpfixDbWriterOracle::createExporterTable()
 /*
  * Write insertStatement to database
  */
-bool IpfixDbWriterOracle::writeToDb()
+bool IpfixDbWriterOracle::writeBatch(Batch* batch)
 {
-	if (insertBuffer.curRows == 0) {
-		// nothing to write
-		return 1;
-	}
-
-	
 	// this is an insert operation. Oracle is a professional datatbase and therefore wants to have
 	// some special handling of multi row inserts. Inserts should look like 
 	// INSERT ALL
@@ -246,7 +240,7 @@ bool IpfixDbWriterOracle::writeToDb()
 	//	...
 	// SELECT * FROM dual;
 	// we therefore need to append the dual select
-	std::string sql_string = std::string(insertBuffer.sql) + " SELECT * FROM dual";
+	std::string sql_string = batch->data + " SELECT * FROM dual";
 
 	oracle::occi::Statement *stmt = NULL;
 	oracle::occi::ResultSet *rs = NULL;
@@ -269,7 +263,7 @@ bool IpfixDbWriterOracle::writeToDb()
 		}
 		catch (oracle::occi::SQLException& ex)
 		{
-			msg(LOG_CRIT,"IpfixDbWriterOracle: Error executing flow db insert \"%s\": %s", insertBuffer.sql, ex.getMessage().c_str());	
+			msg(LOG_CRIT,"IpfixDbWriterOracle: Error executing flow db insert \"%s\": %s", batch->data.c_str(), ex.getMessage().c_str());	
 			dbError = true;
 			con->terminateStatement(stmt);
 			return 0;					
@@ -279,9 +273,6 @@ bool IpfixDbWriterOracle::writeToDb()
 		con->terminateStatement(stmt);
 
 	}
-	insertBuffer.curRows = 0;
-	insertBuffer.appendPtr = insertBuffer.bodyPtr;
-	*insertBuffer.appendPtr = 0;
 
 	// commit transaction
 	try {
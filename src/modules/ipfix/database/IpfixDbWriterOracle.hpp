@@ -56,7 +56,7 @@ class IpfixDbWriterOracle
 		~IpfixDbWriterOracle();
 
 		virtual void connectToDB();
-		virtual bool writeToDb();
+		virtual bool writeBatch(Batch* batch);
 		virtual int createExporterTable();
 		virtual int getExporterID(IpfixRecord::SourceID* sourceID);
 		virtual bool createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime);
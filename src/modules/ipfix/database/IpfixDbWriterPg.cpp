@@ -39,6 +39,63 @@
 
 using namespace std;
 
+/**
+ * Signature, flags field and header extension length of the binary COPY format
+ */
+static const char copyHeader[] = {
+	'P', 'G', 'C', 'O', 'P', 'Y', '\n', '\377', '\r', '\n', '\0',
+	0, 0, 0, 0,
+	0, 0, 0, 0
+};
+
+/**
+ * Reads an unsigned integer in network byte order, handles reduced size encoding.
+ */
+static uint64_t readUint(const IpfixRecord::Data* data, uint16_t length)
+{
+	uint64_t acc = 0;
+	for (int i = 0; i < length; i++) {
+		acc = (acc << 8) + data[i];
+	}
+	return acc;
+}
+
+/**
+ * Reads a signed integer in network byte order, handles reduced size encoding.
+ */
+static int64_t readInt(const IpfixRecord::Data* data, uint16_t length)
+{
+	int64_t acc = (int8_t)data[0];
+	for (int i = 1; i < length; i++) {
+		acc = (acc << 8) + data[i];
+	}
+	return acc;
+}
+
+static void appendBytes(vector<char>& buffer, const void* bytes, size_t length)
+{
+	const char* p = (const char*)bytes;
+	buffer.insert(buffer.end(), p, p + length);
+}
+
+static void appendInt16(vector<char>& buffer, uint16_t value)
+{
+	value = htons(value);
+	appendBytes(buffer, &value, sizeof(value));
+}
+
+static void appendInt32(vector<char>& buffer, uint32_t value)
+{
+	value = htonl(value);
+	appendBytes(buffer, &value, sizeof(value));
+}
+
+static void appendInt64(vector<char>& buffer, uint64_t value)
+{
+	value = htonll(value);
+	appendBytes(buffer, &value, sizeof(value));
+}
+
 /**
  * (re)connect to database
  */
@@ -172,14 +229,14 @@ bool IpfixDbWriterPg::createDBTable(const char* partitionname, uint64_t starttim
  *	Function writes the content of the statemBuffer to database
  *	statemBuffer consist of single insert statements
  */
-bool IpfixDbWriterPg::writeToDb()
+bool IpfixDbWriterPg::writeBatch(Batch* batch)
 {
-	if (insertBuffer.curRows==0) return true;
+	if (useCopy) return writeCopyBatch(batch);
 
-	DPRINTF_INFO("SQL Query: %s", insertBuffer.sql);
+	DPRINTF_INFO("SQL Query: %s", batch->data.c_str());
 
 	// Write rows to database
-	PGresult* res = PQexec(conn, insertBuffer.sql);
+	PGresult* res = PQexec(conn, batch->data.c_str());
 	if (PQresultStatus(res) != PGRES_COMMAND_OK) {
 		msg(LOG_ERR,"IpfixDbWriterPg: Insert of records failed. Error: %s",
 				PQerrorMessage(conn));
@@ -188,10 +245,6 @@ bool IpfixDbWriterPg::writeToDb()
 	}
 	PQclear(res);
 
-	insertBuffer.curRows = 0;
-	insertBuffer.appendPtr = insertBuffer.bodyPtr;
-	*insertBuffer.appendPtr = 0;
-
     msg(LOG_INFO,"Write to database is complete");
     return true;
 
@@ -200,6 +253,26 @@ dbwriteerror:
 	return false;
 }
 
+/**
+ * Takes the encoded COPY rows instead of the INSERT statement in COPY mode
+ */
+void IpfixDbWriterPg::fillBatch(Batch* batch)
+{
+	if (!useCopy) {
+		IpfixDbWriterSQL::fillBatch(batch);
+		return;
+	}
+	batch->table = curTable;
+	batch->data.assign(copyBuffer.begin(), copyBuffer.end());
+	batch->rows = insertBuffer.curRows;
+}
+
+void IpfixDbWriterPg::clearInsertBuffer()
+{
+	IpfixDbWriterSQL::clearInsertBuffer();
+	copyBuffer.resize(sizeof(copyHeader));
+}
+
 /**
  *	Returns the exporterID
  *  	For every different sourcID and expIp a unique ExporterID will be generated from the database
@@ -282,6 +355,342 @@ int IpfixDbWriterPg::getExporterID(IpfixRecord::SourceID* sourceID)
 	return exporterID;
 }
 
+/**
+ *	Sends the rows of a batch with COPY ... FROM STDIN (FORMAT binary)
+ */
+bool IpfixDbWriterPg::writeCopyBatch(Batch* batch)
+{
+	static const char copyTrailer[] = { (char)0xFF, (char)0xFF };
+	ostringstream sql;
+	sql << "COPY " << batch->table.name << " (" << tableColumnsString << ") FROM STDIN (FORMAT binary)";
+	DPRINTF_INFO("SQL Query: %s", sql.str().c_str());
+
+	PGresult* res = PQexec(conn, sql.str().c_str());
+	if (PQresultStatus(res) != PGRES_COPY_IN) {
+		msg(LOG_ERR,"IpfixDbWriterPg: COPY of records failed. Error: %s",
+				PQerrorMessage(conn));
+		PQclear(res);
+		dbError = true;
+		return false;
+	}
+	PQclear(res);
+
+	if (PQputCopyData(conn, batch->data.data(), batch->data.size()) != 1 ||
+			PQputCopyData(conn, copyTrailer, sizeof(copyTrailer)) != 1 ||
+			PQputCopyEnd(conn, NULL) != 1) {
+		msg(LOG_ERR,"IpfixDbWriterPg: Sending of COPY data failed. Error: %s",
+				PQerrorMessage(conn));
+		dbError = true;
+		return false;
+	}
+
+	bool ok = true;
+	while ((res = PQgetResult(conn)) != NULL) {
+		if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+			msg(LOG_ERR,"IpfixDbWriterPg: COPY of records failed. Error: %s",
+					PQerrorMessage(conn));
+			ok = false;
+		}
+		PQclear(res);
+	}
+	if (!ok) {
+		dbError = true;
+		return false;
+	}
+
+	msg(LOG_INFO,"Write to database is complete");
+	return true;
+}
+
+/**
+ * Appends a number as field of the current COPY row, converted to the
+ * representation of the column. Columns without numeric type are set to NULL.
+ */
+void IpfixDbWriterPg::appendCopyNumber(const CopyColumn& cc, int64_t value)
+{
+	switch (cc.format) {
+		case CopyInt2:
+			appendInt32(copyBuffer, 2);
+			appendInt16(copyBuffer, (uint16_t)value);
+			break;
+		case CopyInt4:
+			appendInt32(copyBuffer, 4);
+			appendInt32(copyBuffer, (uint32_t)value);
+			break;
+		case CopyInt8:
+			appendInt32(copyBuffer, 8);
+			appendInt64(copyBuffer, (uint64_t)value);
+			break;
+		case CopyFloat4: {
+			float f = (float)value;
+			uint32_t bits;
+			memcpy(&bits, &f, sizeof(bits));
+			appendInt32(copyBuffer, 4);
+			appendInt32(copyBuffer, bits);
+			break;
+		}
+		case CopyFloat8: {
+			double d = (double)value;
+			uint64_t bits;
+			memcpy(&bits, &d, sizeof(bits));
+			appendInt32(copyBuffer, 8);
+			appendInt64(copyBuffer, bits);
+			break;
+		}
+		case CopyBool:
+			// IPFIX encodes true as 1 and false as 2
+			appendInt32(copyBuffer, 1);
+			copyBuffer.push_back(value == 1 ? 1 : 0);
+			break;
+		default:
+			appendInt32(copyBuffer, (uint32_t)-1);
+	}
+}
+
+/**
+ * Appends the value of a field of the record as field of the current COPY row.
+ */
+void IpfixDbWriterPg::appendCopyField(const CopyColumn& cc, const TemplateInfo::FieldInfo& fi,
+		IpfixRecord::Data* data)
+{
+	IpfixRecord::Data* value = data + fi.offset;
+	uint16_t length = fi.type.length;
+
+	if (fi.isVariableLength) {
+		appendInt32(copyBuffer, (uint32_t)-1);
+		return;
+	}
+
+	switch (cc.format) {
+		case CopyInt2:
+		case CopyInt4:
+		case CopyInt8:
+		case CopyBool:
+			if (length == 0 || length > 8) break;
+			if (cc.ipfixType >= IPFIX_TYPE_signed8 && cc.ipfixType <= IPFIX_TYPE_signed64)
+				appendCopyNumber(cc, readInt(value, length));
+			else
+				appendCopyNumber(cc, readUint(value, length));
+			return;
+
+		case CopyFloat4:
+		case CopyFloat8: {
+			double d;
+			if (length == 4) {
+				uint32_t bits = ntohl(*(uint32_t*)value);
+				float f;
+				memcpy(&f, &bits, sizeof(f));
+				d = f;
+			} else if (length == 8) {
+				uint64_t bits = ntohll(*(uint64_t*)value);
+				memcpy(&d, &bits, sizeof(d));
+			} else {
+				break;
+			}
+			if (cc.format == CopyFloat4) {
+				float f = (float)d;
+				uint32_t bits;
+				memcpy(&bits, &f, sizeof(bits));
+				appendInt32(copyBuffer, 4);
+				appendInt32(copyBuffer, bits);
+			} else {
+				uint64_t bits;
+				memcpy(&bits, &d, sizeof(bits));
+				appendInt32(copyBuffer, 8);
+				appendInt64(copyBuffer, bits);
+			}
+			return;
+		}
+
+		case CopyMacaddr:
+			if (length != 6) break;
+			appendInt32(copyBuffer, 6);
+			appendBytes(copyBuffer, value, 6);
+			return;
+
+		case CopyInet: {
+			// family, netmask bits, is_cidr, address length, address
+			char header[4];
+			if (length == 4) {
+				header[0] = 2; // PGSQL_AF_INET
+				header[1] = 32;
+			} else if (length == 5) {
+				// Vermont stores the inverse netmask behind the address
+				header[0] = 2; // PGSQL_AF_INET
+				header[1] = value[4] < 32 ? 32 - value[4] : 0;
+				length = 4;
+			} else if (length == 16) {
+				header[0] = 3; // PGSQL_AF_INET6
+				header[1] = (char)128;
+			} else {
+				break;
+			}
+			header[2] = 0;
+			header[3] = length;
+			appendInt32(copyBuffer, 4 + length);
+			appendBytes(copyBuffer, header, sizeof(header));
+			appendBytes(copyBuffer, value, length);
+			return;
+		}
+
+		case CopyText: {
+			// strings might be padded with zero bytes
+			uint16_t n = strnlen((const char*)value, length);
+			appendInt32(copyBuffer, n);
+			appendBytes(copyBuffer, value, n);
+			return;
+		}
+
+		case CopyBytea:
+			appendInt32(copyBuffer, length);
+			appendBytes(copyBuffer, value, length);
+			return;
+	}
+	msg(LOG_ERR, "IpfixDbWriterPg: field of type %u has unsupported length %hu", cc.ipfixType, length);
+	appendInt32(copyBuffer, (uint32_t)-1);
+}
+
+/**
+ * Numeric counterpart of IpfixDbWriterSQL::checkTimeAlternatives(): derives
+ * a missing flow start or end time from another field of the record.
+ */
+bool IpfixDbWriterPg::findTimeAlternative(const Column* col, TemplateInfo* dataTemplateInfo,
+		IpfixRecord::Data* data, uint64_t* value)
+{
+	uint16_t alternative, sysUpTime;
+	bool inSeconds;
+
+	switch (col->ipfixId) {
+		case IPFIX_TYPEID_flowStartSeconds:
+			alternative = IPFIX_TYPEID_flowStartMilliseconds;
+			sysUpTime = IPFIX_TYPEID_flowStartSysUpTime;
+			inSeconds = true;
+			break;
+		case IPFIX_TYPEID_flowStartMilliseconds:
+			alternative = IPFIX_TYPEID_flowStartSeconds;
+			sysUpTime = IPFIX_TYPEID_flowStartSysUpTime;
+			inSeconds = false;
+			break;
+		case IPFIX_TYPEID_flowEndSeconds:
+			alternative = IPFIX_TYPEID_flowEndMilliseconds;
+			sysUpTime = IPFIX_TYPEID_flowEndSysUpTime;
+			inSeconds = true;
+			break;
+		case IPFIX_TYPEID_flowEndMilliseconds:
+			alternative = IPFIX_TYPEID_flowEndSeconds;
+			sysUpTime = IPFIX_TYPEID_flowEndSysUpTime;
+			inSeconds = false;
+			break;
+		default:
+			return false;
+	}
+	if (col->enterprise != 0 && col->enterprise != IPFIX_PEN_reverse) return false;
+
+	bool found = false;
+	for (int k = 0; k < dataTemplateInfo->fieldCount; k++) {
+		const TemplateInfo::FieldInfo& fi = dataTemplateInfo->fieldInfo[k];
+		if (fi.isVariableLength || fi.type.length > 8) continue;
+		if (fi.type == InformationElement::IeInfo(alternative, col->enterprise)) {
+			uint64_t v = readUint(data + fi.offset, fi.type.length);
+			*value = inSeconds ? v / 1000 : v * 1000;
+			return true;
+		}
+		// if no flow time is available, maybe this is is from a netflow from Cisco
+		// then - as a last alternative - use the system uptime
+		if (col->enterprise == 0 && fi.type == InformationElement::IeInfo(sysUpTime, 0)) {
+			uint64_t v = readUint(data + fi.offset, fi.type.length);
+			*value = inSeconds ? v : v * 1000;
+			found = true;
+		}
+	}
+	return found;
+}
+
+/**
+ *	Encodes the record as row of COPY ... (FORMAT binary) and appends it to copyBuffer.
+ *	Values are taken directly from the field offsets without string conversion.
+ *	Falls back to the INSERT statement of IpfixDbWriterSQL if COPY is disabled.
+ */
+void IpfixDbWriterPg::fillInsertRow(IpfixRecord::SourceID* sourceID,
+		TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data)
+{
+	if (!useCopy) {
+		IpfixDbWriterSQL::fillInsertRow(sourceID, dataTemplateInfo, length, data);
+		return;
+	}
+
+	uint64_t flowstart = 0;
+	size_t rowStart = copyBuffer.size();
+
+	appendInt16(copyBuffer, numberOfColumns);
+
+	for (uint32_t i = 0; i < numberOfColumns; i++) {
+		const Column* col = &tableColumns[i];
+		const CopyColumn& cc = copyColumns[i];
+		uint64_t time = 0;
+
+		if (col->ipfixId == EXPORTERID) {
+			appendCopyNumber(cc, lookupExporterID(sourceID));
+			continue;
+		}
+
+		int k;
+		for (k = 0; k < dataTemplateInfo->fieldCount; k++) {
+			if (dataTemplateInfo->fieldInfo[k].type.enterprise == col->enterprise &&
+					dataTemplateInfo->fieldInfo[k].type.id == col->ipfixId)
+				break;
+		}
+		if (k < dataTemplateInfo->fieldCount) {
+			const TemplateInfo::FieldInfo& fi = dataTemplateInfo->fieldInfo[k];
+			appendCopyField(cc, fi, data);
+			if (!fi.isVariableLength && fi.type.length <= 8)
+				time = readUint(data + fi.offset, fi.type.length);
+		} else if (findTimeAlternative(col, dataTemplateInfo, data, &time)) {
+			appendCopyNumber(cc, time);
+		} else {
+			appendCopyNumber(cc, col->defaultValue);
+			time = col->defaultValue;
+		}
+
+		// we need to extract the flow start time for determining the correct DB table
+		if (col->enterprise == 0) {
+			switch (col->ipfixId) {
+				case IPFIX_TYPEID_flowStartSeconds:
+					flowstart = time * 1000;
+					break;
+				case IPFIX_TYPEID_flowStartMilliseconds:
+					if (flowstart == 0) flowstart = time;
+					break;
+			}
+		} else if (col->enterprise == IPFIX_PEN_reverse) {
+			switch (col->ipfixId) {
+				case IPFIX_TYPEID_flowStartMilliseconds:
+				case IPFIX_TYPEID_flowEndMilliseconds:
+					if (flowstart == 0) flowstart = time;
+					break;
+			}
+		}
+	}
+
+	// if this flow belongs to a different table, flush all cached entries now
+	// and get new table
+	if (!checkCurrentTable(flowstart)) {
+		vector<char> row(copyBuffer.begin() + rowStart, copyBuffer.end());
+		copyBuffer.resize(rowStart);
+		if (insertBuffer.curRows != 0 && !writeToDb()) {
+			msg(LOG_ERR, "failed to flush table, dropping record");
+			return;
+		}
+		if (!setCurrentTable(flowstart)) {
+			msg(LOG_ERR, "failed to change table, dropping record");
+			return;
+		}
+		copyBuffer.insert(copyBuffer.end(), row.begin(), row.end());
+	}
+
+	insertBuffer.curRows++;
+}
+
 bool IpfixDbWriterPg::checkRelationExists(const char* relname)
 {
 	// check if table needs to be created
@@ -330,9 +739,33 @@ void IpfixDbWriterPg::parseIpfixMacAddress(IpfixRecord::Data* data, string* pars
 IpfixDbWriterPg::IpfixDbWriterPg(const char* dbType, const char* host, const char* db,
 		const char* user, const char* pw,
 		unsigned int port, uint16_t observationDomainId,
-		int maxStatements, vector<string> columns, bool legacyNames, const char* prefix)
-	: IpfixDbWriterSQL(dbType, host, db, user, pw, port, observationDomainId, maxStatements, columns, legacyNames, prefix), conn(0)
+		int maxStatements, vector<string> columns, bool legacyNames, const char* prefix,
+		bool useCopy)
+	: IpfixDbWriterSQL(dbType, host, db, user, pw, port, observationDomainId, maxStatements, columns, legacyNames, prefix), conn(0),
+	  useCopy(useCopy)
 {
+	for (vector<Column>::iterator col = tableColumns.begin(); col != tableColumns.end(); col++) {
+		CopyColumn cc;
+		if (col->ipfixId == EXPORTERID) {
+			cc.ipfixType = IPFIX_TYPE_unsigned16;
+		} else {
+			cc.ipfixType = ipfix_id_lookup(col->ipfixId, col->enterprise)->type;
+		}
+
+		if (col->dataType == "smallint") cc.format = CopyInt2;
+		else if (col->dataType == "integer") cc.format = CopyInt4;
+		else if (col->dataType == "bigint") cc.format = CopyInt8;
+		else if (col->dataType == "real") cc.format = CopyFloat4;
+		else if (col->dataType == "double precision") cc.format = CopyFloat8;
+		else if (col->dataType == "boolean") cc.format = CopyBool;
+		else if (col->dataType == "macaddr") cc.format = CopyMacaddr;
+		else if (col->dataType == "inet") cc.format = CopyInet;
+		else if (col->dataType == "text") cc.format = CopyText;
+		else cc.format = CopyBytea;
+		copyColumns.push_back(cc);
+	}
+	copyBuffer.assign(copyHeader, copyHeader + sizeof(copyHeader));
+
 	connectToDB();
 }
 
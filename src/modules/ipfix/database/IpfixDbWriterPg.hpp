@@ -36,6 +36,7 @@
 #include <libpq-fe.h>
 #include <netinet/in.h>
 #include <time.h>
+#include <vector>
 
 #define EXPORTERID 0
 
@@ -50,11 +51,12 @@ class IpfixDbWriterPg
 		IpfixDbWriterPg(const char* dbType, const char* host, const char* db,
 				const char* user, const char* pw,
 				unsigned int port, uint16_t observationDomainId, // FIXME: observationDomainId
-				int maxStatements, vector<string> columns, bool legacyNames, const char* prefix);
+				int maxStatements, vector<string> columns, bool legacyNames, const char* prefix,
+				bool useCopy = false);
 		~IpfixDbWriterPg();
 
 		virtual void connectToDB();
-		virtual bool writeToDb();
+		virtual bool writeBatch(Batch* batch);
 		virtual int createExporterTable();
 		virtual int getExporterID(IpfixRecord::SourceID* sourceID);
 		virtual bool createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime);
@@ -66,6 +68,36 @@ class IpfixDbWriterPg
 		PGconn* conn;
 		bool checkRelationExists(const char* relname);
 
+		virtual void fillInsertRow(IpfixRecord::SourceID* sourceID,
+				TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data);
+		virtual void fillBatch(Batch* batch);
+		virtual void clearInsertBuffer();
+
+	private:
+		/**
+		 * Binary representation of a column in COPY ... (FORMAT binary),
+		 * derived from the Postgres data type of the column
+		 */
+		enum CopyFormat {
+			CopyInt2, CopyInt4, CopyInt8, CopyFloat4, CopyFloat8,
+			CopyBool, CopyMacaddr, CopyInet, CopyText, CopyBytea
+		};
+
+		struct CopyColumn {
+			CopyFormat format;
+			uint8_t ipfixType; /**< IPFIX data type of the column, decides about signedness */
+		};
+
+		bool useCopy; /**< write records with COPY FROM STDIN instead of INSERT */
+		vector<CopyColumn> copyColumns; /**< one entry per table column */
+		vector<char> copyBuffer; /**< COPY header followed by the buffered rows */
+
+		bool writeCopyBatch(Batch* batch);
+		bool findTimeAlternative(const Column* col, TemplateInfo* dataTemplateInfo,
+				IpfixRecord::Data* data, uint64_t* value);
+		void appendCopyNumber(const CopyColumn& cc, int64_t value);
+		void appendCopyField(const CopyColumn& cc, const TemplateInfo::FieldInfo& fi,
+				IpfixRecord::Data* data);
 };
 
 
@@ -31,6 +31,8 @@
 #include <stdexcept>
 #include <string.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
 #include <sstream>
 #include <algorithm>
 #include <boost/lexical_cast.hpp>
@@ -257,7 +259,8 @@ void IpfixDbWriterSQL::processDataDataRecord(IpfixRecord::SourceID* sourceID,
 	DPRINTF_INFO("Processing data record");
 
 
-	if (dbError) {
+	// the writer thread takes care of reconnecting if it is running
+	if (dbError && !writerRunning) {
 		connectToDB();
 		if (dbError) return;
 	}
@@ -337,7 +340,8 @@ bool IpfixDbWriterSQL::setCurrentTable(uint64_t flowStart)
 
 	tablename += getTimeAsString(starttime, "_%y%m%d_%H%M%S", false);
 
-	if (!createDBTable(tablename.c_str(), starttime, endtime)) return false;
+	// the writer thread creates the table before writing the first batch
+	if (!writerRunning && !createDBTable(tablename.c_str(), starttime, endtime)) return false;
 
 	string sql = getInsertString(tablename);
 
@@ -359,6 +363,323 @@ std::string IpfixDbWriterSQL::insertRowPrefix()
 	return "";
 }
 
+/**
+ * Returns the exporter ID of the cache or asks the database while holding dbLock.
+ */
+int IpfixDbWriterSQL::lookupExporterID(IpfixRecord::SourceID* sourceID)
+{
+	uint32_t expIp = sourceID->exporterAddress.toUInt32();
+	for (uint32_t i = 0; i < curExporterEntries; i++) {
+		if (exporterEntries[i].observationDomainId == sourceID->observationDomainId &&
+				exporterEntries[i].ip == expIp) {
+			return exporterEntries[i].Id;
+		}
+	}
+
+	dbLock.lock();
+	int id = getExporterID(sourceID);
+	dbLock.unlock();
+	return id;
+}
+
+/**
+ * Copies the buffered rows into batch. The default is the INSERT statement in insertBuffer.
+ */
+void IpfixDbWriterSQL::fillBatch(Batch* batch)
+{
+	batch->table = curTable;
+	batch->data.assign(insertBuffer.sql, insertBuffer.appendPtr);
+	batch->rows = insertBuffer.curRows;
+}
+
+void IpfixDbWriterSQL::clearInsertBuffer()
+{
+	insertBuffer.curRows = 0;
+	insertBuffer.appendPtr = insertBuffer.bodyPtr;
+	*insertBuffer.appendPtr = 0;
+}
+
+/**
+ * Writes the buffered rows to the database. If the writer thread is running,
+ * the rows are queued for it and the call only blocks while the queue is full.
+ */
+bool IpfixDbWriterSQL::writeToDb()
+{
+	if (insertBuffer.curRows == 0) return true;
+
+	if (writerRunning) {
+		Batch* batch = new Batch;
+		fillBatch(batch);
+		clearInsertBuffer();
+		if (batchQueue->getCount() >= batchQueue->maxEntries)
+			statBackpressureWaits++;
+		batchQueue->push(batch);
+		return true;
+	}
+
+	Batch batch;
+	fillBatch(&batch);
+	DPRINTF_INFO("SQL Query: %s", batch.data.c_str());
+	if (!writeBatchTimed(&batch)) return false;
+	clearInsertBuffer();
+	statWrittenRecords += batch.rows;
+	return true;
+}
+
+/**
+ * Creates the table of a batch in the writer thread, the table cache makes this cheap
+ */
+bool IpfixDbWriterSQL::createBatchTable(Batch* batch)
+{
+	return createDBTable(batch->table.name.c_str(), batch->table.timeStart, batch->table.timeEnd);
+}
+
+/**
+ * Calls writeBatch() and adds its duration to the latency histogram
+ */
+bool IpfixDbWriterSQL::writeBatchTimed(Batch* batch)
+{
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	bool ok = writeBatch(batch);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	uint64_t usec = (end.tv_sec - start.tv_sec) * 1000000ULL + end.tv_nsec / 1000 - start.tv_nsec / 1000;
+	uint32_t bucket = 0;
+	for (uint64_t limit = 1000; bucket < FLUSH_LATENCY_BUCKETS - 1 && usec >= limit; limit *= 10)
+		bucket++;
+	statFlushLatency[bucket]++;
+	return ok;
+}
+
+/**
+ * Enables the writer thread which takes over writing to the database. Must be
+ * called before the module is started.
+ * @param batches number of batches which may be queued before the record thread blocks, 0 disables the thread
+ * @param journalFile file which takes batches while the database fails, empty to drop them
+ * @param journalMaxSize maximum size of the journal in bytes
+ */
+void IpfixDbWriterSQL::setWriterThread(uint32_t batches, const string& journalFile, uint64_t journalMaxSize)
+{
+	writerBatches = batches;
+	journalFileName = journalFile;
+	this->journalMaxSize = journalMaxSize;
+}
+
+void IpfixDbWriterSQL::performStart()
+{
+	if (writerBatches == 0) return;
+
+	if (!journalFileName.empty()) {
+		journalFile = fopen(journalFileName.c_str(), "a+");
+		if (!journalFile)
+			THROWEXCEPTION("IpfixDbWriter: could not open journal %s: %s", journalFileName.c_str(), strerror(errno));
+		fseek(journalFile, 0, SEEK_END);
+		journalSize = ftell(journalFile);
+		journalOffset = 0;
+		if (journalSize > 0) {
+			// replay what a previous run left behind as soon as possible
+			msg(LOG_NOTICE, "IpfixDbWriter: journal %s contains %llu bytes", journalFileName.c_str(), (unsigned long long)journalSize);
+			dbDown = true;
+			nextRetry = 0;
+		}
+	}
+
+	batchQueue = new ConcurrentQueue<Batch*>(writerBatches);
+	writerExit = false;
+	writerRunning = true;
+	writerThread.run(this);
+}
+
+void IpfixDbWriterSQL::performShutdown()
+{
+	if (!writerRunning) return;
+
+	writeToDb();
+	writerExit = true;
+	writerThread.join();
+	writerRunning = false;
+	delete batchQueue;
+	batchQueue = NULL;
+	if (journalFile) {
+		fclose(journalFile);
+		journalFile = NULL;
+	}
+}
+
+void* IpfixDbWriterSQL::writerThreadFunc(void* dbWriter)
+{
+	IpfixDbWriterSQL* writer = (IpfixDbWriterSQL*)dbWriter;
+	writer->registerCurrentThread();
+	writer->writeBatches();
+	writer->unregisterCurrentThread();
+	return 0;
+}
+
+/**
+ * Main loop of the writer thread, runs until all batches are written after shutdown
+ */
+void IpfixDbWriterSQL::writeBatches()
+{
+	Batch* batch;
+	while (true) {
+		if (batchQueue->pop(WRITER_POLL_TIMEOUT, &batch)) {
+			dbLock.lock();
+			flushBatch(batch);
+			dbLock.unlock();
+			delete batch;
+		} else if (writerExit) {
+			break;
+		} else if (dbDown && time(NULL) >= nextRetry) {
+			dbLock.lock();
+			if (dbError) connectToDB();
+			if (!dbError) {
+				replayJournal();
+			} else {
+				nextRetry = time(NULL) + WRITER_RETRY_INTERVAL;
+			}
+			dbLock.unlock();
+		}
+	}
+}
+
+/**
+ * Writes a batch to the database, reconnecting once if required. Batches
+ * which cannot be written go to the journal. While the database is down,
+ * batches are journalled without trying until nextRetry.
+ */
+void IpfixDbWriterSQL::flushBatch(Batch* batch)
+{
+	if (dbDown && time(NULL) < nextRetry) {
+		journalBatch(batch);
+		return;
+	}
+
+	bool ok = false;
+	if (dbError) connectToDB();
+	if (!dbError) {
+		ok = createBatchTable(batch) && writeBatchTimed(batch);
+		if (!ok) {
+			connectToDB();
+			ok = !dbError && createBatchTable(batch) && writeBatchTimed(batch);
+		}
+	}
+
+	if (!ok) {
+		msg(LOG_ERR, "IpfixDbWriter: database write failed, retrying in %u seconds", WRITER_RETRY_INTERVAL);
+		dbDown = true;
+		nextRetry = time(NULL) + WRITER_RETRY_INTERVAL;
+		journalBatch(batch);
+		return;
+	}
+
+	statWrittenRecords += batch->rows;
+	if (dbDown) replayJournal();
+}
+
+/**
+ * Appends a batch to the journal, or drops it if there is no journal or it is full
+ */
+void IpfixDbWriterSQL::journalBatch(Batch* batch)
+{
+	// zeroed, as the padding behind dataLength is written to the journal as well
+	JournalEntry entry;
+	memset(&entry, 0, sizeof(entry));
+	entry.timeStart = batch->table.timeStart;
+	entry.timeEnd = batch->table.timeEnd;
+	entry.rows = batch->rows;
+	entry.tableLength = batch->table.name.size();
+	entry.dataLength = batch->data.size();
+	uint64_t size = sizeof(entry) + entry.tableLength + entry.dataLength;
+
+	if (!journalFile || journalSize + size > journalMaxSize) {
+		msg(LOG_ERR, "IpfixDbWriter: dropping %u records", batch->rows);
+		statDroppedRecords += batch->rows;
+		return;
+	}
+
+	fseek(journalFile, 0, SEEK_END);
+	if (fwrite(&entry, sizeof(entry), 1, journalFile) != 1 ||
+			fwrite(batch->table.name.data(), 1, entry.tableLength, journalFile) != entry.tableLength ||
+			fwrite(batch->data.data(), 1, entry.dataLength, journalFile) != entry.dataLength ||
+			fflush(journalFile) != 0) {
+		// the entry may be incomplete, forget about all entries behind the replayed ones
+		msg(LOG_ERR, "IpfixDbWriter: failed to write journal %s, dropping %u records", journalFileName.c_str(), batch->rows);
+		statDroppedRecords += batch->rows;
+		if (ftruncate(fileno(journalFile), journalSize) != 0)
+			msg(LOG_ERR, "IpfixDbWriter: failed to truncate journal %s", journalFileName.c_str());
+		return;
+	}
+	journalSize += size;
+	statJournalledRecords += batch->rows;
+}
+
+/**
+ * Writes the batches of the journal to the database. Stops at the first
+ * failure and continues there on the next call. The journal is emptied
+ * when all batches are written.
+ */
+void IpfixDbWriterSQL::replayJournal()
+{
+	dbDown = false;
+	if (!journalFile) return;
+
+	Batch batch;
+	JournalEntry entry;
+	while (journalOffset < journalSize) {
+		fseek(journalFile, journalOffset, SEEK_SET);
+		if (fread(&entry, sizeof(entry), 1, journalFile) != 1) break;
+		batch.table.timeStart = entry.timeStart;
+		batch.table.timeEnd = entry.timeEnd;
+		batch.rows = entry.rows;
+		batch.table.name.resize(entry.tableLength);
+		batch.data.resize(entry.dataLength);
+		if ((entry.tableLength && fread(&batch.table.name[0], 1, entry.tableLength, journalFile) != entry.tableLength) ||
+				(entry.dataLength && fread(&batch.data[0], 1, entry.dataLength, journalFile) != entry.dataLength))
+			break;
+
+		if (!createBatchTable(&batch) || !writeBatchTimed(&batch)) {
+			dbDown = true;
+			nextRetry = time(NULL) + WRITER_RETRY_INTERVAL;
+			return;
+		}
+		statWrittenRecords += batch.rows;
+		journalOffset += sizeof(entry) + entry.tableLength + entry.dataLength;
+	}
+
+	if (journalOffset < journalSize)
+		msg(LOG_ERR, "IpfixDbWriter: journal %s is corrupt, discarding %llu bytes", journalFileName.c_str(),
+				(unsigned long long)(journalSize - journalOffset));
+	if (ftruncate(fileno(journalFile), 0) != 0)
+		msg(LOG_ERR, "IpfixDbWriter: failed to truncate journal %s", journalFileName.c_str());
+	journalSize = 0;
+	journalOffset = 0;
+}
+
+/**
+ * statistics function called by StatisticsManager
+ */
+std::string IpfixDbWriterSQL::getStatisticsXML(double interval)
+{
+	static const char* latencyNames[FLUSH_LATENCY_BUCKETS] = { "1ms", "10ms", "100ms", "1s", "10s", "inf" };
+	ostringstream oss;
+
+	oss << "<writtenRecords>" << statWrittenRecords << "</writtenRecords>";
+	oss << "<droppedRecords>" << statDroppedRecords << "</droppedRecords>";
+	if (writerBatches > 0) {
+		oss << "<queuedBatches>" << (batchQueue ? batchQueue->getCount() : 0) << "</queuedBatches>";
+		oss << "<backpressureWaits>" << statBackpressureWaits << "</backpressureWaits>";
+		oss << "<journalledRecords>" << statJournalledRecords << "</journalledRecords>";
+		oss << "<journalSize>" << journalSize - journalOffset << "</journalSize>";
+	}
+	oss << "<flushLatency>";
+	for (uint32_t i = 0; i < FLUSH_LATENCY_BUCKETS; i++)
+		oss << "<bucket max=\"" << latencyNames[i] << "\">" << statFlushLatency[i] << "</bucket>";
+	oss << "</flushLatency>";
+
+	return oss.str();
+}
+
 /**
  *	loop over the TemplateInfo (fieldinfo,datainfo) to get the IPFIX values to store in database
  *  results are stored in insertBuffer.sql
@@ -380,7 +701,7 @@ void IpfixDbWriterSQL::fillInsertRow(IpfixRecord::SourceID* sourceID,
 		string parsedData = "";
 
 		if (col->ipfixId == EXPORTERID) {
-			parsedData = boost::str(boost::format("%d") % getExporterID(sourceID));
+			parsedData = boost::str(boost::format("%d") % lookupExporterID(sourceID));
 			break;
 		} else {
 			// try to gather data required for the field
@@ -734,6 +1055,12 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
 		const char* user, const char* pw,
 		unsigned int port, uint16_t observationDomainId,
 		int maxStatements, vector<string> columns, bool legacyNames, const char* prefix)
+	: writerBatches(0), writerRunning(false), writerExit(false),
+	  writerThread(writerThreadFunc, "IpfixDbWriter"), batchQueue(NULL),
+	  journalMaxSize(0), journalFile(NULL), journalSize(0), journalOffset(0),
+	  dbDown(false), nextRetry(0),
+	  statWrittenRecords(0), statDroppedRecords(0), statJournalledRecords(0),
+	  statBackpressureWaits(0)
 {
 	/**Initialize structure members IpfixDbWriterSQL*/
 	hostName = host;
@@ -845,6 +1172,8 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
 	insertBuffer.maxRows = maxStatements;
 	insertBuffer.sql = new char[(INS_WIDTH+3)*(numberOfColumns+1)*maxStatements+numberOfColumns*20+60+1];
 	*insertBuffer.sql = 0;
+
+	bzero(statFlushLatency, sizeof(statFlushLatency));
 }
 
 /**
@@ -853,6 +1182,8 @@ IpfixDbWriterSQL::IpfixDbWriterSQL(const char* dbtype, const char* host, const c
  */
 IpfixDbWriterSQL::~IpfixDbWriterSQL()
 {
+	delete batchQueue;
+	if (journalFile) fclose(journalFile);
 	delete[] insertBuffer.sql;
 }
 
@@ -29,7 +29,11 @@
 #include "../IpfixRecordDestination.h"
 #include "common/ipfixlolib/ipfix.h"
 #include "common/ipfixlolib/ipfixlolib.h"
+#include "common/ConcurrentQueue.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
 #include <netinet/in.h>
+#include <stdio.h>
 #include <time.h>
 
 /**
@@ -47,6 +51,8 @@ class IpfixDbWriterSQL
 		~IpfixDbWriterSQL();
 
 		void onDataRecord(IpfixDataRecord* record);
+		void setWriterThread(uint32_t batches, const string& journalFile, uint64_t journalMaxSize);
+		virtual std::string getStatisticsXML(double interval);
 
 		IpfixRecord::SourceID srcId;              /**Exporter default SourceID */
 
@@ -73,6 +79,9 @@ class IpfixDbWriterSQL
 		static const uint32_t MAX_EXP_TABLE = 10; /**< Count of buffered exporters. Increase this value if you use more exporters in parallel */
 		static const uint32_t MAX_USEDTABLES = 5; /**< Number of cached entries for used (and created tables) */
 		static const uint64_t TABLE_INTERVAL = 1000*24*3600; /**< Interval, in which new tables should be created (milliseconds).*/
+		static const uint32_t WRITER_POLL_TIMEOUT = 1000; /**< time in ms until the writer thread checks for shutdown or retries the database */
+		static const uint32_t WRITER_RETRY_INTERVAL = 5; /**< time in s after which a failed database is tried again */
+		static const uint32_t FLUSH_LATENCY_BUCKETS = 6; /**< 1ms, 10ms, 100ms, 1s, 10s and more */
 
 		/**
 		 * Buffer for insert statements
@@ -91,6 +100,15 @@ class IpfixDbWriterSQL
 			uint64_t timeEnd;
 		};
 
+		/**
+		 * Buffered rows handed from the record thread to the writer thread
+		 */
+		struct Batch {
+			Table table;			/** table the rows belong to */
+			string data;			/** INSERT statement or encoded rows, see fillBatch() */
+			uint32_t rows;			/** number of rows */
+		};
+
 
 		list<string> usedPartitions;	/**< list of partitions that were last used */
 
@@ -128,15 +146,20 @@ class IpfixDbWriterSQL
 
 		void addColumnEntry(const char* insert, bool quoted, bool lastcolumn);
 		void addColumnEntry(const uint64_t insert, bool quoted, bool lastcolumn);
-		void fillInsertRow(IpfixRecord::SourceID* sourceID,
+		virtual void fillInsertRow(IpfixRecord::SourceID* sourceID,
 				TemplateInfo* dataTemplateInfo, uint16_t length, IpfixRecord::Data* data);
 		bool checkCurrentTable(uint64_t flowStart);
 		bool setCurrentTable(uint64_t flowStart);
 		string getTimeAsString(uint64_t milliseconds, const char* formatstring, bool addfraction, uint32_t microseconds = 0);
 		bool checkRelationExists(const char* relname);
 
+		bool writeToDb();
+		int lookupExporterID(IpfixRecord::SourceID* sourceID);
+		virtual void fillBatch(Batch* batch);
+		virtual void clearInsertBuffer();
+
 		virtual void connectToDB() = 0;
-		virtual bool writeToDb() = 0;
+		virtual bool writeBatch(Batch* batch) = 0;
 		virtual int createExporterTable() = 0 ;
 		//virtual string createInsertStatement() = 0;
 		virtual bool createDBTable(const char* partitionname, uint64_t starttime, uint64_t endtime) = 0;
@@ -149,7 +172,50 @@ class IpfixDbWriterSQL
 		std::string getDBDataType(const uint16_t ipfixType);
 		Column* legacyNamesMap;
 
+		virtual void performStart();
+		virtual void performShutdown();
+
 	private:
+		/**
+		 * Header of a batch in the journal, followed by table name and data
+		 */
+		struct JournalEntry {
+			uint64_t timeStart;
+			uint64_t timeEnd;
+			uint32_t rows;
+			uint32_t tableLength;
+			uint32_t dataLength;
+		};
+
+		uint32_t writerBatches;		/**< batches queued for the writer thread, 0 writes synchronously */
+		bool writerRunning;
+		volatile bool writerExit;
+		Thread writerThread;
+		ConcurrentQueue<Batch*>* batchQueue;
+		Mutex dbLock;			/**< serializes access to the connection between record and writer thread */
+
+		string journalFileName;		/**< file for batches which could not be written, empty for none */
+		uint64_t journalMaxSize;	/**< maximum size of the journal in bytes */
+		FILE* journalFile;
+		uint64_t journalSize;		/**< bytes in the journal */
+		uint64_t journalOffset;		/**< bytes of the journal which have already been replayed */
+		bool dbDown;			/**< last write failed, batches are journalled until nextRetry */
+		time_t nextRetry;
+
+		uint64_t statWrittenRecords;
+		uint64_t statDroppedRecords;
+		uint64_t statJournalledRecords;
+		uint32_t statBackpressureWaits;	/**< number of times the record thread waited for the writer thread */
+		uint32_t statFlushLatency[FLUSH_LATENCY_BUCKETS];
+
+		static void* writerThreadFunc(void* dbWriter);
+		void writeBatches();
+		void flushBatch(Batch* batch);
+		bool writeBatchTimed(Batch* batch);
+		bool createBatchTable(Batch* batch);
+		void journalBatch(Batch* batch);
+		void replayJournal();
+
 		void processDataDataRecord(IpfixRecord::SourceID* sourceID,
 				TemplateInfo* dataTemplateInfo, uint16_t length,
 				IpfixRecord::Data* data);
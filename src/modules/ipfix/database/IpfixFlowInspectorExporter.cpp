@@ -33,17 +33,18 @@
  */
 int IpfixFlowInspectorExporter::connectToDB()
 {
-	dbError = true;
-	
 	// If a connection exists don't reconnect
-	if (context) return 0;
+	if (context) {
+		dbError = false;
+		return 0;
+	}
+	dbError = true;
   
 	// Connect
-	std::string err;
 	context = redisConnect(dbHost.c_str(), dbPort);
-	if (context->err) {
-		msg(LOG_CRIT,"IpfixFlowInspectorExporter: Redis connect failed. Error: %s", context->errstr);
-		redisFree(context);
+	if (!context || context->err) {
+		msg(LOG_CRIT,"IpfixFlowInspectorExporter: Redis connect failed. Error: %s", context ? context->errstr : "out of memory");
+		if (context) redisFree(context);
 		context = NULL;
 		return 1;
 	}
@@ -60,7 +61,6 @@ void IpfixFlowInspectorExporter::processDataDataRecord(const IpfixRecord::Source
 		TemplateInfo& dataTemplateInfo, uint16_t length,
 		IpfixRecord::Data* data)
 {
-	std::string json_string;
 	msg(LOG_INFO, "IpfixFlowInspectorExporter: Processing data record");
 
 	if (dbError) {
@@ -69,85 +69,101 @@ void IpfixFlowInspectorExporter::processDataDataRecord(const IpfixRecord::Source
 		if (dbError) return;
 	}
 
-	json_string = getInsertObj(dataTemplateInfo, length, data);
+	appendInsertObj(dataTemplateInfo, length, data);
 
-	bufferedObjects.push_back(json_string);
-	
-	writeToDb();
+	// push to the queue if maxInserts is reached
+	if ((int)objectEnds.size() >= maxInserts)
+		writeToDb();
 }
 
-std::string IpfixFlowInspectorExporter::getInsertObj(TemplateInfo& dataTemplateInfo,uint16_t length, IpfixRecord::Data* data)
+/**
+ * Appends the record as JSON object to jsonBuffer, which keeps its memory between batches
+ */
+void IpfixFlowInspectorExporter::appendInsertObj(TemplateInfo& dataTemplateInfo,uint16_t length, IpfixRecord::Data* data)
 {
-	std::stringstream sstream;
-	const struct ipfix_identifier* identifier;
-	uint64_t intdata;
-
-	sstream << "{ ";
+	jsonBuffer += "{ ";
 
 	/* Dump all elements to DB */
-	if(dataTemplateInfo.fieldCount > 0) {
-		// look in ipfix records
-		for(int k=0; k < dataTemplateInfo.fieldCount; k++) {
-			intdata = getData(dataTemplateInfo.fieldInfo[k].type,(data+dataTemplateInfo.fieldInfo[k].offset));
-			DPRINTF_INFO("IpfixFlowInspectorExporter::getData: dumping from packet intdata %llX, type %d, length %d and offset %X",
-				intdata, dataTemplateInfo.fieldInfo[k].type.id, dataTemplateInfo.fieldInfo[k].type.length,
-				dataTemplateInfo.fieldInfo[k].offset);
-
-			if (k != 0) {
-				sstream << ",";
-			}
-			identifier = ipfix_id_lookup(dataTemplateInfo.fieldInfo[k].type.id, dataTemplateInfo.fieldInfo[k].type.enterprise);
-			if (identifier) {
-				// push regular IPFIX name into queue 
-				sstream << "\"" << identifier->name << "\" : ";
-			} else {
-				sstream << dataTemplateInfo.fieldInfo[k].type.id;
-			}
-
-			sstream << static_cast<long long int>(intdata);
-		}
-	}
-			
-	if( dataTemplateInfo.dataCount > 0) {
-		// look in static data fields of template for data
-		for(int k=0; k < dataTemplateInfo.dataCount; k++) {
-			intdata = getData(dataTemplateInfo.dataInfo[k].type,(dataTemplateInfo.data+dataTemplateInfo.dataInfo[k].offset));
-			if (k != 0) {
-				sstream << ",";
-			}
-			identifier = ipfix_id_lookup(dataTemplateInfo.dataInfo[k].type.id, dataTemplateInfo.dataInfo[k].type.enterprise);
-			if (identifier) {
-				// push regular IPFIX name into queue 
-				sstream << "\"" << identifier->name << "\" : ";
-			} else {
-				sstream << dataTemplateInfo.dataInfo[k].type.id;
-			}
-
-			sstream << static_cast<long long int>(intdata);
+	for(int k=0; k < dataTemplateInfo.fieldCount; k++) {
+		if (k != 0) {
+			jsonBuffer += ',';
 		}
+		appendField(dataTemplateInfo.fieldInfo[k].type, data+dataTemplateInfo.fieldInfo[k].offset);
 	}
 
-	sstream << " }";
+	jsonBuffer += " }";
+	objectEnds.push_back(jsonBuffer.size());
+}
 
-	return sstream.str();
+/**
+ * Appends "<name>" : <value> of a field to jsonBuffer
+ */
+void IpfixFlowInspectorExporter::appendField(InformationElement::IeInfo type, IpfixRecord::Data* data)
+{
+	char number[24];
+	uint64_t intdata = getData(type, data);
+	DPRINTF_INFO("IpfixFlowInspectorExporter::getData: dumping from packet intdata %llX, type %d, length %d",
+		intdata, type.id, type.length);
+
+	jsonBuffer += '"';
+	const struct ipfix_identifier* identifier = ipfix_id_lookup(type.id, type.enterprise);
+	if (identifier) {
+		// push regular IPFIX name into queue 
+		jsonBuffer += identifier->name;
+	} else {
+		jsonBuffer.append(number, snprintf(number, sizeof(number), "%u", type.id));
+	}
+	jsonBuffer += "\" : ";
+	jsonBuffer.append(number, snprintf(number, sizeof(number), "%lld", static_cast<long long int>(intdata)));
 }
 
 /*
  * Write Objects to database
+ * All buffered objects are pushed with a single RPUSH, so a batch costs one
+ * round trip to the Redis server instead of one per object.
  */
 int IpfixFlowInspectorExporter::writeToDb()
 {
-	while (!bufferedObjects.empty()) {
-		std::string& elem = bufferedObjects.front();
-		redisReply *reply;
-		reply = (redisReply*)redisCommand(context, "RPUSH %s %s", dbName.c_str(), elem.c_str());
-		if (!reply) {
-			msg(LOG_ERR, "IpfixFlowInspectorExporter: Error while writing to redis queue: %s", reply->str);
-			freeReplyObject(reply);
+	if (objectEnds.empty())
+		return 0;
+
+	argv.resize(2);
+	argvlen.resize(2);
+	argv[0] = "RPUSH";
+	argvlen[0] = 5;
+	argv[1] = dbName.c_str();
+	argvlen[1] = dbName.size();
+	size_t start = 0;
+	for (size_t i = 0; i < objectEnds.size(); i++) {
+		argv.push_back(jsonBuffer.data() + start);
+		argvlen.push_back(objectEnds[i] - start);
+		start = objectEnds[i];
+	}
+
+	int ret = 0;
+	redisReply* reply = NULL;
+	if (context)
+		reply = (redisReply*)redisCommandArgv(context, argv.size(), &argv[0], &argvlen[0]);
+	if (!reply) {
+		msg(LOG_ERR, "IpfixFlowInspectorExporter: Error while writing %u objects to redis queue: %s",
+			(unsigned)objectEnds.size(), context ? context->errstr : "not connected");
+		// the context cannot be used after an I/O error, reconnect on the next record
+		if (context) redisFree(context);
+		context = NULL;
+		dbError = true;
+		ret = 1;
+	} else {
+		if (reply->type == REDIS_REPLY_ERROR) {
+			msg(LOG_ERR, "IpfixFlowInspectorExporter: Error while writing %u objects to redis queue: %s",
+				(unsigned)objectEnds.size(), reply->str);
+			ret = 1;
 		}
-		bufferedObjects.pop_front();
+		freeReplyObject(reply);
 	}
-	return 0; 
+
+	jsonBuffer.clear();
+	objectEnds.clear();
+	return ret;
 }
 
 /**
@@ -196,8 +212,7 @@ void IpfixFlowInspectorExporter::onDataRecord(IpfixDataRecord* record)
 {
 	// only treat non-Options Data Records (although we cannot be sure that there is a Flow inside)
 	if((record->templateInfo->setId != TemplateInfo::NetflowTemplate)
-		&& (record->templateInfo->setId != TemplateInfo::IpfixTemplate)
-		&& (record->templateInfo->setId != TemplateInfo::IpfixDataTemplate)) {
+		&& (record->templateInfo->setId != TemplateInfo::IpfixTemplate)) {
 		record->removeReference();
 		return;
 	}
@@ -212,9 +227,13 @@ void IpfixFlowInspectorExporter::onDataRecord(IpfixDataRecord* record)
 /**
  * Constructor
  */
-IpfixFlowInspectorExporter::IpfixFlowInspectorExporter(const string& hostname, const string& database, unsigned port)
-	: dbHost(hostname), dbName(database), dbPort(port)
+IpfixFlowInspectorExporter::IpfixFlowInspectorExporter(const string& hostname, const string& database, unsigned port,
+		int maxInserts)
+	: dbHost(hostname), dbName(database), dbPort(port), context(NULL), dbError(true), maxInserts(maxInserts)
 {
+	objectEnds.reserve(maxInserts);
+	argv.reserve(maxInserts + 2);
+	argvlen.reserve(maxInserts + 2);
 	if(connectToDB() != 0)
 		THROWEXCEPTION("IpfixFlowInspectorExporter creation failed");
 }
@@ -226,6 +245,8 @@ IpfixFlowInspectorExporter::IpfixFlowInspectorExporter(const string& hostname, c
 IpfixFlowInspectorExporter::~IpfixFlowInspectorExporter()
 {
 	writeToDb();
+	if (context)
+		redisFree(context);
 }
 
 
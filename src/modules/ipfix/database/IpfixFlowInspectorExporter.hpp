@@ -47,7 +47,7 @@ class IpfixFlowInspectorExporter
 {
 	public:
 		IpfixFlowInspectorExporter(const string& hostname, const string& database,
-				unsigned port);
+				unsigned port, int maxInserts);
 		~IpfixFlowInspectorExporter();
 
 		void onDataRecord(IpfixDataRecord* record);
@@ -71,15 +71,20 @@ class IpfixFlowInspectorExporter
 		redisContext* context;
 		bool dbError;
 
-		std::list<std::string> bufferedObjects;
-		
+		int maxInserts;				// maximum number of objects per RPUSH
+		std::string jsonBuffer;			// buffered JSON objects, back to back
+		std::vector<size_t> objectEnds;		// end of each buffered object in jsonBuffer
+		std::vector<const char*> argv;		// arguments of the RPUSH command
+		std::vector<size_t> argvlen;
+
 		int connectToDB();
 		void processDataDataRecord(const IpfixRecord::SourceID& sourceID, 
 				TemplateInfo& dataTemplateInfo, uint16_t length, 
 				IpfixRecord::Data* data);
 		int writeToDb();
 		uint64_t getData(InformationElement::IeInfo type, IpfixRecord::Data* data);
-		std::string getInsertObj(TemplateInfo& dataTemplateInfo,uint16_t length, IpfixRecord::Data* data);
+		void appendInsertObj(TemplateInfo& dataTemplateInfo,uint16_t length, IpfixRecord::Data* data);
+		void appendField(InformationElement::IeInfo type, IpfixRecord::Data* data);
 		const static Column identify[];
 };
 
@@ -34,7 +34,7 @@ IpfixFlowInspectorExporterCfg* IpfixFlowInspectorExporterCfg::create(XMLElement*
 
 IpfixFlowInspectorExporterCfg::IpfixFlowInspectorExporterCfg(XMLElement* elem)
 	: CfgHelper<IpfixFlowInspectorExporter, IpfixFlowInspectorExporterCfg>(elem, "ipfixFlowInspectorExporter"),
-		port(6379)
+		port(6379), bufferObjects(30)
 {
 	if (!elem) return;
 
@@ -47,6 +47,8 @@ IpfixFlowInspectorExporterCfg::IpfixFlowInspectorExporterCfg(XMLElement* elem)
 			port = getInt("port");
 		} else if (e->matches("dbname")) {
 			database = e->getFirstText();
+		} else if (e->matches("bufferobjects")) {
+			bufferObjects = getInt("bufferobjects");
 		} else if (e->matches("next")) { // ignore next
 		} else {
 			msg(LOG_CRIT, "Unknown IpfixFlowInspectorExporter config statement %s\n", e->getName().c_str());
@@ -55,6 +57,7 @@ IpfixFlowInspectorExporterCfg::IpfixFlowInspectorExporterCfg(XMLElement* elem)
 	}
 	if (hostname=="") THROWEXCEPTION("IpfixFlowInspectorExporterCfg: host not set in configuration!");
 	if (database=="") THROWEXCEPTION("IpfixFlowInspectorExporterCfg: dbname not set in configuration!");
+	if (bufferObjects==0) THROWEXCEPTION("IpfixFlowInspectorExporterCfg: bufferobjects must be at least 1!");
 }
 
 IpfixFlowInspectorExporterCfg::~IpfixFlowInspectorExporterCfg()
@@ -64,8 +67,9 @@ IpfixFlowInspectorExporterCfg::~IpfixFlowInspectorExporterCfg()
 
 IpfixFlowInspectorExporter* IpfixFlowInspectorExporterCfg::createInstance()
 {
-	instance = new IpfixFlowInspectorExporter(hostname, database, port);
-	msg(LOG_INFO, "IpfixFlowInspectorExporter configuration host %s queue %s port %i\n", hostname.c_str(), database.c_str(), port);
+	instance = new IpfixFlowInspectorExporter(hostname, database, port, bufferObjects);
+	msg(LOG_INFO, "IpfixFlowInspectorExporter configuration host %s queue %s port %i bufferobjects %i\n",
+		hostname.c_str(), database.c_str(), port, bufferObjects);
 	return instance;
 }
 
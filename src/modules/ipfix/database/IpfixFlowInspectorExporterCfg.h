@@ -47,6 +47,7 @@ protected:
 	std::string hostname; /**< hostname of database host */
 	uint16_t port;	/**< port of database */
 	std::string database; /**< mongo database name */
+	uint16_t bufferObjects;	/**< amount of records to buffer until they are pushed to the queue */
 	
 	IpfixFlowInspectorExporterCfg(XMLElement*);
 };
@@ -14,6 +14,7 @@
 #include "common/msg.h"
 #include "common/Thread.h"
 #include "common/defs.h"
+#include "common/CompressedFile.h"
 
 #include <pcap.h>
 #include <unistd.h>
@@ -86,7 +87,7 @@ Observer::Observer(const std::string& interface, bool offline, uint64_t maxpacke
 	lastProcessedPackets(0),
 	captureInterface(NULL), fileName(NULL), replaceTimestampsFromFile(false),
 	stretchTimeInt(1), stretchTime(1.0), autoExit(true), slowMessageShown(false),
-	statTotalLostPackets(0), statTotalRecvPackets(0)
+	statTotalLostPackets(0), statTotalRecvPackets(0), skippedBytes(0)
 {
 	if(offline) {
 		readFromFile = true;
@@ -133,6 +134,9 @@ Observer::~Observer()
 		pcap_freealldevs(allDevices);
 	}
 
+	for (size_t i = 0; i < headerProcessors.size(); i++)
+		delete headerProcessors[i];
+
 	free(captureInterface);
 	delete[] filter_exp;
 	if (fileName) { free(fileName); fileName = NULL; }
@@ -213,9 +217,14 @@ void *Observer::observerThread(void *arg)
 			//}
 			//printf("\n");
 
+			// update statistics
+			obs->receivedBytes += packetHeader.caplen;
+			obs->processedPackets++;
+
 			// initialize packet structure (init copies packet data)
 			p = packetManager.getNewInstance();
-			p->init((char*)pcapData, packetHeader.caplen, packetHeader.ts, obs->observationDomainID, packetHeader.len, obs->dataLinkType);
+			if (!obs->initPacket(p, pcapData, packetHeader.caplen, packetHeader))
+				continue;
 
 			DPRINTF_INFO("received packet at %u.%04u, len=%d",
 					(unsigned)p->timestamp.tv_sec,
@@ -223,10 +232,6 @@ void *Observer::observerThread(void *arg)
 					packetHeader.caplen
 			);
 
-			// update statistics
-			obs->receivedBytes += packetHeader.caplen;
-			obs->processedPackets++;
-
 			while (!obs->exitFlag) {
 				DPRINTF_DEBUG( "trying to push packet to queue");
 				if ((have_send = obs->send(p))) {
@@ -305,14 +310,18 @@ void *Observer::observerThread(void *arg)
 			if (obs->replaceTimestampsFromFile)
 			    timeradd(&start, &delta_to_be, &packetHeader.ts);
 
+			// update statistics
+			obs->receivedBytes += packetHeader.caplen;
+			obs->processedPackets++;
+
 			// initialize packet structure (init copies packet data)
 			p = obs->packetManager.getNewInstance();
-			p->init((char*)pcapData,
+			if (!obs->initPacket(p, pcapData,
 				// in contrast to live capturing, the data length is not limited
 				// to any snap length when reading from a pcap file
 				(packetHeader.caplen < obs->capturelen) ? packetHeader.caplen : obs->capturelen,
-				packetHeader.ts, obs->observationDomainID, packetHeader.len, obs->dataLinkType);
-
+				packetHeader))
+				continue;
 
 			DPRINTF_INFO("received packet at %u.%03u, len=%d",
 				(unsigned)p->timestamp.tv_sec,
@@ -320,10 +329,6 @@ void *Observer::observerThread(void *arg)
 				packetHeader.caplen
 				);
 
-			// update statistics
-			obs->receivedBytes += packetHeader.caplen;
-			obs->processedPackets++;
-
 			while (!obs->exitFlag) {
 				DPRINTF_DEBUG( "trying to push packet to queue");
 				if ((have_send = obs->send(p))) {
@@ -346,6 +351,43 @@ void *Observer::observerThread(void *arg)
 }
 
 
+/**
+ * copies the captured data into p. With header processors, only the headers
+ * are copied before the processors are run, the payload is only copied if
+ * the packet passes. Returns false if the packet has been dropped.
+ */
+bool Observer::initPacket(Packet* p, const unsigned char* data, unsigned int len, const struct pcap_pkthdr& header)
+{
+	if (headerProcessors.empty()) {
+		p->init((char*)data, len, header.ts, observationDomainID, header.len, dataLinkType);
+		return true;
+	}
+
+	p->initHeaders((char*)data, len, header.ts, observationDomainID, header.len, dataLinkType);
+	// headers reaching beyond the copied bytes are evaluated on the complete packet
+	bool complete = p->headersComplete(len);
+	if (!complete)
+		p->copyPayload((char*)data, len, dataLinkType);
+
+	if (!headerProgram.run(p)) {
+		skippedBytes += len - p->data_length;
+		p->removeReference();
+		return false;
+	}
+
+	if (complete)
+		p->copyPayload((char*)data, len, dataLinkType);
+	return true;
+}
+
+void Observer::setHeaderProcessors(const std::vector<PacketProcessor*>& processors)
+{
+	for (size_t i = 0; i < headerProcessors.size(); i++)
+		delete headerProcessors[i];
+	headerProcessors = processors;
+	headerProgram.compile(headerProcessors);
+}
+
 /*
  call after an Observer has been created
  error checking on pcap here, because it can't be done in the constructor
@@ -403,7 +445,19 @@ bool Observer::prepare(const std::string& filter)
 		msg(LOG_INFO, "pcap seems to run on network %s", inet_ntoa(i_network));
 		msg(LOG_NOTICE, "pcap seems to run on netmask %s", inet_ntoa(i_netmask));
 	} else {
-		captureDevice=pcap_open_offline(fileName, errorBuffer);
+		if (compressed_file_detect(fileName)) {
+			// files written by a compressing pcapExporterFile are decompressed on the fly
+			FILE* f = compressed_file_fopen_read(fileName);
+			if (f) {
+				captureDevice = pcap_fopen_offline(f, errorBuffer);
+				if (!captureDevice) fclose(f);
+			} else {
+				snprintf(errorBuffer, PCAP_ERRBUF_SIZE, "could not open compressed file: %s", strerror(errno));
+				captureDevice = NULL;
+			}
+		} else {
+			captureDevice=pcap_open_offline(fileName, errorBuffer);
+		}
 		// check for errors
 		if(!captureDevice) {
 			msg(LOG_CRIT, "Error opening pcap file %s: %s", fileName, errorBuffer);
@@ -595,6 +649,10 @@ std::string Observer::getStatisticsXML(double interval)
 	lastProcessedPackets += diff;
 	oss << "<processed type=\"packets\">" << (uint32_t)((double)diff/interval) << "</processed>";
 	oss << "<totalProcessed type=\"packets\">" << processedPackets << "</totalProcessed>";
+	if (!headerProcessors.empty()) {
+		oss << headerProgram.getStatisticsXML();
+		oss << "<totalSkipped type=\"bytes\">" << skippedBytes << "</totalSkipped>";
+	}
 	oss << "</observer>";
 	return oss.str();
 }
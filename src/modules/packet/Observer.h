@@ -23,6 +23,7 @@
 
 
 #include "Packet.h"
+#include "modules/packet/filter/FilterProgram.h"
 
 #include "common/msg.h"
 #include "common/Thread.h"
@@ -59,6 +60,14 @@ public:
 	static void doLogging(void *arg);
 	virtual std::string getStatisticsXML(double interval);
 
+	/**
+	 * lets the observer evaluate the given processors, which do not look
+	 * at the payload, after copying only the headers of a packet. The
+	 * payload is only copied if the packet passes them. The observer takes
+	 * ownership of the processors.
+	 */
+	void setHeaderProcessors(const std::vector<PacketProcessor*>& processors);
+
 
 protected:
 	Thread thread;
@@ -130,7 +139,15 @@ protected:
 	uint32_t statTotalLostPackets;
 	uint32_t statTotalRecvPackets;
 
+	// processors evaluated before the payload is copied
+	std::vector<PacketProcessor*> headerProcessors;
+	FilterProgram headerProgram;
+
+	// bytes which were not copied as their packets were dropped by the header processors
+	volatile uint64_t skippedBytes;
+
 	static void *observerThread(void *);
+	bool initPacket(Packet* p, const unsigned char* data, unsigned int len, const struct pcap_pkthdr& header);
 
 	int dataLinkType; // contains the datalink type of the capturing device
 };
@@ -23,6 +23,7 @@
 #include "core/XMLElement.h"
 
 #include "modules/packet//Observer.h"
+#include "modules/packet/filter/PacketFilterCfg.h"
 
 #include <string>
 #include <vector>
@@ -40,6 +41,8 @@ ObserverCfg::ObserverCfg(XMLElement* elem)
 	: CfgHelper<Observer, ObserverCfg>(elem, "observer"),
 	interface(),
 	pcap_filter(),
+	derivedFilter(),
+	twoStageCapture(false),
 	capture_len(PCAP_DEFAULT_CAPTURE_LENGTH),
 	offline(false),
 	replaceOfflineTimestamps(false),
@@ -72,6 +75,8 @@ ObserverCfg::ObserverCfg(XMLElement* elem)
 			capture_len = getInt("captureLength");
 		} else if (e->matches("maxPackets")) {
 			maxPackets = getInt("maxPackets");
+		} else if (e->matches("twoStageCapture")) {
+			twoStageCapture = getBool("twoStageCapture", twoStageCapture);
 		} else if (e->matches("next")) { // ignore next
 		} else {
 			msg(LOG_CRIT, "Unknown observer config statement %s\n", e->getName().c_str());
@@ -82,7 +87,8 @@ ObserverCfg::ObserverCfg(XMLElement* elem)
 
 ObserverCfg::~ObserverCfg()
 {
-
+	for (size_t i = 0; i < headerStage.size(); i++)
+		delete headerStage[i];
 }
 
 Observer* ObserverCfg::createInstance()
@@ -99,7 +105,21 @@ Observer* ObserverCfg::createInstance()
 		}
 	}
 
-	if (!instance->prepare(pcap_filter.c_str())) {
+	std::string filter = pcap_filter;
+	if (!derivedFilter.empty()) {
+		filter = filter.empty() ? derivedFilter : "(" + filter + ") and (" + derivedFilter + ")";
+		msg(LOG_NOTICE, "Observer: evaluating leading packet filters in pcap: %s", derivedFilter.c_str());
+	}
+
+	if (!headerStage.empty()) {
+		std::vector<PacketProcessor*> processors;
+		for (size_t i = 0; i < headerStage.size(); i++)
+			processors.push_back(reinterpret_cast<PacketProcessor*>(headerStage[i]->getInstance()));
+		instance->setHeaderProcessors(processors);
+		msg(LOG_NOTICE, "Observer: evaluating %u leading packet filters before copying the payload", (unsigned)headerStage.size());
+	}
+
+	if (!instance->prepare(filter)) {
 		msg(LOG_CRIT, "Observer: preparing failed");
 		THROWEXCEPTION("Observer setup failed!");
 	}
@@ -115,6 +135,18 @@ bool ObserverCfg::deriveFrom(ObserverCfg* old)
 		return false;
 	if (pcap_filter != old->pcap_filter)
 		return false;
+	if (derivedFilter != old->derivedFilter)
+		return false;
+	if (headerStage.size() != old->headerStage.size())
+		return false;
+	for (size_t i = 0; i < headerStage.size(); i++) {
+		if (!headerStage[i]->deriveFrom(old->headerStage[i]))
+			return false;
+		// the capture thread keeps running, so prefixes are not replaced in place
+		HostFilterCfg* host = dynamic_cast<HostFilterCfg*>(headerStage[i]);
+		if (host && host->getPrefixes() != dynamic_cast<HostFilterCfg*>(old->headerStage[i])->getPrefixes())
+			return false;
+	}
 
 	return true;
 }
@@ -48,6 +48,29 @@ public:
 
 	virtual bool deriveFrom(ObserverCfg* old);
 
+	/**
+	 * sets a pcap filter expression derived from the following modules,
+	 * which is combined with the configured pcap_filter
+	 */
+	void setDerivedFilter(const std::string& filter)
+	{
+		derivedFilter = filter;
+	}
+
+	bool isTwoStageCapture()
+	{
+		return twoStageCapture;
+	}
+
+	/**
+	 * sets the filters which are evaluated after copying only the headers
+	 * of a packet, the ObserverCfg takes ownership of them
+	 */
+	void setHeaderStage(const std::vector<Cfg*>& cfgs)
+	{
+		headerStage = cfgs;
+	}
+
 protected:
 	ObserverCfg(XMLElement*);
 
@@ -55,6 +78,9 @@ private:
 	// config variables
 	std::string interface;	// also used for filename in offline mode
 	std::string pcap_filter;
+	std::string derivedFilter;
+	bool twoStageCapture;
+	std::vector<Cfg*> headerStage;
 	unsigned int capture_len;
 	bool offline;
 	bool replaceOfflineTimestamps;
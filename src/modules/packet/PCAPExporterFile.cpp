@@ -21,12 +21,20 @@
 #include "PCAPExporterFile.h"
 
 #include "modules/packet/Packet.h"
+#include "common/CompressedFile.h"
 
 #include <sstream>
 
-PCAPExporterFile::PCAPExporterFile(const std::string& file)
+PCAPExporterFile::PCAPExporterFile(const std::string& file, int compressionLevel)
 	: fileName(file),
+	  compressionLevel(compressionLevel),
 	  dummy(NULL),
+	  useRecorder(false),
+	  recorderBufferSize(0),
+	  recorderBufferCount(0),
+	  maxFileSize(0),
+	  rotationInterval(0),
+	  recorder(NULL),
 	  statPktsForwarded(0),
 	  statBytesForwarded(0)
 {
@@ -34,16 +42,48 @@ PCAPExporterFile::PCAPExporterFile(const std::string& file)
 
 PCAPExporterFile::~PCAPExporterFile()
 {
+	delete recorder;
+}
+
+/**
+ * writes the packets with O_DIRECT from large buffers in a separate thread,
+ * packets are dropped if the disk cannot keep up
+ */
+void PCAPExporterFile::setRecorder(uint32_t bufferSize, uint32_t bufferCount, uint64_t maxFileSize,
+		uint32_t rotationInterval)
+{
+	useRecorder = true;
+	recorderBufferSize = bufferSize;
+	recorderBufferCount = bufferCount;
+	this->maxFileSize = maxFileSize;
+	this->rotationInterval = rotationInterval;
 }
 
 void PCAPExporterFile::performStart()
 {
+	if (useRecorder) {
+		delete recorder;
+		recorder = new PCAPRecorder(fileName, link_type, snaplen, recorderBufferSize,
+				recorderBufferCount, maxFileSize, rotationInterval);
+		recorder->start();
+		return;
+	}
+
 	char errbuf[PCAP_ERRBUF_SIZE];
 	dummy = pcap_open_dead(link_type, snaplen);
 	if (!dummy) {
 		THROWEXCEPTION("Could not open dummy device: %s", errbuf);
 	}
-	dumper = pcap_dump_open(dummy, fileName.c_str());
+	if (compressionLevel > 0) {
+		// pcap_dump_close() closes the stream and finishes the compression
+		FILE* f = compressed_file_fopen(fileName.c_str(), compressionLevel);
+		if (!f) {
+			THROWEXCEPTION("Could not open compressed dump file %s: %s", fileName.c_str(), strerror(errno));
+		}
+		dumper = pcap_dump_fopen(dummy, f);
+	} else {
+		dumper = pcap_dump_open(dummy, fileName.c_str());
+	}
 	if (!dumper) {
 		THROWEXCEPTION("Could not open dump file: %s", errbuf);
 	}
@@ -51,6 +91,10 @@ void PCAPExporterFile::performStart()
 
 void PCAPExporterFile::performShutdown()
 {
+	if (recorder) {
+		recorder->stop();
+		return;
+	}
 	if (dumper) {
 		if (-1 == pcap_dump_flush(dumper)) {
 			msg(LOG_CRIT, "PCAPExporterFile: Could not flush dump file");
@@ -61,10 +105,15 @@ void PCAPExporterFile::performShutdown()
 
 void PCAPExporterFile::receive(Packet* packet)
 {
-	writePCAP(packet);
-	
 	statBytesForwarded += packet->data_length;
 	statPktsForwarded++;
+
+	if (recorder) {
+		recorder->write(packet->timestamp, packet->data_length, packet->pcapPacketLength, packet->layer2Start);
+		packet->removeReference();
+		return;
+	}
+	writePCAP(packet);
 }
 
 /**
@@ -75,5 +124,9 @@ std::string PCAPExporterFile::getStatisticsXML(double interval)
 	ostringstream oss;
 	oss << "<forwarded type=\"packets\">" << statPktsForwarded << "</forwarded>";
 	oss << "<forwarded type=\"bytes\">" << statBytesForwarded << "</forwarded>";
+	if (recorder) {
+		oss << "<dropped type=\"packets\">" << recorder->statDroppedPackets << "</dropped>";
+		oss << "<files>" << recorder->statFiles << "</files>";
+	}
 	return oss.str();
 }
@@ -28,13 +28,14 @@
 #include <string>
 #include <pcap.h>
 #include "PCAPExporterBase.h"
+#include "PCAPRecorder.h"
 
 class Packet;
 
 class PCAPExporterFile : public Module, public Destination<Packet *>, public Source<Packet *>, public PCAPExporterBase
 {
 public:
-	PCAPExporterFile(const std::string& file);
+	PCAPExporterFile(const std::string& file, int compressionLevel);
 	~PCAPExporterFile();
 
 	virtual void receive(Packet* packet);
@@ -42,11 +43,21 @@ public:
 	virtual void performShutdown();
 	virtual std::string getStatisticsXML(double interval);
 
+	void setRecorder(uint32_t bufferSize, uint32_t bufferCount, uint64_t maxFileSize,
+			uint32_t rotationInterval);
+
 private:
 	static void* pcapExporterSink(void* data);
 
 	std::string fileName;
+	int compressionLevel; /**< zlib level of the gzip-compressed file, 0 for an uncompressed file */
 	pcap_t* dummy;
+	bool useRecorder; /**< write with a PCAPRecorder instead of libpcap */
+	uint32_t recorderBufferSize;
+	uint32_t recorderBufferCount;
+	uint64_t maxFileSize;
+	uint32_t rotationInterval;
+	PCAPRecorder* recorder;
 	uint64_t statPktsForwarded;
 	uint64_t statBytesForwarded;
 };
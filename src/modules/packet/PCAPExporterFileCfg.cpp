@@ -21,12 +21,15 @@
 #include "PCAPExporterFileCfg.h"
 
 #include "common/defs.h"
+#include "common/CompressedFile.h"
 
 #include <cassert>
 #include <pcap.h>
 
 PCAPExporterFileCfg::PCAPExporterFileCfg(XMLElement* elem) 
-	: CfgHelper<PCAPExporterFile, PCAPExporterFileCfg>(elem, "pcapExporterFile"), link_type(DLT_EN10MB), snaplen(PCAP_MAX_CAPTURE_LENGTH)
+	: CfgHelper<PCAPExporterFile, PCAPExporterFileCfg>(elem, "pcapExporterFile"), link_type(DLT_EN10MB), snaplen(PCAP_MAX_CAPTURE_LENGTH),
+	  compression(false), compressionLevel(COMPRESSION_DEFAULT_LEVEL),
+	  directIO(false), bufferSize(4096), buffers(16), maxFileSize(0), rotationInterval(0)
 { 
 	if (!elem) return;
 
@@ -47,8 +50,40 @@ PCAPExporterFileCfg::PCAPExporterFileCfg(XMLElement* elem)
 			}
 		} else if (e->matches("snaplen")) {
 			snaplen = getInt("snaplen", PCAP_MAX_CAPTURE_LENGTH, e);
+		} else if (e->matches("compression")) {
+			std::string c = e->getFirstText();
+			if (c == "none") {
+				compression = false;
+			} else if (c == "gzip") {
+				if (!compression_supported())
+					THROWEXCEPTION("pcapExporterFile: gzip compression requested, but Vermont was compiled without zlib support");
+				compression = true;
+			} else {
+				THROWEXCEPTION("pcapExporterFile: unknown compression '%s', use 'none' or 'gzip'", c.c_str());
+			}
+		} else if (e->matches("compressionLevel")) {
+			compressionLevel = getInt("compressionLevel", COMPRESSION_DEFAULT_LEVEL, e);
+			if (compressionLevel < 1 || compressionLevel > 9)
+				THROWEXCEPTION("pcapExporterFile: compressionLevel must be between 1 and 9");
+		} else if (e->matches("directIO")) {
+			directIO = getBool("directIO", false, e);
+		} else if (e->matches("bufferSize")) {
+			bufferSize = getInt("bufferSize", 4096, e);
+		} else if (e->matches("buffers")) {
+			buffers = getInt("buffers", 16, e);
+			if (buffers < 2)
+				THROWEXCEPTION("pcapExporterFile: at least 2 buffers are required");
+		} else if (e->matches("maxFileSize")) {
+			maxFileSize = getInt64("maxFileSize", 0, e);
+		} else if (e->matches("rotationInterval")) {
+			rotationInterval = getInt("rotationInterval", 0, e);
 		}
 	}
+
+	if (!directIO && (maxFileSize || rotationInterval))
+		THROWEXCEPTION("pcapExporterFile: maxFileSize and rotationInterval require directIO");
+	if (directIO && compression)
+		THROWEXCEPTION("pcapExporterFile: directIO files cannot be compressed");
 } 
 
 PCAPExporterFileCfg* PCAPExporterFileCfg::create(XMLElement* elem)
@@ -64,9 +99,11 @@ PCAPExporterFileCfg::~PCAPExporterFileCfg()
 
 PCAPExporterFile* PCAPExporterFileCfg::createInstance()
 {
-	instance = new PCAPExporterFile(fileName);
+	instance = new PCAPExporterFile(fileName, compression ? compressionLevel : 0);
 	instance->setDataLinkType(link_type);
 	instance->setSnaplen(snaplen);
+	if (directIO)
+		instance->setRecorder(bufferSize*1024, buffers, maxFileSize*1024*1024, rotationInterval);
 	return instance;
 }
 
@@ -48,6 +48,13 @@ private:
 	std::string fileName;
 	int link_type;
 	int snaplen;
+	bool compression;
+	int compressionLevel;
+	bool directIO;
+	uint32_t bufferSize;
+	uint32_t buffers;
+	uint64_t maxFileSize;
+	uint32_t rotationInterval;
 };
 
 
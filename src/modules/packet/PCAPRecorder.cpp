@@ -0,0 +1,294 @@
+/*
+ * Vermont PCAP Recorder
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "PCAPRecorder.h"
+
+#include "common/msg.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sstream>
+
+#define PCAP_MAGIC 0xa1b2c3d4
+
+/* pcap file format, in host byte order */
+struct PCAPFileHeader {
+	uint32_t magic;
+	uint16_t versionMajor;
+	uint16_t versionMinor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+};
+
+struct PCAPRecordHeader {
+	uint32_t tsSec;
+	uint32_t tsUsec;
+	uint32_t caplen;
+	uint32_t len;
+};
+
+PCAPRecorder::PCAPRecorder(const std::string& fileName, int linkType, int snaplen, uint32_t bufferSize,
+		uint32_t bufferCount, uint64_t maxFileSize, uint32_t rotationInterval)
+	: statDroppedPackets(0),
+	  statFiles(0),
+	  fileName(fileName),
+	  linkType(linkType),
+	  snaplen(snaplen),
+	  maxFileSize(maxFileSize),
+	  rotationInterval(rotationInterval),
+	  freeBuffers(bufferCount),
+	  fullBuffers(bufferCount + 1),
+	  thread(PCAPRecorder::writerThread, "PCAPRecorder"),
+	  current(NULL),
+	  next(NULL),
+	  fileSerial(0),
+	  fileLength(0),
+	  fileStart(0),
+	  fd(-1),
+	  directIO(false),
+	  written(0),
+	  openSerial(UINT32_MAX)
+{
+	// a packet spans at most two buffers
+	this->bufferSize = (bufferSize + PCAP_RECORDER_ALIGNMENT - 1) / PCAP_RECORDER_ALIGNMENT * PCAP_RECORDER_ALIGNMENT;
+	if (this->bufferSize < sizeof(PCAPFileHeader) + sizeof(PCAPRecordHeader) + snaplen) {
+		THROWEXCEPTION("PCAPRecorder: buffer size %u is too small for snaplen %d", bufferSize, snaplen);
+	}
+	if (bufferCount < 2) {
+		THROWEXCEPTION("PCAPRecorder: at least 2 buffers are required");
+	}
+
+	for (uint32_t i = 0; i < bufferCount; i++) {
+		Buffer* b = new Buffer;
+		if (posix_memalign((void**)&b->data, PCAP_RECORDER_ALIGNMENT, this->bufferSize) != 0) {
+			delete b;
+			THROWEXCEPTION("PCAPRecorder: could not allocate %u buffers of %u bytes", bufferCount, this->bufferSize);
+		}
+		b->length = 0;
+		b->file = 0;
+		buffers.push_back(b);
+		freeBuffers.push(b);
+	}
+}
+
+PCAPRecorder::~PCAPRecorder()
+{
+	for (size_t i = 0; i < buffers.size(); i++) {
+		free(buffers[i]->data);
+		delete buffers[i];
+	}
+}
+
+void PCAPRecorder::start()
+{
+	thread.run(this);
+}
+
+/**
+ * writes the remaining packets and closes the file
+ */
+void PCAPRecorder::stop()
+{
+	if (current && current->length > 0) {
+		fullBuffers.push(current);
+	} else if (current) {
+		freeBuffers.push(current);
+	}
+	if (next)
+		freeBuffers.push(next);
+	current = NULL;
+	next = NULL;
+	fullBuffers.push(NULL);
+	thread.join();
+}
+
+bool PCAPRecorder::write(const struct timeval& ts, uint32_t caplen, uint32_t len, const uint8_t* data)
+{
+	if (caplen > (uint32_t)snaplen)
+		caplen = snaplen;
+	uint32_t recordLength = sizeof(PCAPRecordHeader) + caplen;
+
+	if (fileLength > 0 && ((maxFileSize && fileLength + recordLength > maxFileSize) ||
+			(rotationInterval && ts.tv_sec >= fileStart + (time_t)rotationInterval))) {
+		// the last buffer of a file is the only one which is not completely filled
+		if (current)
+			fullBuffers.push(current);
+		current = NULL;
+		fileSerial++;
+		fileLength = 0;
+		if (next)
+			next->file = fileSerial;
+	}
+
+	uint32_t needed = recordLength + (fileLength == 0 ? sizeof(PCAPFileHeader) : 0);
+	if (!current) {
+		if (!freeBuffers.pop(0, &current)) {
+			current = NULL;
+			statDroppedPackets++;
+			return false;
+		}
+		current->length = 0;
+		current->file = fileSerial;
+	}
+	if (bufferSize - current->length < needed && !next) {
+		if (!freeBuffers.pop(0, &next)) {
+			next = NULL;
+			statDroppedPackets++;
+			return false;
+		}
+		next->length = 0;
+		next->file = fileSerial;
+	}
+
+	if (fileLength == 0) {
+		PCAPFileHeader fh;
+		fh.magic = PCAP_MAGIC;
+		fh.versionMajor = 2;
+		fh.versionMinor = 4;
+		fh.thiszone = 0;
+		fh.sigfigs = 0;
+		fh.snaplen = snaplen;
+		fh.linktype = linkType;
+		append(&fh, sizeof(fh));
+		fileStart = ts.tv_sec;
+	}
+	PCAPRecordHeader rh;
+	rh.tsSec = ts.tv_sec;
+	rh.tsUsec = ts.tv_usec;
+	rh.caplen = caplen;
+	rh.len = len;
+	append(&rh, sizeof(rh));
+	append(data, caplen);
+	fileLength += needed;
+	return true;
+}
+
+/**
+ * copies data into the current buffer and continues in the next buffer,
+ * which has been reserved by write()
+ */
+void PCAPRecorder::append(const void* data, uint32_t length)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	while (length > 0) {
+		uint32_t n = bufferSize - current->length;
+		if (n > length)
+			n = length;
+		memcpy(current->data + current->length, p, n);
+		current->length += n;
+		p += n;
+		length -= n;
+		if (current->length == bufferSize) {
+			fullBuffers.push(current);
+			current = next;
+			next = NULL;
+		}
+	}
+}
+
+void* PCAPRecorder::writerThread(void* data)
+{
+	PCAPRecorder* recorder = (PCAPRecorder*)data;
+	Buffer* b;
+
+	while (recorder->fullBuffers.pop(&b) && b) {
+		if (b->file != recorder->openSerial) {
+			recorder->closeFile();
+			recorder->openFile(b->file);
+		}
+		recorder->writeBuffer(b);
+		recorder->freeBuffers.push(b);
+	}
+	recorder->closeFile();
+	return NULL;
+}
+
+void PCAPRecorder::openFile(uint32_t serial)
+{
+	std::string name = fileName;
+	if (maxFileSize || rotationInterval) {
+		std::ostringstream oss;
+		oss << fileName << "." << serial;
+		name = oss.str();
+	}
+	openSerial = serial;
+	written = 0;
+
+	directIO = false;
+#ifdef O_DIRECT
+	fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, S_IRUSR | S_IWUSR | S_IRGRP);
+	if (fd >= 0) {
+		directIO = true;
+	} else if (errno == EINVAL) {
+		msg(LOG_NOTICE, "PCAPRecorder: file system of %s does not support O_DIRECT, using buffered writes", name.c_str());
+	}
+#endif
+	if (!directIO)
+		fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP);
+	if (fd < 0) {
+		msg(LOG_ERR, "PCAPRecorder: could not open %s: %s", name.c_str(), strerror(errno));
+		return;
+	}
+	statFiles++;
+	msg(LOG_INFO, "PCAPRecorder: writing to %s", name.c_str());
+}
+
+void PCAPRecorder::closeFile()
+{
+	if (fd < 0)
+		return;
+	// O_DIRECT writes of the last buffer have been padded
+	if (directIO && ftruncate(fd, written) != 0)
+		msg(LOG_ERR, "PCAPRecorder: could not truncate file: %s", strerror(errno));
+	if (close(fd) != 0)
+		msg(LOG_ERR, "PCAPRecorder: could not close file: %s", strerror(errno));
+	fd = -1;
+}
+
+void PCAPRecorder::writeBuffer(Buffer* b)
+{
+	if (fd < 0)
+		return;
+
+	uint32_t length = b->length;
+	if (directIO && length % PCAP_RECORDER_ALIGNMENT) {
+		uint32_t aligned = (length + PCAP_RECORDER_ALIGNMENT - 1) / PCAP_RECORDER_ALIGNMENT * PCAP_RECORDER_ALIGNMENT;
+		memset(b->data + length, 0, aligned - length);
+		length = aligned;
+	}
+
+	uint32_t pos = 0;
+	while (pos < length) {
+		ssize_t n = ::write(fd, b->data + pos, length - pos);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			msg(LOG_ERR, "PCAPRecorder: could not write to file: %s", strerror(errno));
+			closeFile();
+			return;
+		}
+		pos += n;
+	}
+	written += b->length;
+}
@@ -0,0 +1,103 @@
+/*
+ * Vermont PCAP Recorder
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef _PCAP_RECORDER_H_
+#define _PCAP_RECORDER_H_
+
+#include "common/ConcurrentQueue.h"
+#include "common/Thread.h"
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <string>
+#include <vector>
+
+/* alignment of buffers, offsets and lengths for O_DIRECT */
+#define PCAP_RECORDER_ALIGNMENT 4096
+
+/**
+ * Writes packets into pcap files without libpcap and stdio.
+ *
+ * Packets are copied into large aligned buffers. A writer thread writes full
+ * buffers to files opened with O_DIRECT, so neither the page cache nor the
+ * caller are involved in the disk I/O. All buffers but the last one of a file
+ * are completely filled, packets may span two buffers. If the writer thread
+ * falls behind and no buffer is free, packets are dropped instead of blocking
+ * the caller.
+ *
+ * Files are rotated after maxFileSize bytes or rotationInterval seconds of
+ * packet time. Rotated files are numbered: "<fileName>.<n>".
+ */
+class PCAPRecorder
+{
+public:
+	PCAPRecorder(const std::string& fileName, int linkType, int snaplen, uint32_t bufferSize,
+			uint32_t bufferCount, uint64_t maxFileSize, uint32_t rotationInterval);
+	~PCAPRecorder();
+
+	void start();
+	void stop();
+
+	/**
+	 * appends a packet to the current file. Returns false if the packet was dropped.
+	 */
+	bool write(const struct timeval& ts, uint32_t caplen, uint32_t len, const uint8_t* data);
+
+	uint64_t statDroppedPackets;
+	uint32_t statFiles;
+
+private:
+	struct Buffer {
+		uint8_t* data;
+		uint32_t length;
+		uint32_t file; /**< serial number of the file the buffer belongs to */
+	};
+
+	std::string fileName;
+	int linkType;
+	int snaplen;
+	uint32_t bufferSize;
+	uint64_t maxFileSize; /**< in bytes, 0 for no limit */
+	uint32_t rotationInterval; /**< in seconds, 0 for no limit */
+	std::vector<Buffer*> buffers;
+	ConcurrentQueue<Buffer*> freeBuffers;
+	ConcurrentQueue<Buffer*> fullBuffers; /**< NULL stops the writer thread */
+	Thread thread;
+
+	/* state of the calling thread */
+	Buffer* current;
+	Buffer* next; /**< reserved for a packet which does not fit into current */
+	uint32_t fileSerial;
+	uint64_t fileLength; /**< bytes written into the current file */
+	time_t fileStart; /**< packet time of the first packet in the current file */
+
+	/* state of the writer thread */
+	int fd;
+	bool directIO;
+	uint64_t written; /**< bytes written to fd, without padding */
+	uint32_t openSerial; /**< serial number of the open file */
+
+	static void* writerThread(void* data);
+	void append(const void* data, uint32_t length);
+	void openFile(uint32_t serial);
+	void closeFile();
+	void writeBuffer(Buffer* b);
+};
+
+#endif
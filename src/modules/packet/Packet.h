@@ -47,6 +47,9 @@
 #define HEAD_TRANSPORT_AND_BEYOND 5  // for fields that might go beyond the transport header border
 #define HEAD_PAYLOAD              6  // field containing TCP/UDP payload (in the case of TCP or UDP) or IP payload (otherwise)
 
+// maximum length of the IP header and of the transport header, initHeaders() copies both
+#define PACKET_MAX_HEADER_LENGTH  60
+
 
 // Packet classifications
 //
@@ -62,6 +65,7 @@
 // Network header classifications
 #define PCLASS_NET_IP4             (1UL <<  0)
 #define PCLASS_NET_IP6             (1UL <<  1)
+#define PCLASS_NET_FRAGMENT        (1UL <<  2)  // IPv4 or IPv6 fragment, including the first one
 
 #define PCLASS_NETMASK             0x00000fff
 
@@ -200,6 +204,54 @@ public:
 		classify(dataLinkType);
 	};
 
+	/**
+	 * like init(), but only copies the layer 2 header and the following
+	 * 2 * PACKET_MAX_HEADER_LENGTH bytes. If headersComplete() returns true,
+	 * the IP and transport headers can be evaluated before copyPayload()
+	 * copies the rest of the packet.
+	 */
+	inline void initHeaders(char* packetData, unsigned int len, struct timeval time, uint32_t obsdomainid, uint32_t origplen, int dataLinkType)
+	{
+		unsigned int headerLen = getLayer2HeaderLen(packetData, dataLinkType) + 2 * PACKET_MAX_HEADER_LENGTH;
+		init(packetData, len < headerLen ? len : headerLen, time, obsdomainid, origplen, dataLinkType);
+	}
+
+	/**
+	 * returns true if initHeaders() has copied the complete packet of len
+	 * bytes or PACKET_MAX_HEADER_LENGTH bytes behind the start of the transport header
+	 */
+	inline bool headersComplete(unsigned int len)
+	{
+		return data_length == len ||
+			(transportHeader && layer2HeaderLen + transportHeaderOffset + PACKET_MAX_HEADER_LENGTH <= data_length);
+	}
+
+	/**
+	 * copies the rest of the packet of len bytes after initHeaders() and
+	 * classifies the complete packet
+	 */
+	inline void copyPayload(char* packetData, unsigned int len, int dataLinkType)
+	{
+		if (len == data_length)
+			return;
+		if (len > PCAP_MAX_CAPTURE_LENGTH) {
+			THROWEXCEPTION("received packet of size %d is bigger than maximum length (%d), "
+					"adjust compile-time parameter PCAP_MAX_CAPTURE_LENGTH to compensate!", len, PCAP_MAX_CAPTURE_LENGTH);
+		}
+
+		// the classification may have cropped data_length, bytes before it have been copied
+		memcpy(layer2Start + data_length, packetData + data_length, len - data_length);
+		data_length = len;
+
+		transportHeader = NULL;
+		payload = NULL;
+		transportHeaderOffset = 0;
+		payloadOffset = 0;
+		classification = 0;
+		ipProtocolType = NONE;
+		classify(dataLinkType);
+	}
+
 	inline void init(char** datasegments, uint32_t* segmentlens, struct timeval time, uint32_t obsdomainid, uint32_t origplen, int dataLinkType)
 	{
 		transportHeader = NULL;
@@ -296,7 +348,11 @@ public:
 
 			// get fragment offset
 			memcpy(&fragoffset, (data.netHeader+6), sizeof(uint16_t));
-			fragoffset = ntohs(fragoffset) & 0x1FFF;
+			fragoffset = ntohs(fragoffset);
+			// more fragments flag or fragment offset
+			if (fragoffset & 0x3FFF)
+				classification |= PCLASS_NET_FRAGMENT;
+			fragoffset &= 0x1FFF;
 
 			// do not use transport header, if this is not the first fragment
 			// in the end, all fragments are discarded by vermont (TODO!)
@@ -309,12 +365,18 @@ public:
 		// check for IPv6 header, fixed header is 40 bytes long
 		else if ( (data.netHeader + 40 <= layer2Start + data_length) && ((*data.netHeader >> 4) == 6) )
 		{
-			protocol = *(data.netHeader + 7);
+			protocol = *(data.netHeader + 6);
 			classification |= PCLASS_NET_IP6;
 			transportHeaderOffset = 40;
 
 			bool extHeaderPresent = true;
 			while (extHeaderPresent) {
+				// extension headers are at least 8 bytes long
+				if ((protocol == 0 || protocol == 60 || protocol == 43 || protocol == 135 || protocol == 44 || protocol == 51)
+						&& data.netHeader + transportHeaderOffset + 8 > layer2Start + data_length) {
+					protocol = 0;
+					break;
+				}
 				switch (protocol) {
 					case 0:		// Hop-by-Hop Options
 					case 60:	// Destination Options
@@ -326,6 +388,7 @@ public:
 						break;
 
 					case 44:	// Fragment
+						classification |= PCLASS_NET_FRAGMENT;
 						// Only use transport header if this is the first fragment
 						memcpy(&fragoffset, (data.netHeader + transportHeaderOffset + 2),
 							sizeof(uint16_t));
@@ -353,10 +416,10 @@ public:
 
 			}
 
-			// crop layer 2 padding
-			uint16_t ip_total_length;
-			memcpy(&ip_total_length, (data.netHeader+2), sizeof(uint16_t));
-			unsigned int endOfIpOffset = layer2HeaderLen +  ntohs(ip_total_length);
+			// crop layer 2 padding, the payload length does not include the fixed header
+			uint16_t ip_payload_length;
+			memcpy(&ip_payload_length, (data.netHeader+4), sizeof(uint16_t));
+			unsigned int endOfIpOffset = layer2HeaderLen + 40 + ntohs(ip_payload_length);
 			if(data_length > endOfIpOffset)
 			{
 				DPRINTF_INFO("crop layer 2 padding: old: %u  new: %u\n", data_length, endOfIpOffset);
@@ -0,0 +1,135 @@
+/*
+ * Vermont Packet Hash Splitter
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "PacketHashSplitter.h"
+
+#include <string.h>
+#include <sstream>
+
+PacketHashSplitter::PacketHashSplitter()
+{
+	memset(statPackets, 0, sizeof(statPackets));
+}
+
+PacketHashSplitter::~PacketHashSplitter()
+{
+}
+
+static inline uint64_t mix64(uint64_t h)
+{
+	// finalizer of MurmurHash3
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * combines an address of the given length in bytes and a port to one value
+ */
+static inline uint64_t endpoint(const uint8_t* address, unsigned length, uint16_t port)
+{
+	uint64_t e = port;
+	for (unsigned i = 0; i < length; i += 8) {
+		uint64_t word = 0;
+		memcpy(&word, address + i, length - i < 8 ? length - i : 8);
+		e = mix64(e ^ word);
+	}
+	return e;
+}
+
+uint32_t PacketHashSplitter::flowHash(const Packet* p)
+{
+	const uint8_t* src;
+	const uint8_t* dst;
+	unsigned length;
+	unsigned protocol;
+	// only the first fragment carries the ports
+	bool fragment = p->classification & PCLASS_NET_FRAGMENT;
+
+	if (p->classification & PCLASS_NET_IP4) {
+		src = p->data.netHeader + 12;
+		dst = p->data.netHeader + 16;
+		length = 4;
+		// later fragments are not classified by their transport protocol
+		protocol = p->data.netHeader[9];
+	} else if (p->classification & PCLASS_NET_IP6) {
+		src = p->data.netHeader + 8;
+		dst = p->data.netHeader + 24;
+		length = 16;
+		// the transport protocol follows the extension headers, which may
+		// differ between the directions and are not classified in later fragments
+		protocol = fragment ? 0 : p->ipProtocolType;
+	} else {
+		return 0;
+	}
+
+	uint16_t srcPort = 0;
+	uint16_t dstPort = 0;
+	if (!fragment && p->transportHeader && (p->classification & (PCLASS_TRN_TCP | PCLASS_TRN_UDP))) {
+		memcpy(&srcPort, p->transportHeader, sizeof(srcPort));
+		memcpy(&dstPort, p->transportHeader + 2, sizeof(dstPort));
+	}
+
+	uint64_t a = endpoint(src, length, srcPort);
+	uint64_t b = endpoint(dst, length, dstPort);
+	if (a > b) {
+		uint64_t t = a;
+		a = b;
+		b = t;
+	}
+	return mix64(mix64(a ^ protocol) ^ b) >> 32;
+}
+
+void PacketHashSplitter::receive(Packet* p)
+{
+	if (!Source<Packet*>::sleepUntilConnected()) {
+		DPRINTF_INFO("Can't wait for connection, perhaps the program is shutting down?");
+		return;
+	}
+
+	// maps the hash to 0 .. size - 1 without a division
+	size_t i = ((uint64_t)flowHash(p) * size) >> 32;
+	statPackets[i]++;
+	destinations[i]->receive(p);
+}
+
+/**
+ * removes all successors, preceding modules have already been disconnected
+ */
+void PacketHashSplitter::disconnect()
+{
+	Source<Packet*>::mutex.lock();
+	if (size > 0) {
+		Source<Packet*>::connected.dec(size);
+		size = 0;
+	}
+	Source<Packet*>::mutex.unlock();
+}
+
+std::string PacketHashSplitter::getStatisticsXML(double interval)
+{
+	std::ostringstream oss;
+	for (size_t i = 0; i < size; i++) {
+		oss << "<branch index=\"" << i << "\"><packets>" << statPackets[i] << "</packets></branch>";
+	}
+	return oss.str();
+}
@@ -0,0 +1,60 @@
+/*
+ * Vermont Packet Hash Splitter
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef _PACKET_HASH_SPLITTER_H_
+#define _PACKET_HASH_SPLITTER_H_
+
+#include "core/ConnectionSplitter.h"
+#include "modules/packet/Packet.h"
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * Sends every packet to exactly one of its successors, which is chosen by a
+ * hash of the addresses, the protocol and the ports of the packet. The hash
+ * is symmetric, so both directions of a flow take the same branch and every
+ * branch sees complete flows. Each branch should begin with a packetQueue,
+ * so the branches are processed in parallel.
+ *
+ * Fragments of IPv4 and IPv6 packets are hashed without ports, as only the
+ * first fragment carries them, IPv6 fragments also without the protocol,
+ * which follows the fragment header. Packets which are neither IPv4 nor IPv6
+ * are sent to the first successor.
+ */
+class PacketHashSplitter : public ConnectionSplitter<Packet*>
+{
+public:
+	PacketHashSplitter();
+	virtual ~PacketHashSplitter();
+
+	virtual void receive(Packet* p);
+	virtual void disconnect();
+	virtual std::string getStatisticsXML(double interval);
+
+	/**
+	 * returns the same hash for both directions of a flow
+	 */
+	static uint32_t flowHash(const Packet* p);
+
+private:
+	uint64_t statPackets[capacity]; /**< packets sent to each successor */
+};
+
+#endif
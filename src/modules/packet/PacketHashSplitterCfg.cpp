@@ -0,0 +1,63 @@
+/*
+ * Vermont Configuration Subsystem
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "PacketHashSplitterCfg.h"
+
+#include <cassert>
+
+PacketHashSplitterCfg::PacketHashSplitterCfg(XMLElement* elem)
+	: CfgHelper<PacketHashSplitter, PacketHashSplitterCfg>(elem, "packetHashSplitter")
+{
+	if (!elem) return;
+
+	XMLNode::XMLSet<XMLElement*> set = elem->getElementChildren();
+	for (XMLNode::XMLSet<XMLElement*>::iterator it = set.begin();
+	     it != set.end();
+	     it++) {
+		XMLElement* e = *it;
+
+		if (e->matches("next")) { // ignore next
+		} else {
+			msg(LOG_CRIT, "Unknown packetHashSplitter config statement %s\n", e->getName().c_str());
+		}
+	}
+}
+
+PacketHashSplitterCfg* PacketHashSplitterCfg::create(XMLElement* elem)
+{
+	assert(elem);
+	assert(elem->getName() == getName());
+	return new PacketHashSplitterCfg(elem);
+}
+
+PacketHashSplitterCfg::~PacketHashSplitterCfg()
+{
+}
+
+PacketHashSplitter* PacketHashSplitterCfg::createInstance()
+{
+	instance = new PacketHashSplitter();
+	return instance;
+}
+
+bool PacketHashSplitterCfg::deriveFrom(PacketHashSplitterCfg* old)
+{
+	// the successors are connected anew, the splitter has no state
+	return true;
+}
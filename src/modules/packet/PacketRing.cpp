@@ -0,0 +1,400 @@
+/*
+ * Vermont Packet Ring
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "PacketRing.h"
+
+#include "modules/packet/Packet.h"
+
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+/* caplen of the record which marks the jump back to the start of the ring */
+#define PACKET_RING_WRAP 0xFFFFFFFF
+
+/* pcap file format, in host byte order */
+struct PacketRingFileHeader {
+	uint32_t magic;
+	uint16_t versionMajor;
+	uint16_t versionMinor;
+	int32_t thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+};
+
+struct PacketRingRecordHeader {
+	uint32_t tsSec;
+	uint32_t tsUsec;
+	uint32_t caplen;
+	uint32_t len;
+};
+
+static bool secondBefore(const PacketRing::Second& s, uint64_t offset)
+{
+	return s.offset < offset;
+}
+
+static inline uint64_t alignRecord(uint64_t length)
+{
+	return (length + 7) & ~(uint64_t)7;
+}
+
+PacketRing::PacketRing(const std::string& fileName, uint64_t size, int linkType, const std::string& requestDirectory)
+	: fileName(fileName),
+	  size(size),
+	  linkType(linkType),
+	  requestDirectory(requestDirectory),
+	  ring(NULL),
+	  head(0),
+	  tail(0),
+	  thread(PacketRing::requestThread, "PacketRing"),
+	  statPackets(0),
+	  statBytes(0),
+	  statEvicted(0),
+	  statExtractions(0)
+{
+	if (!this->requestDirectory.empty() && this->requestDirectory[this->requestDirectory.length()-1] != '/')
+		this->requestDirectory += "/";
+}
+
+PacketRing::~PacketRing()
+{
+}
+
+void PacketRing::performStart()
+{
+	head = 0;
+	tail = 0;
+	index.clear();
+
+	if (fileName.empty()) {
+		ring = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	} else {
+		// the file only provides the storage, its content is not kept across restarts
+		int fd = open(fileName.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+		if (fd < 0) {
+			THROWEXCEPTION("PacketRing: could not open %s: %s", fileName.c_str(), strerror(errno));
+		}
+		if (ftruncate(fd, size) != 0) {
+			close(fd);
+			THROWEXCEPTION("PacketRing: could not resize %s: %s", fileName.c_str(), strerror(errno));
+		}
+		ring = (uint8_t*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		close(fd);
+	}
+	if (ring == MAP_FAILED) {
+		ring = NULL;
+		THROWEXCEPTION("PacketRing: could not map %lu bytes: %s", (unsigned long)size, strerror(errno));
+	}
+
+	if (!requestDirectory.empty())
+		thread.run(this);
+}
+
+void PacketRing::performShutdown()
+{
+	if (!requestDirectory.empty())
+		thread.join();
+	if (ring)
+		munmap(ring, size);
+	ring = NULL;
+}
+
+/**
+ * removes the oldest packets until length bytes are free
+ */
+void PacketRing::makeRoom(uint64_t length)
+{
+	while (head + length - tail > size) {
+		uint64_t pos = tail % size;
+		if (pos + sizeof(RecordHeader) > size) {
+			tail += size - pos;
+			continue;
+		}
+		const RecordHeader* h = (const RecordHeader*)(ring + pos);
+		if (h->caplen == PACKET_RING_WRAP) {
+			tail += size - pos;
+		} else {
+			tail += alignRecord(sizeof(RecordHeader) + h->caplen);
+			statEvicted++;
+		}
+	}
+
+	while (index.size() > 1 && index[1].offset <= tail)
+		index.pop_front();
+	if (!index.empty() && index.front().offset < tail) {
+		if (tail >= head)
+			index.clear();
+		else
+			index.front().offset = tail;
+	}
+}
+
+uint32_t PacketRing::indexKey(uint32_t ip, uint16_t port)
+{
+	uint32_t h = ip ^ ((uint32_t)port * 0x9e3779b1);
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	return h;
+}
+
+void PacketRing::setIndexBits(uint64_t* bitmap, uint32_t key)
+{
+	uint32_t b1 = key & (PACKET_RING_INDEX_BITS - 1);
+	uint32_t b2 = (key >> 16) & (PACKET_RING_INDEX_BITS - 1);
+	bitmap[b1 / 64] |= (uint64_t)1 << (b1 % 64);
+	bitmap[b2 / 64] |= (uint64_t)1 << (b2 % 64);
+}
+
+bool PacketRing::testIndexBits(const uint64_t* bitmap, uint32_t key)
+{
+	uint32_t b1 = key & (PACKET_RING_INDEX_BITS - 1);
+	uint32_t b2 = (key >> 16) & (PACKET_RING_INDEX_BITS - 1);
+	return (bitmap[b1 / 64] & ((uint64_t)1 << (b1 % 64))) && (bitmap[b2 / 64] & ((uint64_t)1 << (b2 % 64)));
+}
+
+void PacketRing::receive(Packet* packet)
+{
+	RecordHeader h;
+	h.tsSec = packet->timestamp.tv_sec;
+	h.tsUsec = packet->timestamp.tv_usec;
+	h.caplen = packet->data_length;
+	h.len = packet->pcapPacketLength;
+	h.srcIp = 0;
+	h.dstIp = 0;
+	h.srcPort = 0;
+	h.dstPort = 0;
+	h.reserved = 0;
+	if (packet->classification & PCLASS_NET_IP4) {
+		memcpy(&h.srcIp, packet->data.netHeader + 12, 4);
+		memcpy(&h.dstIp, packet->data.netHeader + 16, 4);
+		if (packet->ipProtocolType == Packet::TCP || packet->ipProtocolType == Packet::UDP) {
+			memcpy(&h.srcPort, packet->transportHeader, 2);
+			memcpy(&h.dstPort, packet->transportHeader + 2, 2);
+		}
+	}
+
+	uint64_t recordLength = alignRecord(sizeof(RecordHeader) + h.caplen);
+	if (recordLength > size) {
+		packet->removeReference();
+		return;
+	}
+
+	lock.lock();
+	uint64_t pos = head % size;
+	uint64_t skip = pos + recordLength > size ? size - pos : 0;
+	makeRoom(skip + recordLength);
+	if (skip) {
+		if (skip >= sizeof(RecordHeader))
+			((RecordHeader*)(ring + pos))->caplen = PACKET_RING_WRAP;
+		head += skip;
+		pos = 0;
+	}
+	memcpy(ring + pos, &h, sizeof(h));
+	memcpy(ring + pos + sizeof(h), packet->layer2Start, h.caplen);
+
+	if (index.empty() || index.back().time != h.tsSec) {
+		Second s;
+		s.time = h.tsSec;
+		s.offset = head;
+		memset(s.hosts, 0, sizeof(s.hosts));
+		index.push_back(s);
+	}
+	if (h.srcIp) {
+		uint64_t* hosts = index.back().hosts;
+		setIndexBits(hosts, indexKey(h.srcIp, 0));
+		setIndexBits(hosts, indexKey(h.dstIp, 0));
+		if (h.srcPort || h.dstPort) {
+			setIndexBits(hosts, indexKey(h.srcIp, h.srcPort));
+			setIndexBits(hosts, indexKey(h.dstIp, h.dstPort));
+		}
+	}
+	head += recordLength;
+	lock.unlock();
+
+	statPackets++;
+	statBytes += h.caplen;
+	packet->removeReference();
+}
+
+uint64_t PacketRing::extract(uint32_t start, uint32_t end, uint32_t host, uint16_t port, const std::string& pcapFile)
+{
+	FILE* f = fopen(pcapFile.c_str(), "wb");
+	if (!f) {
+		msg(LOG_ERR, "PacketRing: could not create %s: %s", pcapFile.c_str(), strerror(errno));
+		return 0;
+	}
+	PacketRingFileHeader fh;
+	fh.magic = 0xa1b2c3d4;
+	fh.versionMajor = 2;
+	fh.versionMinor = 4;
+	fh.thiszone = 0;
+	fh.sigfigs = 0;
+	fh.snaplen = 65535;
+	fh.linktype = linkType;
+	fwrite(&fh, sizeof(fh), 1, f);
+
+	uint32_t key = host ? indexKey(host, port) : 0;
+	uint64_t packets = 0;
+	uint64_t from = 0; /**< ring position up to which the index has been processed */
+	std::vector<uint8_t> chunk;
+
+	// one second is copied at a time, so storing packets is never held up for long
+	while (true) {
+		chunk.clear();
+		lock.lock();
+		size_t i = std::lower_bound(index.begin(), index.end(), from, secondBefore) - index.begin();
+		while (i < index.size() && (index[i].time < start || index[i].time > end ||
+				(host && !testIndexBits(index[i].hosts, key))))
+			i++;
+		if (i == index.size()) {
+			lock.unlock();
+			break;
+		}
+		uint64_t pos = index[i].offset;
+		uint64_t stop = i + 1 < index.size() ? index[i+1].offset : head;
+		while (pos < stop) {
+			uint64_t p = pos % size;
+			if (p + sizeof(RecordHeader) > size) {
+				pos += size - p;
+				continue;
+			}
+			const RecordHeader* h = (const RecordHeader*)(ring + p);
+			if (h->caplen == PACKET_RING_WRAP) {
+				pos += size - p;
+				continue;
+			}
+			pos += alignRecord(sizeof(RecordHeader) + h->caplen);
+			if (h->tsSec < start || h->tsSec > end)
+				continue;
+			if (host && !((h->srcIp == host && (!port || h->srcPort == port)) ||
+					(h->dstIp == host && (!port || h->dstPort == port))))
+				continue;
+			PacketRingRecordHeader rh;
+			rh.tsSec = h->tsSec;
+			rh.tsUsec = h->tsUsec;
+			rh.caplen = h->caplen;
+			rh.len = h->len;
+			chunk.insert(chunk.end(), (const uint8_t*)&rh, (const uint8_t*)(&rh + 1));
+			chunk.insert(chunk.end(), (const uint8_t*)(h + 1), (const uint8_t*)(h + 1) + h->caplen);
+			packets++;
+		}
+		from = stop;
+		lock.unlock();
+
+		if (!chunk.empty() && fwrite(chunk.data(), chunk.size(), 1, f) != 1) {
+			msg(LOG_ERR, "PacketRing: could not write to %s", pcapFile.c_str());
+			break;
+		}
+	}
+
+	if (fclose(f) != 0)
+		msg(LOG_ERR, "PacketRing: could not write to %s", pcapFile.c_str());
+	statExtractions++;
+	msg(LOG_NOTICE, "PacketRing: extracted %lu packets into %s", (unsigned long)packets, pcapFile.c_str());
+	return packets;
+}
+
+void* PacketRing::requestThread(void* data)
+{
+	PacketRing* pr = (PacketRing*)data;
+	while (!pr->exitFlag) {
+		pr->processRequests();
+		for (int i = 0; i < PACKET_RING_POLL_INTERVAL / 100 && !pr->exitFlag; i++)
+			usleep(100000);
+	}
+	return NULL;
+}
+
+/**
+ * serves the requests in the request directory
+ */
+void PacketRing::processRequests()
+{
+	static const std::string suffix = ".request";
+
+	DIR* dir = opendir(requestDirectory.c_str());
+	if (!dir) {
+		msg(LOG_ERR, "PacketRing: could not open request directory %s", requestDirectory.c_str());
+		return;
+	}
+	std::vector<std::string> requests;
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		std::string name = entry->d_name;
+		if (name.length() > suffix.length() && name.compare(name.length() - suffix.length(), suffix.length(), suffix) == 0)
+			requests.push_back(name.substr(0, name.length() - suffix.length()));
+	}
+	closedir(dir);
+
+	for (size_t i = 0; i < requests.size() && !exitFlag; i++) {
+		std::string base = requestDirectory + requests[i];
+		FILE* f = fopen((base + suffix).c_str(), "r");
+		if (!f)
+			continue;
+		char line[256];
+		bool valid = fgets(line, sizeof(line), f) != NULL;
+		fclose(f);
+
+		unsigned int start = 0, end = 0, port = 0;
+		char hostText[64] = "";
+		uint32_t host = 0;
+		if (valid) {
+			int n = sscanf(line, "%u %u %63s %u", &start, &end, hostText, &port);
+			valid = n >= 2 && port <= 0xFFFF && (n < 3 || inet_pton(AF_INET, hostText, &host) == 1);
+		}
+		if (valid) {
+			extract(start, end, host, htons(port), base + ".pcap");
+		} else {
+			msg(LOG_ERR, "PacketRing: invalid request %s%s, expected \"<start> <end> [<host> [<port>]]\"",
+				base.c_str(), suffix.c_str());
+		}
+		if (rename((base + suffix).c_str(), (base + ".done").c_str()) != 0)
+			unlink((base + suffix).c_str());
+	}
+}
+
+std::string PacketRing::getStatisticsXML(double interval)
+{
+	lock.lock();
+	uint32_t oldest = index.empty() ? 0 : index.front().time;
+	uint64_t used = head - tail;
+	lock.unlock();
+
+	std::ostringstream oss;
+	oss << "<stored type=\"packets\">" << statPackets << "</stored>";
+	oss << "<stored type=\"bytes\">" << statBytes << "</stored>";
+	oss << "<evicted type=\"packets\">" << statEvicted << "</evicted>";
+	oss << "<used type=\"bytes\">" << used << "</used>";
+	oss << "<oldest>" << oldest << "</oldest>";
+	oss << "<extractions>" << statExtractions << "</extractions>";
+	return oss.str();
+}
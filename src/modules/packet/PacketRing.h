@@ -0,0 +1,118 @@
+/*
+ * Vermont Packet Ring
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef _PACKET_RING_H_
+#define _PACKET_RING_H_
+
+#include "core/Module.h"
+#include "common/Mutex.h"
+#include "common/Thread.h"
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+class Packet;
+
+/* bits of the host index of each second, a power of two */
+#define PACKET_RING_INDEX_BITS 2048
+/* time between two checks of the request directory in ms */
+#define PACKET_RING_POLL_INTERVAL 1000
+
+/**
+ * Keeps the most recent packets in a ring of fixed size, so the packets
+ * around an alert can be extracted afterwards.
+ *
+ * The ring is a memory-mapped file or, without file name, anonymous memory.
+ * Old packets are overwritten by new ones. For every second of packet time,
+ * an index entry holds the position of its first packet and a bitmap of the
+ * hashes of IPv4 addresses and address/port pairs seen in that second, so
+ * extractions for a host only read the seconds in which the host occurred.
+ *
+ * Extractions run while packets are stored. They are requested by calling
+ * @c extract() or by placing a file "<name>.request" into the request
+ * directory. It contains one line "<start> <end> [<host> [<port>]]" with
+ * times in seconds since the epoch. The packets are written to "<name>.pcap",
+ * then the request is renamed to "<name>.done".
+ */
+class PacketRing : public Module, public Destination<Packet*>, public Source<Packet*>
+{
+public:
+	PacketRing(const std::string& fileName, uint64_t size, int linkType, const std::string& requestDirectory);
+	~PacketRing();
+
+	virtual void receive(Packet* packet);
+	virtual void performStart();
+	virtual void performShutdown();
+	virtual std::string getStatisticsXML(double interval);
+
+	/**
+	 * writes the stored packets between start and end (inclusive, in seconds)
+	 * which have been sent or received by host (0 for all hosts), optionally
+	 * only those with the given port, to a new pcap file.
+	 * Host and port are in network byte order. Returns the number of packets.
+	 */
+	uint64_t extract(uint32_t start, uint32_t end, uint32_t host, uint16_t port, const std::string& pcapFile);
+
+	struct Second {
+		uint32_t time;
+		uint64_t offset; /**< ring position of the first packet */
+		uint64_t hosts[PACKET_RING_INDEX_BITS / 64];
+	};
+
+private:
+	struct RecordHeader {
+		uint32_t tsSec;
+		uint32_t tsUsec;
+		uint32_t caplen;
+		uint32_t len;
+		uint32_t srcIp; /**< IPv4 addresses and ports in network byte order, 0 if not available */
+		uint32_t dstIp;
+		uint16_t srcPort;
+		uint16_t dstPort;
+		uint32_t reserved;
+	};
+
+	std::string fileName;
+	uint64_t size;
+	int linkType;
+	std::string requestDirectory;
+	uint8_t* ring;
+
+	Mutex lock; /**< protects the ring positions, the index and the stored data */
+	uint64_t head; /**< position behind the newest packet, positions grow monotonically */
+	uint64_t tail; /**< position of the oldest packet */
+	std::deque<Second> index;
+
+	Thread thread; /**< serves the request directory */
+
+	uint64_t statPackets;
+	uint64_t statBytes;
+	uint64_t statEvicted;
+	uint32_t statExtractions;
+
+	void makeRoom(uint64_t length);
+	static void setIndexBits(uint64_t* bitmap, uint32_t key);
+	static bool testIndexBits(const uint64_t* bitmap, uint32_t key);
+	static uint32_t indexKey(uint32_t ip, uint16_t port);
+	static void* requestThread(void* data);
+	void processRequests();
+};
+
+#endif
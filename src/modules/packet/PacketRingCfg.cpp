@@ -0,0 +1,78 @@
+/*
+ * Vermont Configuration Subsystem
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "PacketRingCfg.h"
+
+#include <cassert>
+#include <pcap.h>
+
+PacketRingCfg::PacketRingCfg(XMLElement* elem)
+	: CfgHelper<PacketRing, PacketRingCfg>(elem, "packetRing"), size(1024), linkType(DLT_EN10MB)
+{
+	if (!elem) return;
+
+	XMLNode::XMLSet<XMLElement*> set = elem->getElementChildren();
+	for (XMLNode::XMLSet<XMLElement*>::iterator it = set.begin();
+	     it != set.end();
+	     it++) {
+		XMLElement* e = *it;
+
+		if (e->matches("filename")) {
+			fileName = e->getFirstText();
+		} else if (e->matches("size")) {
+			size = getInt64("size", 1024, e);
+			if (size == 0)
+				THROWEXCEPTION("packetRing: size must be greater than 0");
+		} else if (e->matches("linkType")) {
+			int tmp = pcap_datalink_name_to_val(e->getFirstText().c_str());
+			if (tmp == -1) {
+				msg(LOG_ERR, "Found illegal link type");
+			} else {
+				linkType = tmp;
+			}
+		} else if (e->matches("requestDirectory")) {
+			requestDirectory = e->getFirstText();
+		} else if (e->matches("next")) { // ignore next
+		} else {
+			msg(LOG_CRIT, "Unknown packetRing config statement %s\n", e->getName().c_str());
+		}
+	}
+}
+
+PacketRingCfg* PacketRingCfg::create(XMLElement* elem)
+{
+	assert(elem);
+	assert(elem->getName() == getName());
+	return new PacketRingCfg(elem);
+}
+
+PacketRingCfg::~PacketRingCfg()
+{
+}
+
+PacketRing* PacketRingCfg::createInstance()
+{
+	instance = new PacketRing(fileName, size*1024*1024, linkType, requestDirectory);
+	return instance;
+}
+
+bool PacketRingCfg::deriveFrom(PacketRingCfg* old)
+{
+	return false;
+}
@@ -0,0 +1,53 @@
+/*
+ * Vermont Configuration Subsystem
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef PACKETRINGCFG_H_
+#define PACKETRINGCFG_H_
+
+#include "core/Cfg.h"
+#include "modules/packet/PacketRing.h"
+
+#include <string>
+
+
+class PacketRingCfg
+	: public CfgHelper<PacketRing, PacketRingCfg>
+{
+	friend class ConfigManager;
+public:
+	virtual ~PacketRingCfg();
+
+	virtual PacketRingCfg* create(XMLElement* elem);
+
+	virtual PacketRing* createInstance();
+
+	bool deriveFrom(PacketRingCfg* old);
+
+protected:
+	PacketRingCfg(XMLElement* elem);
+
+private:
+	std::string fileName;
+	uint64_t size; /**< in MiB */
+	int linkType;
+	std::string requestDirectory;
+};
+
+
+#endif /*PACKETRINGCFG_H_*/
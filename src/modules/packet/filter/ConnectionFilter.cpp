@@ -22,20 +22,22 @@
 
 #include "ConnectionFilter.h"
 
-ConnectionFilter::ConnectionFilter(unsigned Timeout, unsigned bytes, unsigned hashFunctions, unsigned filterSize)
-	:  hashParams(hashFunctions), synFilter(&hashParams, filterSize, false), exportFilter(&hashParams, filterSize, false),
-	  connectionFilter(&hashParams, filterSize, false), timeout(Timeout), exportBytes(bytes), exportControlPackets(true)
+ConnectionFilter::ConnectionFilter(unsigned Timeout, unsigned bytes, unsigned hashFunctions, unsigned filterSize, bool blocked)
+	:  hashParams(hashFunctions), synFilter(&hashParams, filterSize, false, blocked), exportFilter(&hashParams, filterSize, false, blocked),
+	  connectionFilter(&hashParams, filterSize, false, blocked), timeout(Timeout), exportBytes(bytes), exportControlPackets(true)
 {
 	msg(LOG_NOTICE, "Created connectionFilter with parameters:");
 	msg(LOG_NOTICE, "\t - %i seconds timeout", timeout);
 	msg(LOG_NOTICE, "\t - %i bytes filter size", filterSize);
 	msg(LOG_NOTICE, "\t - %i hash functions", hashFunctions);
 	msg(LOG_NOTICE, "\t - %i bytes to export", bytes);
+	if (blocked)
+		msg(LOG_NOTICE, "\t - blocked filters");
 }
 
-ConnectionFilter::ConnectionFilter(unsigned Timeout, unsigned bytes, unsigned hashFunctions, unsigned filterSize, unsigned seed)
-	: hashParams(hashFunctions, seed), synFilter(&hashParams, filterSize, false), exportFilter(&hashParams, filterSize, false),
-	connectionFilter(&hashParams, filterSize, false), timeout(Timeout), exportBytes(bytes), exportControlPackets(true)
+ConnectionFilter::ConnectionFilter(unsigned Timeout, unsigned bytes, unsigned hashFunctions, unsigned filterSize, unsigned seed, bool blocked)
+	: hashParams(hashFunctions, seed), synFilter(&hashParams, filterSize, false, blocked), exportFilter(&hashParams, filterSize, false, blocked),
+	connectionFilter(&hashParams, filterSize, false, blocked), timeout(Timeout), exportBytes(bytes), exportControlPackets(true)
 {
 	msg(LOG_NOTICE, "Created connectionFilter with parameters:");
 	msg(LOG_NOTICE, "\t - %i seed", seed);
@@ -43,6 +45,8 @@ ConnectionFilter::ConnectionFilter(unsigned Timeout, unsigned bytes, unsigned ha
 	msg(LOG_NOTICE, "\t - %i bytes filter size", filterSize);
 	msg(LOG_NOTICE, "\t - %i hash functions", hashFunctions);
 	msg(LOG_NOTICE, "\t - %i bytes to export", bytes);
+	if (blocked)
+		msg(LOG_NOTICE, "\t - blocked filters");
 }
 
 bool ConnectionFilter::processPacket(Packet* p)
@@ -64,14 +68,14 @@ bool ConnectionFilter::processPacket(Packet* p)
 		return false;
 	}
 
-	if (*((uint8_t*)p->layer2Start + flagsOffset) & SYN) {
+	if (*((uint8_t*)p->data.netHeader + flagsOffset) & SYN) {
 		DPRINTF_INFO("ConnectionFilter: Got SYN packet");
 		synFilter.set(key.data, key.len, (agetime_t)p->timestamp.tv_sec);
 		DPRINTF_INFO("ConnectionFilter: synFilter saved time %u", synFilter.get(key.data, key.len));
 		return exportControlPackets;
-	} else if (*((uint8_t*)p->layer2Start + flagsOffset) & RST || *((uint8_t*)p->layer2Start + flagsOffset) & FIN) {
+	} else if (*((uint8_t*)p->data.netHeader + flagsOffset) & RST || *((uint8_t*)p->data.netHeader + flagsOffset) & FIN) {
 		
-		DPRINTF_INFO("ConnectionFilter: Got %s packet", *((uint8_t*)p->layer2Start + flagsOffset) & RST?"RST":"FIN");
+		DPRINTF_INFO("ConnectionFilter: Got %s packet", *((uint8_t*)p->data.netHeader + flagsOffset) & RST?"RST":"FIN");
 	
 		exportFilter.set(key.data, key.len, -exportFilter.get(key.data, key.len));
 		connectionFilter.set(key.data, key.len, p->timestamp.tv_sec);
@@ -30,8 +30,12 @@
 
 class ConnectionFilter : public PacketProcessor {
 public:
-	ConnectionFilter(unsigned timeout, unsigned bytes, unsigned hashFunctions, unsigned FilterSize);
-	ConnectionFilter(unsigned timeout, unsigned bytes, unsigned hashFunctions, unsigned FilterSize, unsigned seed);
+	/**
+	 * blocked filters place all probes of a connection into one cache line
+	 * of each filter, see BloomFilterBase
+	 */
+	ConnectionFilter(unsigned timeout, unsigned bytes, unsigned hashFunctions, unsigned FilterSize, bool blocked = false);
+	ConnectionFilter(unsigned timeout, unsigned bytes, unsigned hashFunctions, unsigned FilterSize, unsigned seed, bool blocked = false);
 
 	virtual bool processPacket(Packet* p);
 	void setExportControlPackets(bool e) { exportControlPackets = e; }
@@ -43,20 +43,10 @@ FilterModule::~FilterModule()
  */
 void FilterModule::receive(Packet* p)
 {
-	vector<PacketProcessor *>::iterator it;
-
-	// set to true so packet is always pushed to receiver
-	// even if the processors-iterator below is NULL
-	bool keepPacket=true;
-
 	DPRINTF_DEBUG( "FilterModule: got packet");
 
 	// run packet through all packetProcessors
-	for (it = processors.begin();
-	     it != processors.end() && keepPacket; ++it)
-	{
-		keepPacket = (*it)->processPacket(p);
-	}
+	bool keepPacket = program.run(p);
 
 	// check if we passed all filters
 	if (keepPacket) {
@@ -80,6 +70,7 @@ bool FilterModule::hasReceiver()
 void FilterModule::addProcessor(PacketProcessor *p)
 {
 	processors.push_back(p);
+	program.compile(processors);
 }
 
 std::vector<PacketProcessor *> FilterModule::getProcessors()
@@ -93,6 +84,7 @@ std::vector<PacketProcessor *> FilterModule::getProcessors()
 std::string FilterModule::getStatisticsXML(double interval)
 {
 	ostringstream oss;
+	oss << program.getStatisticsXML();
 	for (vector<PacketProcessor *>::iterator it = processors.begin(); it != processors.end(); ++it) {
 		oss << (*it)->getStatisticsXML(interval);
 	}
@@ -30,6 +30,7 @@
 #include "core/Destination.h"
 #include "core/Source.h"
 #include "modules/packet/filter/PacketProcessor.h"
+#include "modules/packet/filter/FilterProgram.h"
 
 class FilterModule
 	: public Module, public Source<Packet*>, public Destination<Packet*>
@@ -48,6 +49,7 @@ public:
 
 private:
 	std::vector<PacketProcessor* > processors;
+	FilterProgram program; /**< processors compiled by addProcessor() */
 };
 
 #endif
@@ -0,0 +1,178 @@
+/*
+ * Vermont Packet Filter
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include "FilterProgram.h"
+#include "IPHeaderFilter.h"
+#include "SystematicSampler.h"
+#include "RandomSampler.h"
+
+#include <string.h>
+#include <sstream>
+
+template <int CMP>
+static inline bool compareValues(int srcvalue, int dstvalue)
+{
+	switch (CMP) {
+		case CMP_LT:
+			return srcvalue < dstvalue;
+		case CMP_LE:
+			return srcvalue <= dstvalue;
+		case CMP_EQ:
+			return srcvalue == dstvalue;
+		case CMP_GE:
+			return srcvalue >= dstvalue;
+		case CMP_GT:
+			return srcvalue > dstvalue;
+		case CMP_NE:
+			return srcvalue != dstvalue;
+		case CMP_BIT:
+			return (srcvalue & dstvalue) != 0;
+	}
+	return false;
+}
+
+/**
+ * evaluates an IPHeaderFilter, T has the size of the compared field
+ */
+template <bool TRANSPORT, typename T, int CMP>
+static bool compareHeader(FilterProgram::Step& step, Packet* p)
+{
+	const unsigned char* start = p->data.netHeader;
+	if (TRANSPORT) {
+		start = p->transportHeader;
+		if (start == NULL)
+			return false;
+	}
+	T field;
+	memcpy(&field, start + step.offset, sizeof(field));
+	return compareValues<CMP>(field, step.value);
+}
+
+template <bool TRANSPORT, typename T>
+static FilterProgram::Evaluate selectComparison(int comparison)
+{
+	switch (comparison) {
+		case CMP_LT:
+			return compareHeader<TRANSPORT, T, CMP_LT>;
+		case CMP_LE:
+			return compareHeader<TRANSPORT, T, CMP_LE>;
+		case CMP_EQ:
+			return compareHeader<TRANSPORT, T, CMP_EQ>;
+		case CMP_GE:
+			return compareHeader<TRANSPORT, T, CMP_GE>;
+		case CMP_GT:
+			return compareHeader<TRANSPORT, T, CMP_GT>;
+		case CMP_NE:
+			return compareHeader<TRANSPORT, T, CMP_NE>;
+		case CMP_BIT:
+			return compareHeader<TRANSPORT, T, CMP_BIT>;
+	}
+	return NULL;
+}
+
+template <bool TRANSPORT>
+static FilterProgram::Evaluate selectSize(int size, int comparison)
+{
+	switch (size) {
+		case 1:
+			return selectComparison<TRANSPORT, unsigned char>(comparison);
+		case 2:
+			return selectComparison<TRANSPORT, unsigned short>(comparison);
+		case 4:
+			return selectComparison<TRANSPORT, int>(comparison);
+	}
+	return NULL;
+}
+
+bool FilterProgram::sampleCount(Step& step, Packet*)
+{
+	SystematicSampler* s = static_cast<SystematicSampler*>(step.processor);
+	s->packetCount++;
+	return (s->packetCount % s->interval) < s->samplingOnTime;
+}
+
+bool FilterProgram::sampleRandom(Step& step, Packet*)
+{
+	return static_cast<RandomSampler*>(step.processor)->sample();
+}
+
+bool FilterProgram::processOpaque(Step& step, Packet* p)
+{
+	return step.processor->processPacket(p);
+}
+
+FilterProgram::FilterProgram()
+	: statPackets(0)
+{
+}
+
+void FilterProgram::compile(const std::vector<PacketProcessor*>& processors)
+{
+	steps.clear();
+	statPackets = 0;
+	for (size_t i = 0; i < processors.size(); i++) {
+		Step step;
+		step.evaluate = NULL;
+		step.processor = processors[i];
+		step.type = "processor";
+		step.offset = 0;
+		step.value = 0;
+		step.dropped = 0;
+
+		IPHeaderFilter* header = dynamic_cast<IPHeaderFilter*>(processors[i]);
+		SystematicSampler* systematic = dynamic_cast<SystematicSampler*>(processors[i]);
+		RandomSampler* random = dynamic_cast<RandomSampler*>(processors[i]);
+		if (header) {
+			step.type = "IPHeaderFilter";
+			step.offset = header->m_offset;
+			step.value = header->m_value;
+			if (header->m_header == 2) {
+				step.evaluate = selectSize<true>(header->m_size, header->m_comparison);
+			} else {
+				step.evaluate = selectSize<false>(header->m_size, header->m_comparison);
+			}
+		} else if (systematic) {
+			step.type = "SystematicSampler";
+			if (systematic->samplingType == SYSTEMATIC_SAMPLER_COUNT_BASED && systematic->interval > 0)
+				step.evaluate = sampleCount;
+		} else if (random) {
+			step.type = "RandomSampler";
+			step.evaluate = sampleRandom;
+		}
+		// everything not specialised above keeps its own implementation
+		if (!step.evaluate)
+			step.evaluate = processOpaque;
+		steps.push_back(step);
+	}
+}
+
+std::string FilterProgram::getStatisticsXML()
+{
+	std::ostringstream oss;
+	uint64_t received = statPackets;
+	for (size_t i = 0; i < steps.size(); i++) {
+		uint64_t dropped = steps[i].dropped;
+		oss << "<stage index=\"" << i << "\" type=\"" << steps[i].type << "\">";
+		oss << "<passed type=\"packets\">" << received - dropped << "</passed>";
+		oss << "<dropped type=\"packets\">" << dropped << "</dropped>";
+		oss << "</stage>";
+		received -= dropped;
+	}
+	return oss.str();
+}
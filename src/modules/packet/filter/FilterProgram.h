@@ -0,0 +1,86 @@
+/*
+ * Vermont Packet Filter
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#ifndef FILTERPROGRAM_H
+#define FILTERPROGRAM_H
+
+#include "modules/packet/filter/PacketProcessor.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * The chain of PacketProcessors of a FilterModule, compiled into a flat
+ * array of steps.
+ *
+ * Every step calls a plain function which has been chosen when compiling.
+ * IPHeaderFilters become comparisons specialised for their header, size and
+ * comparison, so no switch is left on the packet path. The samplers are
+ * evaluated inline on their own state. All other processors remain opaque
+ * steps which call processPacket().
+ * The program counts the packets dropped by every step, the packets passed
+ * follow from these counters.
+ */
+class FilterProgram
+{
+public:
+	struct Step;
+	typedef bool (*Evaluate)(Step& step, Packet* p);
+
+	struct Step {
+		Evaluate evaluate;
+		PacketProcessor* processor;
+		const char* type;
+		int offset; /**< offset and value of header comparisons */
+		int value;
+		uint64_t dropped;
+	};
+
+	FilterProgram();
+
+	void compile(const std::vector<PacketProcessor*>& processors);
+
+	/**
+	 * returns true if the packet passes all steps
+	 */
+	bool run(Packet* p)
+	{
+		statPackets++;
+		for (std::vector<Step>::iterator it = steps.begin(); it != steps.end(); ++it) {
+			if (!it->evaluate(*it, p)) {
+				it->dropped++;
+				return false;
+			}
+		}
+		return true;
+	}
+
+	std::string getStatisticsXML();
+
+private:
+	std::vector<Step> steps;
+	uint64_t statPackets;
+
+	static bool sampleCount(Step& step, Packet* p);
+	static bool sampleRandom(Step& step, Packet* p);
+	static bool processOpaque(Step& step, Packet* p);
+};
+
+#endif
@@ -18,43 +18,49 @@
  */
 
 #include "HostFilter.h"
-#include "common/Misc.h"
 
-#define IPV4_ADDRESS_BYTE_LENGTH	4		// Bytes
 #define IPV4_SRC_IP_OFFSET			12
 #define IPV4_DST_IP_OFFSET			16
+#define IPV6_SRC_IP_OFFSET			8
+#define IPV6_DST_IP_OFFSET			24
 
 
-HostFilter::HostFilter(std::string addrFilter, std::set<uint32_t> ipList)
-	: addrFilter(addrFilter), ipList(ipList)
+HostFilter::HostFilter(const std::string& addrFilter, PrefixSet& ipv4, PrefixSet& ipv6)
+	: matchSource(addrFilter == "src" || addrFilter == "both"),
+	  matchDestination(addrFilter == "dst" || addrFilter == "both"),
+	  ipv4(4),
+	  ipv6(16)
 {
+	if (!matchSource && !matchDestination)
+		THROWEXCEPTION("Unknown hostFilter config statement %s", addrFilter.c_str());
+	setPrefixes(ipv4, ipv6);
 }
 
+void HostFilter::setPrefixes(PrefixSet& ipv4, PrefixSet& ipv6)
+{
+	if (ipv4.getAddressLength() != 4 || ipv6.getAddressLength() != 16)
+		THROWEXCEPTION("HostFilter: prefixes of wrong address family");
+	this->ipv4.swap(ipv4);
+	this->ipv6.swap(ipv6);
+}
 
 bool HostFilter::processPacket(Packet *p)
 {
-	// if no IPv4 Packet
-	if ((p->classification & PCLASS_NET_IP4)==0)
-	{
-		msg(LOG_WARNING, "false?");
-		return false;
-	}
-	// srcIP
-	uint32_t srcIp;
-	memcpy(&srcIp, p->data.netHeader+IPV4_SRC_IP_OFFSET, sizeof(srcIp));
-	msg(LOG_WARNING, "srcip: %X, %s", srcIp, IPToString(srcIp).c_str());
-	// dstIP
-	uint32_t dstIp;
-	memcpy(&dstIp, p->data.netHeader+IPV4_DST_IP_OFFSET, sizeof(dstIp));
-
-	if (addrFilter == "src") {
-		return (ipList.find(srcIp) != ipList.end());
-	} else if (addrFilter == "dst") {
-		return (ipList.find(dstIp) != ipList.end());
-	} else if (addrFilter == "both") {
-		return ((ipList.find(srcIp) != ipList.end()) || (ipList.find(dstIp) != ipList.end()));
+	const PrefixSet* prefixes;
+	const uint8_t* srcIp;
+	const uint8_t* dstIp;
+
+	if (p->classification & PCLASS_NET_IP4) {
+		prefixes = &ipv4;
+		srcIp = p->data.netHeader + IPV4_SRC_IP_OFFSET;
+		dstIp = p->data.netHeader + IPV4_DST_IP_OFFSET;
+	} else if (p->classification & PCLASS_NET_IP6) {
+		prefixes = &ipv6;
+		srcIp = p->data.netHeader + IPV6_SRC_IP_OFFSET;
+		dstIp = p->data.netHeader + IPV6_DST_IP_OFFSET;
 	} else {
-		msg(LOG_CRIT, "Unknown hostFilter config statement %s\n", addrFilter.c_str());
 		return false;
 	}
+
+	return (matchSource && prefixes->contains(srcIp)) || (matchDestination && prefixes->contains(dstIp));
 }
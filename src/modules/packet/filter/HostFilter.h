@@ -20,19 +20,37 @@
 #ifndef HOSTFILTER_H_
 #define HOSTFILTER_H_
 
-#include <set>
+#include <string>
+#include "common/PrefixSet.h"
 #include "PacketProcessor.h"
 
+/**
+ * passes IPv4 and IPv6 packets whose source address, destination address or
+ * any of both is covered by one of the configured prefixes
+ */
 class HostFilter : public PacketProcessor
 {
 public:
-	HostFilter(std::string addrfilter, std::set<uint32_t> iplist);
+	/**
+	 * @param addrFilter "src", "dst" or "both"
+	 * @param ipv4 IPv4 prefixes, which are moved into the filter
+	 * @param ipv6 IPv6 prefixes, which are moved into the filter
+	 */
+	HostFilter(const std::string& addrFilter, PrefixSet& ipv4, PrefixSet& ipv6);
 
 	bool processPacket(Packet *p);
 
+	/**
+	 * replaces the prefixes on reconfiguration, the given sets receive the
+	 * old ones
+	 */
+	void setPrefixes(PrefixSet& ipv4, PrefixSet& ipv6);
+
 private:
-	std::string addrFilter;
-	std::set<uint32_t> ipList;
+	bool matchSource;
+	bool matchDestination;
+	PrefixSet ipv4;
+	PrefixSet ipv6;
 };
 
 #endif /*HOSTFILTER_H_*/
@@ -87,6 +87,8 @@ public:
 
 	virtual bool processPacket(Packet *p);
 
+	friend class FilterProgram;
+
 protected:
 	bool compareValues(int srcvalue, int dstvalue);
 	int getData(void *data, int size);
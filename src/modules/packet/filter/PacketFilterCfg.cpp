@@ -25,6 +25,8 @@
 #include <modules/packet/filter//RegExFilter.h>
 #include <modules/packet/filter//StringFilter.h>
 #include <modules/packet/filter//SystematicSampler.h>
+#include <modules/packet/filter//RandomSampler.h>
+#include <modules/packet/filter//IPHeaderFilter.h>
 #include <modules/packet/filter//StateConnectionFilter.h>
 #include <modules/packet/filter//ConnectionFilter.h>
 #include <modules/packet/filter//AnonFilter.h>
@@ -32,12 +34,15 @@
 #include <modules/packet/filter//HostFilter.h>
 
 #include "common/msg.h"
+#include "common/PrefixSet.h"
 #include <netdb.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #include <cassert>
+#include <climits>
+#include <sstream>
 
 
 PacketFilterCfg::PacketFilterCfg(XMLElement* elem)
@@ -68,6 +73,12 @@ PacketFilterCfg::PacketFilterCfg(XMLElement* elem)
 		} else if (e->matches("timeBased")) {
 			msg(LOG_NOTICE, "Filter: Creating time based sampler");
 			c = new PacketTimeFilterCfg(e);
+		} else if (e->matches("randomBased")) {
+			msg(LOG_NOTICE, "Filter: Creating random sampler");
+			c = new PacketRandomFilterCfg(e);
+		} else if (e->matches("ipHeaderBased")) {
+			msg(LOG_NOTICE, "Filter: Creating IP header based filter");
+			c = new PacketIPHeaderFilterCfg(e);
 		} else if (e->matches("stateConnectionBased")) {
 			msg(LOG_NOTICE, "Filter: Creating state connection based sampler");
 			c = new PacketStateConnectionFilterCfg(e);
@@ -135,6 +146,50 @@ bool PacketFilterCfg::deriveFrom(PacketFilterCfg* old)
 	return true;
 }
 
+std::string PacketFilterCfg::getCaptureFilter()
+{
+	std::string expression;
+	for (size_t i = 0; i < subCfgs.size(); i++) {
+		PacketFilterHelperCfg* cfg = dynamic_cast<PacketFilterHelperCfg*>(subCfgs[i]);
+		std::string e = cfg ? cfg->getCaptureFilter() : "";
+		if (e.empty())
+			break;
+		expression += (expression.empty() ? "(" : " and (") + e + ")";
+	}
+	if (expression.empty())
+		return "";
+
+	// the filters are only translated for IPv4, all other packets are passed
+	return "not ip or (" + expression + ")";
+}
+
+std::vector<Cfg*> PacketFilterCfg::takeHeaderStage()
+{
+	size_t n = 0;
+	while (n < subCfgs.size()) {
+		PacketFilterHelperCfg* cfg = dynamic_cast<PacketFilterHelperCfg*>(subCfgs[n]);
+		if (!cfg || !cfg->isHeaderOnly())
+			break;
+		n++;
+	}
+
+	std::vector<Cfg*> stage(subCfgs.begin(), subCfgs.begin() + n);
+	subCfgs.erase(subCfgs.begin(), subCfgs.begin() + n);
+	return stage;
+}
+
+void PacketFilterCfg::transferInstance(Cfg* other)
+{
+	CfgHelper<FilterModule, PacketFilterCfg>::transferInstance(other);
+
+	PacketFilterCfg* old = dynamic_cast<PacketFilterCfg*>(other);
+	for (size_t i = 0; i < subCfgs.size(); i++) {
+		HostFilterCfg* host = dynamic_cast<HostFilterCfg*>(subCfgs[i]);
+		if (host)
+			host->transferInstance(old->subCfgs[i]);
+	}
+}
+
 
 PacketFilterHelperCfg::PacketFilterHelperCfg(XMLElement *e)
 	: Cfg(e)
@@ -142,6 +197,37 @@ PacketFilterHelperCfg::PacketFilterHelperCfg(XMLElement *e)
 
 }
 
+/**
+ * parses "address[/length]" of IPv4 or IPv6 into address with the bits
+ * behind the prefix cleared, returns false if it is no valid prefix
+ */
+static bool parsePrefix(const std::string& str, int& family, uint8_t* address, unsigned& length)
+{
+	size_t slash = str.find('/');
+	std::string addr = str.substr(0, slash);
+	if (inet_pton(AF_INET, addr.c_str(), address) == 1) {
+		family = AF_INET;
+		length = 32;
+	} else if (inet_pton(AF_INET6, addr.c_str(), address) == 1) {
+		family = AF_INET6;
+		length = 128;
+	} else {
+		return false;
+	}
+
+	if (slash != std::string::npos) {
+		std::string len = str.substr(slash + 1);
+		char* end;
+		unsigned long l = strtoul(len.c_str(), &end, 10);
+		if (len.empty() || *end || l > length)
+			return false;
+		length = l;
+	}
+	for (unsigned i = length; i < (family == AF_INET ? 32u : 128u); i++)
+		address[i / 8] &= ~(0x80 >> (i % 8));
+	return true;
+}
+
 HostFilterCfg::HostFilterCfg(XMLElement *e)
 	: PacketFilterHelperCfg(e), instance(NULL)
 {
@@ -155,8 +241,16 @@ HostFilterCfg::HostFilterCfg(XMLElement *e)
 			addrFilter = e->getFirstText();
 		} else if (e->matches("ip")) {
 			std::string ip_str = e->getFirstText();
-			in_addr_t addr = inet_addr(ip_str.c_str());
-			ipList.insert(addr);
+			int family;
+			uint8_t address[16];
+			unsigned length;
+			if (!parsePrefix(ip_str, family, address, length))
+				THROWEXCEPTION("hostBased: invalid address or prefix %s", ip_str.c_str());
+			char str[INET6_ADDRSTRLEN];
+			inet_ntop(family, address, str, sizeof(str));
+			std::ostringstream oss;
+			oss << str << "/" << length;
+			prefixes.insert(oss.str());
 		} else {
 			msg(LOG_CRIT, "Unknown observer config statement %s\n", e->getName().c_str());
 			continue;
@@ -168,17 +262,81 @@ HostFilterCfg::~HostFilterCfg()
 {
 }
 
+void HostFilterCfg::buildPrefixes(PrefixSet& ipv4, PrefixSet& ipv6)
+{
+	for (std::set<std::string>::iterator it = prefixes.begin(); it != prefixes.end(); it++) {
+		int family;
+		uint8_t address[16];
+		unsigned length;
+		parsePrefix(*it, family, address, length);
+		if (family == AF_INET) {
+			ipv4.add(address, length);
+		} else {
+			ipv6.add(address, length);
+		}
+	}
+}
+
 Module* HostFilterCfg::getInstance()
 {
 	if (!instance) {
-		instance = new HostFilter(addrFilter, ipList);
+		PrefixSet ipv4(4);
+		PrefixSet ipv6(16);
+		buildPrefixes(ipv4, ipv6);
+		instance = new HostFilter(addrFilter, ipv4, ipv6);
 	}
 	return (Module*)instance;
 }
 
-std::set<uint32_t> HostFilterCfg::getIpList()
+void HostFilterCfg::transferInstance(Cfg* other)
 {
-	return ipList;
+	HostFilterCfg* old = dynamic_cast<HostFilterCfg*>(other);
+	if (!old)
+		THROWEXCEPTION("Can't transfer HostFilter");
+
+	instance = old->instance;
+	old->instance = NULL;
+	if (instance && prefixes != old->prefixes) {
+		PrefixSet ipv4(4);
+		PrefixSet ipv6(16);
+		buildPrefixes(ipv4, ipv6);
+		instance->setPrefixes(ipv4, ipv6);
+		msg(LOG_NOTICE, "HostFilter: reloaded %u prefixes", (unsigned)prefixes.size());
+	}
+}
+
+std::set<std::string> HostFilterCfg::getPrefixes()
+{
+	return prefixes;
+}
+
+std::string HostFilterCfg::getCaptureFilter()
+{
+	std::string direction;
+	if (addrFilter == "src") {
+		direction = "src ";
+	} else if (addrFilter == "dst") {
+		direction = "dst ";
+	} else if (addrFilter != "both") {
+		return "";
+	}
+	if (prefixes.size() > CAPTURE_FILTER_MAX_HOSTS)
+		return "";
+
+	// only IPv4 prefixes are relevant, IPv6 packets are not filtered by pcap
+	std::string expression;
+	for (std::set<std::string>::iterator it = prefixes.begin(); it != prefixes.end(); it++) {
+		if (it->find(':') != std::string::npos)
+			continue;
+		std::string prefix = *it;
+		if (prefix.compare(prefix.size() - 3, 3, "/32") == 0) {
+			prefix = "host " + prefix.substr(0, prefix.size() - 3);
+		} else {
+			prefix = "net " + prefix;
+		}
+		expression += (expression.empty() ? "" : " or ") + direction + prefix;
+	}
+	return expression;
 }
 
 
@@ -225,6 +383,127 @@ Module* PacketTimeFilterCfg::getInstance()
 
 
 
+PacketRandomFilterCfg::PacketRandomFilterCfg(XMLElement *e)
+	: PacketFilterHelperCfg(e), instance(NULL)
+{
+}
+
+PacketRandomFilterCfg::~PacketRandomFilterCfg()
+{
+
+}
+
+Module* PacketRandomFilterCfg::getInstance()
+{
+	if (!instance)
+		instance = new RandomSampler(getAcceptSize(), getSamplingSize(), getGeometric(), getSeed());
+
+	return (Module*)instance;
+}
+
+
+
+PacketIPHeaderFilterCfg::PacketIPHeaderFilterCfg(XMLElement *e)
+	: PacketFilterHelperCfg(e), instance(NULL)
+{
+	std::string h = get("header");
+	if (h == "ip") {
+		header = 1;
+	} else if (h == "transport") {
+		header = 2;
+	} else {
+		THROWEXCEPTION("ipHeaderBased: unknown header %s, must be ip or transport", h.c_str());
+	}
+	offset = getInt("offset");
+	size = getInt("size");
+	if (size != 1 && size != 2 && size != 4)
+		THROWEXCEPTION("ipHeaderBased: invalid size %d, only 1/2/4 supported", size);
+
+	std::string c = get("comparison");
+	if (c == "lt") {
+		comparison = CMP_LT;
+	} else if (c == "le") {
+		comparison = CMP_LE;
+	} else if (c == "eq") {
+		comparison = CMP_EQ;
+	} else if (c == "ge") {
+		comparison = CMP_GE;
+	} else if (c == "gt") {
+		comparison = CMP_GT;
+	} else if (c == "ne") {
+		comparison = CMP_NE;
+	} else if (c == "bit") {
+		comparison = CMP_BIT;
+	} else {
+		THROWEXCEPTION("ipHeaderBased: unknown comparison %s", c.c_str());
+	}
+	value = getUInt32("value");
+}
+
+PacketIPHeaderFilterCfg::~PacketIPHeaderFilterCfg()
+{
+
+}
+
+/**
+ * IPHeaderFilter compares the fields in memory order with the value in
+ * network byte order, pcap compares in network byte order. Both agree on
+ * single bytes and on equality and bit tests of all sizes.
+ */
+std::string PacketIPHeaderFilterCfg::getCaptureFilter()
+{
+	uint32_t v = value;
+	if (size == 2)
+		v &= 0xffff;
+	if (size != 1 && comparison != CMP_EQ && comparison != CMP_NE && comparison != CMP_BIT)
+		return "";
+	// IPHeaderFilter compares signed integers, pcap unsigned ones
+	if (size == 1 && v > INT_MAX)
+		return "";
+
+	std::ostringstream oss;
+	if (header == 2) {
+		// only the first fragment contains the transport header
+		oss << "(ip[6:2] & 0x1fff) = 0 and ip[(ip[0] & 0xf) * 4 + " << offset << ":" << size << "]";
+	} else {
+		oss << "ip[" << offset << ":" << size << "]";
+	}
+	switch (comparison) {
+		case CMP_LT:
+			oss << " < " << v;
+			break;
+		case CMP_LE:
+			oss << " <= " << v;
+			break;
+		case CMP_EQ:
+			oss << " = " << v;
+			break;
+		case CMP_GE:
+			oss << " >= " << v;
+			break;
+		case CMP_GT:
+			oss << " > " << v;
+			break;
+		case CMP_NE:
+			oss << " != " << v;
+			break;
+		case CMP_BIT:
+			oss << " & " << v << " != 0";
+			break;
+	}
+	return oss.str();
+}
+
+Module* PacketIPHeaderFilterCfg::getInstance()
+{
+	if (!instance)
+		instance = new IPHeaderFilter(header, offset, size, comparison, value);
+
+	return (Module*)instance;
+}
+
+
+
 /** helper function to return the real value of the string (HEX or normal) */
 static std::string getRealValue(XMLElement* e)
 {
@@ -258,6 +537,7 @@ Module* PacketStringFilterCfg::getInstance()
 			continue;
 		}
 	}
+	instance->compile();
 
 	return (Module*)instance;
 }
@@ -287,20 +567,46 @@ bool PacketStringFilterCfg::deriveFrom(PacketStringFilterCfg* old)
 
 Module* PacketRegexFilterCfg::getInstance()
 {
-	if (!instance)
-		instance = new RegExFilter();
+	if (instance)
+		return (Module*)instance;
+
+	instance = new RegExFilter();
+
+	XMLNode::XMLSet<XMLElement*> set = _elem->getElementChildren();
+	for (XMLNode::XMLSet<XMLElement*>::iterator it = set.begin();
+	     it != set.end();
+	     it++) {
+		XMLElement* e = *it;
+
+		if (e->matches("matchPattern")) {
+			instance->addPattern(e->getFirstText());
+		} else {
+			msg(LOG_CRIT, "Unkown regex packet filter config %s\n", e->getName().c_str());
+			continue;
+		}
+	}
+	instance->compile();
 
-	instance->match = get("matchPattern");
-	instance->regcre();
 	return (Module*)instance;
 }
 
 bool PacketRegexFilterCfg::deriveFrom(PacketRegexFilterCfg* old)
 {
-	if (get("matchPattern") == old->get("matchPattern"))
-		return true;
+	XMLNode::XMLSet<XMLElement*> newStatements = this->_elem->getElementChildren();
+	XMLNode::XMLSet<XMLElement*> oldStatements = old->_elem->getElementChildren();
 
-	return false;
+	if (newStatements.size() != oldStatements.size())
+		return false;
+
+	XMLNode::XMLSet<XMLElement*>::iterator itNew = newStatements.begin();
+	XMLNode::XMLSet<XMLElement*>::iterator itOld = oldStatements.begin();
+	for (; itNew != newStatements.end() && itOld != oldStatements.end();
+	     itOld++ , itNew++) {
+		if ((*itOld)->getFirstText() != (*itNew)->getFirstText())
+			return false;
+	}
+
+	return true;
 }
 
 
@@ -311,7 +617,8 @@ Module* PacketStateConnectionFilterCfg::getInstance()
 	if (!instance) {
 		instance = new StateConnectionFilter(
 			getInt("timeout", 3),
-			getInt("bytes", 100));
+			getInt("bytes", 100),
+			getInt("maxConnections", 65536));
 		instance->setExportControlPackets(getBool("exportControlPackets", true));
 	}
 
@@ -320,7 +627,8 @@ Module* PacketStateConnectionFilterCfg::getInstance()
 
 bool PacketStateConnectionFilterCfg::deriveFrom(PacketStateConnectionFilterCfg* old)
 {
-	if (get("timeout") == old->get("timeout") && get("bytes") == old->get("bytes"))
+	if (get("timeout") == old->get("timeout") && get("bytes") == old->get("bytes") &&
+			get("maxConnections") == old->get("maxConnections"))
 		return true;
 	return false;
 }
@@ -337,14 +645,16 @@ Module* PacketConnectionFilterCfg::getInstance()
 				getInt("timeout", 3),
 				getInt("bytes", 100),
 				getInt("hashFunctions", 3),
-				getInt("filterSize", 1000));
+				getInt("filterSize", 1000),
+				getBool("blocked", false));
 		} else {
 			instance = new ConnectionFilter(
 				getInt("timeout", 3),
 				getInt("bytes", 100),
 				getInt("hashFunctions", 3),
 				getInt("filterSize", 1000),
-				seed);
+				seed,
+				getBool("blocked", false));
 		}
 		instance->setExportControlPackets(getBool("exportControlPackets", true));
 	}
@@ -358,7 +668,8 @@ bool PacketConnectionFilterCfg::deriveFrom(PacketConnectionFilterCfg* old)
 	if (get("timeout") == old->get("timeout") &&
 	    get("bytes") == old->get("bytes") &&
 	    get("hashFunctions") == old->get("hashFunctions") &&
-	    get("filterSize") == old->get("filterSize")) {
+	    get("filterSize") == old->get("filterSize") &&
+	    get("blocked") == old->get("blocked")) {
 		return true;
 	}
 	return false;
@@ -387,7 +698,8 @@ bool PacketAnonFilterCfg::deriveFrom(PacketAnonFilterCfg* old)
 	if (get("timeout") == old->get("timeout") &&
 	    get("bytes") == old->get("bytes") &&
 	    get("hashFunctions") == old->get("hashFunctions") &&
-	    get("filterSize") == old->get("filterSize")) {
+	    get("filterSize") == old->get("filterSize") &&
+	    get("blocked") == old->get("blocked")) {
 		return true;
 	}
 	*/
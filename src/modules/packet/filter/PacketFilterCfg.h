@@ -31,13 +31,19 @@
 // forward declaration of instances
 class RegExFilter;
 class HostFilter;
+class PrefixSet;
 class StringFilter;
 class SystematicSampler;
+class RandomSampler;
+class IPHeaderFilter;
 class StateConnectionFilter;
 class ConnectionFilter;
 class AnonFilter;
 class PayloadFilter;
 
+/* maximum number of prefixes of a HostFilter which are evaluated by pcap */
+#define CAPTURE_FILTER_MAX_HOSTS 256
+
 class PacketFilterCfg
 	: public CfgHelper<FilterModule, PacketFilterCfg>
 {
@@ -51,6 +57,24 @@ public:
 
 	virtual bool deriveFrom(PacketFilterCfg* old);
 
+	/**
+	 * returns a pcap filter expression which passes at least all packets
+	 * passed by the leading header filters, or "" if there are none
+	 */
+	std::string getCaptureFilter();
+
+	/**
+	 * removes the leading filters which only look at the headers and returns
+	 * them, so they can be evaluated before the payload of a packet is copied
+	 */
+	std::vector<Cfg*> takeHeaderStage();
+
+	/**
+	 * takes the FilterModule of the old configuration, whose processors are
+	 * updated with settings which can be changed without a new instance
+	 */
+	virtual void transferInstance(Cfg* other);
+
 protected:
 	PacketFilterCfg(XMLElement* e);
 
@@ -61,6 +85,20 @@ private:
 class PacketFilterHelperCfg
 	: public Cfg
 {
+public:
+	/**
+	 * returns a pcap filter expression for IPv4 packets which is equivalent
+	 * to this filter, or "" if the filter cannot be expressed as pcap filter
+	 */
+	virtual std::string getCaptureFilter() { return ""; }
+
+	/**
+	 * returns true if the filter only looks at the first
+	 * PACKET_MAX_HEADER_LENGTH bytes of the IP and transport headers
+	 */
+	virtual bool isHeaderOnly() { return false; }
+
+private:
 
 	/* we have to implement those, because from an implementation standpoint
 	 * the filters could be modules of its own, but as discussed, they where just
@@ -94,7 +132,11 @@ public:
 	virtual std::string getName() { return "hostBased"; }
 
 	virtual std::string getAddrFilter() { return addrFilter; }
-	virtual std::set<uint32_t> getIpList();
+	virtual std::set<std::string> getPrefixes();
+
+	virtual std::string getCaptureFilter();
+
+	virtual bool isHeaderOnly() { return true; }
 
 	virtual Module* getInstance();
 
@@ -108,20 +150,27 @@ public:
 		return false;
 	}
 
+	/**
+	 * changed prefixes are taken over by transferInstance()
+	 */
 	virtual bool deriveFrom(HostFilterCfg* old)
 	{
-		if ((getIpList() != old->getIpList()) || (getAddrFilter() != old->getAddrFilter()))
-			return false;
-
-		return true;
+		return getAddrFilter() == old->getAddrFilter();
 	}
+
+	/**
+	 * takes the HostFilter of the old configuration and replaces its prefixes
+	 */
+	virtual void transferInstance(Cfg* other);
 protected:
 	HostFilterCfg(XMLElement *e);
 
 private:
 	HostFilter* instance;
 	std::string addrFilter;
-	std::set<uint32_t> ipList;
+	std::set<std::string> prefixes; /**< "address/length" with the bits behind the prefix cleared */
+
+	void buildPrefixes(PrefixSet& ipv4, PrefixSet& ipv6);
 };
 
 class PacketCountFilterCfg
@@ -136,6 +185,8 @@ public:
 
 	virtual std::string getName() { return "countBased"; }
 
+	virtual bool isHeaderOnly() { return true; }
+
 	int getInterval() { return getInt("interval", 0); }
 	int getSpacing()  { return getInt("spacing", 0); }
 
@@ -181,6 +232,8 @@ public:
 
 	virtual std::string getName() { return "timeBased"; }
 
+	virtual bool isHeaderOnly() { return true; }
+
 	int getInterval() { return getInt("interval", 0); }
 	int getSpacing()  { return getInt("spacing", 0); }
 
@@ -214,6 +267,96 @@ private:
 };
 
 
+class PacketRandomFilterCfg
+	: public PacketFilterHelperCfg
+{
+public:
+	friend class PacketFilterCfg;
+
+	virtual PacketFilterCfg* create(XMLElement* e) {return NULL; };
+
+	virtual ~PacketRandomFilterCfg();
+
+	virtual std::string getName() { return "randomBased"; }
+
+	virtual bool isHeaderOnly() { return true; }
+
+	int getAcceptSize() { return getInt("acceptSize", 1); }
+	int getSamplingSize() { return getInt("samplingSize", 1); }
+	bool getGeometric() { return getBool("geometric", false); }
+	uint64_t getSeed() { return getInt64("seed", 0); }
+
+	virtual Module* getInstance();
+
+	virtual bool deriveFrom(Cfg* old)
+	{
+		PacketRandomFilterCfg* cfg = dynamic_cast<PacketRandomFilterCfg*>(old);
+		if (cfg)
+			return deriveFrom(cfg);
+
+		THROWEXCEPTION("Can't derive from PacketRandomFilter");
+		return false;
+	}
+
+	virtual bool deriveFrom(PacketRandomFilterCfg* old)
+	{
+		return getAcceptSize() == old->getAcceptSize() && getSamplingSize() == old->getSamplingSize() &&
+			getGeometric() == old->getGeometric() && getSeed() == old->getSeed();
+	}
+protected:
+	PacketRandomFilterCfg(XMLElement *e);
+
+private:
+	RandomSampler* instance;
+};
+
+
+class PacketIPHeaderFilterCfg
+	: public PacketFilterHelperCfg
+{
+public:
+	friend class PacketFilterCfg;
+
+	virtual PacketFilterCfg* create(XMLElement* e) {return NULL; };
+
+	virtual ~PacketIPHeaderFilterCfg();
+
+	virtual std::string getName() { return "ipHeaderBased"; }
+
+	virtual Module* getInstance();
+
+	virtual std::string getCaptureFilter();
+
+	virtual bool isHeaderOnly() { return offset >= 0 && offset + size <= PACKET_MAX_HEADER_LENGTH; }
+
+	virtual bool deriveFrom(Cfg* old)
+	{
+		PacketIPHeaderFilterCfg* cfg = dynamic_cast<PacketIPHeaderFilterCfg*>(old);
+		if (cfg)
+			return deriveFrom(cfg);
+
+		THROWEXCEPTION("Can't derive from PacketIPHeaderFilter");
+		return false;
+	}
+
+	virtual bool deriveFrom(PacketIPHeaderFilterCfg* old)
+	{
+		return header == old->header && offset == old->offset && size == old->size &&
+			comparison == old->comparison && value == old->value;
+	}
+protected:
+	PacketIPHeaderFilterCfg(XMLElement *e);
+
+private:
+	IPHeaderFilter* instance;
+	int header;
+	int offset;
+	int size;
+	int comparison;
+	int value;
+};
+
+
 class PacketStringFilterCfg
 	: public PacketFilterHelperCfg
 {
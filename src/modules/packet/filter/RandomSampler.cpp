@@ -29,50 +29,48 @@
  *
  */
 
-#include <cstdlib>
-#include <ctime>
+#include <cmath>
 
 #include "RandomSampler.h"
 
-RandomSampler::RandomSampler(int n, int N) : samplingSize(N), acceptSize(n), currentPos(0)
+RandomSampler::RandomSampler(int n, int N, bool geometric, uint64_t seed)
+        : samplingSize(N), acceptSize(n), currentPos(0), geometric(geometric), invLogQ(0), skip(0), random(seed)
 {
-        int pos;
-
         if(n > N) {
                 msg(LOG_ERR, "%d out-of %d makes no sense - exchanging values", n, N);
 
                 samplingSize = n;
                 acceptSize = N;
-                N=n;
         }
+        if (acceptSize < 0 || samplingSize <= 0)
+                THROWEXCEPTION("RandomSampler: invalid sampling of %d out of %d packets", n, N);
 
-        sampleMask.clear();
-        sampleMask.insert(sampleMask.begin(), N, false);
-
-        srand(time(0));
+        sampleMask.assign(samplingSize, false);
 
-        /*
-         setup sampling bitfield
-         TODO: There might be a more elegant solution to this...
-         */
-        for(int i = 0; i < acceptSize; i++) {
-                /*
-                 find a free spot in the sampleMask (i.e. a position
-                 with FALSE in it) and set it to TRUE
-                 */
-                do {
-                        pos = rand() % samplingSize;
-                } while(sampleMask[pos]);
+        if (acceptSize < samplingSize)
+                invLogQ = 1.0 / log1p(-(double)acceptSize / samplingSize);
+        if (acceptSize == 0)
+                skip = UINT64_MAX;
+        else
+                skip = random.geometric(invLogQ);
+}
 
+/*
+ selects acceptSize distinct positions of the next N packets with one random
+ number per position (Floyd's algorithm)
+ */
+void RandomSampler::drawMask()
+{
+        sampleMask.assign(samplingSize, false);
+        for (int j = samplingSize - acceptSize; j < samplingSize; j++) {
+                int pos = random.below(j + 1);
+                if (sampleMask[pos])
+                        pos = j;
                 sampleMask[pos] = true;
         }
 }
 
 bool RandomSampler::processPacket(Packet *p)
 {
-        bool accepted = sampleMask[currentPos];
-
-        currentPos = (currentPos + 1) % samplingSize;
-
-        return accepted;
+        return sample();
 }
@@ -37,18 +37,29 @@
 #include <vector>
 
 #include "common/msg.h"
+#include "common/Xoshiro256.h"
 #include "PacketProcessor.h"
 
 class RandomSampler : public PacketProcessor
 {
 public:
-        RandomSampler(int n, int N);
+        /*
+         constructs a random n-out-of-N sampler, which accepts exactly n random
+         packets out of every N consecutive packets. If geometric is set, every
+         packet is accepted with probability n/N instead and the sampler only
+         draws the number of packets to skip after each accepted packet.
+         seed 0 chooses a random seed, other seeds make the sampling
+         reproducible.
+         */
+        RandomSampler(int n, int N, bool geometric = false, uint64_t seed = 0);
 	virtual ~RandomSampler()
 	{
 	};
 	
         virtual bool processPacket(Packet *p);
 
+        friend class FilterProgram;
+
 protected:
         /* N */
         int samplingSize;
@@ -56,6 +67,31 @@ protected:
         int acceptSize;
         int currentPos;
         std::vector<bool> sampleMask;
+
+        bool geometric;
+        double invLogQ;
+        uint64_t skip;
+        Xoshiro256 random;
+
+        bool sample()
+        {
+                if (geometric) {
+                        if (skip > 0) {
+                                skip--;
+                                return false;
+                        }
+                        skip = random.geometric(invLogQ);
+                        return true;
+                }
+                if (currentPos == 0)
+                        drawMask();
+                bool accepted = sampleMask[currentPos];
+                if (++currentPos == samplingSize)
+                        currentPos = 0;
+                return accepted;
+        }
+
+        void drawMask();
 };
 
 #endif
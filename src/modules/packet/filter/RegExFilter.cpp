@@ -22,31 +22,156 @@
 #include "RegExFilter.h"
 
 
-inline bool RegExFilter::compare(char *pdata)
+/* evaluates the expressions whose literal prefix occurs in the payload */
+struct RegExFilterScan
 {
+	const unsigned char* data;
+	const unsigned char* end;
+	const MultiPatternMatcher& prefixes;
+	const std::vector<unsigned>& prefixExpression;
+	const std::vector<boost::regex>& expressions;
+	std::vector<uint32_t>& lastTried;
+	uint32_t scan;
+	bool matched;
 
-	if (boost::regex_search(pdata, rexp)) {
-		return true;
-	} 
+	RegExFilterScan(const unsigned char* data, const unsigned char* end, const MultiPatternMatcher& prefixes,
+			const std::vector<unsigned>& prefixExpression, const std::vector<boost::regex>& expressions,
+			std::vector<uint32_t>& lastTried, uint32_t scan)
+		: data(data), end(end), prefixes(prefixes), prefixExpression(prefixExpression),
+		  expressions(expressions), lastTried(lastTried), scan(scan), matched(false)
+	{
+	}
 
-	return false;
+	bool operator()(unsigned id, size_t prefixEnd)
+	{
+		unsigned e = prefixExpression[id];
+		if (lastTried[e] == scan)
+			return true;
+		lastTried[e] = scan;
 
+		// a match begins with the prefix, so it cannot begin before its first occurrence
+		size_t start = prefixEnd - prefixes.pattern(id).size();
+		boost::match_flag_type flags = boost::match_default;
+		if (start > 0)
+			flags = flags | boost::match_prev_avail;
+		matched = boost::regex_search(data + start, end, expressions[e], flags);
+		return !matched;
+	}
+};
+
+RegExFilter::RegExFilter()
+	: scanCount(0)
+{
+}
+
+void RegExFilter::addPattern(const std::string& pattern)
+{
+	expressions.push_back(boost::regex(pattern));
+	lastTried.push_back(0);
+
+	std::string prefix = literalPrefix(pattern);
+	if (prefix.empty()) {
+		unprefixed.push_back(expressions.size() - 1);
+	} else {
+		prefixes.addPattern(prefix);
+		prefixExpression.push_back(expressions.size() - 1);
+	}
+}
+
+/**
+ * compiles the literal prefixes of all expressions, has to be called after
+ * the last addPattern() and before the first packet
+ */
+void RegExFilter::compile()
+{
+	prefixes.compile();
+}
+
+/**
+ * returns the literal string every match of pattern begins with, or an empty
+ * string if it cannot be determined
+ */
+std::string RegExFilter::literalPrefix(const std::string& pattern)
+{
+	// alternatives outside of groups may begin with anything
+	int depth = 0;
+	bool inSet = false;
+	for (size_t i = 0; i < pattern.size(); i++) {
+		char c = pattern[i];
+		if (c == '\\') {
+			i++;
+		} else if (inSet) {
+			if (c == ']')
+				inSet = false;
+		} else if (c == '[') {
+			inSet = true;
+			// a ']' directly after '[' or '[^' is part of the set
+			if (i + 1 < pattern.size() && pattern[i + 1] == '^')
+				i++;
+			if (i + 1 < pattern.size() && pattern[i + 1] == ']')
+				i++;
+		} else if (c == '(') {
+			depth++;
+		} else if (c == ')') {
+			depth--;
+		} else if (c == '|' && depth == 0) {
+			return "";
+		}
+	}
+
+	std::string prefix;
+	size_t i = 0;
+	while (i < pattern.size()) {
+		char c = pattern[i];
+		if (c == '\\') {
+			// escaped punctuation is literal, escaped letters and digits are classes or references,
+			// \< \> \` and \' are assertions
+			if (i + 1 >= pattern.size() || isalnum((unsigned char)pattern[i + 1]) || strchr("<>`'", pattern[i + 1]))
+				break;
+			prefix += pattern[i + 1];
+			i += 2;
+		} else if (strchr("^$.|?*+()[]{}", c)) {
+			break;
+		} else {
+			prefix += c;
+			i++;
+		}
+	}
+
+	// the last character is optional if it is followed by a quantifier allowing zero repetitions
+	if (!prefix.empty() && i < pattern.size() && strchr("?*{", pattern[i]))
+		prefix.erase(prefix.size() - 1);
+
+	return prefix;
 }
 
 bool RegExFilter::processPacket(Packet* p)
 {
 	const unsigned char* pdata;
+	unsigned int plength;
 	unsigned int payloadOffset;
-	bool result;
 
 	payloadOffset = p->payloadOffset;
 	if( payloadOffset == 0) return false;
 	pdata = p->data.netHeader + payloadOffset;
+	// data_length includes the layer 2 header, payloadOffset does not
+	if (p->layer2HeaderLen + payloadOffset < p->data_length)
+		plength = p->data_length - p->layer2HeaderLen - payloadOffset;
+	else
+		plength = 0;
 
-	if(pdata == NULL) return false;
-
-	result = compare((char*)pdata);
+	for (size_t i = 0; i < unprefixed.size(); i++) {
+		if (boost::regex_search(pdata, pdata + plength, expressions[unprefixed[i]]))
+			return true;
+	}
 
-	return result;
+	if (++scanCount == 0) {
+		// lastTried holds numbers of previous scans, which are reused now
+		std::fill(lastTried.begin(), lastTried.end(), 0);
+		scanCount = 1;
+	}
+	RegExFilterScan scan(pdata, pdata + plength, prefixes, prefixExpression, expressions, lastTried, scanCount);
+	prefixes.scan(pdata, plength, scan);
 
+	return scan.matched;
 }
@@ -25,43 +25,51 @@
 #ifndef REGEXFILTER_H
 #define REGEXFILTER_H
 
-#include <list>
+#include <vector>
 #include <string>
 #include <string.h>
 #include "common/msg.h"
+#include "common/MultiPatternMatcher.h"
 #include "PacketProcessor.h"
 #include <sys/types.h>
 #include <boost/regex.hpp>
 
 
-
+/**
+ * Passes packets whose payload matches any of the regular expressions.
+ *
+ * Most expressions begin with a literal string. These strings are searched in
+ * a single pass over the payload, and an expression is only evaluated from the
+ * first occurrence of its string on. Expressions without literal prefix are
+ * evaluated for every packet.
+ */
 class RegExFilter
 	: public PacketProcessor
 {
 
 public:
 
-  RegExFilter ()
-  {
-  };
+  RegExFilter ();
 
   virtual ~RegExFilter ()
   {
   };
 
-  void regcre()
-  {
-  	rexp.assign(match);
-  };
+  void addPattern(const std::string& pattern);
+
+  void compile();
 
   virtual bool processPacket (Packet * p);
 
-  int filtertype;
-  std::string match;
-  boost::regex rexp;
+  static std::string literalPrefix(const std::string& pattern);
 
 protected:
-  bool compare (char *data);
+  std::vector<boost::regex> expressions;
+  std::vector<unsigned> unprefixed; /**< expressions without literal prefix */
+  MultiPatternMatcher prefixes;
+  std::vector<unsigned> prefixExpression; /**< by prefix id, the expression it belongs to */
+  std::vector<uint32_t> lastTried; /**< by expression, number of the last scan which evaluated it */
+  uint32_t scanCount;
 
 };
 
@@ -19,23 +19,158 @@
  */
 
 #include "StateConnectionFilter.h"
+#include "common/bloom/BloomHash.h"
 
+#include <string.h>
 #include <iostream>
+#include <sstream>
 
-StateConnectionFilter::StateConnectionFilter(unsigned timeout, unsigned bytes)
-	: exportControlPackets(true)
+/* slots checked for expired connections per packet */
+#define STATE_CONNECTION_FILTER_SWEEP 2
+
+static const uint32_t NOT_FOUND = UINT32_MAX;
+
+StateConnectionFilter::StateConnectionFilter(unsigned timeout, unsigned bytes, uint32_t maxConnections)
+	: exportControlPackets(true),
+	  maxConnections(maxConnections),
+	  connections(0),
+	  sweepPosition(0),
+	  statExpired(0),
+	  statEvicted(0)
 {
+	if (maxConnections == 0 || maxConnections > (1U << 30)) {
+		THROWEXCEPTION("StateConnectionFilter: maximum number of connections must be between 1 and %u", 1U << 30);
+	}
 	this->timeout = timeout;
 	this->exportBytes = bytes;
+
+	// at most half of the slots are used, so probe sequences stay short
+	uint32_t size = 2;
+	while (size < 2 * maxConnections)
+		size <<= 1;
+	Slot empty;
+	memset(&empty, 0, sizeof(empty));
+	table.assign(size, empty);
+	mask = size - 1;
+
 	msg(LOG_NOTICE, "Created stateConnectionFilter with parameters:");
 	msg(LOG_NOTICE, "\t - %i seconds timeout", timeout);
 	msg(LOG_NOTICE, "\t - %i bytes to export", bytes);
+	msg(LOG_NOTICE, "\t - %u connections at most", maxConnections);
 }
 
 StateConnectionFilter::~StateConnectionFilter()
 {
 }
 
+uint32_t StateConnectionFilter::hashKey(const QuintupleKey& key)
+{
+	uint64_t h[2];
+	bloomHash128(key.data, key.len, 0, h);
+	return (uint32_t)h[0];
+}
+
+/**
+ * returns the slot of the connection or NOT_FOUND. An expired connection is
+ * removed and not found.
+ */
+uint32_t StateConnectionFilter::lookup(const QuintupleKey& key, uint32_t hash, uint32_t now)
+{
+	for (uint32_t pos = hash & mask; table[pos].used; pos = (pos + 1) & mask) {
+		Slot& s = table[pos];
+		if (s.hash != hash || memcmp(s.key, key.data, sizeof(s.key)) != 0)
+			continue;
+		if (isExpired(s, now)) {
+			remove(pos);
+			statExpired++;
+			return NOT_FOUND;
+		}
+		return pos;
+	}
+	return NOT_FOUND;
+}
+
+/**
+ * adds a connection which is not in the table and returns its slot
+ */
+uint32_t StateConnectionFilter::insert(const QuintupleKey& key, uint32_t hash, uint32_t now)
+{
+	if (connections >= maxConnections)
+		evictNear(hash);
+
+	uint32_t pos = hash & mask;
+	while (table[pos].used)
+		pos = (pos + 1) & mask;
+	Slot& s = table[pos];
+	s.hash = hash;
+	s.lastSeen = now;
+	s.remaining = 0;
+	s.used = 1;
+	memcpy(s.key, key.data, sizeof(s.key));
+	connections++;
+	return pos;
+}
+
+/**
+ * removes the connection in slot pos. Following connections of the probe
+ * sequence are moved backwards, so lookups never have to skip deleted slots.
+ */
+void StateConnectionFilter::remove(uint32_t pos)
+{
+	uint32_t next = pos;
+	while (true) {
+		next = (next + 1) & mask;
+		if (!table[next].used)
+			break;
+		// a connection may fill the gap if the gap is not before its hash position
+		uint32_t home = table[next].hash & mask;
+		if (((next - home) & mask) >= ((next - pos) & mask)) {
+			table[pos] = table[next];
+			pos = next;
+		}
+	}
+	table[pos].used = 0;
+	connections--;
+}
+
+/**
+ * replaces the least recently seen of the next connections from the hash
+ * position on, the table is at most half full so there always are some
+ */
+void StateConnectionFilter::evictNear(uint32_t hash)
+{
+	uint32_t oldest = NOT_FOUND;
+	uint32_t pos = hash & mask;
+	for (unsigned found = 0; found < STATE_CONNECTION_FILTER_EVICTION_CANDIDATES; pos = (pos + 1) & mask) {
+		if (!table[pos].used)
+			continue;
+		if (oldest == NOT_FOUND || (int32_t)(table[pos].lastSeen - table[oldest].lastSeen) < 0)
+			oldest = pos;
+		found++;
+	}
+	remove(oldest);
+	statEvicted++;
+}
+
+/**
+ * removes expired connections from the next few slots, so connections which
+ * are never seen again do not stay in the table
+ */
+void StateConnectionFilter::sweep(uint32_t now)
+{
+	if (!timeout)
+		return;
+	for (unsigned i = 0; i < STATE_CONNECTION_FILTER_SWEEP; i++) {
+		if (table[sweepPosition].used && isExpired(table[sweepPosition], now)) {
+			// another connection may have been moved into the slot
+			remove(sweepPosition);
+			statExpired++;
+		} else {
+			sweepPosition = (sweepPosition + 1) & mask;
+		}
+	}
+}
+
 bool StateConnectionFilter::processPacket(Packet* p)
 {
 	return processPacket(p, true);
@@ -58,48 +193,66 @@ bool StateConnectionFilter::processPacket(Packet* p, bool connFilterResult)
 		return false;
 	}
 
+	uint32_t now = p->timestamp.tv_sec;
+	sweep(now);
+
 	QuintupleKey key(p);
+	uint32_t hash = hashKey(key);
+	uint32_t pos = lookup(key, hash, now);
 
 	if (*((uint8_t*)p->data.netHeader + flagsOffset) & SYN) {
 		DPRINTF_INFO("StateConnectionFilter: Got SYN packet");
-		if (exportList.find(key) == exportList.end()) {
-			exportList[key] = 0;
+		if (pos == NOT_FOUND) {
+			insert(key, hash, now);
+		} else {
+			table[pos].lastSeen = now;
 		}
 		return exportControlPackets;
 	} else if (*((uint8_t*)p->data.netHeader + flagsOffset) & RST || *((uint8_t*)p->data.netHeader + flagsOffset) & FIN) {
 		DPRINTF_INFO("StateConnectionFilter: Got %s packet", *((uint8_t*)p->data.netHeader + flagsOffset) & RST?"RST":"FIN");
-		if (exportList.find(key) != exportList.end()) {
-			exportList.erase(exportList.find(key));
+		if (pos != NOT_FOUND) {
+			remove(pos);
 		}
 		return exportControlPackets;
 	} else {
 		DPRINTF_INFO("StateConnectionFilter: Got a normal packet");
-		if (exportList.find(key) == exportList.end()) {
+		if (pos == NOT_FOUND) {
 			// unknown connection
 			return false;
-		} else if (exportList[key] > 0) {
-			bool ret = exportList[key]>static_cast<int>(payloadLen)?true:false;
+		}
+		Slot& s = table[pos];
+		s.lastSeen = now;
+		if (s.remaining > 0) {
+			bool ret = s.remaining>static_cast<int>(payloadLen)?true:false;
 			DPRINTF_INFO("StateConnectionFilter: Connection known, exporting packet");
-			exportList[key] -= payloadLen;
-			DPRINTF_INFO("StateConnectionFilter: We have to export %i bytes after exporting this packet", exportList[key]>0?exportList[key]:0);
-			if (exportList[key] <= 0) {
-				exportList.erase(exportList.find(key));
+			s.remaining -= payloadLen;
+			DPRINTF_INFO("StateConnectionFilter: We have to export %i bytes after exporting this packet", s.remaining>0?s.remaining:0);
+			if (s.remaining <= 0) {
+				remove(pos);
 			}
 			return ret;
 		} else {
 			// new established connection
 			bool ret = exportBytes>payloadLen?true:false;
 			if (exportBytes > payloadLen) {
-				exportList[key] = exportBytes - payloadLen;
+				s.remaining = exportBytes - payloadLen;
 			} else {
-				exportList.erase(exportList.find(key));
+				remove(pos);
 			}
 			return ret;
 		}
 	}
-
-	msg(LOG_CRIT, "StateConnectionFilter: SOMTHING IS SCRWED UP, YOU SHOULD NEVER SEE THIS MESSAGE!");
-	return false; // make compiler happy
 }
 
+std::string StateConnectionFilter::getStatisticsXML(double interval)
+{
+	std::ostringstream oss;
 
+	oss << "<StateConnectionFilter>";
+	oss << "<connections>" << connections << "</connections>";
+	oss << "<maxConnections>" << maxConnections << "</maxConnections>";
+	oss << "<expired>" << statExpired << "</expired>";
+	oss << "<evicted>" << statEvicted << "</evicted>";
+	oss << "</StateConnectionFilter>";
+	return oss.str();
+}
@@ -24,25 +24,72 @@
 #include <modules/packet/filter//PacketProcessor.h>
 #include <common/bloom/BloomFilter.h>
 
-#include <map>
 #include <ostream>
+#include <vector>
+
+/* number of connections whose oldest one is replaced if the table is full */
+#define STATE_CONNECTION_FILTER_EVICTION_CANDIDATES 8
 
 class MemStatistics;
 
+/**
+ * Exports the first bytes of the payload of every TCP connection which has
+ * been opened with a SYN packet.
+ *
+ * The state of the connections is kept in an open-addressing hash table with
+ * linear probing, which holds at most maxConnections entries in twice as many
+ * slots. A connection expires if no packet of it has been seen for timeout
+ * seconds of packet time (0 disables expiry). Expired connections are removed
+ * when they are looked up and by a sweep over a few slots per packet. If the
+ * table is full, the least recently seen of the next connections behind the
+ * hash position of a new connection is replaced.
+ */
 class StateConnectionFilter : public PacketProcessor {
 public:
-	StateConnectionFilter(unsigned timeout, unsigned bytes);
+	StateConnectionFilter(unsigned timeout, unsigned bytes, uint32_t maxConnections = 65536);
 	~StateConnectionFilter();
 
 	bool processPacket(Packet* p, bool connFilterResult);
 	virtual bool processPacket(Packet* p);
+	virtual std::string getStatisticsXML(double interval);
 	
 	void setExportControlPackets(bool e) { exportControlPackets = e; }
+
+	uint32_t getConnectionCount() const { return connections; }
+
 protected:
+	struct Slot {
+		uint32_t hash;
+		uint32_t lastSeen; /**< seconds of packet time */
+		int32_t remaining; /**< bytes to export, 0 before the first packet after SYN */
+		uint8_t used;
+		uint8_t key[sizeof(QuintupleKey::data)];
+	};
+
 	unsigned timeout;
 	unsigned exportBytes;
-	std::map<QuintupleKey, int> exportList;
 	bool exportControlPackets;
+
+	std::vector<Slot> table;
+	uint32_t mask;
+	uint32_t maxConnections;
+	uint32_t connections;
+	uint32_t sweepPosition;
+
+	uint64_t statExpired;
+	uint64_t statEvicted;
+
+	bool isExpired(const Slot& s, uint32_t now) const
+	{
+		return timeout && (int32_t)(now - s.lastSeen) > (int32_t)timeout;
+	}
+
+	static uint32_t hashKey(const QuintupleKey& key);
+	uint32_t lookup(const QuintupleKey& key, uint32_t hash, uint32_t now);
+	uint32_t insert(const QuintupleKey& key, uint32_t hash, uint32_t now);
+	void remove(uint32_t pos);
+	void evictNear(uint32_t hash);
+	void sweep(uint32_t now);
 };
 
 #endif
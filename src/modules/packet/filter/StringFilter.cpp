@@ -26,7 +26,39 @@
 #include "StringFilter.h"
 
 
+/* counts the "is" strings found in a payload and stops at the first "isnot" string */
+struct StringFilterScan
+{
+    const std::vector<bool>& notFilter;
+    std::vector<uint32_t>& lastFound;
+    uint32_t scan;
+    unsigned andFilters;
+    unsigned andFound;
+    bool notFound;
+
+    StringFilterScan(const std::vector<bool>& notFilter, std::vector<uint32_t>& lastFound, uint32_t scan,
+	    unsigned andFilters)
+	: notFilter(notFilter), lastFound(lastFound), scan(scan), andFilters(andFilters), andFound(0), notFound(false)
+    {
+    }
+
+    bool operator()(unsigned id, size_t end)
+    {
+	if (lastFound[id] == scan)
+	    return true;
+	lastFound[id] = scan;
+	if (notFilter[id]) {
+	    notFound = true;
+	    return false;
+	}
+	andFound++;
+	// without "isnot" strings the result is known once all "is" strings have been found
+	return andFound < andFilters || andFilters < notFilter.size();
+    }
+};
+
 StringFilter::StringFilter()
+    : andFilterCount(0), scanCount(0)
 {
 }
 
@@ -34,16 +66,32 @@ StringFilter::~StringFilter()
 {
 }
 
-void StringFilter::addandFilter(std::string string)
+void StringFilter::addandFilter(const std::string& string)
 {
-    if(string.size()>0)
-	andFilters.push_back (string);
+    if(string.size()>0) {
+	matcher.addPattern(string);
+	notFilter.push_back(false);
+	lastFound.push_back(0);
+	andFilterCount++;
+    }
+}
+
+void StringFilter::addnotFilter(const std::string& string)
+{
+    if(string.size()>0) {
+	matcher.addPattern(string);
+	notFilter.push_back(true);
+	lastFound.push_back(0);
+    }
 }
 
-void StringFilter::addnotFilter(std::string string)
+/**
+ * compiles the strings, has to be called after the last string has been added
+ * and before the first packet
+ */
+void StringFilter::compile()
 {
-    if(string.size()>0)
-	notFilters.push_back (string);
+    matcher.compile();
 }
 
 std::string StringFilter::hexparser(const std::string input) 
@@ -65,67 +113,28 @@ std::string StringFilter::hexparser(const std::string input)
     return output;
 }
 
-/**
- * compare given String to packet data and check for a match
- * @param pdata Packet payload
- * @param toMatch the String to be matched against the packet
- * @param plength The packetlength
- * @return true on match false otherwise
- */
-inline bool StringFilter::compare(unsigned char *pdata, std::string toMatch, unsigned int plength)
-{
-    unsigned counter=0;
-    char* tmp;
-    unsigned i=0;
-
-    while(i + toMatch.size() <=  plength) 
-    {
-	if ((char)pdata[i] == toMatch[0]) 
-	{
-	    counter = 1;
-	    tmp = (char*)&pdata[i];
-	    for( unsigned int j=1; j < toMatch.size(); j++) 
-	    {
-		if(tmp[j] != toMatch[j]) 
-		    break;
-		counter++;
-	    }
-	    if(counter == toMatch.size())
-		return true;
-	}
-	i++;
-    }
-    return false;
-
-}
-
-/**
- * prepare the Packet for comparefucntion
- * set Pointer to Payload
- * @param p Packet data
- * @return true if packet contains string false otherwise
- */
 bool StringFilter::processPacket(Packet *p)
 {
-    unsigned char* pdata;
+    const unsigned char* pdata;
     unsigned int plength;
     unsigned int payloadOffset;
-    std::vector<std::string>::iterator iti;
 
     payloadOffset = p->payloadOffset;
     if( payloadOffset == 0) return false;
-    pdata = (unsigned char*)p->data.netHeader + payloadOffset;
-    plength = p->data_length - payloadOffset;
-
-    if(pdata == NULL) return false;
-
-    for(iti = andFilters.begin(); iti != andFilters.end(); ++iti)
-	if(!compare(pdata, *iti, plength)) 
-	    return false;
-
-    for(iti = notFilters.begin(); iti != notFilters.end(); ++iti)
-	if(compare(pdata, *iti, plength)) 
-	    return false;
+    pdata = p->data.netHeader + payloadOffset;
+    // data_length includes the layer 2 header, payloadOffset does not
+    if (p->layer2HeaderLen + payloadOffset < p->data_length)
+	plength = p->data_length - p->layer2HeaderLen - payloadOffset;
+    else
+	plength = 0;
+
+    if (++scanCount == 0) {
+	// lastFound holds numbers of previous scans, which are reused now
+	std::fill(lastFound.begin(), lastFound.end(), 0);
+	scanCount = 1;
+    }
+    StringFilterScan scan(notFilter, lastFound, scanCount, andFilterCount);
+    matcher.scan(pdata, plength, scan);
 
-    return true;
+    return !scan.notFound && scan.andFound == andFilterCount;
 }
@@ -28,10 +28,14 @@
 #include <vector>
 #include <string>
 #include "common/msg.h"
+#include "common/MultiPatternMatcher.h"
 #include "PacketProcessor.h"
 
 
-
+/**
+ * Passes packets whose payload contains all "is" strings and none of the
+ * "isnot" strings. All strings are searched in a single pass over the payload.
+ */
 class StringFilter : public PacketProcessor
 {
 public:
@@ -40,14 +44,16 @@ public:
 
 	static std::string hexparser(const std::string input);
 	virtual bool processPacket (Packet * p);
-	void addandFilter(std::string string);
-	void addnotFilter(std::string string);
+	void addandFilter(const std::string& string);
+	void addnotFilter(const std::string& string);
+	void compile();
 
 protected:
-	std::vector<std::string> andFilters;
-	std::vector<std::string> notFilters;
-
-	bool compare (unsigned char *data, std::string toMatch, unsigned int plength);
+	MultiPatternMatcher matcher;
+	std::vector<bool> notFilter; /**< by pattern id, true for "isnot" strings */
+	unsigned andFilterCount;
+	std::vector<uint32_t> lastFound; /**< by pattern id, number of the last scan which found the string */
+	uint32_t scanCount;
 };
 
 #endif
@@ -41,6 +41,8 @@ public:
 	};
 
         virtual bool processPacket(Packet *p);
+
+        friend class FilterProgram;
         virtual std::string getStatisticsXML(double interval);
 
 protected:
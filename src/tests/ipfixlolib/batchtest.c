@@ -0,0 +1,146 @@
+/*
+ * Vermont's Send Batch Test
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include "common/ipfixlolib/ipfixlolib.h"
+#include "common/ipfixlolib/ipfixlolib_config.h"
+#include "common/ipfixlolib/ipfix.h"
+#include "common/msg.h"
+
+#define OBSERVATION_DOMAIN_ID 1
+#define TEMPLATE_ID 260
+#define COLLECTOR_IP_ADDRESS "127.0.0.1"
+#define COLLECTOR_PORT 4749
+#define BATCH_SIZE 4
+
+static uint32_t records[16];
+
+void define_template(ipfix_exporter *exporter) {
+	ipfix_start_template(exporter, TEMPLATE_ID, 1);
+	ipfix_put_template_field(exporter, TEMPLATE_ID, IPFIX_TYPEID_packetDeltaCount, 4, 0);
+	ipfix_end_template(exporter, TEMPLATE_ID);
+}
+
+void send_message(ipfix_exporter *exporter, unsigned n) {
+	unsigned i;
+	ipfix_start_data_set(exporter, htons(TEMPLATE_ID));
+	for (i = 0; i < n; i++) {
+		records[i] = htonl(i);
+		ipfix_put_data_field(exporter, &records[i], sizeof(records[i]));
+	}
+	ipfix_end_data_set(exporter, n);
+	ipfix_send(exporter);
+	/* data has been copied into the batch and may be overwritten */
+	memset(records, 0xff, sizeof(records));
+}
+
+int open_collector_socket() {
+	struct sockaddr_in addr;
+	int s = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(COLLECTOR_PORT);
+	inet_pton(AF_INET, COLLECTOR_IP_ADDRESS, &addr.sin_addr);
+	if (s < 0 || bind(s, (struct sockaddr*)&addr, sizeof(addr))) {
+		fprintf(stderr, "could not open collector socket\n");
+		exit(1);
+	}
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+	return s;
+}
+
+/* returns the number of data messages received, exits on malformed messages */
+int receive_data_messages(int s) {
+	char buf[IPFIX_MAX_PACKETSIZE];
+	ssize_t len;
+	int count = 0;
+	while ((len = recv(s, buf, sizeof(buf), 0)) > 0) {
+		ipfix_header *header = (ipfix_header *)buf;
+		ipfix_set_header *set = (ipfix_set_header *)(buf + sizeof(ipfix_header));
+		if (ntohs(header->length) != len) {
+			fprintf(stderr, "message length %u does not match datagram length %zd\n", ntohs(header->length), len);
+			exit(1);
+		}
+		if (ntohs(set->set_id) != TEMPLATE_ID)
+			continue;
+		uint32_t first = *(uint32_t *)(buf + sizeof(ipfix_header) + sizeof(ipfix_set_header));
+		if (first != 0) {
+			fprintf(stderr, "unexpected record content %08x\n", ntohl(first));
+			exit(1);
+		}
+		count++;
+	}
+	return count;
+}
+
+void expect(int s, int expected) {
+	int received;
+	usleep(100000);
+	received = receive_data_messages(s);
+	if (received != expected) {
+		fprintf(stderr, "received %d data messages, expected %d\n", received, expected);
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv) {
+	int i;
+	int s;
+	ipfix_exporter *exporter;
+	ipfix_aux_config_udp acu = {
+		.mtu = 1500
+	};
+
+	msg_setlevel(LOG_INFO);
+	s = open_collector_socket();
+
+	if (ipfix_init_exporter(IPFIX_PROTOCOL, OBSERVATION_DOMAIN_ID, &exporter)) {
+		fprintf(stderr, "ipfix_init_exporter() failed.\n");
+		exit(1);
+	}
+	if (ipfix_set_send_batch_size(exporter, BATCH_SIZE)) {
+		fprintf(stderr, "ipfix_set_send_batch_size() failed.\n");
+		exit(1);
+	}
+	if (ipfix_add_collector(exporter, COLLECTOR_IP_ADDRESS, COLLECTOR_PORT, UDP, &acu, "")) {
+		fprintf(stderr, "ipfix_add_collector() failed.\n");
+		exit(1);
+	}
+	define_template(exporter);
+
+	for (i = 0; i < BATCH_SIZE - 1; i++)
+		send_message(exporter, i + 1);
+	expect(s, 0);
+	send_message(exporter, BATCH_SIZE);
+	expect(s, BATCH_SIZE);
+
+	send_message(exporter, 2);
+	send_message(exporter, 3);
+	expect(s, 0);
+	ipfix_flush(exporter);
+	expect(s, 2);
+
+	send_message(exporter, 1);
+	ipfix_deinit_exporter(&exporter);
+	expect(s, 1);
+
+	close(s);
+	return 0;
+}
@@ -0,0 +1,172 @@
+/*
+ * Vermont's Exporter Capacity Test
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ */
+
+/*
+ * Uses more collectors, templates and sets per message than the initial
+ * capacities of ipfixlolib provide.
+ */
+
+#include <stdio.h>
+#include <fcntl.h>
+#include "common/ipfixlolib/ipfixlolib.h"
+#include "common/ipfixlolib/ipfixlolib_config.h"
+#include "common/ipfixlolib/ipfix.h"
+#include "common/msg.h"
+
+#define OBSERVATION_DOMAIN_ID 1
+#define FIRST_TEMPLATE_ID 256
+#define COLLECTOR_IP_ADDRESS "127.0.0.1"
+#define COLLECTOR_PORT 4750
+#define NUM_COLLECTORS (IPFIX_INITIAL_COLLECTOR_CAPACITY + 1)
+#define NUM_TEMPLATES (5 * IPFIX_INITIAL_TEMPLATE_CAPACITY)
+#define NUM_SETS (2 * IPFIX_INITIAL_SETS_PER_PACKET + 1)
+
+static uint32_t records[NUM_SETS];
+
+void define_template(ipfix_exporter *exporter, uint16_t template_id) {
+	if (ipfix_start_template(exporter, template_id, 1) ||
+			ipfix_put_template_field(exporter, template_id, IPFIX_TYPEID_packetDeltaCount, 4, 0) ||
+			ipfix_end_template(exporter, template_id)) {
+		fprintf(stderr, "could not define template %u\n", template_id);
+		exit(1);
+	}
+}
+
+/* sends one message with NUM_SETS sets, using all templates in turn */
+void send_message(ipfix_exporter *exporter) {
+	unsigned i;
+	for (i = 0; i < NUM_SETS; i++) {
+		records[i] = htonl(i);
+		if (ipfix_start_data_set(exporter, htons(FIRST_TEMPLATE_ID + i % NUM_TEMPLATES))) {
+			fprintf(stderr, "could not start set %u\n", i);
+			exit(1);
+		}
+		ipfix_put_data_field(exporter, &records[i], sizeof(records[i]));
+		ipfix_end_data_set(exporter, 1);
+	}
+	ipfix_send(exporter);
+}
+
+int open_collector_socket() {
+	struct sockaddr_in addr;
+	int s = socket(AF_INET, SOCK_DGRAM, 0);
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(COLLECTOR_PORT);
+	inet_pton(AF_INET, COLLECTOR_IP_ADDRESS, &addr.sin_addr);
+	if (s < 0 || bind(s, (struct sockaddr*)&addr, sizeof(addr))) {
+		fprintf(stderr, "could not open collector socket\n");
+		exit(1);
+	}
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+	return s;
+}
+
+/*
+ * Receives all pending messages. Counts the template records and data
+ * messages and checks the content of the data sets.
+ */
+void receive_messages(int s, int *templates, int *data_messages) {
+	char buf[IPFIX_MAX_PACKETSIZE];
+	ssize_t len;
+	*templates = 0;
+	*data_messages = 0;
+	usleep(100000);
+	while ((len = recv(s, buf, sizeof(buf), 0)) > 0) {
+		char *p = buf + sizeof(ipfix_header);
+		unsigned sets = 0;
+		while (p + sizeof(ipfix_set_header) <= buf + len) {
+			ipfix_set_header *set = (ipfix_set_header *)p;
+			uint16_t set_id = ntohs(set->set_id);
+			if (set_id == IPFIX_SetId_Template) {
+				/* field count of a withdrawal is zero */
+				if (ntohs(*(uint16_t *)(p + 6)) != 0)
+					(*templates)++;
+			} else {
+				uint32_t value = ntohl(*(uint32_t *)(p + sizeof(ipfix_set_header)));
+				if (set_id != FIRST_TEMPLATE_ID + sets % NUM_TEMPLATES || value != sets) {
+					fprintf(stderr, "unexpected set %u with ID %u and value %u\n", sets, set_id, value);
+					exit(1);
+				}
+				sets++;
+			}
+			p += ntohs(set->length);
+		}
+		if (sets) {
+			if (sets != NUM_SETS) {
+				fprintf(stderr, "received %u sets, expected %u\n", sets, NUM_SETS);
+				exit(1);
+			}
+			(*data_messages)++;
+		}
+	}
+}
+
+void expect(int s, int expected_templates, int expected_data_messages) {
+	int templates, data_messages;
+	receive_messages(s, &templates, &data_messages);
+	if (templates != expected_templates || data_messages != expected_data_messages) {
+		fprintf(stderr, "received %d templates and %d data messages, expected %d and %d\n",
+				templates, data_messages, expected_templates, expected_data_messages);
+		exit(1);
+	}
+}
+
+int main(int argc, char **argv) {
+	int i;
+	int s;
+	ipfix_exporter *exporter;
+	ipfix_aux_config_udp acu = {
+		.mtu = 9000
+	};
+
+	msg_setlevel(LOG_INFO);
+	s = open_collector_socket();
+
+	if (ipfix_init_exporter(IPFIX_PROTOCOL, OBSERVATION_DOMAIN_ID, &exporter)) {
+		fprintf(stderr, "ipfix_init_exporter() failed.\n");
+		exit(1);
+	}
+	for (i = 0; i < NUM_COLLECTORS; i++) {
+		if (ipfix_add_collector(exporter, COLLECTOR_IP_ADDRESS, COLLECTOR_PORT, UDP, &acu, "")) {
+			fprintf(stderr, "ipfix_add_collector() failed for collector %d.\n", i);
+			exit(1);
+		}
+	}
+	for (i = 0; i < NUM_TEMPLATES; i++)
+		define_template(exporter, FIRST_TEMPLATE_ID + i);
+
+	send_message(exporter);
+	expect(s, NUM_COLLECTORS * NUM_TEMPLATES, NUM_COLLECTORS);
+
+	/* withdrawn templates are no longer sent, redefined ones are sent again */
+	ipfix_remove_template(exporter, FIRST_TEMPLATE_ID);
+	ipfix_remove_template(exporter, FIRST_TEMPLATE_ID + 1);
+	define_template(exporter, FIRST_TEMPLATE_ID + 1);
+	ipfix_send(exporter);
+	expect(s, NUM_COLLECTORS * (NUM_TEMPLATES - 1), 0);
+
+	define_template(exporter, FIRST_TEMPLATE_ID);
+	send_message(exporter);
+	expect(s, NUM_COLLECTORS * NUM_TEMPLATES, NUM_COLLECTORS);
+
+	ipfix_deinit_exporter(&exporter);
+	close(s);
+	return 0;
+}
@@ -97,7 +97,7 @@ int main(int argc, char **argv)
 	 proto: transport protocol to use, TCP/UDP/SCTP
 	 *aux_config: protocol dependent parameters
 
-         You can add up to IPFIX_MAX_COLLECTORS collectors.
+         You can add as many collectors as you need.
 	 */
 	ipfix_aux_config_udp aux_config;
 	aux_config.mtu = 1500;
@@ -74,7 +74,7 @@ void print_usage(char *argv0);
 
 
 /*
- You can add up to IPFIX_MAX_COLLECTORS collectors.
+ You can add as many collectors as you need.
 */
 int add_collector(ipfix_exporter *exporter) {
     int ret;
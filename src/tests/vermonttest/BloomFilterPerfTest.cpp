@@ -0,0 +1,109 @@
+#ifdef HAVE_CONNECTION_FILTER
+
+#include "BloomFilterPerfTest.h"
+#include <common/bloom/BloomFilter.h>
+#include <common/bloom/AgeBloomFilter.h>
+#include <common/bloom/CountBloomFilter.h>
+#include <common/Time.h>
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <vector>
+
+#define BLOOMFILTER_PERF_HASHFUNCTIONS 4
+/* filter entries per key */
+#define BLOOMFILTER_PERF_ENTRIES 16
+
+/**
+ * @param fast determines if this test should be performed really fast or slower for performance measurements
+ */
+BloomFilterPerfTest::BloomFilterPerfTest(bool fast)
+{
+	if (fast) {
+		numKeys = 10000;
+	} else {
+		numKeys = 1000000;
+	}
+}
+
+static void createKeys(std::vector<QuintupleKey>& keys, uint32_t firstIp)
+{
+	for (size_t i = 0; i < keys.size(); i++) {
+		keys[i].getQuintuple()->srcIp = firstIp + i;
+		keys[i].getQuintuple()->dstIp = 0x0a000001;
+		keys[i].getQuintuple()->proto = 6;
+		keys[i].getQuintuple()->srcPort = 1024 + i % 50000;
+		keys[i].getQuintuple()->dstPort = 80;
+	}
+}
+
+static void printTime(const char* name, const char* op, struct timeval& start, size_t count)
+{
+	struct timeval stop, diff;
+	REQUIRE(gettimeofday(&stop, 0) == 0);
+	REQUIRE(timeval_subtract(&diff, &stop, &start) == 0);
+	double ns = (diff.tv_sec * 1000000.0 + diff.tv_usec) * 1000.0 / count;
+	printf("%s: %s of %lu keys: %d.%06d seconds, %.1f ns per key\n", name, op, (unsigned long)count,
+			(int)diff.tv_sec, (int)diff.tv_usec, ns);
+}
+
+/**
+ * inserts all keys with a value other than 0, looks them up and looks up as
+ * many keys which have not been inserted. Returns the number of false positives.
+ */
+template <class F, class V>
+static size_t measure(const char* name, F& filter, const std::vector<QuintupleKey>& keys,
+		const std::vector<QuintupleKey>& others, V value)
+{
+	struct timeval start;
+	REQUIRE(gettimeofday(&start, 0) == 0);
+	for (size_t i = 0; i < keys.size(); i++)
+		filter.set(keys[i].data, keys[i].len, value);
+	printTime(name, "set", start, keys.size());
+
+	REQUIRE(gettimeofday(&start, 0) == 0);
+	for (size_t i = 0; i < keys.size(); i++)
+		REQUIRE(filter.get(keys[i].data, keys[i].len));
+	printTime(name, "get", start, keys.size());
+
+	size_t falsePositives = 0;
+	for (size_t i = 0; i < others.size(); i++) {
+		if (filter.get(others[i].data, others[i].len))
+			falsePositives++;
+	}
+	printf("%s: %lu false positives in %lu keys\n", name, (unsigned long)falsePositives, (unsigned long)others.size());
+	return falsePositives;
+}
+
+Test::TestResult BloomFilterPerfTest::execTest()
+{
+	std::vector<QuintupleKey> keys(numKeys);
+	std::vector<QuintupleKey> others(numKeys);
+	createKeys(keys, 0xc0a80000);
+	createKeys(others, 0xac100000);
+
+	HashParams hashParams(BLOOMFILTER_PERF_HASHFUNCTIONS);
+	size_t filterSize = numKeys * BLOOMFILTER_PERF_ENTRIES;
+	// the expected false positive rate is (1 - e^(-4/16))^4, about 0.24%.
+	// Blocked counters have only 8 or 16 entries per block and reach 2 to 4%.
+	size_t maxFalsePositives = numKeys / 100;
+	size_t maxBlockedFalsePositives = numKeys / 20;
+
+	for (int blocked = 0; blocked < 2; blocked++) {
+		BloomFilter bf(&hashParams, filterSize, true, blocked);
+		REQUIRE(measure(blocked ? "blocked BloomFilter" : "BloomFilter", bf, keys, others, true)
+				<= maxFalsePositives);
+
+		CountBloomFilter cbf(&hashParams, filterSize, true, blocked);
+		REQUIRE(measure(blocked ? "blocked CountBloomFilter" : "CountBloomFilter", cbf, keys, others, 1)
+				<= (blocked ? maxBlockedFalsePositives : maxFalsePositives));
+
+		AgeBloomFilter abf(&hashParams, filterSize, true, blocked);
+		REQUIRE(measure(blocked ? "blocked AgeBloomFilter" : "AgeBloomFilter", abf, keys, others, time(NULL))
+				<= (blocked ? maxBlockedFalsePositives : maxFalsePositives));
+	}
+
+	return PASSED;
+}
+
+#endif
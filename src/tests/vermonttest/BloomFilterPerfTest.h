@@ -0,0 +1,25 @@
+#ifdef HAVE_CONNECTION_FILTER
+
+#ifndef _BLOOMFILTER_PERF_TEST_H_
+#define _BLOOMFILTER_PERF_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * measures set() and get() of the BloomFilter classes and checks the false
+ * positive rate of their hash functions
+ */
+class BloomFilterPerfTest : public Test
+{
+	public:
+		BloomFilterPerfTest(bool fast);
+		virtual TestResult execTest();
+
+	private:
+		int numKeys;
+};
+
+
+#endif
+
+#endif
@@ -33,10 +33,10 @@ static void setupGlobalKey()
 
 }
 
-static void testBloomFilter()
+static void testBloomFilter(bool blocked)
 {
 	HashParams hashParams(10);
-	BloomFilter* bf = new BloomFilter(&hashParams, 1000);
+	BloomFilter* bf = new BloomFilter(&hashParams, 1000, true, blocked);
 
 	REQUIRE(bf->get(key1.data, key1.len) == false);
 	REQUIRE(bf->get(key1.data, key1.len) == false);
@@ -52,10 +52,10 @@ static void testBloomFilter()
 	delete bf;
 }
 
-static void testCountBloomFilter()
+static void testCountBloomFilter(bool blocked)
 {
 	HashParams hashParams(10);
-	CountBloomFilter* bf = new CountBloomFilter(&hashParams, 1000);
+	CountBloomFilter* bf = new CountBloomFilter(&hashParams, 1000, true, blocked);
 
 	std::cout << "bf(key1) == " << bf->get(key1.data, key1.len) << std::endl;
         REQUIRE(bf->get(key1.data, key1.len) == 0);
@@ -89,10 +89,10 @@ static void testCountBloomFilter()
 	delete bf;
 }
 
-static void testAgeBloomFilter()
+static void testAgeBloomFilter(bool blocked)
 {
 	HashParams hashParams(10);
-	AgeBloomFilter* bf = new AgeBloomFilter(&hashParams, 1000);
+	AgeBloomFilter* bf = new AgeBloomFilter(&hashParams, 1000, true, blocked);
 
 	time_t now = time(NULL);
 	time_t later = now + 10;
@@ -121,13 +121,22 @@ Test::TestResult  BloomFilterTestSuite::execTest()
 	setupGlobalKey();
 
 	std::cout << "Testing BloomFilter..." << std::endl;
-	testBloomFilter();
+	testBloomFilter(false);
 	
 	std::cout << "Testing AgeBloomFilter..." << std::endl;
-	testAgeBloomFilter();
+	testAgeBloomFilter(false);
 
 	std::cout << "Testing CountBloomFilter..." << std::endl;
-	testCountBloomFilter();
+	testCountBloomFilter(false);
+
+	std::cout << "Testing blocked BloomFilter..." << std::endl;
+	testBloomFilter(true);
+
+	std::cout << "Testing blocked AgeBloomFilter..." << std::endl;
+	testAgeBloomFilter(true);
+
+	std::cout << "Testing blocked CountBloomFilter..." << std::endl;
+	testCountBloomFilter(true);
 
 	std::cout << "All tests on all BloomFilter classes passed" << std::endl;
 
@@ -33,18 +33,16 @@ static Packet* getNextPacket(pcap_t* dev)
 	return p;
 }
 
-Test::TestResult ConnectionFilterTestSuite::execTest()
+static void testConnectionFilter(bool blocked)
 {
-	std::cout << "running tests on ConnectionFilter" << std::endl;
-	msg_init();
-	msg_setlevel(100);
 	captureDevice = pcap_open_offline("data/connectionfiltertest.pcap", errorBuffer);
 	if (!captureDevice) {
 		ERROR(errorBuffer);
 	}
 
 	Packet* p;
-	ConnectionFilter connFilter(5, 100, 10, 1000);
+	ConnectionFilter connFilter(5, 100, 10, 1000, blocked);
+	connFilter.setExportControlPackets(false);
 	
 	// first packet is a udp packet
 	p = getNextPacket(captureDevice);
@@ -100,6 +98,17 @@ Test::TestResult ConnectionFilterTestSuite::execTest()
 	REQUIRE(connFilter.processPacket(p) == false); // ACK
 
 	pcap_close(captureDevice);
+}
+
+Test::TestResult ConnectionFilterTestSuite::execTest()
+{
+	std::cout << "running tests on ConnectionFilter" << std::endl;
+	msg_init();
+	msg_setlevel(100);
+	testConnectionFilter(false);
+
+	std::cout << "running tests on blocked ConnectionFilter" << std::endl;
+	testConnectionFilter(true);
 
 	std::cout << "All tests on ConnectionFilter passed" << std::endl;
 
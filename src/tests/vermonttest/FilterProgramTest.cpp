@@ -0,0 +1,181 @@
+#include "FilterProgramTest.h"
+#include "TestPacket.h"
+
+#include <modules/packet/filter/FilterProgram.h>
+#include <modules/packet/filter/IPHeaderFilter.h>
+#include <modules/packet/filter/SystematicSampler.h>
+#include <modules/packet/filter/StringFilter.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <sstream>
+
+FilterProgramTest::FilterProgramTest()
+{
+}
+
+/**
+ * returns an ethernet/IPv4 packet with random addresses, ports and sequence
+ * numbers, which is a TCP packet or, if gre is set, a GRE packet
+ */
+static Packet* createPacket(bool gre)
+{
+	std::string data = TestPacket("195.37.132.190", "91.32.249.51").ports(5003, 1811).tcpFlags(0x18)
+		.payload("GET ").frame();
+	// TOS, identification, TTL, checksum and addresses
+	char* ip = &data[14];
+	ip[1] = rand();
+	ip[4] = rand();
+	ip[5] = rand();
+	ip[8] = rand() % 4 ? ip[8] : rand();
+	for (int i = 10; i < 20; i++)
+		ip[i] = rand() % 4 ? ip[i] : rand();
+	// ports, sequence and acknowledgement numbers
+	for (int i = 20; i < 32; i++)
+		ip[i] = rand() % 4 ? ip[i] : rand();
+	if (gre)
+		ip[9] = 47;
+
+	return TestPacket::create(data);
+}
+
+/**
+ * every combination of header, size and comparison on random fields
+ */
+static void testHeaderComparisons()
+{
+	for (int header = 1; header <= 2; header++) {
+		for (int size = 1; size <= 4; size *= 2) {
+			for (int comparison = CMP_LT; comparison <= CMP_BIT; comparison++) {
+				for (int round = 0; round < 10; round++) {
+					int offset = rand() % 17;
+					int value = rand() % 2 ? rand() % 256 : rand();
+					IPHeaderFilter* filter = new IPHeaderFilter(header, offset, size, comparison, value);
+					std::vector<PacketProcessor*> processors(1, filter);
+					FilterProgram program;
+					program.compile(processors);
+
+					for (int i = 0; i < 50; i++) {
+						Packet* p = createPacket(rand() % 8 == 0);
+						REQUIRE(program.run(p) == filter->processPacket(p));
+						p->removeReference();
+					}
+					delete filter;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * a chain of a compiled filter, a sampler and an opaque filter, the packets
+ * passed by every stage must match the statistics
+ */
+static void testChain()
+{
+	IPHeaderFilter* tcp = new IPHeaderFilter(1, 9, 1, CMP_EQ, 6);
+	SystematicSampler* sampler = new SystematicSampler(SYSTEMATIC_SAMPLER_COUNT_BASED, 3, 2);
+	StringFilter* get = new StringFilter();
+	get->addandFilter("GET");
+	get->compile();
+	std::vector<PacketProcessor*> processors;
+	processors.push_back(tcp);
+	processors.push_back(sampler);
+	processors.push_back(get);
+
+	FilterProgram program;
+	program.compile(processors);
+	SystematicSampler reference(SYSTEMATIC_SAMPLER_COUNT_BASED, 3, 2);
+	uint64_t passed[3] = { 0, 0, 0 };
+	for (int i = 0; i < 1000; i++) {
+		Packet* p = createPacket(rand() % 4 == 0);
+		bool expected = true;
+		for (int stage = 0; stage < 3 && expected; stage++) {
+			PacketProcessor* processor = stage == 1 ? &reference : processors[stage];
+			expected = processor->processPacket(p);
+			if (expected)
+				passed[stage]++;
+		}
+		REQUIRE(program.run(p) == expected);
+		p->removeReference();
+	}
+	REQUIRE(passed[2] > 0);
+
+	std::ostringstream oss;
+	oss << "<stage index=\"0\" type=\"IPHeaderFilter\"><passed type=\"packets\">" << passed[0]
+		<< "</passed><dropped type=\"packets\">" << 1000 - passed[0] << "</dropped></stage>"
+		<< "<stage index=\"1\" type=\"SystematicSampler\"><passed type=\"packets\">" << passed[1]
+		<< "</passed><dropped type=\"packets\">" << passed[0] - passed[1] << "</dropped></stage>"
+		<< "<stage index=\"2\" type=\"processor\"><passed type=\"packets\">" << passed[2]
+		<< "</passed><dropped type=\"packets\">" << passed[1] - passed[2] << "</dropped></stage>";
+	REQUIRE(program.getStatisticsXML() == oss.str());
+
+	for (size_t i = 0; i < processors.size(); i++)
+		delete processors[i];
+}
+
+/**
+ * packets whose headers are copied first and whose payload is copied by
+ * copyPayload() equal packets copied at once, header filters evaluated in
+ * between give the same result
+ */
+static void testHeaderStage()
+{
+	struct timeval now = { 0, 0 };
+	unsigned char data[PCAP_MAX_CAPTURE_LENGTH];
+	IPHeaderFilter http(2, 2, 2, CMP_EQ, 80);
+
+	for (int i = 0; i < 1000; i++) {
+		unsigned int ipHeader = 20 + 4 * (rand() % 11);
+		unsigned int len = 14 + ipHeader + 20;
+		len += rand() % (PCAP_MAX_CAPTURE_LENGTH - len + 1);
+		for (unsigned int k = 0; k < len; k++)
+			data[k] = rand();
+		data[12] = 0x08;
+		data[13] = 0x00;
+		unsigned char* ip = data + 14;
+		ip[0] = 0x40 | (ipHeader / 4);
+		// some packets have layer 2 padding
+		unsigned int ipLength = len - 14 - (rand() % 4 ? 0 : rand() % (len - 14 - ipHeader + 1));
+		ip[2] = ipLength >> 8;
+		ip[3] = ipLength & 0xff;
+		// some packets are later fragments
+		ip[6] = rand() % 4 ? 0 : ip[6] & 0x1f;
+		ip[7] = ip[6] ? ip[7] : 0;
+		ip[9] = rand() % 2 ? 6 : 17;
+		unsigned char* transport = ip + ipHeader;
+		transport[2] = 0;
+		transport[3] = rand() % 2 ? 80 : transport[3];
+		transport[12] = 0x50;
+
+		Packet* full = TestPacket::newPacket();
+		full->init((char*)data, len, now, 0, len, DLT_EN10MB);
+		Packet* staged = TestPacket::newPacket();
+		staged->initHeaders((char*)data, len, now, 0, len, DLT_EN10MB);
+		if (staged->headersComplete(len))
+			REQUIRE(http.processPacket(staged) == http.processPacket(full));
+		staged->copyPayload((char*)data, len, DLT_EN10MB);
+
+		REQUIRE(staged->data_length == full->data_length);
+		REQUIRE(staged->classification == full->classification);
+		REQUIRE(staged->ipProtocolType == full->ipProtocolType);
+		REQUIRE(staged->transportHeaderOffset == full->transportHeaderOffset);
+		REQUIRE(staged->payloadOffset == full->payloadOffset);
+		REQUIRE(memcmp(staged->layer2Start, full->layer2Start, full->data_length) == 0);
+		full->removeReference();
+		staged->removeReference();
+	}
+}
+
+Test::TestResult FilterProgramTest::execTest()
+{
+	std::cout << "Testing FilterProgram..." << std::endl;
+	srand(1);
+	testHeaderComparisons();
+	testChain();
+	testHeaderStage();
+
+	std::cout << "All tests on FilterProgram passed" << std::endl;
+	return PASSED;
+}
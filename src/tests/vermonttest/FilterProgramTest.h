@@ -0,0 +1,17 @@
+#ifndef _FILTERPROGRAM_TEST_H_
+#define _FILTERPROGRAM_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * compares FilterProgram with running the PacketProcessors one by one and
+ * tests the header stage of packet initialization used by two-stage capture
+ */
+class FilterProgramTest : public Test
+{
+	public:
+		FilterProgramTest();
+		virtual TestResult execTest();
+};
+
+#endif
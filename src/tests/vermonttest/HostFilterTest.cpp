@@ -0,0 +1,125 @@
+#include "HostFilterTest.h"
+#include "TestPacket.h"
+
+#include <common/PrefixSet.h>
+#include <modules/packet/filter/HostFilter.h>
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+HostFilterTest::HostFilterTest()
+{
+}
+
+struct Prefix {
+	uint8_t address[16];
+	unsigned length;
+};
+
+static bool covers(const Prefix& prefix, const uint8_t* address)
+{
+	for (unsigned i = 0; i < prefix.length; i++) {
+		uint8_t mask = 0x80 >> (i % 8);
+		if ((prefix.address[i / 8] & mask) != (address[i / 8] & mask))
+			return false;
+	}
+	return true;
+}
+
+/**
+ * compares lookups with a linear search over the prefixes. Addresses and
+ * prefixes share a few leading bytes, so prefixes overlap and nodes are shared.
+ */
+static void testPrefixSet(unsigned addressLength)
+{
+	PrefixSet set(addressLength);
+	std::vector<Prefix> prefixes;
+	uint8_t common[16];
+	for (unsigned i = 0; i < 16; i++)
+		common[i] = rand();
+
+	for (int i = 0; i < 2000; i++) {
+		Prefix p;
+		for (unsigned b = 0; b < addressLength; b++)
+			p.address[b] = (b < 2 && rand() % 2) ? common[b] : (rand() % 4 ? common[b] ^ (rand() % 4) : rand());
+		p.length = rand() % 3 ? 8 * addressLength - rand() % 12 : rand() % (8 * addressLength + 1);
+		prefixes.push_back(p);
+		set.add(p.address, p.length);
+		// lookups with few and with many prefixes
+		if (i != 10 && i != 100 && i != 1999)
+			continue;
+
+		for (int j = 0; j < 5000; j++) {
+			uint8_t address[16];
+			const uint8_t* base = rand() % 2 ? prefixes[rand() % prefixes.size()].address : common;
+			for (unsigned b = 0; b < addressLength; b++)
+				address[b] = rand() % 3 ? base[b] : base[b] ^ (1 << (rand() % 8));
+			bool expected = false;
+			for (size_t k = 0; k < prefixes.size() && !expected; k++)
+				expected = covers(prefixes[k], address);
+			REQUIRE(set.contains(address) == expected);
+		}
+	}
+	REQUIRE(set.size() == prefixes.size());
+}
+
+static bool filter(HostFilter& f, const char* src, const char* dst)
+{
+	Packet* p = TestPacket(src, dst, 17).create();
+	bool result = f.processPacket(p);
+	p->removeReference();
+	return result;
+}
+
+static void testHostFilter()
+{
+	PrefixSet ipv4(4);
+	PrefixSet ipv6(16);
+	uint8_t a[16];
+	inet_pton(AF_INET, "10.0.0.0", a);
+	ipv4.add(a, 8);
+	inet_pton(AF_INET, "192.168.1.17", a);
+	ipv4.add(a, 32);
+	inet_pton(AF_INET6, "2001:db8::", a);
+	ipv6.add(a, 32);
+
+	HostFilter src("src", ipv4, ipv6);
+	REQUIRE(filter(src, "10.1.2.3", "8.8.8.8"));
+	REQUIRE(!filter(src, "8.8.8.8", "10.1.2.3"));
+	REQUIRE(filter(src, "192.168.1.17", "8.8.8.8"));
+	REQUIRE(!filter(src, "192.168.1.18", "8.8.8.8"));
+	REQUIRE(filter(src, "2001:db8:1::1", "2001:4860::1"));
+	REQUIRE(!filter(src, "2001:db9::1", "2001:db8::1"));
+
+	// the sets are empty now, reloading swaps the prefixes back
+	HostFilter both("both", ipv4, ipv6);
+	REQUIRE(!filter(both, "10.1.2.3", "8.8.8.8"));
+	src.setPrefixes(ipv4, ipv6);
+	both.setPrefixes(ipv4, ipv6);
+	REQUIRE(!filter(src, "10.1.2.3", "8.8.8.8"));
+	REQUIRE(filter(both, "10.1.2.3", "8.8.8.8"));
+	REQUIRE(filter(both, "8.8.8.8", "10.1.2.3"));
+	REQUIRE(filter(both, "2001:4860::1", "2001:db8::1"));
+	REQUIRE(!filter(both, "8.8.8.8", "8.8.4.4"));
+
+	HostFilter dst("dst", ipv4, ipv6);
+	both.setPrefixes(ipv4, ipv6);
+	dst.setPrefixes(ipv4, ipv6);
+	REQUIRE(!filter(both, "8.8.8.8", "10.1.2.3"));
+	REQUIRE(filter(dst, "8.8.8.8", "10.1.2.3"));
+	REQUIRE(!filter(dst, "10.1.2.3", "8.8.8.8"));
+}
+
+Test::TestResult HostFilterTest::execTest()
+{
+	std::cout << "Testing PrefixSet and HostFilter..." << std::endl;
+	srand(1);
+	testPrefixSet(4);
+	testPrefixSet(16);
+	testHostFilter();
+
+	std::cout << "All tests on PrefixSet and HostFilter passed" << std::endl;
+	return PASSED;
+}
@@ -0,0 +1,16 @@
+#ifndef _HOSTFILTER_TEST_H_
+#define _HOSTFILTER_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * tests PrefixSet and the HostFilter using it
+ */
+class HostFilterTest : public Test
+{
+	public:
+		HostFilterTest();
+		virtual TestResult execTest();
+};
+
+#endif
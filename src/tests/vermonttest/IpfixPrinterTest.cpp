@@ -0,0 +1,153 @@
+#include "IpfixPrinterTest.h"
+
+#include <modules/ipfix/IpfixPrinter.hpp>
+#include <common/ipfixlolib/ipfix.h>
+#include <core/InstanceManager.h>
+
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+
+IpfixPrinterTest::IpfixPrinterTest()
+{
+}
+
+struct TestField {
+	uint16_t id;
+	uint32_t enterprise;
+	uint16_t length;
+};
+
+/* one field of each formatter, the reverse and unknown IEs test the naming of keys */
+static const TestField fields[] = {
+	{ IPFIX_TYPEID_sourceIPv4Address, 0, 4 },
+	{ IPFIX_TYPEID_destinationIPv6Address, 0, 16 },
+	{ IPFIX_TYPEID_sourceTransportPort, 0, 2 },
+	{ IPFIX_TYPEID_protocolIdentifier, 0, 1 },
+	{ IPFIX_TYPEID_octetDeltaCount, 0, 8 },
+	{ IPFIX_TYPEID_octetDeltaCount, IPFIX_PEN_reverse, 8 },
+	{ IPFIX_TYPEID_flowStartMilliseconds, 0, 8 },
+	{ IPFIX_TYPEID_flowStartMicroseconds, 0, 8 },
+	{ IPFIX_TYPEID_sourceMacAddress, 0, 6 },
+	{ IPFIX_TYPEID_interfaceName, 0, 6 },
+	{ 7, 12345, 3 },
+};
+
+static boost::shared_ptr<TemplateInfo> createTemplate()
+{
+	boost::shared_ptr<TemplateInfo> templateInfo(new TemplateInfo);
+	templateInfo->templateId = 256;
+	templateInfo->setId = TemplateInfo::IpfixTemplate;
+	templateInfo->fieldCount = ARRAY_SIZE(fields);
+	templateInfo->fieldInfo = (TemplateInfo::FieldInfo*)calloc(templateInfo->fieldCount, sizeof(TemplateInfo::FieldInfo));
+	uint16_t offset = 0;
+	for (int i = 0; i < templateInfo->fieldCount; i++) {
+		templateInfo->fieldInfo[i].type.id = fields[i].id;
+		templateInfo->fieldInfo[i].type.enterprise = fields[i].enterprise;
+		templateInfo->fieldInfo[i].type.length = fields[i].length;
+		templateInfo->fieldInfo[i].offset = offset;
+		offset += fields[i].length;
+	}
+	return templateInfo;
+}
+
+static void putUint(uint8_t* p, uint64_t v, unsigned length)
+{
+	for (unsigned i = length; i > 0; i--) {
+		p[i - 1] = v & 0xFF;
+		v >>= 8;
+	}
+}
+
+static IpfixDataRecord* createRecord(boost::shared_ptr<TemplateInfo> templateInfo, uint16_t port, uint64_t octets,
+		uint64_t revOctets)
+{
+	static InstanceManager<IpfixDataRecord> im("IpfixDataRecord");
+	const TemplateInfo::FieldInfo* fi = templateInfo->fieldInfo;
+	int length = fi[templateInfo->fieldCount - 1].offset + fi[templateInfo->fieldCount - 1].type.length;
+	boost::shared_array<IpfixRecord::Data> data(new IpfixRecord::Data[length]);
+	uint8_t* p = data.get();
+
+	inet_pton(AF_INET, "10.0.0.1", p + fi[0].offset);
+	inet_pton(AF_INET6, "2001:db8::1", p + fi[1].offset);
+	putUint(p + fi[2].offset, port, 2);
+	putUint(p + fi[3].offset, 6, 1);
+	putUint(p + fi[4].offset, octets, 8);
+	putUint(p + fi[5].offset, revOctets, 8);
+	putUint(p + fi[6].offset, 1700000000123ULL, 8);
+	// NTP timestamp of 1700000000.5 s
+	putUint(p + fi[7].offset, ((1700000000ULL + 2208988800ULL) << 32) | 0x80000000, 8);
+	memcpy(p + fi[8].offset, "\x00\x11\x22\xaa\xbb\xcc", 6);
+	memcpy(p + fi[9].offset, "eth\"0\x01", 6);
+	memcpy(p + fi[10].offset, "\xab\xcd\xef", 3);
+
+	IpfixDataRecord* record = im.getNewInstance();
+	record->templateInfo = templateInfo;
+	record->dataLength = length;
+	record->message = data;
+	record->data = data.get();
+	return record;
+}
+
+static std::string readFile(const std::string& fileName)
+{
+	std::string content;
+	FILE* f = fopen(fileName.c_str(), "rb");
+	REQUIRE(f != NULL);
+	char buf[4096];
+	size_t n;
+	while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+		content.append(buf, n);
+	fclose(f);
+	return content;
+}
+
+/**
+ * prints two Data Records and compares the lines byte for byte
+ */
+static void testJson(const std::string& fileName)
+{
+	static InstanceManager<IpfixTemplateRecord> im("IpfixTemplateRecord");
+	boost::shared_ptr<TemplateInfo> templateInfo = createTemplate();
+	{
+		IpfixPrinter printer(IpfixPrinter::JSON, fileName);
+		IpfixTemplateRecord* templateRecord = im.getNewInstance();
+		templateRecord->templateInfo = templateInfo;
+		printer.onTemplate(templateRecord);
+		printer.onDataRecord(createRecord(templateInfo, 443, 123456789012ULL, 42));
+		printer.onDataRecord(createRecord(templateInfo, 80, 0, 18446744073709551615ULL));
+		// the records are written at the latest when the printer is destroyed
+	}
+
+	std::string expected =
+		"{\"sourceIPv4Address\":\"10.0.0.1\",\"destinationIPv6Address\":\"2001:db8::1\","
+		"\"sourceTransportPort\":443,\"protocolIdentifier\":6,\"octetDeltaCount\":123456789012,"
+		"\"revOctetDeltaCount\":42,\"flowStartMilliseconds\":1700000000123,"
+		"\"flowStartMicroseconds\":1700000000500000,\"sourceMacAddress\":\"00:11:22:aa:bb:cc\","
+		"\"interfaceName\":\"eth\\\"0\\u0001\",\"12345_7\":\"abcdef\"}\n"
+		"{\"sourceIPv4Address\":\"10.0.0.1\",\"destinationIPv6Address\":\"2001:db8::1\","
+		"\"sourceTransportPort\":80,\"protocolIdentifier\":6,\"octetDeltaCount\":0,"
+		"\"revOctetDeltaCount\":18446744073709551615,\"flowStartMilliseconds\":1700000000123,"
+		"\"flowStartMicroseconds\":1700000000500000,\"sourceMacAddress\":\"00:11:22:aa:bb:cc\","
+		"\"interfaceName\":\"eth\\\"0\\u0001\",\"12345_7\":\"abcdef\"}\n";
+	std::string output = readFile(fileName);
+	if (output != expected)
+		std::cerr << "IpfixPrinter printed:" << std::endl << output;
+	REQUIRE(output == expected);
+}
+
+Test::TestResult IpfixPrinterTest::execTest()
+{
+	std::cout << "running tests on IpfixPrinter" << std::endl;
+	char dir[] = "/tmp/vermont-tests-ipfixprinter-XXXXXX";
+	REQUIRE(mkdtemp(dir) != NULL);
+	std::string fileName = std::string(dir) + "/records.json";
+	testJson(fileName);
+	unlink(fileName.c_str());
+	rmdir(dir);
+	std::cout << "All tests on IpfixPrinter passed" << std::endl;
+	return PASSED;
+}
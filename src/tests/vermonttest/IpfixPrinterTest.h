@@ -0,0 +1,16 @@
+#ifndef _IPFIXPRINTER_TEST_H_
+#define _IPFIXPRINTER_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * tests the json output type of the IpfixPrinter
+ */
+class IpfixPrinterTest : public Test
+{
+	public:
+		IpfixPrinterTest();
+		virtual TestResult execTest();
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "PacketHashSplitterTest.h"
+#include "TestPacket.h"
+
+#include <modules/packet/PacketHashSplitter.h>
+
+#include <arpa/inet.h>
+#include <stdlib.h>
+#include <iostream>
+
+PacketHashSplitterTest::PacketHashSplitterTest()
+{
+}
+
+/**
+ * remembers which branch received the last packet
+ */
+class BranchDestination : public Destination<Packet*>
+{
+public:
+	BranchDestination(int index, int* last) : index(index), last(last), count(0) { }
+
+	virtual void receive(Packet* p)
+	{
+		p->removeReference();
+		*last = index;
+		count++;
+	}
+
+	int index;
+	int* last;
+	unsigned count;
+};
+
+struct Endpoint {
+	uint8_t address[16];
+	uint16_t port;
+};
+
+/**
+ * creates a TCP packet between two IPv4 or IPv6 endpoints, fragmentOffset
+ * 0xffff creates the first fragment of a fragmented packet
+ */
+static Packet* createPacket(bool ipv6, const Endpoint& src, const Endpoint& dst, uint16_t fragmentOffset = 0,
+		uint8_t hopLimit = 64)
+{
+	TestPacket packet(ipv6, src.address, dst.address);
+	packet.ports(ntohs(src.port), ntohs(dst.port)).hopLimit(hopLimit);
+	if (fragmentOffset == 0xffff)
+		packet.fragment(0, true);
+	else if (fragmentOffset)
+		packet.fragment(fragmentOffset, false);
+	return packet.create();
+}
+
+static Endpoint randomEndpoint()
+{
+	Endpoint e;
+	for (unsigned i = 0; i < 16; i++)
+		e.address[i] = rand();
+	e.port = rand();
+	return e;
+}
+
+static void testDistribution(bool ipv6)
+{
+	const int branches = 4;
+	const int flows = 4000;
+	int last = -1;
+	PacketHashSplitter splitter;
+	BranchDestination* destinations[branches];
+	for (int i = 0; i < branches; i++) {
+		destinations[i] = new BranchDestination(i, &last);
+		splitter.connectTo(destinations[i]);
+	}
+
+	for (int i = 0; i < flows; i++) {
+		Endpoint a = randomEndpoint();
+		Endpoint b = randomEndpoint();
+		// both directions of a flow take the same branch
+		splitter.receive(createPacket(ipv6, a, b));
+		int forward = last;
+		splitter.receive(createPacket(ipv6, b, a));
+		REQUIRE(last == forward);
+
+		// flows differing in a port only are distributed independently
+		if (i % 10 == 0) {
+			b.port++;
+			splitter.receive(createPacket(ipv6, a, b));
+		}
+	}
+
+	for (int i = 0; i < branches; i++) {
+		REQUIRE(destinations[i]->count > flows / branches);
+		REQUIRE(destinations[i]->count < 3 * flows / branches);
+	}
+	splitter.disconnect();
+	for (int i = 0; i < branches; i++)
+		delete destinations[i];
+}
+
+static void testFragments()
+{
+	int last = -1;
+	PacketHashSplitter splitter;
+	BranchDestination first(0, &last);
+	BranchDestination second(1, &last);
+	BranchDestination third(2, &last);
+	splitter.connectTo(&first);
+	splitter.connectTo(&second);
+	splitter.connectTo(&third);
+
+	for (int i = 0; i < 100; i++) {
+		Endpoint a = randomEndpoint();
+		Endpoint b = randomEndpoint();
+		splitter.receive(createPacket(false, a, b, 0xffff));
+		int branch = last;
+		// later fragments do not have ports
+		Endpoint c = a;
+		Endpoint d = b;
+		c.port = rand();
+		d.port = rand();
+		splitter.receive(createPacket(false, c, d, 185));
+		REQUIRE(last == branch);
+	}
+	splitter.disconnect();
+}
+
+static void testIPv6Ports()
+{
+	int last = -1;
+	PacketHashSplitter splitter;
+	BranchDestination first(0, &last);
+	BranchDestination second(1, &last);
+	splitter.connectTo(&first);
+	splitter.connectTo(&second);
+
+	int moved = 0;
+	for (int i = 0; i < 100; i++) {
+		Endpoint a = randomEndpoint();
+		Endpoint b = randomEndpoint();
+		// the hop limit differs between the directions of a flow
+		Packet* forward = createPacket(true, a, b, 0, 64);
+		Packet* reverse = createPacket(true, b, a, 0, 57);
+		uint32_t hash = PacketHashSplitter::flowHash(forward);
+		REQUIRE(PacketHashSplitter::flowHash(reverse) == hash);
+		splitter.receive(forward);
+		int branch = last;
+		splitter.receive(reverse);
+		REQUIRE(last == branch);
+
+		b.port++;
+		Packet* other = createPacket(true, a, b);
+		REQUIRE(PacketHashSplitter::flowHash(other) != hash);
+		splitter.receive(other);
+		if (last != branch)
+			moved++;
+	}
+	// about half of the flows differing in a port only take the other branch
+	REQUIRE(moved > 25);
+	splitter.disconnect();
+}
+
+/**
+ * returns the hash of a TCP packet between two IPv6 endpoints
+ */
+static uint32_t hashIPv6(const TestPacket& packet)
+{
+	Packet* p = packet.create();
+	uint32_t hash = PacketHashSplitter::flowHash(p);
+	p->removeReference();
+	return hash;
+}
+
+static void testIPv6ExtensionHeaders()
+{
+	for (int i = 0; i < 100; i++) {
+		Endpoint a = randomEndpoint();
+		Endpoint b = randomEndpoint();
+		uint16_t portA = ntohs(a.port);
+		uint16_t portB = ntohs(b.port);
+		uint32_t hash = hashIPv6(TestPacket(true, a.address, b.address).ports(portA, portB));
+
+		// an extension header in one direction only
+		REQUIRE(hashIPv6(TestPacket(true, b.address, a.address).ports(portB, portA).extensionHeader(0)) == hash);
+		REQUIRE(hashIPv6(TestPacket(true, a.address, b.address).ports(portA, portB)
+				.extensionHeader(0).extensionHeader(60)) == hash);
+
+		// fragment headers behind other extension headers, later fragments have no ports
+		uint32_t fragment = hashIPv6(TestPacket(true, a.address, b.address).ports(portA, portB).fragment(0, true));
+		REQUIRE(hashIPv6(TestPacket(true, a.address, b.address).ports(portA + 1, portB + 1)
+				.extensionHeader(0).fragment(185, false)) == fragment);
+		REQUIRE(hashIPv6(TestPacket(true, b.address, a.address).ports(portB, portA)
+				.extensionHeader(60).fragment(0, true)) == fragment);
+	}
+}
+
+Test::TestResult PacketHashSplitterTest::execTest()
+{
+	std::cout << "running tests on PacketHashSplitter" << std::endl;
+	testDistribution(false);
+	testDistribution(true);
+	testFragments();
+	testIPv6Ports();
+	testIPv6ExtensionHeaders();
+	std::cout << "All tests on PacketHashSplitter passed" << std::endl;
+	return PASSED;
+}
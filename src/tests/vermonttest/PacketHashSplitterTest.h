@@ -0,0 +1,16 @@
+#ifndef _PACKETHASHSPLITTER_TEST_H_
+#define _PACKETHASHSPLITTER_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * tests the distribution of flows by the PacketHashSplitter
+ */
+class PacketHashSplitterTest : public Test
+{
+	public:
+		PacketHashSplitterTest();
+		virtual TestResult execTest();
+};
+
+#endif
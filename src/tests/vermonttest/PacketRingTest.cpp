@@ -0,0 +1,162 @@
+#include "PacketRingTest.h"
+#include "TestPacket.h"
+
+#include <modules/packet/PacketRing.h>
+
+#include <arpa/inet.h>
+#include <pcap.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+
+PacketRingTest::PacketRingTest()
+{
+}
+
+struct StoredPacket {
+	uint32_t sec;
+	std::string frame;
+};
+
+/**
+ * reads all packets of a pcap file written by PacketRing::extract()
+ */
+static std::vector<StoredPacket> readPcap(const std::string& fileName)
+{
+	std::vector<StoredPacket> packets;
+	FILE* f = fopen(fileName.c_str(), "rb");
+	REQUIRE(f != NULL);
+	uint32_t header[6];
+	REQUIRE(fread(header, sizeof(header), 1, f) == 1);
+	REQUIRE(header[0] == 0xa1b2c3d4);
+	REQUIRE(header[5] == DLT_EN10MB);
+
+	uint32_t record[4];
+	while (fread(record, sizeof(record), 1, f) == 1) {
+		StoredPacket p;
+		p.sec = record[0];
+		p.frame.resize(record[2]);
+		REQUIRE(record[2] == record[3]);
+		REQUIRE(fread(&p.frame[0], record[2], 1, f) == 1);
+		packets.push_back(p);
+	}
+	fclose(f);
+	return packets;
+}
+
+static TestPacket createPacket(const char* src, const char* dst, uint16_t srcPort, uint16_t dstPort, time_t sec)
+{
+	TestPacket packet(src, dst);
+	packet.ports(srcPort, dstPort).time(sec).payload(std::string(sec % 7, 'x'));
+	return packet;
+}
+
+/**
+ * stores packets of several seconds and extracts time ranges of them
+ */
+static void testExtract(const std::string& dir)
+{
+	std::string pcapFile = dir + "/extract.pcap";
+	PacketRing ring("", 1 << 20, DLT_EN10MB, "");
+	ring.performStart();
+
+	std::vector<StoredPacket> sent;
+	for (uint32_t sec = 100; sec < 110; sec++) {
+		for (uint16_t i = 0; i < 3; i++) {
+			TestPacket packet = createPacket("10.0.0.1", "10.0.0.2", 1000 + i, 80, sec);
+			StoredPacket p = { sec, packet.frame() };
+			sent.push_back(p);
+			ring.receive(packet.create());
+		}
+		TestPacket packet = createPacket("10.0.0.3", "10.0.0.1", 53, 2000, sec);
+		StoredPacket p = { sec, packet.frame() };
+		sent.push_back(p);
+		ring.receive(packet.create());
+	}
+
+	// all hosts, the packets of seconds 102 to 105 in the order they were stored
+	REQUIRE(ring.extract(102, 105, 0, 0, pcapFile) == 16);
+	std::vector<StoredPacket> packets = readPcap(pcapFile);
+	REQUIRE(packets.size() == 16);
+	for (size_t i = 0; i < packets.size(); i++) {
+		REQUIRE(packets[i].sec == sent[8 + i].sec);
+		REQUIRE(packets[i].frame == sent[8 + i].frame);
+	}
+
+	// a single host in either direction
+	REQUIRE(ring.extract(102, 105, inet_addr("10.0.0.3"), 0, pcapFile) == 4);
+	packets = readPcap(pcapFile);
+	REQUIRE(packets.size() == 4);
+	for (size_t i = 0; i < packets.size(); i++) {
+		REQUIRE(packets[i].sec == 102 + i);
+		REQUIRE(packets[i].frame == sent[11 + 4 * i].frame);
+	}
+	REQUIRE(ring.extract(100, 109, inet_addr("10.0.0.1"), 0, pcapFile) == 40);
+
+	// a host and port
+	REQUIRE(ring.extract(100, 109, inet_addr("10.0.0.1"), htons(1001), pcapFile) == 10);
+	REQUIRE(ring.extract(100, 109, inet_addr("10.0.0.2"), htons(80), pcapFile) == 30);
+	REQUIRE(ring.extract(100, 109, inet_addr("10.0.0.2"), htons(53), pcapFile) == 0);
+
+	// ranges without packets
+	REQUIRE(ring.extract(90, 99, 0, 0, pcapFile) == 0);
+	REQUIRE(ring.extract(110, 120, 0, 0, pcapFile) == 0);
+	REQUIRE(readPcap(pcapFile).empty());
+
+	ring.performShutdown();
+	unlink(pcapFile.c_str());
+}
+
+/**
+ * fills a small ring, so the oldest seconds are overwritten and packets wrap around its end
+ */
+static void testEviction(const std::string& dir)
+{
+	std::string pcapFile = dir + "/eviction.pcap";
+	std::string ringFile = dir + "/ring";
+	PacketRing ring(ringFile, 1000, DLT_EN10MB, "");
+	ring.performStart();
+
+	std::vector<StoredPacket> sent;
+	for (uint32_t sec = 100; sec < 130; sec++) {
+		TestPacket packet = createPacket("10.0.0.1", "10.0.0.2", 1000, 80, sec);
+		StoredPacket p = { sec, packet.frame() };
+		sent.push_back(p);
+		ring.receive(packet.create());
+	}
+
+	uint64_t stored = ring.extract(0, 200, 0, 0, pcapFile);
+	REQUIRE(stored > 0);
+	REQUIRE(stored < sent.size());
+	std::vector<StoredPacket> packets = readPcap(pcapFile);
+	REQUIRE(packets.size() == stored);
+	// the newest packets are kept
+	for (size_t i = 0; i < packets.size(); i++) {
+		const StoredPacket& expected = sent[sent.size() - stored + i];
+		REQUIRE(packets[i].sec == expected.sec);
+		REQUIRE(packets[i].frame == expected.frame);
+	}
+
+	uint32_t oldest = packets.front().sec;
+	REQUIRE(ring.extract(0, oldest - 1, 0, 0, pcapFile) == 0);
+	REQUIRE(ring.extract(oldest, oldest + 1, 0, 0, pcapFile) == 2);
+
+	ring.performShutdown();
+	unlink(pcapFile.c_str());
+	unlink(ringFile.c_str());
+}
+
+Test::TestResult PacketRingTest::execTest()
+{
+	std::cout << "running tests on PacketRing" << std::endl;
+	char dir[] = "/tmp/vermont-tests-packetring-XXXXXX";
+	REQUIRE(mkdtemp(dir) != NULL);
+	testExtract(dir);
+	testEviction(dir);
+	rmdir(dir);
+	std::cout << "All tests on PacketRing passed" << std::endl;
+	return PASSED;
+}
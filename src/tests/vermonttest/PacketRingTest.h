@@ -0,0 +1,16 @@
+#ifndef _PACKETRING_TEST_H_
+#define _PACKETRING_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * tests storing packets in the PacketRing and extracting them by time, host and port
+ */
+class PacketRingTest : public Test
+{
+	public:
+		PacketRingTest();
+		virtual TestResult execTest();
+};
+
+#endif
@@ -0,0 +1,177 @@
+#include "PayloadFilterTest.h"
+#include "TestPacket.h"
+
+#include <common/MultiPatternMatcher.h>
+#include <modules/packet/filter/StringFilter.h>
+#include <modules/packet/filter/RegExFilter.h>
+
+#include <stdlib.h>
+#include <iostream>
+#include <set>
+#include <stdexcept>
+#include <utility>
+
+typedef std::set<std::pair<unsigned, size_t> > MatchSet;
+
+struct CollectMatches
+{
+	MatchSet matches;
+
+	bool operator()(unsigned id, size_t end)
+	{
+		matches.insert(std::make_pair(id, end));
+		return true;
+	}
+};
+
+PayloadFilterTestSuite::PayloadFilterTestSuite()
+{
+}
+
+static void testClassicPatterns()
+{
+	MultiPatternMatcher m;
+	m.addPattern("he");
+	m.addPattern("she");
+	m.addPattern("his");
+	m.addPattern("hers");
+	m.compile();
+
+	std::string text = "ushers";
+	CollectMatches c;
+	m.scan((const uint8_t*)text.data(), text.size(), c);
+	REQUIRE(c.matches.size() == 3);
+	REQUIRE(c.matches.count(std::make_pair(1u, (size_t)4)));
+	REQUIRE(c.matches.count(std::make_pair(0u, (size_t)4)));
+	REQUIRE(c.matches.count(std::make_pair(3u, (size_t)6)));
+
+	// scanning without compiling the added pattern would miss it
+	m.addPattern("us");
+	bool thrown = false;
+	try {
+		m.scan((const uint8_t*)text.data(), text.size(), c);
+	} catch (std::runtime_error&) {
+		thrown = true;
+	}
+	REQUIRE(thrown);
+}
+
+/**
+ * compares all matches with a naive search, small alphabets produce many
+ * overlapping patterns and many candidates for the prefilter
+ */
+static void testRandomPatterns(unsigned alphabet, unsigned patternCount)
+{
+	MultiPatternMatcher m;
+	std::vector<std::string> patterns;
+	for (unsigned p = 0; p < patternCount; p++) {
+		std::string s;
+		size_t len = 1 + rand() % 6;
+		for (size_t i = 0; i < len; i++)
+			s += (char)('a' + rand() % alphabet);
+		patterns.push_back(s);
+		REQUIRE(m.addPattern(s) == p);
+	}
+	m.compile();
+
+	for (unsigned round = 0; round < 20; round++) {
+		std::string text;
+		size_t len = rand() % 300;
+		for (size_t i = 0; i < len; i++)
+			text += (char)(rand() % 4 == 0 ? 'a' + rand() % alphabet : 'A' + rand() % 26);
+
+		MatchSet expected;
+		for (unsigned p = 0; p < patterns.size(); p++) {
+			for (size_t pos = text.find(patterns[p]); pos != std::string::npos; pos = text.find(patterns[p], pos + 1))
+				expected.insert(std::make_pair(p, pos + patterns[p].size()));
+		}
+		CollectMatches c;
+		m.scan((const uint8_t*)text.data(), text.size(), c);
+		REQUIRE(c.matches == expected);
+	}
+}
+
+static void testLiteralPrefix()
+{
+	REQUIRE(RegExFilter::literalPrefix("GET /index") == "GET /index");
+	REQUIRE(RegExFilter::literalPrefix("User-Agent: .*curl") == "User-Agent: ");
+	REQUIRE(RegExFilter::literalPrefix("abc?d") == "ab");
+	REQUIRE(RegExFilter::literalPrefix("abc+d") == "abc");
+	REQUIRE(RegExFilter::literalPrefix("a\\.b\\d") == "a.b");
+	REQUIRE(RegExFilter::literalPrefix("abc|def") == "");
+	REQUIRE(RegExFilter::literalPrefix("ab(c|d)") == "ab");
+	REQUIRE(RegExFilter::literalPrefix("a[|]b") == "a");
+	REQUIRE(RegExFilter::literalPrefix("^abc") == "");
+	REQUIRE(RegExFilter::literalPrefix("(?i)abc") == "");
+	REQUIRE(RegExFilter::literalPrefix("ab\\<cd") == "ab");
+	REQUIRE(RegExFilter::literalPrefix("\\<foo") == "");
+	REQUIRE(RegExFilter::literalPrefix("foo\\>") == "foo");
+	REQUIRE(RegExFilter::literalPrefix("\\`GET") == "");
+	REQUIRE(RegExFilter::literalPrefix("ab\\'") == "ab");
+}
+
+static bool filter(PacketProcessor& f, const std::string& payload)
+{
+	// the bytes behind the payload must not be matched
+	Packet* p = TestPacket("195.37.132.190", "91.32.249.51").ports(5003, 1811).tcpFlags(0x18)
+		.payload(payload).padding("0000").create();
+	bool result = f.processPacket(p);
+	p->removeReference();
+	return result;
+}
+
+static void testStringFilter()
+{
+	StringFilter f;
+	f.addandFilter("GET ");
+	f.addandFilter("HTTP/1.1");
+	f.addnotFilter("Host: example");
+	f.compile();
+
+	REQUIRE(filter(f, "GET / HTTP/1.1\r\nHost: vermont\r\n") == true);
+	REQUIRE(filter(f, "GET / HTTP/1.0\r\n") == false);
+	REQUIRE(filter(f, "GET / HTTP/1.1\r\nHost: example.org\r\n") == false);
+	REQUIRE(filter(f, "POST / HTTP/1.1\r\n") == false);
+	REQUIRE(filter(f, "GET / HTTP/1.") == false);
+	REQUIRE(filter(f, std::string("GET \0 HTTP/1.1", 14)) == true);
+}
+
+static void testRegExFilter()
+{
+	RegExFilter f;
+	f.addPattern("User-Agent: [a-z]+/[0-9]");
+	f.addPattern("\\bpassw(or)?d=");
+	f.addPattern("a{3}|b{3}");
+	f.addPattern("\\<foo");
+	f.compile();
+
+	REQUIRE(filter(f, "GET / HTTP/1.1\r\nUser-Agent: curl/7.0\r\n") == true);
+	REQUIRE(filter(f, "GET / HTTP/1.1\r\nUser-Agent: Curl/7.0\r\n") == false);
+	REQUIRE(filter(f, "user=x&passwd=y") == true);
+	REQUIRE(filter(f, "user=x&mypasswd=y") == false);
+	REQUIRE(filter(f, "xxbbbxx") == true);
+	REQUIRE(filter(f, std::string("\0User-Agent: wget/1", 19)) == true);
+	REQUIRE(filter(f, "password") == false);
+	REQUIRE(filter(f, "pass") == false);
+	// assertions are not part of the literal prefix
+	REQUIRE(filter(f, "a foo") == true);
+	REQUIRE(filter(f, "afoo") == false);
+}
+
+Test::TestResult PayloadFilterTestSuite::execTest()
+{
+	std::cout << "Testing MultiPatternMatcher..." << std::endl;
+	srand(1);
+	testClassicPatterns();
+	testRandomPatterns(2, 5);
+	testRandomPatterns(4, 50);
+	testRandomPatterns(26, 300);
+
+	std::cout << "Testing StringFilter and RegExFilter..." << std::endl;
+	testLiteralPrefix();
+	testStringFilter();
+	testRegExFilter();
+
+	std::cout << "All tests on payload filters passed" << std::endl;
+	return PASSED;
+}
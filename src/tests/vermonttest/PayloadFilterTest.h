@@ -0,0 +1,16 @@
+#ifndef _PAYLOADFILTER_TEST_H_
+#define _PAYLOADFILTER_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * tests MultiPatternMatcher and the StringFilter and RegExFilter using it
+ */
+class PayloadFilterTestSuite : public Test
+{
+	public:
+		PayloadFilterTestSuite();
+		virtual TestResult execTest();
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "SamplerTest.h"
+
+#include <common/Xoshiro256.h>
+#include <modules/packet/filter/RandomSampler.h>
+#include <modules/packet/filter/FilterProgram.h>
+
+#include <iostream>
+#include <set>
+
+SamplerTest::SamplerTest()
+{
+}
+
+static void testXoshiro()
+{
+	Xoshiro256 a(42), b(42), c(43);
+	bool differs = false;
+	for (int i = 0; i < 1000; i++) {
+		uint64_t x = a.next();
+		REQUIRE(x == b.next());
+		differs |= x != c.next();
+	}
+	REQUIRE(differs);
+
+	// mean of geometric skips with p = 0.01 is (1 - p) / p = 99
+	double invLogQ = 1.0 / log1p(-0.01);
+	uint64_t sum = 0;
+	unsigned below10 = 0;
+	for (int i = 0; i < 100000; i++) {
+		uint32_t r = a.below(10);
+		REQUIRE(r < 10);
+		below10 += r == 3;
+		sum += a.geometric(invLogQ);
+	}
+	REQUIRE(sum > 9700000 && sum < 10100000);
+	REQUIRE(below10 > 9500 && below10 < 10500);
+}
+
+/**
+ * n-out-of-N sampling accepts exactly n packets of every window of N
+ * packets, at positions which change between windows
+ */
+static void testMaskSampling()
+{
+	RandomSampler sampler(3, 10, false, 1);
+	std::set<std::vector<bool> > patterns;
+	for (int window = 0; window < 100; window++) {
+		std::vector<bool> pattern;
+		int accepted = 0;
+		for (int i = 0; i < 10; i++) {
+			pattern.push_back(sampler.processPacket(NULL));
+			accepted += pattern.back();
+		}
+		REQUIRE(accepted == 3);
+		patterns.insert(pattern);
+	}
+	REQUIRE(patterns.size() > 50);
+}
+
+static void testGeometricSampling()
+{
+	RandomSampler a(1, 100, true, 7);
+	RandomSampler b(1, 100, true, 7);
+	std::vector<PacketProcessor*> processors(1, &b);
+	FilterProgram program;
+	program.compile(processors);
+
+	unsigned accepted = 0;
+	for (int i = 0; i < 1000000; i++) {
+		bool sampled = a.processPacket(NULL);
+		REQUIRE(program.run(NULL) == sampled);
+		accepted += sampled;
+	}
+	REQUIRE(accepted > 9700 && accepted < 10300);
+
+	RandomSampler all(5, 5, true, 7);
+	RandomSampler none(0, 5, true, 7);
+	for (int i = 0; i < 100; i++) {
+		REQUIRE(all.processPacket(NULL));
+		REQUIRE(!none.processPacket(NULL));
+	}
+}
+
+Test::TestResult SamplerTest::execTest()
+{
+	std::cout << "Testing samplers..." << std::endl;
+	testXoshiro();
+	testMaskSampling();
+	testGeometricSampling();
+
+	std::cout << "All tests on samplers passed" << std::endl;
+	return PASSED;
+}
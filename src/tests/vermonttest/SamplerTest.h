@@ -0,0 +1,16 @@
+#ifndef _SAMPLER_TEST_H_
+#define _SAMPLER_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * tests Xoshiro256 and the RandomSampler using it
+ */
+class SamplerTest : public Test
+{
+	public:
+		SamplerTest();
+		virtual TestResult execTest();
+};
+
+#endif
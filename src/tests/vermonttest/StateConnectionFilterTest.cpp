@@ -0,0 +1,94 @@
+#include "StateConnectionFilterTest.h"
+#include "TestPacket.h"
+
+#include <modules/packet/filter/StateConnectionFilter.h>
+
+#include <iostream>
+
+StateConnectionFilterTest::StateConnectionFilterTest()
+{
+}
+
+static const uint8_t SYN = 0x02;
+static const uint8_t ACK = 0x10;
+static const uint8_t FIN = 0x01;
+
+static bool filter(StateConnectionFilter& f, uint16_t port, uint8_t flags, unsigned payload, time_t sec)
+{
+	// from 10.0.0.1:port to 10.0.0.2:80
+	Packet* p = TestPacket("10.0.0.1", "10.0.0.2").ports(port, 80).tcpFlags(flags)
+		.payload(std::string(payload, '\0')).time(sec).create();
+	bool result = f.processPacket(p);
+	p->removeReference();
+	return result;
+}
+
+static void testExport()
+{
+	StateConnectionFilter f(10, 100);
+	f.setExportControlPackets(false);
+
+	REQUIRE(!filter(f, 1000, ACK, 20, 0)); // no SYN seen
+	REQUIRE(!filter(f, 1000, SYN, 0, 0));
+	REQUIRE(f.getConnectionCount() == 1);
+	REQUIRE(filter(f, 1000, ACK, 20, 1));
+	REQUIRE(filter(f, 1000, ACK, 20, 1));
+	REQUIRE(!filter(f, 1000, ACK, 20, 1)); // export limit reached
+	REQUIRE(f.getConnectionCount() == 0);
+	REQUIRE(!filter(f, 1000, ACK, 20, 1));
+
+	REQUIRE(!filter(f, 1001, SYN, 0, 2));
+	REQUIRE(!filter(f, 1001, FIN, 0, 2));
+	REQUIRE(f.getConnectionCount() == 0);
+	REQUIRE(!filter(f, 1001, ACK, 20, 2));
+}
+
+static void testExpiry()
+{
+	StateConnectionFilter f(10, 1000, 128);
+
+	REQUIRE(filter(f, 2000, SYN, 0, 100));
+	REQUIRE(filter(f, 2001, SYN, 0, 100));
+	REQUIRE(filter(f, 2000, ACK, 10, 105));
+	REQUIRE(filter(f, 2000, ACK, 10, 115)); // last seen at 105
+	REQUIRE(!filter(f, 2001, ACK, 10, 115)); // idle for 15 seconds
+	REQUIRE(f.getConnectionCount() == 1);
+
+	// connections which are never seen again are swept out
+	for (uint16_t port = 3000; port < 3100; port++)
+		filter(f, port, SYN, 0, 200);
+	REQUIRE(f.getConnectionCount() == 100);
+	for (int i = 0; i < 1000; i++)
+		filter(f, 4000, FIN, 0, 300);
+	REQUIRE(f.getConnectionCount() == 0);
+}
+
+static void testCapacity()
+{
+	StateConnectionFilter f(0, 1000, 64);
+
+	for (uint16_t port = 5000; port < 6000; port++) {
+		filter(f, port, SYN, 0, port);
+		REQUIRE(f.getConnectionCount() <= 64);
+	}
+	REQUIRE(f.getConnectionCount() == 64);
+
+	// the most recent connections survive, older ones are likely replaced
+	unsigned known = 0;
+	for (uint16_t port = 5000; port < 6000; port++) {
+		if (filter(f, port, ACK, 10, 10000))
+			known++;
+	}
+	REQUIRE(known == 64);
+	REQUIRE(filter(f, 5999, ACK, 10, 10000));
+}
+
+Test::TestResult StateConnectionFilterTest::execTest()
+{
+	std::cout << "running tests on StateConnectionFilter" << std::endl;
+	testExport();
+	testExpiry();
+	testCapacity();
+	std::cout << "All tests on StateConnectionFilter passed" << std::endl;
+	return PASSED;
+}
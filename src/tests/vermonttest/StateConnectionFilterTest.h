@@ -0,0 +1,16 @@
+#ifndef _STATECONNECTIONFILTER_TEST_H_
+#define _STATECONNECTIONFILTER_TEST_H_
+
+#include "TestSuiteBase.h"
+
+/**
+ * tests the connection table of the StateConnectionFilter
+ */
+class StateConnectionFilterTest : public Test
+{
+	public:
+		StateConnectionFilterTest();
+		virtual TestResult execTest();
+};
+
+#endif
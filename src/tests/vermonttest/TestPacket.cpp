@@ -0,0 +1,178 @@
+#include "TestPacket.h"
+
+#include <core/InstanceManager.h>
+
+#include <arpa/inet.h>
+#include <string.h>
+
+TestPacket::TestPacket(const char* src, const char* dst, uint8_t protocol)
+	: ipv6(strchr(src, ':') != NULL),
+	  protocol(protocol),
+	  srcPort(0),
+	  dstPort(0),
+	  flags(0),
+	  hops(64),
+	  fragmentOffset(0),
+	  moreFragments(false),
+	  sec(0)
+{
+	memset(this->src, 0, sizeof(this->src));
+	memset(this->dst, 0, sizeof(this->dst));
+	inet_pton(ipv6 ? AF_INET6 : AF_INET, src, this->src);
+	inet_pton(ipv6 ? AF_INET6 : AF_INET, dst, this->dst);
+}
+
+TestPacket::TestPacket(bool ipv6, const uint8_t* src, const uint8_t* dst, uint8_t protocol)
+	: ipv6(ipv6),
+	  protocol(protocol),
+	  srcPort(0),
+	  dstPort(0),
+	  flags(0),
+	  hops(64),
+	  fragmentOffset(0),
+	  moreFragments(false),
+	  sec(0)
+{
+	memset(this->src, 0, sizeof(this->src));
+	memset(this->dst, 0, sizeof(this->dst));
+	memcpy(this->src, src, ipv6 ? 16 : 4);
+	memcpy(this->dst, dst, ipv6 ? 16 : 4);
+}
+
+TestPacket& TestPacket::ports(uint16_t src, uint16_t dst)
+{
+	srcPort = src;
+	dstPort = dst;
+	return *this;
+}
+
+TestPacket& TestPacket::tcpFlags(uint8_t flags)
+{
+	this->flags = flags;
+	return *this;
+}
+
+TestPacket& TestPacket::hopLimit(uint8_t hops)
+{
+	this->hops = hops;
+	return *this;
+}
+
+TestPacket& TestPacket::fragment(uint16_t offset, bool more)
+{
+	fragmentOffset = offset;
+	moreFragments = more;
+	return *this;
+}
+
+TestPacket& TestPacket::extensionHeader(uint8_t type)
+{
+	extensions += (char)type;
+	return *this;
+}
+
+TestPacket& TestPacket::payload(const std::string& data)
+{
+	payloadData = data;
+	return *this;
+}
+
+TestPacket& TestPacket::padding(const std::string& data)
+{
+	paddingData = data;
+	return *this;
+}
+
+TestPacket& TestPacket::time(time_t sec)
+{
+	this->sec = sec;
+	return *this;
+}
+
+std::string TestPacket::frame() const
+{
+	std::string transport;
+	if (protocol == 6) {
+		transport.assign(20, '\0');
+		transport[12] = 0x50;
+		transport[13] = flags;
+	} else if (protocol == 17) {
+		transport.assign(8, '\0');
+		uint16_t length = transport.size() + payloadData.size();
+		transport[4] = length >> 8;
+		transport[5] = length & 0xff;
+	}
+	if (!transport.empty()) {
+		transport[0] = srcPort >> 8;
+		transport[1] = srcPort & 0xff;
+		transport[2] = dstPort >> 8;
+		transport[3] = dstPort & 0xff;
+	}
+	uint16_t length = transport.size() + payloadData.size();
+
+	std::string ip;
+	if (ipv6) {
+		std::string types = extensions;
+		if (fragmentOffset || moreFragments)
+			types += (char)44;
+		// every extension header holds the type of the next header
+		std::string headers;
+		for (size_t i = 0; i < types.size(); i++) {
+			std::string header(8, '\0');
+			header[0] = i + 1 < types.size() ? types[i + 1] : protocol;
+			if (types[i] == 44) {
+				header[2] = fragmentOffset >> 5;
+				header[3] = (fragmentOffset << 3) | (moreFragments ? 1 : 0);
+			}
+			headers += header;
+		}
+		length += headers.size();
+
+		ip.assign(40, '\0');
+		ip[0] = 0x60;
+		ip[4] = length >> 8;
+		ip[5] = length & 0xff;
+		ip[6] = types.empty() ? protocol : types[0];
+		ip[7] = hops;
+		ip.replace(8, 16, (const char*)src, 16);
+		ip.replace(24, 16, (const char*)dst, 16);
+		ip += headers;
+	} else {
+		ip.assign(20, '\0');
+		length += ip.size();
+		ip[0] = 0x45;
+		ip[2] = length >> 8;
+		ip[3] = length & 0xff;
+		ip[6] = (moreFragments ? 0x20 : 0) | (fragmentOffset >> 8);
+		ip[7] = fragmentOffset & 0xff;
+		ip[8] = hops;
+		ip[9] = protocol;
+		ip.replace(12, 4, (const char*)src, 4);
+		ip.replace(16, 4, (const char*)dst, 4);
+	}
+
+	std::string ethernet(14, '\0');
+	ethernet[12] = ipv6 ? 0x86 : 0x08;
+	ethernet[13] = ipv6 ? 0xdd : 0x00;
+
+	return ethernet + ip + transport + payloadData + paddingData;
+}
+
+Packet* TestPacket::create() const
+{
+	return create(frame(), sec);
+}
+
+Packet* TestPacket::create(const std::string& frame, time_t sec)
+{
+	struct timeval time = { sec, 0 };
+	Packet* p = newPacket();
+	p->init((char*)frame.data(), frame.size(), time, 0, frame.size(), DLT_EN10MB);
+	return p;
+}
+
+Packet* TestPacket::newPacket()
+{
+	static InstanceManager<Packet> packetManager("Packet");
+	return packetManager.getNewInstance();
+}
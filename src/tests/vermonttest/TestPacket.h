@@ -0,0 +1,84 @@
+#ifndef _TEST_PACKET_H_
+#define _TEST_PACKET_H_
+
+#include <modules/packet/Packet.h>
+
+#include <stdint.h>
+#include <time.h>
+#include <string>
+
+/**
+ * builds Ethernet frames with an IPv4 or IPv6 header, a TCP or UDP header
+ * and a payload for the unit tests. Values are given in host byte order,
+ * unset header fields are zero.
+ */
+class TestPacket
+{
+public:
+	/**
+	 * addresses in text form, their family selects IPv4 or IPv6
+	 */
+	TestPacket(const char* src, const char* dst, uint8_t protocol = 6);
+
+	/**
+	 * addresses of 4 or 16 bytes in network byte order
+	 */
+	TestPacket(bool ipv6, const uint8_t* src, const uint8_t* dst, uint8_t protocol = 6);
+
+	TestPacket& ports(uint16_t src, uint16_t dst);
+	TestPacket& tcpFlags(uint8_t flags);
+	TestPacket& hopLimit(uint8_t hops);
+
+	/**
+	 * sets the fragment offset in units of 8 bytes and the more fragments flag,
+	 * IPv6 packets get a fragment header behind the other extension headers
+	 */
+	TestPacket& fragment(uint16_t offset, bool more);
+
+	/**
+	 * adds an IPv6 extension header of 8 bytes, like hop-by-hop (0) or
+	 * destination options (60)
+	 */
+	TestPacket& extensionHeader(uint8_t type);
+
+	TestPacket& payload(const std::string& data);
+
+	/**
+	 * appends bytes behind the IP packet, which are not part of it
+	 */
+	TestPacket& padding(const std::string& data);
+
+	TestPacket& time(time_t sec);
+
+	std::string frame() const;
+
+	Packet* create() const;
+
+	/**
+	 * returns a Packet initialised with the given frame
+	 */
+	static Packet* create(const std::string& frame, time_t sec = 0);
+
+	/**
+	 * returns a Packet which has not been initialised yet
+	 */
+	static Packet* newPacket();
+
+private:
+	bool ipv6;
+	uint8_t src[16];
+	uint8_t dst[16];
+	uint8_t protocol;
+	uint16_t srcPort;
+	uint16_t dstPort;
+	uint8_t flags;
+	uint8_t hops;
+	uint16_t fragmentOffset;
+	bool moreFragments;
+	std::string extensions; /**< types of the IPv6 extension headers */
+	std::string payloadData;
+	std::string paddingData;
+	time_t sec;
+};
+
+#endif
@@ -4,7 +4,16 @@
 #include "AggregationPerfTest.h"
 #include "ReconfTest.h"
 #include "BloomFilterTest.h" 
+#include "BloomFilterPerfTest.h"
 #include "ConnectionFilterTest.h"
+#include "PayloadFilterTest.h"
+#include "FilterProgramTest.h"
+#include "SamplerTest.h"
+#include "HostFilterTest.h"
+#include "StateConnectionFilterTest.h"
+#include "PacketHashSplitterTest.h"
+#include "PacketRingTest.h"
+#include "IpfixPrinterTest.h"
 #include "test_concentrator.h"
 #include "ConfigTester.h"
 
@@ -49,8 +58,17 @@ int main(int argc, char* argv[])
 	testSuite.add(new ReconfTest());
 	testSuite.add(new AggregationPerfTest(!perftest));
 	testSuite.add(new ConcentratorTestSuite());
+	testSuite.add(new PayloadFilterTestSuite());
+	testSuite.add(new FilterProgramTest());
+	testSuite.add(new SamplerTest());
+	testSuite.add(new HostFilterTest());
+	testSuite.add(new StateConnectionFilterTest());
+	testSuite.add(new PacketHashSplitterTest());
+	testSuite.add(new PacketRingTest());
+	testSuite.add(new IpfixPrinterTest());
 #ifdef HAVE_CONNECTION_FILTER
 	testSuite.add(new BloomFilterTestSuite());
+	testSuite.add(new BloomFilterPerfTest(!perftest));
 	testSuite.add(new ConnectionFilterTestSuite());
 #endif
 	testSuite.add(new ConfigTester(config_dir));
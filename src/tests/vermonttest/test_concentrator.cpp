@@ -2,6 +2,7 @@
 
 #include "modules/ipfix/IpfixParser.hpp"
 #include "common/ipfixlolib/ipfixlolib.h"
+#include "common/ipfixlolib/ipfixlolib_config.h"
 #include "modules/ipfix/IpfixSender.hpp"
 #include "modules/ipfix/IpfixRawdirReader.hpp"
 #include "modules/ipfix/IpfixRawdirWriter.hpp"
@@ -14,6 +15,8 @@
 #include <iostream>
 #include <vector>
 #include <stdlib.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
 
 class TestSink : public IpfixRecordDestination {
 	public:
@@ -243,6 +246,113 @@ void test_ipfixlolib_rawdir() {
 #endif
 }
 
+void test_sender_serialisation() {
+	std::cout << "Testing: IpfixSender serialisation of fixed-length Data Records..." << std::endl;
+
+	const uint16_t port = 4752;
+	const int numRecords = 3;
+
+	int s = socket(AF_INET, SOCK_DGRAM, 0);
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if (s < 0 || bind(s, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		ERROR("Unable to open collector socket. Cannot continue.");
+		return;
+	}
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL) | O_NONBLOCK);
+
+	// source address with mask, packetDeltaCount and a port stored after a gap
+	boost::shared_ptr<TemplateInfo> templateInfo(new TemplateInfo);
+	templateInfo->templateId = 256;
+	templateInfo->setId = TemplateInfo::IpfixTemplate;
+	templateInfo->fieldCount = 3;
+	templateInfo->fieldInfo = (TemplateInfo::FieldInfo*)malloc(templateInfo->fieldCount * sizeof(TemplateInfo::FieldInfo));
+	for (int i = 0; i < templateInfo->fieldCount; i++) {
+		templateInfo->fieldInfo[i].type.enterprise = 0;
+		templateInfo->fieldInfo[i].privDataOffset = 0;
+		templateInfo->fieldInfo[i].isVariableLength = false;
+		templateInfo->fieldInfo[i].basicListData.semantic = 0;
+		templateInfo->fieldInfo[i].basicListData.fieldIe = NULL;
+	}
+	templateInfo->fieldInfo[0].type.id = IPFIX_TYPEID_sourceIPv4Address;
+	templateInfo->fieldInfo[0].type.length = 5;
+	templateInfo->fieldInfo[0].offset = 0;
+	templateInfo->fieldInfo[1].type.id = IPFIX_TYPEID_packetDeltaCount;
+	templateInfo->fieldInfo[1].type.length = 8;
+	templateInfo->fieldInfo[1].offset = 5;
+	templateInfo->fieldInfo[2].type.id = IPFIX_TYPEID_destinationTransportPort;
+	templateInfo->fieldInfo[2].type.length = 2;
+	templateInfo->fieldInfo[2].offset = 16;
+	const uint16_t wireLength = 4 + 1 + 8 + 2;
+
+	{
+		IpfixSender ipfixSender(0xbeef);
+		ipfix_aux_config_udp acu;
+		acu.mtu = 1500;
+		ipfixSender.addCollector("127.0.0.1", port, UDP, &acu, "");
+		ipfixSender.start();
+
+		ipfixSender.receive(createTestTemplateRecord(0, templateInfo));
+		for (int i = 0; i < numRecords; i++) {
+			static InstanceManager<IpfixDataRecord> im("IpfixDataRecord");
+			IpfixDataRecord* record = im.getNewInstance();
+			boost::shared_array<uint8_t> data(new uint8_t[18]);
+			memset(data.get(), 0xee, 18);
+			data[0] = 10; data[1] = 0; data[2] = 0; data[3] = i;
+			data[4] = 8; // network mask is converted to a prefix length
+			uint64_t packets = htonll(i + 1);
+			memcpy(&data[5], &packets, sizeof(packets));
+			data[16] = 0; data[17] = 80 + i;
+			record->sourceID = createTestSourceId(0);
+			record->templateInfo = templateInfo;
+			record->dataLength = 18;
+			record->message = data;
+			record->data = data.get();
+			ipfixSender.receive(record);
+		}
+		// sends the cached Data Records
+		ipfixSender.receive(createTestTemplateDestructionRecord(0, templateInfo));
+		ipfixSender.shutdown();
+	}
+
+	usleep(100000);
+	uint8_t buf[IPFIX_MAX_PACKETSIZE];
+	ssize_t len;
+	int receivedRecords = 0;
+	while ((len = recv(s, buf, sizeof(buf), 0)) > 0) {
+		uint8_t* p = buf + sizeof(ipfix_header);
+		while (p + sizeof(ipfix_set_header) <= buf + len) {
+			ipfix_set_header* set = (ipfix_set_header*)p;
+			if (ntohs(set->set_id) == 256) {
+				if (ntohs(set->length) != sizeof(ipfix_set_header) + numRecords * wireLength) {
+					ERROR("Data Set has unexpected length");
+					break;
+				}
+				for (int i = 0; i < numRecords; i++) {
+					uint8_t* r = p + sizeof(ipfix_set_header) + i * wireLength;
+					uint64_t packets;
+					memcpy(&packets, r + 5, sizeof(packets));
+					if (r[0] != 10 || r[3] != i || r[4] != 24 || ntohll(packets) != (uint64_t)i + 1 ||
+							r[13] != 0 || r[14] != 80 + i)
+						ERROR("Data Record got corrupted during serialisation");
+					receivedRecords++;
+				}
+			}
+			p += ntohs(set->length);
+		}
+	}
+	close(s);
+
+	if (receivedRecords != numRecords) {
+		char msg[256];
+		snprintf(msg, 255, "IpfixSender should have sent %d records, but sent %d", numRecords, receivedRecords);
+		ERROR(msg);
+	}
+}
+
 void test_parser_stability() {
 
 	boost::shared_ptr<IpfixRecord::SourceID> testSourceId = createTestSourceId(42);
@@ -282,6 +392,8 @@ Test::TestResult ConcentratorTestSuite::execTest()
 
 	test_ipfixlolib_rawdir();
 
+	test_sender_serialisation();
+
 	//test_parser_stability();
 	
 	return Test::FAILED;